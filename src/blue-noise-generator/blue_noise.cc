@@ -0,0 +1,274 @@
+#include "blue_noise.h"
+
+#include <cmath>
+#include <complex>
+#include <random>
+#include <limits>
+
+namespace rtrt
+{
+  namespace
+  {
+    //------------------------------------------------------------------------------------------------------
+    // Toroidal gaussian filter, indexed by the wrapped offset between two pixels
+    std::vector<float> CreateEnergyFilter(int size, float sigma)
+    {
+      std::vector<float> filter(size * size);
+
+      for (int y = 0; y < size; y++)
+      {
+        for (int x = 0; x < size; x++)
+        {
+          int dx = x <= size / 2 ? x : x - size;
+          int dy = y <= size / 2 ? y : y - size;
+          filter[y * size + x] = std::exp(-static_cast<float>(dx * dx + dy * dy) / (2.0f * sigma * sigma));
+        }
+      }
+
+      return filter;
+    }
+
+    //------------------------------------------------------------------------------------------------------
+    void SplatEnergy(std::vector<float>& energy, const std::vector<float>& filter, int size, int pixel, float sign)
+    {
+      int px = pixel % size;
+      int py = pixel / size;
+
+      for (int y = 0; y < size; y++)
+      {
+        const float* row = &filter[((y - py + size) % size) * size];
+        float* out = &energy[y * size];
+
+        for (int x = 0; x < size; x++)
+        {
+          out[x] += sign * row[(x - px + size) % size];
+        }
+      }
+    }
+
+    //------------------------------------------------------------------------------------------------------
+    // The tightest cluster is the set pixel with the highest energy
+    int FindTightestCluster(const std::vector<float>& energy, const std::vector<bool>& pattern)
+    {
+      int best = -1;
+      float best_energy = -std::numeric_limits<float>::max();
+
+      for (int i = 0; i < static_cast<int>(pattern.size()); i++)
+      {
+        if (pattern[i] == true && energy[i] > best_energy)
+        {
+          best = i;
+          best_energy = energy[i];
+        }
+      }
+
+      return best;
+    }
+
+    //------------------------------------------------------------------------------------------------------
+    // The largest void is the unset pixel with the lowest energy
+    int FindLargestVoid(const std::vector<float>& energy, const std::vector<bool>& pattern)
+    {
+      int best = -1;
+      float best_energy = std::numeric_limits<float>::max();
+
+      for (int i = 0; i < static_cast<int>(pattern.size()); i++)
+      {
+        if (pattern[i] == false && energy[i] < best_energy)
+        {
+          best = i;
+          best_energy = energy[i];
+        }
+      }
+
+      return best;
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  std::vector<UINT> BlueNoise::GenerateVoidAndCluster(int size, float sigma, UINT seed)
+  {
+    const int num_pixels = size * size;
+    const int num_initial = num_pixels / 10;
+
+    std::vector<float> filter = CreateEnergyFilter(size, sigma);
+    std::vector<UINT> ranks(num_pixels, 0);
+
+    // Initial binary pattern: random points, relaxed by repeatedly moving the tightest cluster into the largest void
+    std::vector<bool> initial_pattern(num_pixels, false);
+    std::vector<float> initial_energy(num_pixels, 0.0f);
+
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> pixel_distribution(0, num_pixels - 1);
+
+    for (int placed = 0; placed < num_initial;)
+    {
+      int pixel = pixel_distribution(rng);
+
+      if (initial_pattern[pixel] == false)
+      {
+        initial_pattern[pixel] = true;
+        SplatEnergy(initial_energy, filter, size, pixel, 1.0f);
+        placed++;
+      }
+    }
+
+    for (;;)
+    {
+      int cluster = FindTightestCluster(initial_energy, initial_pattern);
+      initial_pattern[cluster] = false;
+      SplatEnergy(initial_energy, filter, size, cluster, -1.0f);
+
+      int hole = FindLargestVoid(initial_energy, initial_pattern);
+      initial_pattern[hole] = true;
+      SplatEnergy(initial_energy, filter, size, hole, 1.0f);
+
+      if (hole == cluster)
+      {
+        break;
+      }
+    }
+
+    // Phase 1: rank the initial points by removing the tightest clusters first
+    std::vector<bool> pattern = initial_pattern;
+    std::vector<float> energy = initial_energy;
+
+    for (int rank = num_initial - 1; rank >= 0; rank--)
+    {
+      int cluster = FindTightestCluster(energy, pattern);
+      pattern[cluster] = false;
+      SplatEnergy(energy, filter, size, cluster, -1.0f);
+      ranks[cluster] = static_cast<UINT>(rank);
+    }
+
+    // Phase 2 & 3: rank the remaining pixels by filling the largest voids first
+    pattern = initial_pattern;
+    energy = initial_energy;
+
+    for (int rank = num_initial; rank < num_pixels; rank++)
+    {
+      int hole = FindLargestVoid(energy, pattern);
+      pattern[hole] = true;
+      SplatEnergy(energy, filter, size, hole, 1.0f);
+      ranks[hole] = static_cast<UINT>(rank);
+    }
+
+    return ranks;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  std::vector<unsigned char> BlueNoise::QuantizeRanks(const std::vector<UINT>& ranks)
+  {
+    std::vector<unsigned char> values(ranks.size());
+
+    for (size_t i = 0; i < ranks.size(); i++)
+    {
+      values[i] = static_cast<unsigned char>((static_cast<UINT64>(ranks[i]) * 256) / ranks.size());
+    }
+
+    return values;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  SpectrumAnalysis BlueNoise::AnalyzeSpectrum(const std::vector<double>& values, int size)
+  {
+    const double pi = 3.14159265358979323846;
+    const int num_pixels = size * size;
+
+    double mean = 0.0;
+    for (double value : values)
+    {
+      mean += value;
+    }
+    mean /= num_pixels;
+
+    double variance = 0.0;
+    for (double value : values)
+    {
+      variance += (value - mean) * (value - mean);
+    }
+    variance /= num_pixels;
+
+    // Separable DFT: first along the rows, then along the columns
+    std::vector<std::complex<double>> twiddles(size);
+    for (int k = 0; k < size; k++)
+    {
+      twiddles[k] = std::polar(1.0, -2.0 * pi * k / size);
+    }
+
+    std::vector<std::complex<double>> rows(num_pixels);
+    for (int y = 0; y < size; y++)
+    {
+      for (int u = 0; u < size; u++)
+      {
+        std::complex<double> sum = 0.0;
+        for (int x = 0; x < size; x++)
+        {
+          sum += (values[y * size + x] - mean) * twiddles[(u * x) % size];
+        }
+        rows[y * size + u] = sum;
+      }
+    }
+
+    std::vector<double> power(num_pixels);
+    for (int u = 0; u < size; u++)
+    {
+      for (int v = 0; v < size; v++)
+      {
+        std::complex<double> sum = 0.0;
+        for (int y = 0; y < size; y++)
+        {
+          sum += rows[y * size + u] * twiddles[(v * y) % size];
+        }
+        // White noise with the same variance has an expected power of 1 at every frequency
+        power[v * size + u] = std::norm(sum) / (num_pixels * variance);
+      }
+    }
+
+    const int max_radius = size / 2;
+
+    SpectrumAnalysis analysis;
+    analysis.radial_power.assign(max_radius + 1, 0.0);
+    std::vector<int> counts(max_radius + 1, 0);
+
+    for (int v = 0; v < size; v++)
+    {
+      for (int u = 0; u < size; u++)
+      {
+        int fu = u <= size / 2 ? u : u - size;
+        int fv = v <= size / 2 ? v : v - size;
+        int radius = static_cast<int>(std::lround(std::sqrt(static_cast<double>(fu * fu + fv * fv))));
+
+        if (radius > 0 && radius <= max_radius)
+        {
+          analysis.radial_power[radius] += power[v * size + u];
+          counts[radius]++;
+        }
+      }
+    }
+
+    double low = 0.0, high = 0.0;
+    int low_count = 0, high_count = 0;
+
+    for (int radius = 1; radius <= max_radius; radius++)
+    {
+      analysis.radial_power[radius] /= counts[radius] > 0 ? counts[radius] : 1;
+
+      if (radius <= max_radius / 8)
+      {
+        low += analysis.radial_power[radius];
+        low_count++;
+      }
+      else if (radius > max_radius / 2)
+      {
+        high += analysis.radial_power[radius];
+        high_count++;
+      }
+    }
+
+    analysis.low_frequency_ratio = low / (low_count > 0 ? low_count : 1);
+    analysis.high_frequency_ratio = high / (high_count > 0 ? high_count : 1);
+
+    return analysis;
+  }
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#define NOMINMAX
+#include <windows.h>
+
+#include <vector>
+
+namespace rtrt
+{
+  // Spectral properties of a tileable mask, computed from its radially averaged power spectrum
+  struct SpectrumAnalysis
+  {
+    std::vector<double> radial_power; // Mean power per integer frequency radius, normalized so white noise is ~1
+    double low_frequency_ratio; // Mean normalized power in the lowest eighth of the frequencies
+    double high_frequency_ratio; // Mean normalized power in the highest half of the frequencies
+  };
+
+  class BlueNoise
+  {
+  public:
+    /**
+    * Generates a tileable blue-noise dither mask using Ulichney's void-and-cluster method.
+    * Every pixel of the returned size * size mask holds a unique rank in [0, size * size).
+    * @param[in] size The width and height of the (square) mask, in pixels
+    * @param[in] sigma The standard deviation of the toroidal gaussian energy filter
+    * @param[in] seed The seed used to generate the initial binary pattern
+    */
+    static std::vector<UINT> GenerateVoidAndCluster(int size, float sigma, UINT seed);
+
+    // Converts a rank mask into 8-bit values that are uniformly distributed over [0, 255]
+    static std::vector<unsigned char> QuantizeRanks(const std::vector<UINT>& ranks);
+
+    /**
+    * Computes the power spectrum of a size * size mask with a direct 2D DFT, the masks are small
+    * @param[in] values The mask, only its variation matters, the mean and the scale are normalized away
+    * @param[in] size The width and height of the (square) mask, in pixels
+    */
+    static SpectrumAnalysis AnalyzeSpectrum(const std::vector<double>& values, int size);
+  };
+}
\ No newline at end of file
@@ -0,0 +1,128 @@
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "blue_noise.h"
+
+#include <DirectXMath.h>
+#include "shared/sampling.h"
+
+#define NUM_CHANNELS 4
+#define FILTER_SIGMA 1.9f
+
+// A blue-noise mask has (almost) no energy in its lowest frequencies and more than white noise in the highest
+#define MAX_LOW_FREQUENCY_RATIO 0.25
+#define MIN_HIGH_FREQUENCY_RATIO 1.0
+
+// Sample counts at which the error of the dithered samples the renderer traces is checked
+static const UINT SAMPLED_CHECK_COUNTS[] = { 1, 2, 4 };
+
+namespace rtrt
+{
+  namespace
+  {
+    //------------------------------------------------------------------------------------------------------
+    bool IsBlue(const SpectrumAnalysis& analysis)
+    {
+      return analysis.low_frequency_ratio <= MAX_LOW_FREQUENCY_RATIO && analysis.high_frequency_ratio >= MIN_HIGH_FREQUENCY_RATIO;
+    }
+
+    //------------------------------------------------------------------------------------------------------
+    // Per pixel error of integrating x^2 over [0, 1) with the first num_samples samples of a sample dimension,
+    // generated the way SAMPLER_TYPE_BLUE_NOISE does it: the shared sequence, rotated by the 8-bit UNORM mask
+    std::vector<double> SampledError(const std::vector<unsigned char>& mask, UINT dimension, UINT num_samples)
+    {
+      std::vector<double> error(mask.size());
+
+      for (size_t i = 0; i < mask.size(); i++)
+      {
+        float offset = static_cast<float>(mask[i]) / 255.0f;
+        double estimate = 0.0;
+
+        for (UINT sample = 0; sample < num_samples; sample++)
+        {
+          double value = CranleyPattersonRotation(LowDiscrepancySample(SAMPLER_TYPE_BLUE_NOISE, 0, sample, dimension), offset);
+          estimate += value * value;
+        }
+
+        error[i] = estimate / num_samples - 1.0 / 3.0;
+      }
+
+      return error;
+    }
+  }
+}
+
+//------------------------------------------------------------------------------------------------------
+// Usage: blue-noise-generator [output directory]
+// Writes textures/blue-noise/blue_noise_<slice>.png, every channel of every slice being an independent
+// void-and-cluster mask. Verifies the spectrum of each mask, and of the error the dithered samples that the
+// renderer derives from it make. Returns non-zero if any of them is not blue.
+int main(int argc, char** argv)
+{
+  using namespace rtrt;
+
+  std::string output_directory = argc > 1 ? argv[1] : "./textures/blue-noise";
+
+  bool all_blue = true;
+
+  for (int slice = 0; slice < BLUE_NOISE_SLICES; slice++)
+  {
+    std::vector<unsigned char> pixels(BLUE_NOISE_SIZE * BLUE_NOISE_SIZE * NUM_CHANNELS);
+
+    for (int channel = 0; channel < NUM_CHANNELS; channel++)
+    {
+      UINT seed = static_cast<UINT>(slice * NUM_CHANNELS + channel + 1);
+      std::vector<unsigned char> values = BlueNoise::QuantizeRanks(BlueNoise::GenerateVoidAndCluster(BLUE_NOISE_SIZE, FILTER_SIGMA, seed));
+
+      for (int i = 0; i < BLUE_NOISE_SIZE * BLUE_NOISE_SIZE; i++)
+      {
+        pixels[i * NUM_CHANNELS + channel] = values[i];
+      }
+
+      SpectrumAnalysis analysis = BlueNoise::AnalyzeSpectrum(std::vector<double>(values.begin(), values.end()), BLUE_NOISE_SIZE);
+      bool is_blue = IsBlue(analysis);
+      all_blue = all_blue && is_blue;
+
+      printf("slice %d channel %d: low frequency power %.3f, high frequency power %.3f %s\n",
+        slice, channel, analysis.low_frequency_ratio, analysis.high_frequency_ratio, is_blue ? "" : "(NOT BLUE)");
+
+      // The mask is only what the sampler starts from, what counts is that the error of the samples is blue too
+      UINT dimension = static_cast<UINT>(slice * NUM_CHANNELS + channel);
+
+      for (UINT num_samples : SAMPLED_CHECK_COUNTS)
+      {
+        SpectrumAnalysis sampled = BlueNoise::AnalyzeSpectrum(SampledError(values, dimension, num_samples), BLUE_NOISE_SIZE);
+        bool is_sampled_blue = IsBlue(sampled);
+        all_blue = all_blue && is_sampled_blue;
+
+        printf("  error after %u sample(s): low frequency power %.3f, high frequency power %.3f %s\n",
+          num_samples, sampled.low_frequency_ratio, sampled.high_frequency_ratio, is_sampled_blue ? "" : "(NOT BLUE)");
+      }
+    }
+
+    std::string path = output_directory + "/blue_noise_" + std::to_string(slice) + ".png";
+    if (stbi_write_png(path.c_str(), BLUE_NOISE_SIZE, BLUE_NOISE_SIZE, NUM_CHANNELS, pixels.data(), BLUE_NOISE_SIZE * NUM_CHANNELS) == 0)
+    {
+      printf("Failed to write %s, does the directory exist?\n", path.c_str());
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Reference point: the same measurement on white noise should be ~1 in both bands
+  std::vector<double> white_noise(BLUE_NOISE_SIZE * BLUE_NOISE_SIZE);
+  for (double& value : white_noise)
+  {
+    value = static_cast<double>(rand() & 0xFF);
+  }
+
+  SpectrumAnalysis reference = BlueNoise::AnalyzeSpectrum(white_noise, BLUE_NOISE_SIZE);
+  printf("white noise reference: low frequency power %.3f, high frequency power %.3f\n", reference.low_frequency_ratio, reference.high_frequency_ratio);
+
+  return all_blue == true ? EXIT_SUCCESS : EXIT_FAILURE;
+}
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include "buffer.h"
 #include "device.h"
 #include "descriptor_heap.h"
+#include "opacity_mask.h"
 
 namespace rtrt
 {
@@ -60,7 +61,8 @@ namespace rtrt
     {
       geometry_descs[i] = {};
       geometry_descs[i].Type = D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES;
-      geometry_descs[i].Flags = D3D12_RAYTRACING_GEOMETRY_FLAG_OPAQUE;
+      // Only alpha tested geometry pays for any-hit invocations
+      geometry_descs[i].Flags = OpacityMaskUtility::HasOpacityMask(model, model.meshes[i].material) ? D3D12_RAYTRACING_GEOMETRY_FLAG_NONE : D3D12_RAYTRACING_GEOMETRY_FLAG_OPAQUE;
 
       geometry_descs[i].Triangles.VertexBuffer.StartAddress = model_vertex_buffers[i]->GetBuffer()->GetGPUVirtualAddress();
       geometry_descs[i].Triangles.VertexBuffer.StrideInBytes = sizeof(Vertex);
@@ -2,9 +2,27 @@
 
 #include "camera.h"
 #include "imgui_layer.h"
+#include "image_writer.h"
 
 namespace rtrt
 {
+  namespace
+  {
+    //------------------------------------------------------------------------------------------------------
+    // 64-bit FNV-1a
+    UINT64 HashBytes(const void* data, size_t size, UINT64 hash = 14695981039346656037ull)
+    {
+      const unsigned char* bytes = static_cast<const unsigned char*>(data);
+
+      for (size_t i = 0; i < size; i++)
+      {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+      }
+
+      return hash;
+    }
+  }
+
   //------------------------------------------------------------------------------------------------------
   Application::Application() :
     camera(nullptr)
@@ -36,6 +54,12 @@ namespace rtrt
     selected_material = -1;
     materials_dirty = false;
 
+    resolution.match_window = true;
+    resolution.size[0] = 1280;
+    resolution.size[1] = 720;
+    resolution.width = 1280;
+    resolution.height = 720;
+
     delta_time = 0.0f;
     previous_timestamp = 0.0f;
     current_timestamp = 0.0f;
@@ -58,15 +82,99 @@ namespace rtrt
     aa.algorithm = AntiAliasing::Algorithm::Random;
     aa.sample_point = DirectX::XMFLOAT2(0.0f, 0.0f);
 
+    sampling.sampler_type = SAMPLER_TYPE_PMJ02;
+    sampling.blue_noise_available = false;
+
+    texture_lod.enabled = true;
+    texture_lod.bias = 0.0f;
+
+    texture_streaming.budget_mb = 512;
+    texture_streaming.resident_size = 0;
+    texture_streaming.num_loading = 0;
+
     pp.gamma = 2.2f;
+    pp.exposure = 0.0f;
+    pp.tonemapper = TONEMAPPER_ACES;
+    pp.firefly_clamp = 0.0f;
+
+    strcpy_s(output.prefix, "render");
+    output.format = ImageWriter::EXR;
+    output.beauty = true;
+    output.normals = false;
+    output.albedo = false;
+    output.variance = false;
+    output.denoised = true;
+    output.interval = 0;
+    output.save = false;
+    output.num_pending = 0;
+
+    strcpy_s(checkpointing.path, "render.checkpoint");
+    checkpointing.interval = 0;
+    checkpointing.save_on_exit = false;
+    checkpointing.save = false;
+    checkpointing.load = false;
+
+    // The backends fill in their names and whether they are available once they are created
+    denoising.method = Denoising::ATrous;
+    for (int i = 0; i < Denoising::NumMethods; i++)
+    {
+      denoising.names[i] = "";
+      denoising.available[i] = false;
+    }
+    denoising.atrous_iterations = 5;
+    denoising.atrous_sigma_luminance = 4.0f;
+    denoising.atrous_normal_sharpness = 7;
+    denoising.readback_frames = 0;
+    denoising.timings = DenoiserTimings{ 0.0, 0.0, 0.0 };
+    denoising.num_threads = 0;
+    denoising.average_utilization = 0.0f;
+    denoising.min_utilization = 0.0f;
+    denoising.tiles_stolen = 0;
 
     gi.bounce_distance = 10000.0f;
     gi.num_bounces = 4;
 
+    adaptive.enabled = false;
+    adaptive.show_heat_map = false;
+    adaptive.min_samples = 16;
+    adaptive.max_samples_per_frame = 4;
+    adaptive.error_threshold = 0.02f;
+    adaptive.converged_tiles = 0;
+    adaptive.num_tiles = 0;
+    adaptive.samples_traced = 0;
+    adaptive.samples_saved = 0;
+
+    frame_budget.enabled = true;
+    frame_budget.target_ms = 16.0f;
+    frame_budget.max_samples_per_frame = 64;
+    frame_budget.samples_per_frame = 1;
+    frame_budget.ms_per_sample = 0.0f;
+    frame_budget.overhead_ms = 0.0f;
+
+    restir.enabled = true;
+    restir.temporal_reuse = true;
+    restir.spatial_reuse = true;
+    restir.candidates = 32;
+    restir.spatial_samples = 5;
+    restir.spatial_radius = 30.0f;
+    restir.history_limit = 20;
+
+    guiding.enabled = false;
+    guiding.reset = true;
+    guiding.probability = 0.5f;
+    guiding.training_samples = 256;
+
+    ray_benchmark.enabled = false;
+    ray_benchmark.pathtrace_ms = 0.0;
+    ray_benchmark.averager_ms = 0.0;
+    ray_benchmark.occlusion_rays_per_second = 0.0;
+    ray_benchmark.closest_hit_rays_per_second = 0.0;
+
     sky_color = DirectX::XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 
-    //model.LoadFromFile("./models/Sponza/glTF/Sponza.gltf");
-    model.LoadFromFile("./models/CornellBox/CornellBox-Sphere.obj");
+    //model_path = "./models/Sponza/glTF/Sponza.gltf";
+    model_path = "./models/CornellBox/CornellBox-Sphere.obj";
+    model.LoadFromFile(model_path);
   }
 
   //------------------------------------------------------------------------------------------------------
@@ -157,10 +265,17 @@ namespace rtrt
     }
 
     previous_cursor_position = current_cursor_position;
-    sample_count = freeze_rendering || (static_cast<int>(sample_count) >= denoise_at_sample) ? sample_count : sample_count + 1;
+
+    // The previous frame traced the samples that were picked for it
+    UINT previous_sample_count = sample_count;
+    sample_count = freeze_rendering || (static_cast<int>(sample_count) >= denoise_at_sample) ? sample_count : sample_count + frame_budget.samples_per_frame;
     frame_count = frame_count + 1;
 
-    ImGui::SetNextWindowSize(ImVec2(400.0f, 720.0f), ImGuiSetCond_Always);
+    // Batch renders save their outputs every so many samples, frames that trace several can step over a multiple
+    output.save = output.interval > 0 && previous_sample_count / static_cast<UINT>(output.interval) != sample_count / static_cast<UINT>(output.interval) ? true : output.save;
+    checkpointing.save = checkpointing.interval > 0 && previous_sample_count / static_cast<UINT>(checkpointing.interval) != sample_count / static_cast<UINT>(checkpointing.interval) ? true : checkpointing.save;
+
+    ImGui::SetNextWindowSize(ImVec2(400.0f, ImGui::GetIO().DisplaySize.y), ImGuiSetCond_Always);
     ImGui::SetNextWindowPos(ImVec2(0.0f, 0.0f), ImGuiSetCond_Always);
     ImGui::Begin("Settings", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
     
@@ -194,6 +309,27 @@ namespace rtrt
       ImGui::EndChild();
     }
 
+    // Resolution
+    {
+      ImGui::BeginChild("Resolution", ImVec2(380, 80), true);
+
+      ImGui::TextColored(ImVec4(0.2f, 1.0f, 0.0f, 1.0f), "Resolution");
+
+      // Switching to a fixed size starts out at the current size
+      if (ImGui::Checkbox("Match Window", &resolution.match_window) && !resolution.match_window)
+      {
+        resolution.size[0] = static_cast<int>(resolution.width);
+        resolution.size[1] = static_cast<int>(resolution.height);
+      }
+
+      if (!resolution.match_window)
+      {
+        ImGui::InputInt2("Size", resolution.size);
+      }
+
+      ImGui::EndChild();
+    }
+
     // Lens
     {
       ImGui::BeginChild("Lens", ImVec2(380, 80), true);
@@ -234,20 +370,306 @@ namespace rtrt
       clear_samples = ImGui::Checkbox("Anti Aliasing", &aa.enabled) ? true : clear_samples;
 
       const char* items[] = { "Random", "Stratified 2x", "Stratified 4x", "Stratified 8x", "Stratified 16x" };
-      clear_samples = ImGui::Combo("AA Algorithm", reinterpret_cast<int*>(&aa.algorithm), items, 5) ? true : clear_samples;
+      clear_samples = ImGui::Combo("AA Algorithm", reinterpret_cast<int*>(&aa.algorithm), items, AntiAliasing::NumAlgorithms) ? true : clear_samples;
+
+      ImGui::EndChild();
+    }
+
+    // Sampling
+    {
+      ImGui::BeginChild("Sampling", ImVec2(380, 75), true);
+
+      ImGui::TextColored(ImVec4(0.2f, 1.0f, 0.0f, 1.0f), "Sampling");
+
+      const char* items[] = { "LCG", "Sobol (Owen scrambled)", "PMJ02 (Shuffled Sobol)", "Blue noise (PMJ02 rotated)" };
+      clear_samples = ImGui::Combo("Sampler", reinterpret_cast<int*>(&sampling.sampler_type), items, SAMPLER_TYPE_COUNT) ? true : clear_samples;
+
+      if (sampling.blue_noise_available == false)
+      {
+        ImGui::Text("No blue-noise tiles, run blue-noise-generator");
+
+        if (sampling.sampler_type == SAMPLER_TYPE_BLUE_NOISE)
+        {
+          sampling.sampler_type = SAMPLER_TYPE_PMJ02;
+        }
+      }
+
+      ImGui::EndChild();
+    }
+
+    // Texture level of detail
+    {
+      ImGui::BeginChild("Texture LOD", ImVec2(380, 150), true);
+
+      ImGui::TextColored(ImVec4(0.2f, 1.0f, 0.0f, 1.0f), "Texture LOD");
+
+      clear_samples = ImGui::Checkbox("Ray Cone Mip Selection", &texture_lod.enabled) ? true : clear_samples;
+      clear_samples = ImGui::SliderFloat("LOD Bias", &texture_lod.bias, -2.0f, 2.0f) ? true : clear_samples;
+
+      ImGui::InputInt("Texture Budget (MB)", &texture_streaming.budget_mb, 64, 256);
+      texture_streaming.budget_mb = std::max(texture_streaming.budget_mb, 64);
+
+      ImGui::LabelText("Resident textures", "%.1f MB", texture_streaming.resident_size / (1024.0 * 1024.0));
+      ImGui::LabelText("Loading textures", "%u", texture_streaming.num_loading);
+
+      ImGui::EndChild();
+    }
+
+    // Adaptive sampling
+    {
+      ImGui::BeginChild("Adaptive Sampling", ImVec2(380, 190), true);
+
+      ImGui::TextColored(ImVec4(0.2f, 1.0f, 0.0f, 1.0f), "Adaptive Sampling");
+
+      clear_samples = ImGui::Checkbox("Adaptive Sampling", &adaptive.enabled) ? true : clear_samples;
+      ImGui::Checkbox("Convergence Heat Map", &adaptive.show_heat_map);
+
+      ImGui::InputInt("Min Samples", &adaptive.min_samples, 1, 10);
+      adaptive.min_samples = std::max(adaptive.min_samples, 2);
+
+      // The frame budget takes over the maximum when it is enabled
+      if (frame_budget.enabled)
+      {
+        ImGui::LabelText("Max Samples Per Frame", "%u (frame budget)", frame_budget.samples_per_frame);
+      }
+      else
+      {
+        ImGui::InputInt("Max Samples Per Frame", &adaptive.max_samples_per_frame, 1, 1);
+        adaptive.max_samples_per_frame = std::max(std::min(adaptive.max_samples_per_frame, 16), 1);
+      }
+
+      ImGui::InputFloat("Error Threshold", &adaptive.error_threshold, 0.001f, 0.01f, 3);
+      adaptive.error_threshold = std::max(adaptive.error_threshold, 0.001f);
+
+      ImGui::LabelText("Converged tiles", "%u / %u", adaptive.converged_tiles, adaptive.num_tiles);
+      ImGui::LabelText("Samples traced", "%llu", adaptive.samples_traced);
+      ImGui::LabelText("Samples saved", "%llu", adaptive.samples_saved);
+
+      ImGui::EndChild();
+    }
+
+    // Frame budget
+    {
+      ImGui::BeginChild("Frame Budget", ImVec2(380, 170), true);
+
+      ImGui::TextColored(ImVec4(0.2f, 1.0f, 0.0f, 1.0f), "Frame Budget");
+
+      ImGui::Checkbox("Fit Samples To Frame Time", &frame_budget.enabled);
+
+      ImGui::InputFloat("Target Frame Time (ms)", &frame_budget.target_ms, 1.0f, 10.0f, 1);
+      frame_budget.target_ms = std::max(frame_budget.target_ms, 1.0f);
+
+      ImGui::InputInt("Max Samples Per Frame", &frame_budget.max_samples_per_frame, 1, 16);
+      frame_budget.max_samples_per_frame = std::max(std::min(frame_budget.max_samples_per_frame, 256), 1);
+
+      ImGui::LabelText("Samples per frame", "%u", frame_budget.samples_per_frame);
+      ImGui::LabelText("Per sample", "%.2f ms", frame_budget.ms_per_sample);
+      ImGui::LabelText("Overhead", "%.2f ms", frame_budget.overhead_ms);
+
+      ImGui::EndChild();
+    }
+
+    // ReSTIR
+    {
+      ImGui::BeginChild("ReSTIR DI", ImVec2(380, 210), true);
+
+      ImGui::TextColored(ImVec4(0.2f, 1.0f, 0.0f, 1.0f), "ReSTIR DI");
+
+      clear_samples = ImGui::Checkbox("Reservoir Resampling", &restir.enabled) ? true : clear_samples;
+      clear_samples = ImGui::Checkbox("Temporal Reuse", &restir.temporal_reuse) ? true : clear_samples;
+      clear_samples = ImGui::Checkbox("Spatial Reuse", &restir.spatial_reuse) ? true : clear_samples;
+
+      if (restir.enabled && (restir.temporal_reuse || restir.spatial_reuse))
+      {
+        ImGui::Text("Reuse is biased, the result differs from the reference");
+      }
+
+      clear_samples = ImGui::InputInt("Candidates", &restir.candidates, 1, 8) ? true : clear_samples;
+      restir.candidates = std::max(std::min(restir.candidates, 64), 1);
+
+      clear_samples = ImGui::InputInt("Spatial Samples", &restir.spatial_samples, 1, 1) ? true : clear_samples;
+      restir.spatial_samples = std::max(std::min(restir.spatial_samples, 16), 0);
+
+      clear_samples = ImGui::InputFloat("Spatial Radius", &restir.spatial_radius, 1.0f, 10.0f, 1) ? true : clear_samples;
+      restir.spatial_radius = std::max(restir.spatial_radius, 1.0f);
+
+      clear_samples = ImGui::InputInt("History Limit", &restir.history_limit, 1, 5) ? true : clear_samples;
+      restir.history_limit = std::max(restir.history_limit, 1);
+
+      ImGui::EndChild();
+    }
+
+    // Ray benchmark
+    {
+      ImGui::BeginChild("Ray Benchmark", ImVec2(380, 120), true);
+
+      ImGui::TextColored(ImVec4(0.2f, 1.0f, 0.0f, 1.0f), "Ray Benchmark");
+
+      ImGui::LabelText("Pathtrace GPU time", "%.2f ms", ray_benchmark.pathtrace_ms);
+      ImGui::LabelText("Averager GPU time", "%.3f ms", ray_benchmark.averager_ms);
+      ImGui::Checkbox("Benchmark Occlusion Rays", &ray_benchmark.enabled);
+
+      if (ray_benchmark.enabled)
+      {
+        ImGui::LabelText("Occlusion", "%.1f Mrays/s", ray_benchmark.occlusion_rays_per_second / 1e6);
+        ImGui::LabelText("Closest hit", "%.1f Mrays/s", ray_benchmark.closest_hit_rays_per_second / 1e6);
+      }
+
+      ImGui::EndChild();
+    }
+
+    // Path guiding
+    {
+      ImGui::BeginChild("Path Guiding", ImVec2(380, 125), true);
+
+      ImGui::TextColored(ImVec4(0.2f, 1.0f, 0.0f, 1.0f), "Path Guiding");
+
+      if (ImGui::Checkbox("Path Guiding", &guiding.enabled))
+      {
+        clear_samples = true;
+        guiding.reset = true;
+      }
+
+      clear_samples = ImGui::InputFloat("Guiding Probability", &guiding.probability, 0.05f, 0.1f, 2) ? true : clear_samples;
+      guiding.probability = std::max(std::min(guiding.probability, 0.95f), 0.05f);
+
+      ImGui::InputInt("Training Samples", &guiding.training_samples, 16, 128);
+      guiding.training_samples = std::max(guiding.training_samples, 0);
+
+      if (ImGui::Button("Reset Guiding"))
+      {
+        clear_samples = true;
+        guiding.reset = true;
+      }
 
       ImGui::EndChild();
     }
 
     // Post processing
     {
-      ImGui::BeginChild("Post Processing", ImVec2(380, 55), true);
+      ImGui::BeginChild("Post Processing", ImVec2(380, 125), true);
 
       ImGui::TextColored(ImVec4(0.2f, 1.0f, 0.0f, 1.0f), "Post Processing");
 
-      ImGui::InputFloat("Gamma Correction", &pp.gamma, 0.1f, 1.0f, 1);
+      const char* tonemappers[] = { "None", "Reinhard", "Filmic", "ACES" };
+      bool changed = ImGui::Combo("Tonemapper", &pp.tonemapper, tonemappers, 4);
+
+      changed = ImGui::InputFloat("Exposure", &pp.exposure, 0.5f, 1.0f, 1) ? true : changed;
+
+      changed = ImGui::InputFloat("Gamma Correction", &pp.gamma, 0.1f, 1.0f, 1) ? true : changed;
       pp.gamma = std::max(pp.gamma, 0.1f);
 
+      // Clamping changes what is accumulated, unlike the settings above that only change how it is displayed
+      clear_samples = ImGui::InputFloat("Firefly Clamp", &pp.firefly_clamp, 1.0f, 10.0f, 1) ? true : clear_samples;
+      pp.firefly_clamp = std::max(pp.firefly_clamp, 0.0f);
+
+      // Denoised images are tonemapped on the CPU, so they are redone with the new settings
+      denoised = changed ? false : denoised;
+
+      ImGui::EndChild();
+    }
+
+    // Output
+    {
+      ImGui::BeginChild("Output", ImVec2(380, 150), true);
+
+      ImGui::TextColored(ImVec4(0.2f, 1.0f, 0.0f, 1.0f), "Output");
+
+      ImGui::InputText("Prefix", output.prefix, sizeof(output.prefix));
+      ImGui::Combo("Format", &output.format, ImageWriter::FORMAT_NAMES, ImageWriter::NumFormats);
+
+      ImGui::Checkbox("Beauty", &output.beauty);
+      ImGui::SameLine();
+      ImGui::Checkbox("Normals", &output.normals);
+      ImGui::SameLine();
+      ImGui::Checkbox("Albedo", &output.albedo);
+      ImGui::Checkbox("Variance", &output.variance);
+      ImGui::SameLine();
+      ImGui::Checkbox("Denoised", &output.denoised);
+
+      ImGui::InputInt("Save Every # Samples", &output.interval, 1, 100);
+      output.interval = std::max(output.interval, 0);
+
+      if (ImGui::Button("Save"))
+      {
+        output.save = true;
+      }
+
+      ImGui::SameLine();
+      ImGui::Text("%u images pending", output.num_pending);
+
+      ImGui::EndChild();
+    }
+
+    // Checkpoint
+    {
+      ImGui::BeginChild("Checkpoint", ImVec2(380, 125), true);
+
+      ImGui::TextColored(ImVec4(0.2f, 1.0f, 0.0f, 1.0f), "Checkpoint");
+
+      ImGui::InputText("Path", checkpointing.path, sizeof(checkpointing.path));
+
+      ImGui::InputInt("Save Every # Samples", &checkpointing.interval, 1, 100);
+      checkpointing.interval = std::max(checkpointing.interval, 0);
+
+      ImGui::Checkbox("Save On Exit", &checkpointing.save_on_exit);
+
+      if (ImGui::Button("Save Checkpoint"))
+      {
+        checkpointing.save = true;
+      }
+
+      ImGui::SameLine();
+
+      if (ImGui::Button("Resume Checkpoint"))
+      {
+        checkpointing.load = true;
+      }
+
+      ImGui::EndChild();
+    }
+
+    // Denoising
+    {
+      ImGui::BeginChild("Denoising", ImVec2(380, denoising.method == Denoising::ATrous ? 270.0f : 205.0f), true);
+
+      ImGui::TextColored(ImVec4(0.2f, 1.0f, 0.0f, 1.0f), "Denoising");
+
+      // Changing the denoiser redoes the denoise on the same samples
+      bool changed = false;
+
+      Denoising::Method previous_method = denoising.method;
+      changed = ImGui::Combo("Denoiser", reinterpret_cast<int*>(&denoising.method), denoising.names, Denoising::NumMethods) ? true : changed;
+
+      if (denoising.available[denoising.method] == false)
+      {
+        denoising.method = previous_method;
+        ImGui::Text("That denoiser is unavailable on this machine");
+      }
+
+      if (denoising.method == Denoising::ATrous)
+      {
+        changed = ImGui::InputInt("Iterations", &denoising.atrous_iterations) ? true : changed;
+        denoising.atrous_iterations = std::max(std::min(denoising.atrous_iterations, 6), 1);
+
+        changed = ImGui::InputFloat("Luminance Sigma", &denoising.atrous_sigma_luminance, 0.5f, 1.0f, 1) ? true : changed;
+        denoising.atrous_sigma_luminance = std::max(denoising.atrous_sigma_luminance, 0.1f);
+
+        changed = ImGui::InputInt("Normal Sharpness", &denoising.atrous_normal_sharpness) ? true : changed;
+        denoising.atrous_normal_sharpness = std::max(std::min(denoising.atrous_normal_sharpness, 10), 0);
+
+        ImGui::LabelText("Threads", "%u", denoising.num_threads);
+        ImGui::LabelText("Utilization", "%.0f%% average, %.0f%% lowest", denoising.average_utilization * 100.0f, denoising.min_utilization * 100.0f);
+        ImGui::LabelText("Stolen", "%u tiles", denoising.tiles_stolen);
+      }
+
+      ImGui::LabelText("Readback", "%u frames", denoising.readback_frames);
+      ImGui::LabelText("Input", "%.2f ms", denoising.timings.input_ms);
+      ImGui::LabelText("Denoise", "%.2f ms", denoising.timings.denoise_ms);
+      ImGui::LabelText("Output", "%.2f ms", denoising.timings.output_ms);
+
+      denoised = changed ? false : denoised;
+
       ImGui::EndChild();
     }
 
@@ -264,7 +686,7 @@ namespace rtrt
 
     // Material editing
     {
-      ImGui::BeginChild("Material", ImVec2(380, 145), true);
+      ImGui::BeginChild("Material", ImVec2(380, 170), true);
 
       ImGui::TextColored(ImVec4(0.2f, 1.0f, 0.0f, 1.0f), "Material Editing");
 
@@ -280,6 +702,7 @@ namespace rtrt
 
         materials_dirty = ImGui::ColorEdit4("Emissive", &model.materials[selected_material].color_emissive.x) ? true : materials_dirty;
         materials_dirty = ImGui::ColorEdit4("Diffuse", &model.materials[selected_material].color_diffuse.x) ? true : materials_dirty;
+        materials_dirty = ImGui::ColorEdit4("Specular", &model.materials[selected_material].color_specular.x) ? true : materials_dirty;
         materials_dirty = ImGui::InputFloat("Index of Refraction", &model.materials[selected_material].index_of_refraction, 0.025f, 0.1f, 3) ? true : materials_dirty;
         materials_dirty = ImGui::InputFloat("Roughness", &model.materials[selected_material].glossiness, 0.01f, 0.1f, 3) ? true : materials_dirty;
       }
@@ -289,6 +712,8 @@ namespace rtrt
 
     ImGui::End();
 
+    UpdateResolution(window);
+
     if (materials_dirty)
     {
       clear_samples = true;
@@ -304,9 +729,20 @@ namespace rtrt
       denoised = false;
     }
 
+    UpdateSamplesPerFrame();
+
+    // Hashed from the sample count rather than taken from rand(), so a restored checkpoint continues the same jitter
+    DirectX::XMFLOAT2 random_point = { (static_cast<float>(SamplingHash(sample_count * 2) % 100) / 100.0f) - 0.5f, (static_cast<float>(SamplingHash(sample_count * 2 + 1) % 100) / 100.0f) - 0.5f };
+
+    if (sampling.sampler_type != SAMPLER_TYPE_LCG)
+    {
+      random_point.x = LowDiscrepancySample(sampling.sampler_type, 0, sample_count, 0) - 0.5f;
+      random_point.y = LowDiscrepancySample(sampling.sampler_type, 0, sample_count, 1) - 0.5f;
+    }
+
     DirectX::XMFLOAT2 sampling_points[31] = {
       // Random
-      { (static_cast<float>(rand() % 100) / 100.0f) - 0.5f, (static_cast<float>(rand() % 100) / 100.0f) - 0.5f },
+      random_point,
       // Strat2x
       { 0.25f, 0.25f },
       { -0.25f, -0.25f },
@@ -371,4 +807,230 @@ namespace rtrt
       break;
     }
   }
-}
+
+  //------------------------------------------------------------------------------------------------------
+  void Application::UpdateConvergenceStatistics(UINT converged_tiles, UINT64 tile_samples, UINT max_pixel_samples, UINT num_tiles)
+  {
+    adaptive.converged_tiles = converged_tiles;
+    adaptive.num_tiles = num_tiles;
+    adaptive.samples_traced = tile_samples * CONVERGENCE_TILE_SIZE * CONVERGENCE_TILE_SIZE;
+
+    // Uniform sampling needs as many samples in every tile as the slowest converging tile to reach the same error
+    UINT64 uniform_samples = static_cast<UINT64>(max_pixel_samples) * num_tiles * CONVERGENCE_TILE_SIZE * CONVERGENCE_TILE_SIZE;
+    adaptive.samples_saved = uniform_samples > adaptive.samples_traced ? uniform_samples - adaptive.samples_traced : 0;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void Application::UpdateGpuTimings(double pathtrace_ms, double occlusion_benchmark_ms, double closest_hit_benchmark_ms, double averager_ms, UINT num_benchmark_rays)
+  {
+    ray_benchmark.pathtrace_ms = pathtrace_ms;
+    ray_benchmark.averager_ms = averager_ms;
+    ray_benchmark.occlusion_rays_per_second = occlusion_benchmark_ms > 0.0 ? num_benchmark_rays / (occlusion_benchmark_ms / 1000.0) : 0.0;
+    ray_benchmark.closest_hit_rays_per_second = closest_hit_benchmark_ms > 0.0 ? num_benchmark_rays / (closest_hit_benchmark_ms / 1000.0) : 0.0;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void Application::UpdateFrameBudget(double pathtrace_ms, float samples_traced)
+  {
+    // Frames that did not path trace say nothing about its cost, their time goes to denoising and saving instead
+    if (samples_traced <= 0.0f || pathtrace_ms <= 0.0)
+    {
+      return;
+    }
+
+    // Smoothed, a single hitch should not make the next frames trace a single sample
+    const float smoothing = 0.25f;
+
+    float ms_per_sample = static_cast<float>(pathtrace_ms) / samples_traced;
+    float overhead_ms = std::max(delta_time * 1000.0f - static_cast<float>(pathtrace_ms), 0.0f);
+
+    frame_budget.ms_per_sample = frame_budget.ms_per_sample > 0.0f ? frame_budget.ms_per_sample + (ms_per_sample - frame_budget.ms_per_sample) * smoothing : ms_per_sample;
+    frame_budget.overhead_ms = frame_budget.overhead_ms > 0.0f ? frame_budget.overhead_ms + (overhead_ms - frame_budget.overhead_ms) * smoothing : overhead_ms;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  UINT Application::GetSampleLimit() const
+  {
+    UINT limit = 0;
+
+    if (denoise_at_sample > 0)
+    {
+      limit = static_cast<UINT>(denoise_at_sample);
+    }
+
+    if (freeze_at_sample > 0 && (limit == 0 || static_cast<UINT>(freeze_at_sample) < limit) && static_cast<UINT>(freeze_at_sample) > sample_count)
+    {
+      limit = static_cast<UINT>(freeze_at_sample);
+    }
+
+    return limit;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void Application::GetCheckpointState(Checkpoint::State* out_state) const
+  {
+    out_state->width = resolution.width;
+    out_state->height = resolution.height;
+    out_state->sample_count = sample_count;
+    out_state->frame_count = frame_count;
+    out_state->denoise_at_sample = denoise_at_sample;
+
+    out_state->camera_position = camera->GetPosition();
+    out_state->camera_rotation = camera->GetRotation();
+    out_state->fov_degrees = camera->GetFovDegrees();
+    out_state->lens_diameter = lens.lens_diameter;
+    out_state->focal_length = lens.focal_length;
+
+    out_state->num_bounces = gi.num_bounces;
+    out_state->bounce_distance = gi.bounce_distance;
+    out_state->aa_enabled = aa.enabled ? 1 : 0;
+    out_state->aa_algorithm = static_cast<UINT>(aa.algorithm);
+    out_state->sampler_type = sampling.sampler_type;
+    out_state->sky_color = sky_color;
+    out_state->firefly_clamp = pp.firefly_clamp;
+    out_state->texture_lod_enabled = texture_lod.enabled ? 1 : 0;
+    out_state->texture_lod_bias = texture_lod.bias;
+
+    out_state->exposure = pp.exposure;
+    out_state->tonemapper = pp.tonemapper;
+    out_state->gamma = pp.gamma;
+
+    out_state->scene_hash = GetSceneHash();
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  bool Application::RestoreCheckpointState(const Checkpoint::State& state)
+  {
+    // The sums of another scene, or of materials that were edited since, would blend two different images
+    if (state.scene_hash != GetSceneHash())
+    {
+      return false;
+    }
+
+    // The render continues at the checkpoint's resolution whatever the size of the window
+    resolution.match_window = false;
+    resolution.size[0] = static_cast<int>(state.width);
+    resolution.size[1] = static_cast<int>(state.height);
+    resolution.width = state.width;
+    resolution.height = state.height;
+
+    camera->SetPosition(state.camera_position);
+    camera->SetRotation(state.camera_rotation);
+    camera->SetFovDegrees(state.fov_degrees);
+    camera->SetAspectRatio(static_cast<float>(state.width) / static_cast<float>(state.height));
+    lens.lens_diameter = state.lens_diameter;
+    lens.focal_length = state.focal_length;
+
+    gi.num_bounces = state.num_bounces;
+    gi.bounce_distance = state.bounce_distance;
+    aa.enabled = state.aa_enabled != 0;
+    aa.algorithm = static_cast<AntiAliasing::Algorithm>(state.aa_algorithm);
+    sampling.sampler_type = state.sampler_type;
+    sky_color = state.sky_color;
+    pp.firefly_clamp = state.firefly_clamp;
+    texture_lod.enabled = state.texture_lod_enabled != 0;
+    texture_lod.bias = state.texture_lod_bias;
+
+    pp.exposure = state.exposure;
+    pp.tonemapper = state.tonemapper;
+    pp.gamma = state.gamma;
+
+    sample_count = state.sample_count;
+    frame_count = state.frame_count;
+    denoise_at_sample = state.denoise_at_sample;
+    denoised = false;
+    clear_samples = false;
+
+    // Nothing has been traced into the restored sums yet, and the learned guiding distribution was not saved
+    frame_budget.samples_per_frame = 0;
+    guiding.reset = true;
+
+    return true;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void Application::UpdateTextureStreamingStatistics(UINT64 resident_size, UINT num_loading)
+  {
+    texture_streaming.resident_size = resident_size;
+    texture_streaming.num_loading = num_loading;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void Application::UpdateSamplesPerFrame()
+  {
+    UINT previous = frame_budget.samples_per_frame;
+    UINT samples = 1;
+
+    // While the view changes every frame is thrown away by the next one, so it only has to be quick.
+    // Once it settles the samples ramp up, at most doubling per frame in case the cost estimate is off.
+    if (frame_budget.enabled && clear_samples == false && frame_budget.ms_per_sample > 0.0f)
+    {
+      float available_ms = frame_budget.target_ms - frame_budget.overhead_ms;
+      UINT fit = static_cast<UINT>(std::max(available_ms / frame_budget.ms_per_sample, 1.0f));
+
+      samples = std::min(std::min(fit, previous * 2), static_cast<UINT>(frame_budget.max_samples_per_frame));
+    }
+
+    // Freezing and denoising happen at exactly the sample they were asked for. Adaptive sampling picks the samples
+    // per tile instead, the convergence pass holds every tile to GetSampleLimit.
+    if (denoise_at_sample > static_cast<int>(sample_count))
+    {
+      samples = std::min(samples, static_cast<UINT>(denoise_at_sample) - sample_count);
+    }
+
+    if (freeze_at_sample > static_cast<int>(sample_count))
+    {
+      samples = std::min(samples, static_cast<UINT>(freeze_at_sample) - sample_count);
+    }
+
+    frame_budget.samples_per_frame = std::max(samples, 1u);
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  UINT64 Application::GetSceneHash() const
+  {
+    UINT64 hash = HashBytes(model_path.data(), model_path.size());
+
+    // Everything after the name is plain 4 byte values, without any padding in between
+    for (size_t i = 0; i < model.materials.size(); i++)
+    {
+      const Model::Material& material = model.materials[i];
+      const char* first = reinterpret_cast<const char*>(&material.color_emissive);
+      const char* last = reinterpret_cast<const char*>(&material.opacity_mask + 1);
+
+      hash = HashBytes(first, static_cast<size_t>(last - first), hash);
+    }
+
+    return hash;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void Application::UpdateResolution(GLFWwindow* window)
+  {
+    int width = resolution.size[0];
+    int height = resolution.size[1];
+
+    if (resolution.match_window)
+    {
+      glfwGetFramebufferSize(window, &width, &height);
+
+      // A minimized window has no size, the last resolution is kept until it is restored
+      if (width == 0 || height == 0)
+      {
+        return;
+      }
+    }
+
+    // Large enough for a single convergence tile, small enough for 16 bytes per pixel to fit in a UINT
+    width = std::min(std::max(width, CONVERGENCE_TILE_SIZE), 8192);
+    height = std::min(std::max(height, CONVERGENCE_TILE_SIZE), 8192);
+
+    if (static_cast<UINT>(width) != resolution.width || static_cast<UINT>(height) != resolution.height)
+    {
+      resolution.width = static_cast<UINT>(width);
+      resolution.height = static_cast<UINT>(height);
+      camera->SetAspectRatio(static_cast<float>(width) / static_cast<float>(height));
+      clear_samples = true;
+    }
+  }
+}
\ No newline at end of file
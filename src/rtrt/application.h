@@ -1,6 +1,9 @@
 #pragma once
 
 #include "model.h"
+#include "denoiser.h"
+#include "checkpoint.h"
+#include "shared/sampling.h"
 
 namespace rtrt
 {
@@ -30,7 +33,8 @@ namespace rtrt
       Stratified2,
       Stratified4,
       Stratified8,
-      Stratified16
+      Stratified16,
+      NumAlgorithms
     };
 
     bool enabled;
@@ -38,9 +42,92 @@ namespace rtrt
     DirectX::XMFLOAT2 sample_point;
   };
 
+  struct Sampling
+  {
+    UINT sampler_type;
+    bool blue_noise_available;
+  };
+
+  struct TextureLod
+  {
+    bool enabled;
+    float bias;
+  };
+
+  struct TextureStreaming
+  {
+    int budget_mb;
+
+    UINT64 resident_size;
+    UINT num_loading;
+  };
+
+  struct Resolution
+  {
+    bool match_window; // Follow the size of the window instead of the size entered below
+    int size[2]; // Entered in the UI
+
+    UINT width; // The resolution that is rendered at, the back buffers are stretched to the window
+    UINT height;
+  };
+
   struct PostProcessing
   {
     float gamma;
+    float exposure; // In stops
+    int tonemapper; // One of TONEMAPPER_*
+    float firefly_clamp; // Luminance that samples are clamped to before they are accumulated, 0 disables the clamp
+  };
+
+  struct Output
+  {
+    char prefix[256]; // Files are named <prefix>_<output>_<sample count> with the extension of the format
+    int format; // One of ImageWriter::Format
+    bool beauty;
+    bool normals;
+    bool albedo;
+    bool variance;
+    bool denoised;
+    int interval; // Saves every so many samples while accumulating, 0 only saves when asked to
+
+    bool save; // Set by the UI or the interval, cleared once the images are queued
+    UINT num_pending; // Images the writer has not finished yet
+  };
+
+  struct Checkpointing
+  {
+    char path[256];
+    int interval; // Saves a checkpoint every so many samples, 0 only saves on demand
+    bool save_on_exit;
+
+    bool save; // Set by the UI or the interval, cleared once the checkpoint is written
+    bool load; // Set by the UI, cleared once the checkpoint is restored
+  };
+
+  struct Denoising
+  {
+    enum Method {
+      OptiX,
+      OIDN,
+      ATrous,
+      NumMethods
+    };
+
+    Method method;
+    const char* names[NumMethods];
+    bool available[NumMethods]; // Backends that failed to start or were not built in can not be picked
+    int atrous_iterations;
+    float atrous_sigma_luminance;
+    int atrous_normal_sharpness;
+
+    UINT readback_frames; // Frames presented between resolving the inputs and denoising them
+    DenoiserTimings timings; // Reported by the backend for the last denoise
+
+    // How well the CPU denoiser kept its threads busy during the last denoise
+    UINT num_threads;
+    float average_utilization; // Fraction of the denoise the average thread was working
+    float min_utilization; // The same for the thread that waited the longest
+    UINT tiles_stolen;
   };
 
   struct GlobalIllumination
@@ -49,6 +136,59 @@ namespace rtrt
     float bounce_distance;
   };
 
+  struct AdaptiveSampling
+  {
+    bool enabled;
+    bool show_heat_map;
+    int min_samples;
+    int max_samples_per_frame;
+    float error_threshold;
+
+    UINT converged_tiles;
+    UINT num_tiles;
+    UINT64 samples_traced;
+    UINT64 samples_saved;
+  };
+
+  struct FrameBudget
+  {
+    bool enabled;
+    float target_ms; // Frame time the number of samples per frame is fitted to
+    int max_samples_per_frame;
+
+    UINT samples_per_frame; // Traced this frame, a single one while the view is changing
+    float ms_per_sample; // GPU time of one sample per pixel, smoothed over frames
+    float overhead_ms; // Frame time spent outside of path tracing, smoothed over frames
+  };
+
+  struct RayBenchmark
+  {
+    bool enabled;
+    double pathtrace_ms;
+    double averager_ms;
+    double occlusion_rays_per_second;
+    double closest_hit_rays_per_second;
+  };
+
+  struct PathGuiding
+  {
+    bool enabled;
+    bool reset;
+    float probability;
+    int training_samples;
+  };
+
+  struct ReSTIR
+  {
+    bool enabled;
+    bool temporal_reuse;
+    bool spatial_reuse;
+    int candidates;
+    int spatial_samples;
+    float spatial_radius;
+    int history_limit;
+  };
+
   class Application
   {
   public:
@@ -59,6 +199,33 @@ namespace rtrt
 
     void Update(GLFWwindow* window, int picking_result);
 
+    void UpdateConvergenceStatistics(UINT converged_tiles, UINT64 tile_samples, UINT max_pixel_samples, UINT num_tiles);
+
+    void UpdateGpuTimings(double pathtrace_ms, double occlusion_benchmark_ms, double closest_hit_benchmark_ms, double averager_ms, UINT num_benchmark_rays);
+
+    /**
+    * Measures what a sample per pixel costs, called after Update with the timings of the previous frame
+    * @param[in] pathtrace_ms GPU time of the previous frame's path tracing dispatch
+    * @param[in] samples_traced The samples per pixel that dispatch traced, on average over all pixels when adaptive
+    * sampling decided them per tile, 0 when the previous frame did not path trace
+    */
+    void UpdateFrameBudget(double pathtrace_ms, float samples_traced);
+
+    // The sample no pixel may go beyond, the first of the freeze and denoise samples that is still ahead, 0 if there is none
+    UINT GetSampleLimit() const;
+
+    // The camera, settings and sample count that go into a checkpoint
+    void GetCheckpointState(Checkpoint::State* out_state) const;
+
+    /**
+    * Continues from a checkpoint, its accumulation has to be uploaded in the same frame
+    * @param[in] state The state the checkpoint was saved with, its resolution replaces the one in use
+    * @return Whether the checkpoint was saved from this model with these materials, nothing is restored if it was not
+    */
+    bool RestoreCheckpointState(const Checkpoint::State& state);
+
+    void UpdateTextureStreamingStatistics(UINT64 resident_size, UINT num_loading);
+
   public:
     bool freeze_rendering;
     int freeze_at_sample;
@@ -84,9 +251,32 @@ namespace rtrt
     Shadows shadows;
     Lens lens;
     AntiAliasing aa;
+    Sampling sampling;
+    TextureLod texture_lod;
+    TextureStreaming texture_streaming;
+    Resolution resolution;
     PostProcessing pp;
+    Output output;
+    Checkpointing checkpointing;
+    Denoising denoising;
     GlobalIllumination gi;
+    AdaptiveSampling adaptive;
+    FrameBudget frame_budget;
+    ReSTIR restir;
+    PathGuiding guiding;
+    RayBenchmark ray_benchmark;
     DirectX::XMFLOAT4 sky_color;
+    std::string model_path;
     Model model;
+
+  private:
+    // Picks the render resolution for this frame, a change clears the accumulated samples
+    void UpdateResolution(GLFWwindow* window);
+
+    // Picks how many samples per pixel this frame traces, so the frame lands on the target frame time
+    void UpdateSamplesPerFrame();
+
+    // Identifies the model and the current state of its materials, edited materials change the converged image
+    UINT64 GetSceneHash() const;
   };
 }
\ No newline at end of file
@@ -0,0 +1,438 @@
+#include "atrous_denoiser.h"
+#include "tonemapping.h"
+#include "simd_math.h"
+
+#include <chrono>
+
+namespace rtrt
+{
+  namespace
+  {
+    // The B3-spline kernel of the a-trous transform, taps at -2, -1, 0, 1 and 2 times the step
+    const float KERNEL[5] = { 1.0f / 16.0f, 1.0f / 4.0f, 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f };
+
+    // Albedo is clamped before it is divided out, black surfaces would blow the irradiance up
+    const float ALBEDO_EPSILON = 0.01f;
+
+    //------------------------------------------------------------------------------------------------------
+    float Luminance(float r, float g, float b)
+    {
+      return 0.2126f * r + 0.7152f * g + 0.0722f * b;
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  AtrousDenoiser::AtrousDenoiser() :
+    num_iterations(5),
+    sigma_luminance(4.0f),
+    normal_sharpness(7),
+    width_(0),
+    height_(0),
+    padding_(0),
+    stride_(0)
+  {
+
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  AtrousDenoiser::~AtrousDenoiser()
+  {
+
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  bool AtrousDenoiser::Create(UINT width, UINT height)
+  {
+    scheduler_.Create();
+    ResizePlanes(width, height, GetPadding());
+    return true;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void AtrousDenoiser::Destroy()
+  {
+    scheduler_.Destroy();
+    ResizePlanes(0, 0, 0);
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void AtrousDenoiser::Resize(UINT width, UINT height)
+  {
+    ResizePlanes(width, height, GetPadding());
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void AtrousDenoiser::Denoise(const DenoiserInputs& inputs, const DenoiserOutput& output)
+  {
+    auto input_start = std::chrono::high_resolution_clock::now();
+
+    int iterations = GetNumIterations();
+
+    // The number of iterations may have changed since the last denoise, and with it the padding
+    if (inputs.width != width_ || inputs.height != height_ || GetPadding() != padding_)
+    {
+      ResizePlanes(inputs.width, inputs.height, GetPadding());
+    }
+
+    scheduler_.ResetStats();
+
+    ParallelTiles([&](const TileScheduler::Tile& tile)
+    {
+      Prepare(inputs, tile);
+    });
+
+    auto denoise_start = std::chrono::high_resolution_clock::now();
+
+    int source = 0;
+
+    for (int i = 0; i < iterations; i++)
+    {
+      ParallelTiles([&](const TileScheduler::Tile& tile)
+      {
+        Filter(source, 1u << i, tile);
+      });
+
+      source = 1 - source;
+    }
+
+    // Modulated straight into the linear output when there is one
+    XMFLOAT4* color = output.linear;
+    if (color == nullptr)
+    {
+      result_.resize(albedo_.size());
+      color = result_.data();
+    }
+
+    ParallelTiles([&](const TileScheduler::Tile& tile)
+    {
+      Modulate(source, color, tile);
+    });
+
+    auto output_start = std::chrono::high_resolution_clock::now();
+
+    WriteOutput(color, albedo_.size(), output);
+
+    auto output_end = std::chrono::high_resolution_clock::now();
+
+    timings_.input_ms = std::chrono::duration<double, std::milli>(denoise_start - input_start).count();
+    timings_.denoise_ms = std::chrono::duration<double, std::milli>(output_start - denoise_start).count();
+    timings_.output_ms = std::chrono::duration<double, std::milli>(output_end - output_start).count();
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  const char* AtrousDenoiser::GetName() const
+  {
+    return "A-Trous (CPU)";
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  const TileScheduler& AtrousDenoiser::GetScheduler() const
+  {
+    return scheduler_;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void AtrousDenoiser::ResizePlanes(UINT width, UINT height, UINT padding)
+  {
+    width_ = width;
+    height_ = height;
+    padding_ = padding;
+    stride_ = width + 2 * padding;
+
+    size_t plane_size = static_cast<size_t>(stride_) * (height + 2 * padding);
+
+    // Only the inside of the planes is ever written, the border stays zero and so does its weight
+    mask_.assign(plane_size, 0.0f);
+    normal_x_.assign(plane_size, 0.0f);
+    normal_y_.assign(plane_size, 0.0f);
+    normal_z_.assign(plane_size, 0.0f);
+
+    for (int i = 0; i < 2; i++)
+    {
+      irradiance_r_[i].assign(plane_size, 0.0f);
+      irradiance_g_[i].assign(plane_size, 0.0f);
+      irradiance_b_[i].assign(plane_size, 0.0f);
+      luminance_[i].assign(plane_size, 0.0f);
+      variance_[i].assign(plane_size, 0.0f);
+    }
+
+    albedo_.resize(static_cast<size_t>(width) * height);
+    result_.clear();
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void AtrousDenoiser::Prepare(const DenoiserInputs& inputs, const TileScheduler::Tile& tile)
+  {
+    for (UINT y = tile.y0; y < tile.y1; y++)
+    {
+      size_t row_start = static_cast<size_t>(y) * width_;
+
+      for (UINT x = tile.x0; x < tile.x1; x++)
+      {
+        size_t i = PlaneIndex(x, y);
+
+        const XMFLOAT4& input_albedo = inputs.albedo[row_start + x];
+        XMFLOAT4 a = XMFLOAT4(std::max(input_albedo.x, ALBEDO_EPSILON), std::max(input_albedo.y, ALBEDO_EPSILON), std::max(input_albedo.z, ALBEDO_EPSILON), 1.0f);
+        albedo_[row_start + x] = a;
+
+        const XMFLOAT4& c = inputs.color[row_start + x];
+        irradiance_r_[0][i] = c.x / a.x;
+        irradiance_g_[0][i] = c.y / a.y;
+        irradiance_b_[0][i] = c.z / a.z;
+        luminance_[0][i] = Luminance(irradiance_r_[0][i], irradiance_g_[0][i], irradiance_b_[0][i]);
+
+        // Averaged normals are shorter than 1 at silhouettes, pixels the camera rays missed have none at all
+        const XMFLOAT4& n = inputs.normals[row_start + x];
+        float length = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+        float inverse_length = length > 1e-6f ? 1.0f / length : 0.0f;
+        normal_x_[i] = n.x * inverse_length;
+        normal_y_[i] = n.y * inverse_length;
+        normal_z_[i] = n.z * inverse_length;
+
+        // Variance of the mean luminance, like the convergence pass, moved into irradiance by the albedo luminance
+        const XMFLOAT4& m = inputs.moments[row_start + x];
+        float variance = 0.0f;
+
+        if (m.w > 1.0f)
+        {
+          float mean = m.x / m.w;
+          variance = std::max(m.y / m.w - mean * mean, 0.0f) / (m.w - 1.0f);
+        }
+
+        float albedo_luminance = Luminance(a.x, a.y, a.z);
+        variance_[0][i] = variance / (albedo_luminance * albedo_luminance);
+
+        mask_[i] = 1.0f;
+      }
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void AtrousDenoiser::Filter(int source, UINT step, const TileScheduler::Tile& tile)
+  {
+    ptrdiff_t offsets[24];
+    float weights[24];
+    int num_taps = 0;
+
+    // Every tap but the center, which always has the full weight of its kernel entry
+    for (int dy = -2; dy <= 2; dy++)
+    {
+      for (int dx = -2; dx <= 2; dx++)
+      {
+        if (dx == 0 && dy == 0)
+        {
+          continue;
+        }
+
+        offsets[num_taps] = static_cast<ptrdiff_t>(dy) * step * stride_ + static_cast<ptrdiff_t>(dx) * step;
+        weights[num_taps] = KERNEL[dy + 2] * KERNEL[dx + 2];
+        num_taps++;
+      }
+    }
+
+    bool avx2 = ToneMappingUtility::IsAVX2Supported();
+
+    for (UINT y = tile.y0; y < tile.y1; y++)
+    {
+      UINT x = tile.x0;
+
+      if (avx2)
+      {
+        for (; x + 8 <= tile.x1; x += 8)
+        {
+          FilterPixelsAVX2(source, PlaneIndex(x, y), offsets, weights);
+        }
+      }
+
+      for (; x < tile.x1; x++)
+      {
+        FilterPixel(source, PlaneIndex(x, y), offsets, weights);
+      }
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void AtrousDenoiser::FilterPixel(int source, size_t index, const ptrdiff_t* offsets, const float* weights)
+  {
+    int target = 1 - source;
+
+    const float* r = irradiance_r_[source].data();
+    const float* g = irradiance_g_[source].data();
+    const float* b = irradiance_b_[source].data();
+    const float* luminance = luminance_[source].data();
+    const float* variance = variance_[source].data();
+
+    // The variance of a single pixel is too noisy to steer the filter with, it is blurred with a 3x3 gaussian first
+    float blurred_variance =
+      0.25f * variance[index] +
+      0.125f * (variance[index - 1] + variance[index + 1] + variance[index - stride_] + variance[index + stride_]) +
+      0.0625f * (variance[index - stride_ - 1] + variance[index - stride_ + 1] + variance[index + stride_ - 1] + variance[index + stride_ + 1]);
+
+    float inverse_sigma = 1.0f / (sigma_luminance * std::sqrt(std::max(blurred_variance, 0.0f)) + 1e-4f);
+
+    float nx = normal_x_[index];
+    float ny = normal_y_[index];
+    float nz = normal_z_[index];
+    float l = luminance[index];
+
+    float center = KERNEL[2] * KERNEL[2];
+    float sum_weights = center;
+    float sum_r = center * r[index];
+    float sum_g = center * g[index];
+    float sum_b = center * b[index];
+    float sum_variance = center * center * variance[index];
+
+    for (int t = 0; t < 24; t++)
+    {
+      size_t q = index + offsets[t];
+
+      float cosine = std::max(nx * normal_x_[q] + ny * normal_y_[q] + nz * normal_z_[q], 0.0f);
+      for (int s = 0; s < normal_sharpness; s++)
+      {
+        cosine *= cosine;
+      }
+
+      float weight = weights[t] * cosine * std::exp(-std::abs(l - luminance[q]) * inverse_sigma) * mask_[q];
+
+      sum_weights += weight;
+      sum_r += weight * r[q];
+      sum_g += weight * g[q];
+      sum_b += weight * b[q];
+      sum_variance += weight * weight * variance[q];
+    }
+
+    float inverse_sum = 1.0f / sum_weights;
+
+    irradiance_r_[target][index] = sum_r * inverse_sum;
+    irradiance_g_[target][index] = sum_g * inverse_sum;
+    irradiance_b_[target][index] = sum_b * inverse_sum;
+    luminance_[target][index] = Luminance(irradiance_r_[target][index], irradiance_g_[target][index], irradiance_b_[target][index]);
+    variance_[target][index] = sum_variance * inverse_sum * inverse_sum;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void AtrousDenoiser::FilterPixelsAVX2(int source, size_t index, const ptrdiff_t* offsets, const float* weights)
+  {
+    int target = 1 - source;
+
+    const float* r = irradiance_r_[source].data();
+    const float* g = irradiance_g_[source].data();
+    const float* b = irradiance_b_[source].data();
+    const float* luminance = luminance_[source].data();
+    const float* variance = variance_[source].data();
+
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+
+    __m256 blurred_variance = _mm256_mul_ps(_mm256_set1_ps(0.25f), _mm256_loadu_ps(variance + index));
+
+    __m256 edges = _mm256_add_ps(_mm256_loadu_ps(variance + index - 1), _mm256_loadu_ps(variance + index + 1));
+    edges = _mm256_add_ps(edges, _mm256_loadu_ps(variance + index - stride_));
+    edges = _mm256_add_ps(edges, _mm256_loadu_ps(variance + index + stride_));
+    blurred_variance = _mm256_add_ps(blurred_variance, _mm256_mul_ps(_mm256_set1_ps(0.125f), edges));
+
+    __m256 corners = _mm256_add_ps(_mm256_loadu_ps(variance + index - stride_ - 1), _mm256_loadu_ps(variance + index - stride_ + 1));
+    corners = _mm256_add_ps(corners, _mm256_loadu_ps(variance + index + stride_ - 1));
+    corners = _mm256_add_ps(corners, _mm256_loadu_ps(variance + index + stride_ + 1));
+    blurred_variance = _mm256_add_ps(blurred_variance, _mm256_mul_ps(_mm256_set1_ps(0.0625f), corners));
+
+    __m256 sigma = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(sigma_luminance), _mm256_sqrt_ps(_mm256_max_ps(blurred_variance, zero))), _mm256_set1_ps(1e-4f));
+    __m256 negative_inverse_sigma = _mm256_div_ps(_mm256_set1_ps(-1.0f), sigma);
+
+    __m256 nx = _mm256_loadu_ps(normal_x_.data() + index);
+    __m256 ny = _mm256_loadu_ps(normal_y_.data() + index);
+    __m256 nz = _mm256_loadu_ps(normal_z_.data() + index);
+    __m256 l = _mm256_loadu_ps(luminance + index);
+
+    __m256 center = _mm256_set1_ps(KERNEL[2] * KERNEL[2]);
+    __m256 sum_weights = center;
+    __m256 sum_r = _mm256_mul_ps(center, _mm256_loadu_ps(r + index));
+    __m256 sum_g = _mm256_mul_ps(center, _mm256_loadu_ps(g + index));
+    __m256 sum_b = _mm256_mul_ps(center, _mm256_loadu_ps(b + index));
+    __m256 sum_variance = _mm256_mul_ps(_mm256_mul_ps(center, center), _mm256_loadu_ps(variance + index));
+
+    for (int t = 0; t < 24; t++)
+    {
+      size_t q = index + offsets[t];
+
+      __m256 cosine = _mm256_mul_ps(nx, _mm256_loadu_ps(normal_x_.data() + q));
+      cosine = _mm256_add_ps(cosine, _mm256_mul_ps(ny, _mm256_loadu_ps(normal_y_.data() + q)));
+      cosine = _mm256_add_ps(cosine, _mm256_mul_ps(nz, _mm256_loadu_ps(normal_z_.data() + q)));
+      cosine = _mm256_max_ps(cosine, zero);
+
+      for (int s = 0; s < normal_sharpness; s++)
+      {
+        cosine = _mm256_mul_ps(cosine, cosine);
+      }
+
+      __m256 difference = _mm256_andnot_ps(sign_mask, _mm256_sub_ps(l, _mm256_loadu_ps(luminance + q)));
+      __m256 weight = _mm256_mul_ps(_mm256_set1_ps(weights[t]), cosine);
+      weight = _mm256_mul_ps(weight, SimdExp(_mm256_mul_ps(difference, negative_inverse_sigma)));
+      weight = _mm256_mul_ps(weight, _mm256_loadu_ps(mask_.data() + q));
+
+      sum_weights = _mm256_add_ps(sum_weights, weight);
+      sum_r = _mm256_add_ps(sum_r, _mm256_mul_ps(weight, _mm256_loadu_ps(r + q)));
+      sum_g = _mm256_add_ps(sum_g, _mm256_mul_ps(weight, _mm256_loadu_ps(g + q)));
+      sum_b = _mm256_add_ps(sum_b, _mm256_mul_ps(weight, _mm256_loadu_ps(b + q)));
+      sum_variance = _mm256_add_ps(sum_variance, _mm256_mul_ps(_mm256_mul_ps(weight, weight), _mm256_loadu_ps(variance + q)));
+    }
+
+    __m256 inverse_sum = _mm256_div_ps(_mm256_set1_ps(1.0f), sum_weights);
+
+    __m256 filtered_r = _mm256_mul_ps(sum_r, inverse_sum);
+    __m256 filtered_g = _mm256_mul_ps(sum_g, inverse_sum);
+    __m256 filtered_b = _mm256_mul_ps(sum_b, inverse_sum);
+
+    __m256 filtered_luminance = _mm256_mul_ps(_mm256_set1_ps(0.2126f), filtered_r);
+    filtered_luminance = _mm256_add_ps(filtered_luminance, _mm256_mul_ps(_mm256_set1_ps(0.7152f), filtered_g));
+    filtered_luminance = _mm256_add_ps(filtered_luminance, _mm256_mul_ps(_mm256_set1_ps(0.0722f), filtered_b));
+
+    _mm256_storeu_ps(irradiance_r_[target].data() + index, filtered_r);
+    _mm256_storeu_ps(irradiance_g_[target].data() + index, filtered_g);
+    _mm256_storeu_ps(irradiance_b_[target].data() + index, filtered_b);
+    _mm256_storeu_ps(luminance_[target].data() + index, filtered_luminance);
+    _mm256_storeu_ps(variance_[target].data() + index, _mm256_mul_ps(sum_variance, _mm256_mul_ps(inverse_sum, inverse_sum)));
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void AtrousDenoiser::Modulate(int source, XMFLOAT4* out_color, const TileScheduler::Tile& tile)
+  {
+    for (UINT y = tile.y0; y < tile.y1; y++)
+    {
+      size_t row_start = static_cast<size_t>(y) * width_;
+
+      for (UINT x = tile.x0; x < tile.x1; x++)
+      {
+        size_t i = PlaneIndex(x, y);
+        const XMFLOAT4& a = albedo_[row_start + x];
+
+        out_color[row_start + x] = XMFLOAT4(irradiance_r_[source][i] * a.x, irradiance_g_[source][i] * a.y, irradiance_b_[source][i] * a.z, 1.0f);
+      }
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void AtrousDenoiser::ParallelTiles(const std::function<void(const TileScheduler::Tile&)>& task)
+  {
+    scheduler_.Run(width_, height_, TILE_SIZE, task);
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  int AtrousDenoiser::GetNumIterations() const
+  {
+    return std::max(std::min(num_iterations, MAX_ITERATIONS), 1);
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  UINT AtrousDenoiser::GetPadding() const
+  {
+    // The last iteration reaches two steps of 2^(iterations - 1) pixels out
+    return 2u << (GetNumIterations() - 1);
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  size_t AtrousDenoiser::PlaneIndex(UINT x, UINT y) const
+  {
+    return static_cast<size_t>(y + padding_) * stride_ + x + padding_;
+  }
+}
\ No newline at end of file
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "denoiser.h"
+#include "tile_scheduler.h"
+
+namespace rtrt
+{
+  /**
+  * Denoises on the CPU with the edge-avoiding a-trous wavelet filter of SVGF (Schied et al. 2017), guided by the
+  * normals, albedo and luminance moments the path tracer already accumulates. The albedo is divided out before
+  * filtering so textures stay sharp. Every iteration doubles the spacing between the taps of a 5x5 B3-spline kernel,
+  * whose weights fall off with the angle between normals and with luminance differences relative to the standard
+  * deviation of the pixel. The variance is filtered along with the color, so later iterations smooth less.
+  *
+  * The image is filtered in Morton ordered tiles on a work-stealing pool that spans every logical processor, eight
+  * pixels at a time with AVX2 when the CPU supports it.
+  */
+  class AtrousDenoiser : public Denoiser
+  {
+  public:
+    AtrousDenoiser();
+    ~AtrousDenoiser();
+
+    bool Create(UINT width, UINT height) override;
+    void Destroy() override;
+
+    void Resize(UINT width, UINT height) override;
+
+    void Denoise(const DenoiserInputs& inputs, const DenoiserOutput& output) override;
+
+    const char* GetName() const override;
+
+    // Per thread statistics of the last denoise
+    const TileScheduler& GetScheduler() const;
+
+  public:
+    int num_iterations; // Every iteration doubles the footprint, 5 iterations cover 125x125 pixels
+    float sigma_luminance; // How many standard deviations of luminance difference are still smoothed over
+    int normal_sharpness; // The normal weight is the cosine between the normals raised to 2^normal_sharpness
+
+    static const int MAX_ITERATIONS = 6;
+    static const UINT TILE_SIZE = 32; // Four AVX2 iterations wide, and a tile of every plane stays within L2
+
+  private:
+    void ResizePlanes(UINT width, UINT height, UINT padding);
+
+    void Prepare(const DenoiserInputs& inputs, const TileScheduler::Tile& tile);
+    void Filter(int source, UINT step, const TileScheduler::Tile& tile);
+    void Modulate(int source, XMFLOAT4* out_color, const TileScheduler::Tile& tile);
+
+    // Filters a single pixel, index is into the padded planes
+    void FilterPixel(int source, size_t index, const ptrdiff_t* offsets, const float* weights);
+    // Filters eight consecutive pixels starting at index
+    void FilterPixelsAVX2(int source, size_t index, const ptrdiff_t* offsets, const float* weights);
+
+    // Runs task on every tile of the image, returns once all tiles are done
+    void ParallelTiles(const std::function<void(const TileScheduler::Tile&)>& task);
+
+    int GetNumIterations() const;
+    UINT GetPadding() const;
+    size_t PlaneIndex(UINT x, UINT y) const;
+
+    UINT width_;
+    UINT height_;
+    UINT padding_; // Zeroed border around every plane, so the widest kernel never reads outside of them
+    UINT stride_;
+
+    TileScheduler scheduler_;
+
+    // Planar so eight neighbouring pixels are a single load, the filtered planes are ping-ponged between iterations
+    std::vector<float> mask_;
+    std::vector<float> normal_x_;
+    std::vector<float> normal_y_;
+    std::vector<float> normal_z_;
+    std::vector<float> irradiance_r_[2];
+    std::vector<float> irradiance_g_[2];
+    std::vector<float> irradiance_b_[2];
+    std::vector<float> luminance_[2];
+    std::vector<float> variance_[2];
+    std::vector<XMFLOAT4> albedo_; // Linear albedo the result is modulated with again, not padded
+    std::vector<XMFLOAT4> result_; // The denoised color when no linear output is requested
+  };
+}
\ No newline at end of file
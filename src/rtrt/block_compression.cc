@@ -0,0 +1,347 @@
+#include "block_compression.h"
+
+#include <fstream>
+
+namespace rtrt
+{
+  //------------------------------------------------------------------------------------------------------
+  DXGI_FORMAT BlockCompressionUtility::SelectFormat(const ProcessedTexture& texture, TextureUsage usage)
+  {
+    // Only the top level has to be block aligned, D3D12 pads the smaller levels itself
+    if (texture.mip_levels == 0 || texture.width % 4 != 0 || texture.height % 4 != 0)
+    {
+      return DXGI_FORMAT_UNKNOWN;
+    }
+
+    switch (usage)
+    {
+    case TextureUsage::Normal:
+      return DXGI_FORMAT_BC5_UNORM;
+    case TextureUsage::Linear:
+      return DXGI_FORMAT_BC4_UNORM;
+    default:
+      break;
+    }
+
+    size_t num_texels = static_cast<size_t>(texture.width) * texture.height;
+    for (size_t i = 0; i < num_texels; i++)
+    {
+      if (texture.mip_chain[i * 4 + 3] != 255)
+      {
+        return DXGI_FORMAT_BC3_UNORM;
+      }
+    }
+
+    return DXGI_FORMAT_BC1_UNORM;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void BlockCompressionUtility::CompressMipChain(const ProcessedTexture& texture, DXGI_FORMAT format, std::vector<unsigned char>* out_blocks)
+  {
+    UINT block_size = BlockSize(format);
+    ThrowIfFalse(block_size > 0);
+
+    out_blocks->clear();
+
+    const unsigned char* level_pixels = texture.mip_chain.data();
+    unsigned char block[64];
+
+    for (UINT level = 0; level < texture.mip_levels; level++)
+    {
+      UINT width = std::max(texture.width >> level, 1u);
+      UINT height = std::max(texture.height >> level, 1u);
+      UINT blocks_x = (width + 3) / 4;
+      UINT blocks_y = (height + 3) / 4;
+
+      size_t level_offset = out_blocks->size();
+      out_blocks->resize(level_offset + static_cast<size_t>(blocks_x) * blocks_y * block_size);
+
+      for (UINT y = 0; y < blocks_y; y++)
+      {
+        for (UINT x = 0; x < blocks_x; x++)
+        {
+          FetchBlock(level_pixels, width, height, x, y, block);
+          unsigned char* out = out_blocks->data() + level_offset + (static_cast<size_t>(y) * blocks_x + x) * block_size;
+
+          switch (format)
+          {
+          case DXGI_FORMAT_BC1_UNORM:
+            EncodeBC1(block, out);
+            break;
+          case DXGI_FORMAT_BC3_UNORM:
+            EncodeBC4(block, 3, out);
+            EncodeBC1(block, out + 8);
+            break;
+          case DXGI_FORMAT_BC4_UNORM:
+            EncodeBC4(block, 0, out);
+            break;
+          case DXGI_FORMAT_BC5_UNORM:
+            EncodeBC4(block, 0, out);
+            EncodeBC4(block, 1, out + 8);
+            break;
+          }
+        }
+      }
+
+      level_pixels += static_cast<size_t>(width) * height * 4;
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  UINT BlockCompressionUtility::BlockSize(DXGI_FORMAT format)
+  {
+    switch (format)
+    {
+    case DXGI_FORMAT_BC1_UNORM: return 8;
+    case DXGI_FORMAT_BC3_UNORM: return 16;
+    case DXGI_FORMAT_BC4_UNORM: return 8;
+    case DXGI_FORMAT_BC5_UNORM: return 16;
+    default: return 0;
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  bool BlockCompressionUtility::WriteDDS(const std::string& path, DXGI_FORMAT format, UINT width, UINT height, UINT mip_levels, const std::vector<unsigned char>& blocks)
+  {
+    DDSHeader header = {};
+    header.size = sizeof(DDSHeader);
+    header.flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000; // Caps, height, width, pixel format, mip map count, linear size
+    header.height = height;
+    header.width = width;
+    header.pitch_or_linear_size = ((width + 3) / 4) * ((height + 3) / 4) * BlockSize(format);
+    header.depth = 1;
+    header.mip_map_count = mip_levels;
+    header.pixel_format.size = sizeof(DDSPixelFormat);
+    header.pixel_format.flags = 0x4; // Four CC
+    header.pixel_format.four_cc = DDS_FOUR_CC_DX10;
+    header.caps = 0x1000 | 0x400000 | 0x8; // Texture, mip map, complex
+
+    DDSHeaderDX10 header_dx10 = {};
+    header_dx10.dxgi_format = format;
+    header_dx10.resource_dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+    header_dx10.array_size = 1;
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (file.is_open() == false)
+    {
+      return false;
+    }
+
+    UINT magic = DDS_MAGIC;
+    file.write(reinterpret_cast<const char*>(&magic), sizeof(magic));
+    file.write(reinterpret_cast<const char*>(&header), sizeof(DDSHeader));
+    file.write(reinterpret_cast<const char*>(&header_dx10), sizeof(DDSHeaderDX10));
+    file.write(reinterpret_cast<const char*>(blocks.data()), blocks.size());
+
+    return file.good();
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  bool BlockCompressionUtility::ReadDDSDescription(const std::string& path, UINT* out_width, UINT* out_height, UINT* out_mip_levels, DXGI_FORMAT* out_format)
+  {
+    std::ifstream file(path, std::ios::binary);
+    if (file.is_open() == false)
+    {
+      return false;
+    }
+
+    UINT magic;
+    DDSHeader header;
+    DDSHeaderDX10 header_dx10;
+
+    file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    file.read(reinterpret_cast<char*>(&header), sizeof(DDSHeader));
+    file.read(reinterpret_cast<char*>(&header_dx10), sizeof(DDSHeaderDX10));
+
+    if (file.good() == false || magic != DDS_MAGIC || header.pixel_format.four_cc != DDS_FOUR_CC_DX10)
+    {
+      return false;
+    }
+
+    *out_width = header.width;
+    *out_height = header.height;
+    *out_mip_levels = header.mip_map_count;
+    *out_format = header_dx10.dxgi_format;
+
+    return true;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void BlockCompressionUtility::FetchBlock(const unsigned char* pixels, UINT width, UINT height, UINT block_x, UINT block_y, unsigned char out_block[64])
+  {
+    for (UINT y = 0; y < 4; y++)
+    {
+      UINT source_y = std::min(block_y * 4 + y, height - 1);
+
+      for (UINT x = 0; x < 4; x++)
+      {
+        UINT source_x = std::min(block_x * 4 + x, width - 1);
+        memcpy(out_block + (y * 4 + x) * 4, pixels + (static_cast<size_t>(source_y) * width + source_x) * 4, 4);
+      }
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void BlockCompressionUtility::EncodeBC1(const unsigned char block[64], unsigned char out[8])
+  {
+    // Range fit: the endpoints are the diagonal of the bounding box of the colors, flipped along the axes that are
+    // anti-correlated with the widest one and inset to reduce the influence of outliers (van Waveren 2006)
+    int min_color[3] = { 255, 255, 255 };
+    int max_color[3] = { 0, 0, 0 };
+
+    for (int i = 0; i < 16; i++)
+    {
+      for (int c = 0; c < 3; c++)
+      {
+        min_color[c] = std::min(min_color[c], static_cast<int>(block[i * 4 + c]));
+        max_color[c] = std::max(max_color[c], static_cast<int>(block[i * 4 + c]));
+      }
+    }
+
+    int widest = 0;
+    for (int c = 1; c < 3; c++)
+    {
+      widest = (max_color[c] - min_color[c]) > (max_color[widest] - min_color[widest]) ? c : widest;
+    }
+
+    for (int c = 0; c < 3; c++)
+    {
+      if (c == widest)
+      {
+        continue;
+      }
+
+      int covariance = 0;
+      for (int i = 0; i < 16; i++)
+      {
+        covariance += (block[i * 4 + c] - (min_color[c] + max_color[c]) / 2) * (block[i * 4 + widest] - (min_color[widest] + max_color[widest]) / 2);
+      }
+
+      if (covariance < 0)
+      {
+        std::swap(min_color[c], max_color[c]);
+      }
+    }
+
+    for (int c = 0; c < 3; c++)
+    {
+      int inset = (max_color[c] - min_color[c]) / 16;
+      max_color[c] -= inset;
+      min_color[c] += inset;
+    }
+
+    auto to_565 = [](const int color[3])
+    {
+      return static_cast<UINT16>(((color[0] >> 3) << 11) | ((color[1] >> 2) << 5) | (color[2] >> 3));
+    };
+
+    UINT16 color0 = to_565(max_color);
+    UINT16 color1 = to_565(min_color);
+
+    // color0 > color1 selects the four color mode, equal endpoints would select the three color mode with black
+    if (color0 < color1)
+    {
+      std::swap(color0, color1);
+    }
+
+    UINT indices = 0;
+
+    if (color0 != color1)
+    {
+      int palette[4][3];
+      palette[0][0] = ((color0 >> 11) << 3) | (color0 >> 13);
+      palette[0][1] = (((color0 >> 5) & 63) << 2) | (((color0 >> 5) & 63) >> 4);
+      palette[0][2] = ((color0 & 31) << 3) | ((color0 & 31) >> 2);
+      palette[1][0] = ((color1 >> 11) << 3) | (color1 >> 13);
+      palette[1][1] = (((color1 >> 5) & 63) << 2) | (((color1 >> 5) & 63) >> 4);
+      palette[1][2] = ((color1 & 31) << 3) | ((color1 & 31) >> 2);
+
+      for (int c = 0; c < 3; c++)
+      {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+      }
+
+      for (int i = 0; i < 16; i++)
+      {
+        int best_index = 0;
+        int best_distance = INT_MAX;
+
+        for (int p = 0; p < 4; p++)
+        {
+          int dr = block[i * 4 + 0] - palette[p][0];
+          int dg = block[i * 4 + 1] - palette[p][1];
+          int db = block[i * 4 + 2] - palette[p][2];
+          int distance = dr * dr + dg * dg + db * db;
+
+          if (distance < best_distance)
+          {
+            best_distance = distance;
+            best_index = p;
+          }
+        }
+
+        indices |= static_cast<UINT>(best_index) << (i * 2);
+      }
+    }
+
+    memcpy(out + 0, &color0, 2);
+    memcpy(out + 2, &color1, 2);
+    memcpy(out + 4, &indices, 4);
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void BlockCompressionUtility::EncodeBC4(const unsigned char block[64], UINT channel, unsigned char out[8])
+  {
+    int min_value = 255;
+    int max_value = 0;
+
+    for (int i = 0; i < 16; i++)
+    {
+      min_value = std::min(min_value, static_cast<int>(block[i * 4 + channel]));
+      max_value = std::max(max_value, static_cast<int>(block[i * 4 + channel]));
+    }
+
+    // red0 > red1 selects the eight value mode
+    out[0] = static_cast<unsigned char>(max_value);
+    out[1] = static_cast<unsigned char>(min_value);
+
+    UINT64 indices = 0;
+
+    if (max_value != min_value)
+    {
+      int palette[8];
+      palette[0] = max_value;
+      palette[1] = min_value;
+
+      for (int p = 2; p < 8; p++)
+      {
+        palette[p] = ((8 - p) * max_value + (p - 1) * min_value) / 7;
+      }
+
+      for (int i = 0; i < 16; i++)
+      {
+        int best_index = 0;
+        int best_distance = INT_MAX;
+
+        for (int p = 0; p < 8; p++)
+        {
+          int distance = std::abs(block[i * 4 + channel] - palette[p]);
+
+          if (distance < best_distance)
+          {
+            best_distance = distance;
+            best_index = p;
+          }
+        }
+
+        indices |= static_cast<UINT64>(best_index) << (i * 3);
+      }
+    }
+
+    for (int i = 0; i < 6; i++)
+    {
+      out[2 + i] = static_cast<unsigned char>((indices >> (i * 8)) & 0xFF);
+    }
+  }
+}
\ No newline at end of file
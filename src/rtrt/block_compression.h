@@ -0,0 +1,89 @@
+#pragma once
+
+#include "texture_processor.h"
+
+namespace rtrt
+{
+  class BlockCompressionUtility
+  {
+  public:
+    /**
+    * Picks the block compressed format of a texture: BC1 for opaque color, BC3 for color with alpha, BC5 for
+    * normal maps and BC4 for single channel data.
+    * @param[in] texture The processed texture, with its mip chain
+    * @param[in] usage How the texture is used
+    * @return The format, or DXGI_FORMAT_UNKNOWN if the top level is not a multiple of the 4x4 block size
+    */
+    static DXGI_FORMAT SelectFormat(const ProcessedTexture& texture, TextureUsage usage);
+
+    /**
+    * Encodes every level of a mip chain, blocks that hang over the edge of small levels repeat the edge texels.
+    * @param[in] texture The processed texture, with its mip chain
+    * @param[in] format One of the formats returned by SelectFormat
+    * @param[out] out_blocks The blocks of all levels, tightly packed one after the other
+    */
+    static void CompressMipChain(const ProcessedTexture& texture, DXGI_FORMAT format, std::vector<unsigned char>* out_blocks);
+
+    /**
+    * Writes block compressed data as a DDS file with a DX10 header, so DirectX::CreateDDSTextureFromFile can load it.
+    * @return Whether the file was written
+    */
+    static bool WriteDDS(const std::string& path, DXGI_FORMAT format, UINT width, UINT height, UINT mip_levels, const std::vector<unsigned char>& blocks);
+
+    /**
+    * Reads the dimensions and format of a DDS file written by WriteDDS.
+    * @return Whether the file exists and has a DX10 header
+    */
+    static bool ReadDDSDescription(const std::string& path, UINT* out_width, UINT* out_height, UINT* out_mip_levels, DXGI_FORMAT* out_format);
+
+    static UINT BlockSize(DXGI_FORMAT format);
+
+  private:
+    // Layouts from the DDS programming guide
+    struct DDSPixelFormat
+    {
+      UINT size;
+      UINT flags;
+      UINT four_cc;
+      UINT rgb_bit_count;
+      UINT r_bit_mask;
+      UINT g_bit_mask;
+      UINT b_bit_mask;
+      UINT a_bit_mask;
+    };
+
+    struct DDSHeader
+    {
+      UINT size;
+      UINT flags;
+      UINT height;
+      UINT width;
+      UINT pitch_or_linear_size;
+      UINT depth;
+      UINT mip_map_count;
+      UINT reserved1[11];
+      DDSPixelFormat pixel_format;
+      UINT caps;
+      UINT caps2;
+      UINT caps3;
+      UINT caps4;
+      UINT reserved2;
+    };
+
+    struct DDSHeaderDX10
+    {
+      DXGI_FORMAT dxgi_format;
+      UINT resource_dimension;
+      UINT misc_flag;
+      UINT array_size;
+      UINT misc_flags2;
+    };
+
+    static const UINT DDS_MAGIC = 0x20534444; // "DDS "
+    static const UINT DDS_FOUR_CC_DX10 = 0x30315844; // "DX10"
+
+    static void FetchBlock(const unsigned char* pixels, UINT width, UINT height, UINT block_x, UINT block_y, unsigned char out_block[64]);
+    static void EncodeBC1(const unsigned char block[64], unsigned char out[8]);
+    static void EncodeBC4(const unsigned char block[64], UINT channel, unsigned char out[8]);
+  };
+}
\ No newline at end of file
@@ -14,7 +14,8 @@ namespace rtrt
     far_plane_(1000.0f),
     aperture_(0.1f),
     translation_acculumator_(0.0f, 0.0f, 0.0f),
-    fov_in_radians_(DirectX::XM_PIDIV2)
+    fov_in_radians_(DirectX::XM_PIDIV2),
+    aspect_ratio_(1280.0f / 720.0f)
   {
 
   }
@@ -187,12 +188,25 @@ namespace rtrt
     return DirectX::XMConvertToDegrees(fov_in_radians_);
   }
 
+  //------------------------------------------------------------------------------------------------------
+  void Camera::SetAspectRatio(float aspect_ratio)
+  {
+    projection_dirty_ = true;
+    aspect_ratio_ = aspect_ratio;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  float Camera::GetAspectRatio() const
+  {
+    return aspect_ratio_;
+  }
+
   //------------------------------------------------------------------------------------------------------
   void Camera::UpdateProjectionMatrix()
   {
     projection_ = DirectX::XMMatrixPerspectiveFovLH(
       fov_in_radians_,
-      1280.0f / 720.0f,
+      aspect_ratio_,
       near_plane_,
       far_plane_
     );
@@ -37,6 +37,10 @@ namespace rtrt
     float GetFovRadians() const;
     float GetFovDegrees() const;
 
+    // Width over height of the image the camera renders to
+    void SetAspectRatio(float aspect_ratio);
+    float GetAspectRatio() const;
+
   protected:
     void UpdateViewMatrix();
 
@@ -56,6 +60,7 @@ namespace rtrt
     float aperture_;
 
     float fov_in_radians_;
+    float aspect_ratio_;
 
   private:
     DirectX::XMFLOAT3 translation_acculumator_;
@@ -0,0 +1,306 @@
+#include "checkpoint.h"
+#include "application.h"
+#include "device.h"
+#include "render_target_set.h"
+#include "readback_buffer.h"
+#include "upload_buffer.h"
+#include "shared/raytracing_data.h"
+
+#include <fstream>
+
+namespace filesystem = std::experimental::filesystem;
+
+namespace rtrt
+{
+  //------------------------------------------------------------------------------------------------------
+  Checkpoint::Checkpoint() :
+    file_(nullptr),
+    mapping_(nullptr),
+    view_(nullptr)
+  {
+
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  Checkpoint::~Checkpoint()
+  {
+    Close();
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  bool Checkpoint::Save(Device* device, RenderTargetSet* targets, const State& state, const std::string& path)
+  {
+    UINT row_size = targets->width * static_cast<UINT>(sizeof(DirectX::XMFLOAT4));
+    UINT plane_size = row_size * targets->height;
+
+    // The radiance is a texture, its rows are read back at the pitch the copy demands
+    D3D12_RESOURCE_DESC texture_desc = targets->render->GetDesc();
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint;
+    UINT64 texture_size;
+    device->device->GetCopyableFootprints(&texture_desc, 0, 1, 0, &footprint, nullptr, nullptr, &texture_size);
+
+    ReadbackBuffer readbacks[NumPlanes];
+    for (int i = 0; i < NumPlanes; i++)
+    {
+      readbacks[i].Create(device->device, i == Radiance ? static_cast<UINT>(texture_size) : plane_size);
+    }
+
+    device->PrepareCommandLists();
+    TransitionTargets(device->command_list, targets, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE);
+
+    CD3DX12_TEXTURE_COPY_LOCATION destination(readbacks[Radiance].GetBuffer(), footprint);
+    CD3DX12_TEXTURE_COPY_LOCATION source(targets->render, 0);
+    device->command_list->CopyTextureRegion(&destination, 0, 0, 0, &source, nullptr);
+
+    for (int i = Normals; i < NumPlanes; i++)
+    {
+      device->command_list->CopyResource(readbacks[i].GetBuffer(), GetTarget(targets, i));
+    }
+
+    TransitionTargets(device->command_list, targets, D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    device->ExecuteCommandLists();
+    device->WaitForGPU();
+
+    FileHeader header = {};
+    header.magic = MAGIC;
+    header.version = VERSION;
+    header.plane_size = plane_size;
+    header.state = state;
+
+    for (int i = 0; i < NumPlanes; i++)
+    {
+      header.plane_offsets[i] = AlignPlane(sizeof(FileHeader)) + AlignPlane(plane_size) * static_cast<UINT64>(i);
+    }
+
+    // Written under a temporary name first, so a render that is preempted while saving keeps its previous checkpoint
+    std::string temporary_path = path + ".tmp";
+
+    std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+    if (file.is_open() == false)
+    {
+      return false;
+    }
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
+
+    std::vector<char> padding(static_cast<size_t>(PLANE_ALIGNMENT), 0);
+
+    for (int i = 0; i < NumPlanes; i++)
+    {
+      UINT64 position = static_cast<UINT64>(file.tellp());
+      file.write(padding.data(), static_cast<std::streamsize>(header.plane_offsets[i] - position));
+
+      const char* data = static_cast<const char*>(readbacks[i].Map());
+
+      if (i == Radiance)
+      {
+        for (UINT y = 0; y < targets->height; y++)
+        {
+          file.write(data + footprint.Offset + static_cast<size_t>(y) * footprint.Footprint.RowPitch, row_size);
+        }
+      }
+      else
+      {
+        file.write(data, plane_size);
+      }
+
+      readbacks[i].Unmap();
+    }
+
+    bool written = file.good();
+    file.close();
+
+    // filesystem::rename refuses to replace the previous checkpoint, MoveFileEx swaps it out in one step
+    if (written == false || MoveFileExA(temporary_path.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) == FALSE)
+    {
+      std::error_code error;
+      filesystem::remove(temporary_path, error);
+      return false;
+    }
+
+    return true;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  bool Checkpoint::Open(const std::string& path)
+  {
+    Close();
+
+    file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE)
+    {
+      file_ = nullptr;
+      return false;
+    }
+
+    LARGE_INTEGER file_size;
+    if (GetFileSizeEx(file_, &file_size) == FALSE || static_cast<UINT64>(file_size.QuadPart) < sizeof(FileHeader))
+    {
+      Close();
+      return false;
+    }
+
+    mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    view_ = mapping_ != nullptr ? static_cast<const unsigned char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+
+    if (view_ == nullptr)
+    {
+      Close();
+      return false;
+    }
+
+    memcpy(&header_, view_, sizeof(FileHeader));
+
+    const State& state = header_.state;
+    bool valid =
+      header_.magic == MAGIC &&
+      header_.version == VERSION &&
+      state.width > 0 && state.width <= 8192 &&
+      state.height > 0 && state.height <= 8192 &&
+      header_.plane_size == static_cast<UINT64>(state.width) * state.height * sizeof(DirectX::XMFLOAT4) &&
+      state.aa_algorithm < static_cast<UINT>(AntiAliasing::NumAlgorithms) &&
+      state.sampler_type < SAMPLER_TYPE_COUNT &&
+      state.tonemapper >= TONEMAPPER_NONE && state.tonemapper <= TONEMAPPER_ACES;
+
+    for (int i = 0; i < NumPlanes && valid; i++)
+    {
+      valid = header_.plane_offsets[i] + header_.plane_size <= static_cast<UINT64>(file_size.QuadPart);
+    }
+
+    if (valid == false)
+    {
+      Close();
+      return false;
+    }
+
+    return true;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void Checkpoint::Close()
+  {
+    if (view_ != nullptr)
+    {
+      UnmapViewOfFile(view_);
+      view_ = nullptr;
+    }
+
+    if (mapping_ != nullptr)
+    {
+      CloseHandle(mapping_);
+      mapping_ = nullptr;
+    }
+
+    if (file_ != nullptr)
+    {
+      CloseHandle(file_);
+      file_ = nullptr;
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  bool Checkpoint::IsOpen() const
+  {
+    return view_ != nullptr;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  const Checkpoint::State& Checkpoint::GetState() const
+  {
+    return header_.state;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  bool Checkpoint::Upload(Device* device, RenderTargetSet* targets)
+  {
+    const State& state = header_.state;
+
+    if (IsOpen() == false || targets->width != state.width || targets->height != state.height)
+    {
+      return false;
+    }
+
+    UINT row_size = state.width * static_cast<UINT>(sizeof(DirectX::XMFLOAT4));
+    UINT plane_size = static_cast<UINT>(header_.plane_size);
+
+    D3D12_RESOURCE_DESC texture_desc = targets->render->GetDesc();
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint;
+    UINT64 texture_size;
+    device->device->GetCopyableFootprints(&texture_desc, 0, 1, 0, &footprint, nullptr, nullptr, &texture_size);
+
+    // The mapped planes are copied straight into the upload heap, this is where the file is actually read
+    UploadBuffer uploads[NumPlanes];
+    for (int i = 0; i < NumPlanes; i++)
+    {
+      uploads[i].Create(device->device, i == Radiance ? static_cast<UINT>(texture_size) : plane_size, nullptr);
+
+      unsigned char* destination = static_cast<unsigned char*>(uploads[i].GetData());
+      const unsigned char* source = view_ + header_.plane_offsets[i];
+
+      if (i == Radiance)
+      {
+        for (UINT y = 0; y < state.height; y++)
+        {
+          memcpy(destination + footprint.Offset + static_cast<size_t>(y) * footprint.Footprint.RowPitch, source + static_cast<size_t>(y) * row_size, row_size);
+        }
+      }
+      else
+      {
+        memcpy(destination, source, plane_size);
+      }
+    }
+
+    device->PrepareCommandLists();
+    TransitionTargets(device->command_list, targets, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_DEST);
+
+    CD3DX12_TEXTURE_COPY_LOCATION destination(targets->render, 0);
+    CD3DX12_TEXTURE_COPY_LOCATION source(uploads[Radiance].GetBuffer(), footprint);
+    device->command_list->CopyTextureRegion(&destination, 0, 0, 0, &source, nullptr);
+
+    for (int i = Normals; i < NumPlanes; i++)
+    {
+      device->command_list->CopyResource(GetTarget(targets, i), uploads[i].GetBuffer());
+    }
+
+    TransitionTargets(device->command_list, targets, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    device->ExecuteCommandLists();
+    device->WaitForGPU();
+
+    return true;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  ID3D12Resource* Checkpoint::GetTarget(RenderTargetSet* targets, int plane)
+  {
+    switch (plane)
+    {
+    case Radiance:
+      return targets->render;
+    case Normals:
+      return targets->normals;
+    case Albedo:
+      return targets->albedo;
+    default:
+      return targets->variance;
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void Checkpoint::TransitionTargets(ID3D12GraphicsCommandList* command_list, RenderTargetSet* targets, D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after)
+  {
+    D3D12_RESOURCE_BARRIER barriers[NumPlanes];
+
+    for (int i = 0; i < NumPlanes; i++)
+    {
+      barriers[i] = CD3DX12_RESOURCE_BARRIER::Transition(GetTarget(targets, i), before, after);
+    }
+
+    command_list->ResourceBarrier(NumPlanes, barriers);
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  UINT64 Checkpoint::AlignPlane(UINT64 offset)
+  {
+    return (offset + PLANE_ALIGNMENT - 1) & ~(PLANE_ALIGNMENT - 1);
+  }
+}
\ No newline at end of file
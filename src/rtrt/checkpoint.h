@@ -0,0 +1,126 @@
+#pragma once
+
+namespace rtrt
+{
+  class Device;
+  class RenderTargetSet;
+
+  /**
+  * Saves the progressive accumulation to a file and restores it, so long renders survive the process and can be split
+  * over several sessions. A checkpoint holds the raw sums the path tracer accumulates, radiance, normals, albedo and
+  * luminance moments with the number of samples of every pixel in their w, together with the camera and the settings
+  * that decide what the image converges to. The low discrepancy samplers continue every pixel's sequence from its
+  * sample count, the LCG sampler seeds from the frame count, so that is stored too. The random AA jitter is derived
+  * from the sample count.
+  *
+  * The adaptive sampling, reservoir resampling and path guiding settings are not stored, nor are the reservoirs and
+  * the learned guiding distribution. A restored render continues with whatever those are set to at the time.
+  *
+  * The file is a header followed by the four planes, tightly packed and page aligned. Opening a checkpoint maps the
+  * file instead of reading it, so the state is available right away and the planes are paged in only while they are
+  * copied into the upload buffers, without a staging copy in between.
+  */
+  class Checkpoint
+  {
+  public:
+    // Everything besides the accumulation that is needed to continue a render where it stopped
+    struct State
+    {
+      UINT width;
+      UINT height;
+      UINT sample_count;
+      UINT frame_count;
+      int denoise_at_sample;
+
+      DirectX::XMFLOAT3 camera_position;
+      DirectX::XMFLOAT3 camera_rotation;
+      float fov_degrees;
+      float lens_diameter;
+      float focal_length;
+
+      int num_bounces;
+      float bounce_distance;
+      UINT aa_enabled;
+      UINT aa_algorithm;
+      UINT sampler_type;
+      DirectX::XMFLOAT4 sky_color;
+      float firefly_clamp;
+
+      float exposure;
+      int tonemapper;
+      float gamma;
+
+      UINT texture_lod_enabled;
+      float texture_lod_bias;
+
+      UINT64 scene_hash; // The model and its materials, a checkpoint only resumes in the scene it was saved from
+    };
+
+  public:
+    Checkpoint();
+    ~Checkpoint();
+
+    /**
+    * Reads the accumulation back and writes it to a file together with the state. Records and executes its own
+    * command list and waits for the GPU, so it may only be called between frames.
+    * @param[in] device The device the targets were created on
+    * @param[in] targets The accumulation targets, at the resolution in the state
+    * @param[in] state The camera and settings the samples were traced with
+    * @param[in] path Where the checkpoint is written, an existing file is only replaced once the new one is complete
+    * @return Whether the checkpoint was written
+    */
+    static bool Save(Device* device, RenderTargetSet* targets, const State& state, const std::string& path);
+
+    /**
+    * Maps a checkpoint file and validates its header.
+    * @param[in] path The checkpoint file
+    * @return Whether the file is a checkpoint that can be restored, the state is only valid if it is
+    */
+    bool Open(const std::string& path);
+    void Close();
+
+    bool IsOpen() const;
+    const State& GetState() const;
+
+    /**
+    * Copies the accumulation of the open checkpoint into the targets. Records and executes its own command list and
+    * waits for the GPU, so it may only be called between frames.
+    * @param[in] device The device the targets were created on
+    * @param[in] targets The accumulation targets, already resized to the resolution of the checkpoint
+    * @return Whether the accumulation was restored, the targets are left alone if their size does not match
+    */
+    bool Upload(Device* device, RenderTargetSet* targets);
+
+  private:
+    enum Plane
+    {
+      Radiance,
+      Normals,
+      Albedo,
+      Moments,
+      NumPlanes
+    };
+
+    struct FileHeader
+    {
+      UINT magic;
+      UINT version;
+      UINT64 plane_size; // Every plane is width * height float4s
+      UINT64 plane_offsets[NumPlanes];
+      State state;
+    };
+
+    static const UINT MAGIC = 0x4B484352; // "RCHK"
+    static const UINT VERSION = 3;
+    static const UINT64 PLANE_ALIGNMENT = 4096;
+
+    static ID3D12Resource* GetTarget(RenderTargetSet* targets, int plane);
+    static void TransitionTargets(ID3D12GraphicsCommandList* command_list, RenderTargetSet* targets, D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after);
+    static UINT64 AlignPlane(UINT64 offset);
+
+    HANDLE file_;
+    HANDLE mapping_;
+    const unsigned char* view_;
+    FileHeader header_;
+  };
+}
\ No newline at end of file
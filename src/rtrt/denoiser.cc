@@ -0,0 +1,38 @@
+#include "denoiser.h"
+
+namespace rtrt
+{
+  //------------------------------------------------------------------------------------------------------
+  Denoiser::Denoiser()
+  {
+    timings_.input_ms = 0.0;
+    timings_.denoise_ms = 0.0;
+    timings_.output_ms = 0.0;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  Denoiser::~Denoiser()
+  {
+
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  const DenoiserTimings& Denoiser::GetTimings() const
+  {
+    return timings_;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void Denoiser::WriteOutput(const XMFLOAT4* color, size_t num_pixels, const DenoiserOutput& output)
+  {
+    if (output.linear != nullptr && color != output.linear)
+    {
+      memcpy(output.linear, color, num_pixels * sizeof(XMFLOAT4));
+    }
+
+    if (output.pixels != nullptr)
+    {
+      ToneMappingUtility::Apply(color, num_pixels, output.tone_mapping, output.pixels);
+    }
+  }
+}
\ No newline at end of file
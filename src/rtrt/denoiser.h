@@ -0,0 +1,78 @@
+#pragma once
+
+#include "tonemapping.h"
+
+namespace rtrt
+{
+  /**
+  * The guides and color a denoiser works from, as resolved by the averager. The pointers usually point straight into
+  * the mapped readback buffers, backends that need their own buffers copy out of them.
+  */
+  struct DenoiserInputs
+  {
+    const XMFLOAT4* color; // Linear radiance, w is 1
+    const XMFLOAT4* normals; // Averaged world space normals in [-1, 1], not renormalized, w is 0
+    const XMFLOAT4* albedo; // Linear albedo, w is 1
+    const XMFLOAT4* moments; // Luminance moments: sum, sum of squares, unused and the number of samples
+    UINT width;
+    UINT height;
+  };
+
+  /**
+  * Where a denoiser writes its result, either pointer may be nullptr when that form is not needed.
+  */
+  struct DenoiserOutput
+  {
+    XMFLOAT4* linear; // width * height linear colors
+    unsigned char* pixels; // width * height tonemapped and gamma corrected RGBA8 pixels
+    ToneMapping tone_mapping;
+  };
+
+  /**
+  * How long each stage of the last denoise took on the CPU.
+  */
+  struct DenoiserTimings
+  {
+    double input_ms; // Getting the inputs into the form the backend wants
+    double denoise_ms; // The denoise itself
+    double output_ms; // Converting the result into the requested outputs
+  };
+
+  /**
+  * A denoising backend. Backends are created once at startup and picked between at runtime, a backend that can not
+  * run on this machine reports so from Create and is never used.
+  */
+  class Denoiser
+  {
+  public:
+    Denoiser();
+    virtual ~Denoiser();
+
+    /**
+    * @param[in] width The width of the images that will be denoised
+    * @param[in] height The height of the images that will be denoised
+    * @return Whether the backend is available
+    */
+    virtual bool Create(UINT width, UINT height) = 0;
+    virtual void Destroy() = 0;
+
+    virtual void Resize(UINT width, UINT height) = 0;
+
+    virtual void Denoise(const DenoiserInputs& inputs, const DenoiserOutput& output) = 0;
+
+    virtual const char* GetName() const = 0;
+
+    const DenoiserTimings& GetTimings() const;
+
+  protected:
+    /**
+    * Fills the requested outputs from a denoised image.
+    * @param[in] color The denoised linear color, one XMFLOAT4 per pixel
+    * @param[in] num_pixels The number of pixels in color
+    * @param[in] output The outputs to fill
+    */
+    static void WriteOutput(const XMFLOAT4* color, size_t num_pixels, const DenoiserOutput& output);
+
+    DenoiserTimings timings_;
+  };
+}
@@ -169,4 +169,22 @@ namespace rtrt
 
     num_allocated_descriptors_ = num_allocated_descriptors_ + 1;
   }
+
+  //------------------------------------------------------------------------------------------------------
+  void DescriptorHeap::AllocateRange(UINT num_descriptors, std::vector<DescriptorHandle>* out_handles)
+  {
+    ThrowIfFalse(descriptor_heap_ != nullptr);
+    ThrowIfFalse(out_handles != nullptr);
+    ThrowIfFalse(num_allocated_descriptors_ + num_descriptors <= max_num_allocated_descriptors_);
+
+    out_handles->resize(num_descriptors);
+
+    for (UINT i = 0; i < num_descriptors; i++)
+    {
+      (*out_handles)[i].parent_heap = this;
+      (*out_handles)[i].descriptor_index = num_allocated_descriptors_ + i;
+    }
+
+    num_allocated_descriptors_ = num_allocated_descriptors_ + num_descriptors;
+  }
 }
\ No newline at end of file
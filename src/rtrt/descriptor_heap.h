@@ -22,6 +22,9 @@ namespace rtrt
     void CreateDescriptor(ID3D12Device* device, ID3D12Resource* resource, D3D12_DEPTH_STENCIL_VIEW_DESC* dsv_desc, DescriptorHandle* out_handle);
     void CreateDescriptor(ID3D12Device* device, D3D12_SAMPLER_DESC* sampler_desc, DescriptorHandle* out_handle);
 
+    // Reserves consecutive descriptors without creating views in them, for descriptor tables that are indexed in shaders
+    void AllocateRange(UINT num_descriptors, std::vector<DescriptorHandle>* out_handles);
+
     inline ID3D12DescriptorHeap* GetDescriptorHeap() { return descriptor_heap_; }
 
   private:
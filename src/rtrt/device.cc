@@ -348,6 +348,31 @@ namespace rtrt
 
     ThrowIfFailed(factory->MakeWindowAssociation(glfwGetWin32Window(glfw_window), DXGI_MWA_NO_ALT_ENTER));
 
+    CreateBackBuffers(true);
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void Device::Resize(UINT a_width, UINT a_height)
+  {
+    WaitForGPU();
+
+    for (UINT i = 0; i < NUM_BACK_BUFFERS; i++)
+    {
+      RELEASE(back_buffers[i]);
+      fence_values[i] = fence_values[back_buffer_index];
+    }
+
+    width = a_width;
+    height = a_height;
+
+    ThrowIfFailed(swap_chain->ResizeBuffers(NUM_BACK_BUFFERS, width, height, back_buffer_format, 0));
+
+    CreateBackBuffers(false);
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void Device::CreateBackBuffers(bool allocate_descriptors)
+  {
     for (UINT i = 0; i < NUM_BACK_BUFFERS; i++)
     {
       ThrowIfFailed(swap_chain->GetBuffer(i, IID_PPV_ARGS(&back_buffers[i])));
@@ -362,7 +387,14 @@ namespace rtrt
       rtv.Texture2D.MipSlice = 0;
       rtv.Texture2D.PlaneSlice = 0;
 
-      rtv_heap->CreateDescriptor(device, back_buffers[i], &rtv, &back_buffer_rtvs[i]);
+      if (allocate_descriptors)
+      {
+        rtv_heap->CreateDescriptor(device, back_buffers[i], &rtv, &back_buffer_rtvs[i]);
+      }
+      else
+      {
+        device->CreateRenderTargetView(back_buffers[i], &rtv, back_buffer_rtvs[i].cpu_handle());
+      }
     }
 
     back_buffer_index = swap_chain->GetCurrentBackBufferIndex();
@@ -68,11 +68,15 @@ namespace rtrt
 
     void Present();
 
+    // Resizes the swap chain, back buffer views are rewritten in place. Waits for the GPU to become idle first.
+    void Resize(UINT width, UINT height);
+
     WRAPPED_GPU_POINTER CreateFallbackWrappedPointer(DescriptorHeap* uav_descriptor_heap, ID3D12Resource* resource, UINT buffer_num_elements);
 
   private:
     void EnableRaytracing();
     void CreateDeviceResources();
     void CreateSwapChainResources();
+    void CreateBackBuffers(bool allocate_descriptors);
   };
 }
\ No newline at end of file
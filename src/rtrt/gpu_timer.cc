@@ -0,0 +1,103 @@
+#include "gpu_timer.h"
+
+#include "readback_buffer.h"
+
+namespace rtrt
+{
+  //------------------------------------------------------------------------------------------------------
+  GpuTimer::GpuTimer() :
+    query_heap_(nullptr),
+    readback_(nullptr),
+    frequency_(1),
+    stopped_(),
+    resolved_()
+  {
+
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  GpuTimer::~GpuTimer()
+  {
+    Destroy();
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void GpuTimer::Create(ID3D12Device* device, ID3D12CommandQueue* command_queue)
+  {
+    Destroy();
+
+    D3D12_QUERY_HEAP_DESC query_heap_desc = {};
+    query_heap_desc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+    query_heap_desc.Count = MAX_TIMERS * 2;
+    query_heap_desc.NodeMask = 0;
+
+    ThrowIfFailed(device->CreateQueryHeap(&query_heap_desc, IID_PPV_ARGS(&query_heap_)));
+    ThrowIfFailed(command_queue->GetTimestampFrequency(&frequency_));
+
+    readback_ = new ReadbackBuffer();
+    readback_->Create(device, MAX_TIMERS * 2 * sizeof(UINT64));
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void GpuTimer::Destroy()
+  {
+    RELEASE(query_heap_);
+    DELETE(readback_);
+
+    for (UINT i = 0; i < MAX_TIMERS; i++)
+    {
+      stopped_[i] = false;
+      resolved_[i] = false;
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void GpuTimer::Start(ID3D12GraphicsCommandList* command_list, UINT timer)
+  {
+    ThrowIfFalse(timer < MAX_TIMERS);
+    command_list->EndQuery(query_heap_, D3D12_QUERY_TYPE_TIMESTAMP, timer * 2);
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void GpuTimer::Stop(ID3D12GraphicsCommandList* command_list, UINT timer)
+  {
+    ThrowIfFalse(timer < MAX_TIMERS);
+    command_list->EndQuery(query_heap_, D3D12_QUERY_TYPE_TIMESTAMP, timer * 2 + 1);
+    stopped_[timer] = true;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void GpuTimer::Resolve(ID3D12GraphicsCommandList* command_list)
+  {
+    // Queries that were never issued must not be resolved
+    for (UINT i = 0; i < MAX_TIMERS; i++)
+    {
+      if (stopped_[i] == true)
+      {
+        command_list->ResolveQueryData(query_heap_, D3D12_QUERY_TYPE_TIMESTAMP, i * 2, 2, readback_->GetBuffer(), i * 2 * sizeof(UINT64));
+      }
+
+      // A timer that is no longer recorded, like the benchmarks once disabled, must not keep its last value
+      resolved_[i] = stopped_[i];
+      stopped_[i] = false;
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  double GpuTimer::GetMilliseconds(UINT timer)
+  {
+    ThrowIfFalse(timer < MAX_TIMERS);
+
+    if (resolved_[timer] == false)
+    {
+      return 0.0;
+    }
+
+    UINT64* timestamps = static_cast<UINT64*>(readback_->Map());
+    UINT64 start = timestamps[timer * 2];
+    UINT64 end = timestamps[timer * 2 + 1];
+    readback_->Unmap();
+
+    return end > start ? static_cast<double>(end - start) * 1000.0 / static_cast<double>(frequency_) : 0.0;
+  }
+}
\ No newline at end of file
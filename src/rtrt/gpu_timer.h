@@ -0,0 +1,39 @@
+#pragma once
+
+namespace rtrt
+{
+  class ReadbackBuffer;
+
+  /**
+  * Measures GPU time between pairs of timestamp queries on the direct queue. Results are resolved into a
+  * readback buffer and can be read once the command list that resolved them has finished executing.
+  */
+  class GpuTimer
+  {
+  public:
+    static const UINT MAX_TIMERS = 8;
+
+    GpuTimer();
+    ~GpuTimer();
+
+    void Create(ID3D12Device* device, ID3D12CommandQueue* command_queue);
+    void Destroy();
+
+    void Start(ID3D12GraphicsCommandList* command_list, UINT timer);
+    void Stop(ID3D12GraphicsCommandList* command_list, UINT timer);
+
+    // Copies every timer that was stopped in this command list into the readback buffer, timers that were not
+    // stopped since the previous resolve read 0 from now on
+    void Resolve(ID3D12GraphicsCommandList* command_list);
+
+    // Elapsed milliseconds of the last resolved measurement, 0 if the timer did not run in the resolved command list
+    double GetMilliseconds(UINT timer);
+
+  private:
+    ID3D12QueryHeap* query_heap_;
+    ReadbackBuffer* readback_;
+    UINT64 frequency_;
+    bool stopped_[MAX_TIMERS]; // Stopped since the last resolve
+    bool resolved_[MAX_TIMERS]; // Part of the last resolve
+  };
+}
\ No newline at end of file
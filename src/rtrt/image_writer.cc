@@ -0,0 +1,330 @@
+#include "image_writer.h"
+#include "shared/raytracing_data.h"
+
+#include <fstream>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+namespace rtrt
+{
+  //------------------------------------------------------------------------------------------------------
+  const char* ImageWriter::FORMAT_NAMES[ImageWriter::NumFormats] = { "PNG", "EXR", "PFM" };
+
+  //------------------------------------------------------------------------------------------------------
+  ImageWriter::ImageWriter() :
+    num_encoding_(0),
+    stop_(false)
+  {
+
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  ImageWriter::~ImageWriter()
+  {
+    Destroy();
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void ImageWriter::Create()
+  {
+    stop_ = false;
+
+    // Encoding is a background task, it should not compete with the denoiser for every core
+    UINT num_threads = std::min(std::max(std::thread::hardware_concurrency() / 2, 1u), 4u);
+    for (UINT i = 0; i < num_threads; i++)
+    {
+      threads_.push_back(std::thread(&ImageWriter::WorkerThread, this));
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void ImageWriter::Destroy()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+
+    condition_.notify_all();
+
+    for (size_t i = 0; i < threads_.size(); i++)
+    {
+      threads_[i].join();
+    }
+
+    threads_.clear();
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void ImageWriter::Write(const std::string& path, Format format, Content content, const ToneMapping& tone_mapping, const XMFLOAT4* pixels, UINT width, UINT height)
+  {
+    Request request;
+    request.path = path;
+    request.format = format;
+    request.content = content;
+    request.tone_mapping = tone_mapping;
+    request.pixels.assign(pixels, pixels + static_cast<size_t>(width) * height);
+    request.width = width;
+    request.height = height;
+
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      space_condition_.wait(lock, [&]() { return requests_.size() < MAX_QUEUED; });
+
+      requests_.push_back(std::move(request));
+    }
+
+    condition_.notify_one();
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  UINT ImageWriter::GetNumPending()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return static_cast<UINT>(requests_.size()) + num_encoding_;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  const char* ImageWriter::GetExtension(Format format)
+  {
+    switch (format)
+    {
+    case PNG:
+      return ".png";
+    case EXR:
+      return ".exr";
+    default:
+      return ".pfm";
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void ImageWriter::WorkerThread()
+  {
+    while (true)
+    {
+      Request request;
+
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        condition_.wait(lock, [&]() { return stop_ || requests_.empty() == false; });
+
+        // Stopping still drains the queue, images that were asked for are not lost on exit
+        if (requests_.empty())
+        {
+          return;
+        }
+
+        request = std::move(requests_.front());
+        requests_.pop_front();
+        num_encoding_++;
+      }
+
+      space_condition_.notify_one();
+
+      Convert(&request);
+
+      std::vector<char> file;
+      switch (request.format)
+      {
+      case PNG:
+        EncodePng(request, &file);
+        break;
+      case EXR:
+        EncodeExr(request, &file);
+        break;
+      default:
+        EncodePfm(request, &file);
+        break;
+      }
+
+      bool written;
+
+      {
+        std::lock_guard<std::mutex> lock(disk_mutex_);
+
+        std::ofstream stream(request.path, std::ios::binary);
+        stream.write(file.data(), file.size());
+        written = stream.good();
+      }
+
+      std::stringstream message;
+      message << (written ? "Saved " : "Could not save ") << request.path << "\n";
+      LOG(message.str().c_str());
+
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        num_encoding_--;
+      }
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void ImageWriter::Convert(Request* request)
+  {
+    std::vector<XMFLOAT4>& pixels = request->pixels;
+
+    if (request->content == Moments)
+    {
+      for (size_t i = 0; i < pixels.size(); i++)
+      {
+        const XMFLOAT4& moments = pixels[i];
+        float mean = moments.w > 0.0f ? moments.x / moments.w : 0.0f;
+        float variance = moments.w > 0.0f ? std::max(moments.y / moments.w - mean * mean, 0.0f) : 0.0f;
+
+        pixels[i] = XMFLOAT4(variance, variance, variance, 1.0f);
+      }
+    }
+
+    // The float formats keep the vectors signed, only 8 bits per channel need them in [0, 1]
+    if (request->content == Normals && request->format == PNG)
+    {
+      for (size_t i = 0; i < pixels.size(); i++)
+      {
+        pixels[i] = XMFLOAT4(pixels[i].x * 0.5f + 0.5f, pixels[i].y * 0.5f + 0.5f, pixels[i].z * 0.5f + 0.5f, 1.0f);
+      }
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void ImageWriter::EncodePng(const Request& request, std::vector<char>* out_file)
+  {
+    // Only radiance goes through the tonemapper, albedo keeps its gamma and everything else is stored as is
+    ToneMapping mapping = request.tone_mapping;
+    if (request.content != Radiance)
+    {
+      mapping.tonemapper = TONEMAPPER_NONE;
+      mapping.exposure = 0.0f;
+      mapping.gamma = request.content == Albedo ? mapping.gamma : 1.0f;
+    }
+
+    std::vector<unsigned char> rgba(request.pixels.size() * 4);
+    ToneMappingUtility::Apply(request.pixels.data(), request.pixels.size(), mapping, rgba.data());
+
+    auto append = [](void* context, void* data, int size)
+    {
+      Append(static_cast<std::vector<char>*>(context), data, size);
+    };
+
+    int width = static_cast<int>(request.width);
+    stbi_write_png_to_func(append, out_file, width, static_cast<int>(request.height), 4, rgba.data(), width * 4);
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void ImageWriter::EncodeExr(const Request& request, std::vector<char>* out_file)
+  {
+    UINT width = request.width;
+    UINT height = request.height;
+
+    // Magic number and version 2, a single part scanline file
+    const int magic[2] = { 20000630, 2 };
+    Append(out_file, magic, sizeof(magic));
+
+    // Channels are listed in alphabetical order, every one is a 32-bit float (2) sampled once per pixel
+    {
+      std::vector<char> channels;
+      const char* names[3] = { "B", "G", "R" };
+      const int layout[4] = { 2, 0, 1, 1 }; // Pixel type, linear flag and reserved bytes, x and y sampling
+
+      for (int c = 0; c < 3; c++)
+      {
+        Append(&channels, names[c], 2);
+        Append(&channels, layout, sizeof(layout));
+      }
+
+      channels.push_back('\0');
+      AppendExrAttribute(out_file, "channels", "chlist", channels.data(), static_cast<int>(channels.size()));
+    }
+
+    const unsigned char no_compression = 0;
+    const unsigned char increasing_y = 0;
+    const int window[4] = { 0, 0, static_cast<int>(width) - 1, static_cast<int>(height) - 1 };
+    const float aspect_ratio = 1.0f;
+    const float window_center[2] = { 0.0f, 0.0f };
+    const float window_width = 1.0f;
+
+    AppendExrAttribute(out_file, "compression", "compression", &no_compression, 1);
+    AppendExrAttribute(out_file, "dataWindow", "box2i", window, sizeof(window));
+    AppendExrAttribute(out_file, "displayWindow", "box2i", window, sizeof(window));
+    AppendExrAttribute(out_file, "lineOrder", "lineOrder", &increasing_y, 1);
+    AppendExrAttribute(out_file, "pixelAspectRatio", "float", &aspect_ratio, sizeof(aspect_ratio));
+    AppendExrAttribute(out_file, "screenWindowCenter", "v2f", window_center, sizeof(window_center));
+    AppendExrAttribute(out_file, "screenWindowWidth", "float", &window_width, sizeof(window_width));
+    out_file->push_back('\0');
+
+    // Uncompressed files hold one scanline per block: its y, its size and then every channel's row in turn
+    int block_size = static_cast<int>(width * 3 * sizeof(float));
+    UINT64 first_block = out_file->size() + sizeof(UINT64) * height;
+
+    std::vector<UINT64> offsets(height);
+    for (UINT y = 0; y < height; y++)
+    {
+      offsets[y] = first_block + static_cast<UINT64>(y) * (sizeof(int) * 2 + block_size);
+    }
+
+    out_file->reserve(static_cast<size_t>(first_block) + static_cast<size_t>(height) * (sizeof(int) * 2 + block_size));
+    Append(out_file, offsets.data(), offsets.size() * sizeof(UINT64));
+
+    std::vector<float> block(width * 3);
+    for (UINT y = 0; y < height; y++)
+    {
+      const XMFLOAT4* row = request.pixels.data() + static_cast<size_t>(y) * width;
+
+      for (UINT x = 0; x < width; x++)
+      {
+        block[x] = row[x].z;
+        block[width + x] = row[x].y;
+        block[width * 2 + x] = row[x].x;
+      }
+
+      const int header[2] = { static_cast<int>(y), block_size };
+      Append(out_file, header, sizeof(header));
+      Append(out_file, block.data(), block_size);
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void ImageWriter::EncodePfm(const Request& request, std::vector<char>* out_file)
+  {
+    // A negative scale marks little endian data, rows are stored from the bottom up
+    std::stringstream header;
+    header << "PF\n" << request.width << " " << request.height << "\n-1.0\n";
+
+    std::string text = header.str();
+    Append(out_file, text.data(), text.size());
+
+    std::vector<float> row(request.width * 3);
+    out_file->reserve(out_file->size() + row.size() * sizeof(float) * request.height);
+
+    for (UINT y = request.height; y-- > 0;)
+    {
+      const XMFLOAT4* pixels = request.pixels.data() + static_cast<size_t>(y) * request.width;
+
+      for (UINT x = 0; x < request.width; x++)
+      {
+        row[x * 3 + 0] = pixels[x].x;
+        row[x * 3 + 1] = pixels[x].y;
+        row[x * 3 + 2] = pixels[x].z;
+      }
+
+      Append(out_file, row.data(), row.size() * sizeof(float));
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void ImageWriter::Append(std::vector<char>* out_file, const void* data, size_t size)
+  {
+    const char* bytes = static_cast<const char*>(data);
+    out_file->insert(out_file->end(), bytes, bytes + size);
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void ImageWriter::AppendExrAttribute(std::vector<char>* out_file, const char* name, const char* type, const void* value, int size)
+  {
+    Append(out_file, name, strlen(name) + 1);
+    Append(out_file, type, strlen(type) + 1);
+    Append(out_file, &size, sizeof(size));
+    Append(out_file, value, size);
+  }
+}
\ No newline at end of file
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "tonemapping.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+namespace rtrt
+{
+  /**
+  * Saves renders and their AOVs as PNG, OpenEXR or PFM files without holding up the render loop. Queuing an image
+  * only copies its pixels, converting, encoding and compressing happen on a pool of worker threads. Every file is
+  * encoded into memory first and written with a single sequential write, and only one worker writes at a time, so
+  * batch renders that save many frames do not make the disk seek between files.
+  */
+  class ImageWriter
+  {
+  public:
+    enum Format
+    {
+      PNG,
+      EXR,
+      PFM,
+      NumFormats
+    };
+
+    // What the pixels hold, which decides how they are converted to the format
+    enum Content
+    {
+      Radiance, // Linear HDR color, tonemapped for PNG
+      Albedo, // Linear color in [0, 1], only gamma corrected for PNG
+      Normals, // Signed vectors, mapped to [0, 1] for PNG
+      Moments // Luminance moments as accumulated by the tracer, saved as the per pixel variance
+    };
+
+  public:
+    ImageWriter();
+    ~ImageWriter();
+
+    void Create();
+
+    // Finishes every queued image before the workers stop
+    void Destroy();
+
+    /**
+    * Queues an image. Blocks only when too many images are waiting already, which bounds the memory held by the queue.
+    * @param[in] path Where the file is written, an existing file is overwritten
+    * @param[in] format The file format, the path is used as is and should carry the matching extension
+    * @param[in] content What the pixels hold
+    * @param[in] tone_mapping How Radiance is mapped to PNG, the gamma is also applied to Albedo
+    * @param[in] pixels width * height pixels, copied before this returns
+    * @param[in] width The width of the image
+    * @param[in] height The height of the image
+    */
+    void Write(const std::string& path, Format format, Content content, const ToneMapping& tone_mapping, const XMFLOAT4* pixels, UINT width, UINT height);
+
+    // The number of images that are queued or being encoded and written
+    UINT GetNumPending();
+
+    static const char* GetExtension(Format format);
+
+    static const char* FORMAT_NAMES[NumFormats];
+    static const size_t MAX_QUEUED = 16;
+
+  private:
+    struct Request
+    {
+      std::string path;
+      Format format;
+      Content content;
+      ToneMapping tone_mapping;
+      std::vector<XMFLOAT4> pixels;
+      UINT width;
+      UINT height;
+    };
+
+    void WorkerThread();
+
+    static void Convert(Request* request);
+    static void EncodePng(const Request& request, std::vector<char>* out_file);
+    static void EncodeExr(const Request& request, std::vector<char>* out_file);
+    static void EncodePfm(const Request& request, std::vector<char>* out_file);
+
+    static void Append(std::vector<char>* out_file, const void* data, size_t size);
+    static void AppendExrAttribute(std::vector<char>* out_file, const char* name, const char* type, const void* value, int size);
+
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    std::condition_variable space_condition_;
+    std::deque<Request> requests_;
+    UINT num_encoding_;
+    bool stop_;
+
+    std::mutex disk_mutex_;
+  };
+}
\ No newline at end of file
@@ -83,7 +83,11 @@ namespace rtrt
 
     ImGuiIO& io = ImGui::GetIO();
 
-    io.DisplaySize = ImVec2(1280.0f, 720.0f);
+    // The UI is drawn into the back buffers, which have the render resolution and are stretched to the window
+    io.DisplaySize = ImVec2(static_cast<float>(device_->width), static_cast<float>(device_->height));
+
+    int window_width, window_height;
+    glfwGetWindowSize(window_, &window_width, &window_height);
 
     INT64 current_time;
     QueryPerformanceCounter((LARGE_INTEGER *)&current_time);
@@ -119,7 +123,10 @@ namespace rtrt
 
     double x, y;
     glfwGetCursorPos(window_, &x, &y);
-    io.MousePos = ImVec2(static_cast<float>(x), static_cast<float>(y));
+    io.MousePos = ImVec2(
+      static_cast<float>(x) * io.DisplaySize.x / std::max(window_width, 1),
+      static_cast<float>(y) * io.DisplaySize.y / std::max(window_height, 1)
+    );
     io.MouseWheel = mouse_scroll_;
     mouse_scroll_ = 0.0f;
 
@@ -0,0 +1,115 @@
+#include "light_list.h"
+
+#include "model.h"
+
+namespace rtrt
+{
+  //------------------------------------------------------------------------------------------------------
+  void LightListUtility::BuildEmissiveTriangles(const Model& model, std::vector<EmissiveTriangle>* out_triangles)
+  {
+    ThrowIfFalse(out_triangles != nullptr);
+
+    std::vector<EmissiveTriangle>& triangles = *out_triangles;
+    triangles.clear();
+
+    std::function<DirectX::XMMATRIX(const Model::Node*)> CalculateTransformForNode = [&](const Model::Node* node)->DirectX::XMMATRIX
+    {
+      if (node->parent != nullptr)
+      {
+        return DirectX::XMMatrixMultiply(node->transform, CalculateTransformForNode(node->parent));
+      }
+      else
+      {
+        return DirectX::XMMatrixIdentity();
+      }
+    };
+
+    std::function<void(const Model::Node*)> ProcessModelNode = [&](const Model::Node* node)
+    {
+      for (size_t i = 0; i < node->meshes.size(); i++)
+      {
+        const Model::Mesh& mesh = model.meshes[node->meshes[i]];
+
+        if (IsEmissiveTriangleMaterial(model, mesh.material) == false)
+        {
+          continue;
+        }
+
+        DirectX::XMMATRIX transform = CalculateTransformForNode(node);
+        const DirectX::XMFLOAT4& emission = model.materials[mesh.material].color_emissive;
+
+        for (size_t j = 0; j + 2 < mesh.indices.size(); j += 3)
+        {
+          DirectX::XMVECTOR p0 = DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&mesh.vertices[mesh.indices[j + 0]].position), transform);
+          DirectX::XMVECTOR p1 = DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&mesh.vertices[mesh.indices[j + 1]].position), transform);
+          DirectX::XMVECTOR p2 = DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&mesh.vertices[mesh.indices[j + 2]].position), transform);
+
+          float area = 0.5f * DirectX::XMVectorGetX(DirectX::XMVector3Length(DirectX::XMVector3Cross(DirectX::XMVectorSubtract(p1, p0), DirectX::XMVectorSubtract(p2, p0))));
+
+          // Degenerate triangles can never be hit, so they should never be picked either
+          if (area <= 0.0f)
+          {
+            continue;
+          }
+
+          EmissiveTriangle triangle = {};
+          DirectX::XMStoreFloat3(&triangle.p0, p0);
+          DirectX::XMStoreFloat3(&triangle.p1, p1);
+          DirectX::XMStoreFloat3(&triangle.p2, p2);
+          triangle.area = area;
+          triangle.emission = DirectX::XMFLOAT3(emission.x, emission.y, emission.z);
+          triangle.material = mesh.material;
+
+          triangles.push_back(triangle);
+        }
+      }
+
+      for (size_t i = 0; i < node->children.size(); i++)
+      {
+        ProcessModelNode(node->children[i]);
+      }
+    };
+
+    ProcessModelNode(model.root_node);
+
+    BuildSelectionDistribution(out_triangles);
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void LightListUtility::BuildSelectionDistribution(std::vector<EmissiveTriangle>* triangles_in_out)
+  {
+    std::vector<EmissiveTriangle>& triangles = *triangles_in_out;
+
+    // Selection probability proportional to emitted power: area * luminance of the emission
+    double total_power = 0.0;
+    for (size_t i = 0; i < triangles.size(); i++)
+    {
+      const DirectX::XMFLOAT3& e = triangles[i].emission;
+      total_power += triangles[i].area * (0.2126f * e.x + 0.7152f * e.y + 0.0722f * e.z);
+    }
+
+    double cumulative = 0.0;
+    for (size_t i = 0; i < triangles.size(); i++)
+    {
+      const DirectX::XMFLOAT3& e = triangles[i].emission;
+      double power = triangles[i].area * (0.2126f * e.x + 0.7152f * e.y + 0.0722f * e.z);
+
+      cumulative += power;
+      triangles[i].pdf = static_cast<float>(power / total_power);
+      triangles[i].cdf = static_cast<float>(cumulative / total_power);
+    }
+
+    if (triangles.empty() == false)
+    {
+      triangles.back().cdf = 1.0f;
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  bool LightListUtility::IsEmissiveTriangleMaterial(const Model& model, UINT material)
+  {
+    const Model::Material& m = model.materials[material];
+
+    return m.emissive_map == MATERIAL_NO_TEXTURE_INDEX && (m.color_emissive.x > 0.0f || m.color_emissive.y > 0.0f || m.color_emissive.z > 0.0f);
+  }
+}
\ No newline at end of file
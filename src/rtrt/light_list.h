@@ -0,0 +1,29 @@
+#pragma once
+
+#include "shared/raytracing_data.h"
+
+namespace rtrt
+{
+  class Model;
+
+  class LightListUtility
+  {
+  public:
+    /**
+    * Collects every triangle with an emissive material in world space and builds the power-proportional
+    * selection distribution (pdf & cdf) used by the reservoir resampling shaders.
+    * @param[in] model The model to collect emissive triangles from
+    * @param[out] out_triangles The emissive triangles, empty if the model has no emitters
+    */
+    static void BuildEmissiveTriangles(const Model& model, std::vector<EmissiveTriangle>* out_triangles);
+
+    /**
+    * Fills in the pdf & cdf of every triangle, proportional to its emitted power.
+    * @param[in,out] triangles_in_out Triangles with their positions, area and emission set
+    */
+    static void BuildSelectionDistribution(std::vector<EmissiveTriangle>* triangles_in_out);
+
+    // Keep in sync with IsEmissiveTriangleMaterial in shading_data.hlsli
+    static bool IsEmissiveTriangleMaterial(const Model& model, UINT material);
+  };
+}
\ No newline at end of file
@@ -1,6 +1,5 @@
 #include <iostream>
 #include <thread>
-#include <optix_world.h>
 
 #include "application.h"
 #include "imgui_layer.h"
@@ -10,17 +9,35 @@
 #include "buffer.h"
 #include "upload_buffer.h"
 #include "readback_buffer.h"
+#include "gpu_timer.h"
 #include "descriptor_heap.h"
 #include "model.h"
 #include "camera.h"
 #include "shader_table.h"
 #include "texture_loader.h"
+#include "texture_streamer.h"
+#include "light_list.h"
+#include "path_guiding.h"
+#include "opacity_mask.h"
+#include "texture_registry.h"
+#include "tonemapping.h"
+#include "restir_validation.h"
+#include "render_target_set.h"
+#include "readback_ring.h"
+#include "image_writer.h"
+#include "checkpoint.h"
+#include "optix_denoiser.h"
+#include "oidn_denoiser.h"
+#include "atrous_denoiser.h"
 #include "shared/raytracing_data.h"
 
 #include "compiled-shaders/rt/raytrace.cso.h"
 #include "compiled-shaders/rt/pathtrace.cso.h"
 #include "compiled-shaders/rt/picking.cso.h"
+#include "compiled-shaders/rt/restir.cso.h"
 #include "compiled-shaders/cs/averager.cso.h"
+#include "compiled-shaders/cs/convergence.cso.h"
+#include "compiled-shaders/cs/guiding.cso.h"
 
 using namespace rtrt;
 
@@ -40,6 +57,18 @@ namespace GlobalRootSignatureParams
     Indices,
     Lights,
     PickingBuffer,
+    OutputVariance,
+    ConvergenceTiles,
+    BlueNoise,
+    Reservoirs,
+    ReservoirHistory,
+    ReservoirSurfaces,
+    EmissiveTriangles,
+    GuidingTraining,
+    GuidingDistribution,
+    OpacityMasks,
+    OpacityMaskBits,
+    TextureFeedback,
     Count
   };
 }
@@ -56,6 +85,44 @@ namespace AveragerRootSignatureParams
     OutputNormals,
     OutputAlbedo,
     Constants,
+    InputVariance,
+    ConvergenceTiles,
+    Count
+  };
+}
+
+namespace ConvergenceRootSignatureParams
+{
+  enum Enum
+  {
+    InputTexture = 0,
+    InputVariance,
+    OutputTiles,
+    OutputStats,
+    Constants,
+    Count
+  };
+}
+
+namespace GuidingRootSignatureParams
+{
+  enum Enum
+  {
+    InputTraining = 0,
+    OutputDistribution,
+    Constants,
+    Count
+  };
+}
+
+namespace GpuTimers
+{
+  enum Enum
+  {
+    Pathtrace = 0,
+    OcclusionBenchmark,
+    ClosestHitBenchmark,
+    Averager,
     Count
   };
 }
@@ -72,6 +139,18 @@ union AlignedAveragerConstantBuffer
   uint8_t alignment_padding[D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT];
 };
 
+union AlignedConvergenceConstantBuffer
+{
+  ConvergenceConstantBuffer buffer;
+  uint8_t alignment_padding[D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT];
+};
+
+union AlignedGuidingConstantBuffer
+{
+  GuidingConstantBuffer buffer;
+  uint8_t alignment_padding[D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT];
+};
+
 void MessageBoxThreadFunc()
 {
   MessageBox(NULL, "Please be patient, initialization can take a long time.", "Loading..", MB_OK | MB_SYSTEMMODAL);
@@ -79,16 +158,32 @@ void MessageBoxThreadFunc()
 
 int main(int argc, char** argv)
 {
+  // Compares the CPU resolve kernels without opening a window or creating a device
+  if (argc > 1 && std::string(argv[1]) == "--benchmark-resolve")
+  {
+    ToneMappingUtility::RunResolveBenchmark(1280, 720, 100);
+    return 0;
+  }
+
+  // Checks the reservoir resampling against a reference on the CPU, also without a device
+  if (argc > 1 && std::string(argv[1]) == "--validate-restir")
+  {
+    return RestirValidationUtility::RunValidation(100000) ? 0 : 1;
+  }
+
   std::thread message_box_thread(MessageBoxThreadFunc);
   ID3D12RootSignature* global_root_signature = nullptr;
   ID3D12RaytracingFallbackStateObject* pso = nullptr;
 
-  ID3D12Resource* target_render = nullptr;
-  ID3D12Resource* target_normals = nullptr;
-  ID3D12Resource* target_albedo_target = nullptr;
-  DescriptorHandle target_render_descriptor;
-  DescriptorHandle target_normals_descriptor;
-  DescriptorHandle target_albedo_descriptor;
+  RenderTargetSet render_targets;
+
+  // Indexed by Denoising::Method
+  OptixDenoiser optix_denoiser;
+  OidnDenoiser oidn_denoiser;
+  AtrousDenoiser atrous_denoiser;
+  Denoiser* denoisers[Denoising::NumMethods] = { &optix_denoiser, &oidn_denoiser, &atrous_denoiser };
+
+  ImageWriter image_writer;
 
   std::vector<Mesh> meshes;
 
@@ -100,8 +195,16 @@ int main(int argc, char** argv)
   Buffer* materials_buffer = nullptr;
   DescriptorHandle materials_descriptor = {};
 
-  std::vector<ID3D12Resource*> textures;
+  TextureStreamer texture_streamer;
   std::vector<DescriptorHandle> texture_descriptors;
+  Buffer* texture_feedback = nullptr;
+  Buffer* texture_feedback_clear = nullptr;
+  ReadbackBuffer* texture_feedback_readback = nullptr;
+  DescriptorHandle texture_feedback_descriptor;
+  bool texture_feedback_recorded = false;
+
+  std::vector<ID3D12Resource*> blue_noise_textures;
+  std::vector<DescriptorHandle> blue_noise_descriptors;
 
   std::vector<Buffer*> vertex_buffers;
   std::vector<Buffer*> index_buffers;
@@ -112,6 +215,10 @@ int main(int argc, char** argv)
   ShaderTable* shader_table_ray_generation = nullptr;
   ShaderTable* shader_table_hit = nullptr;
   ShaderTable* shader_table_miss = nullptr;
+  ShaderTable* shader_table_occlusion_benchmark = nullptr;
+  ShaderTable* shader_table_closest_hit_benchmark = nullptr;
+
+  GpuTimer gpu_timer;
 
   UploadBuffer* scene_constants_buffer = nullptr;
   SceneConstantBuffer constant_buffer_data[Device::NUM_BACK_BUFFERS] = {};
@@ -121,20 +228,10 @@ int main(int argc, char** argv)
 
   ID3D12RootSignature* averager_root_signature = nullptr;
   ID3D12PipelineState* averager_pso = nullptr;
-  ID3D12Resource* averager_texture = nullptr;
-  ID3D12Resource* averager_buffer = nullptr;
-  ID3D12Resource* averager_normals = nullptr;
-  ID3D12Resource* averager_albedo = nullptr;
-  DescriptorHandle averager_texture_descriptor;
-  DescriptorHandle averager_buffer_descriptor;
-  DescriptorHandle averager_normals_descriptor;
-  DescriptorHandle averager_albedo_descriptor;
-  ReadbackBuffer* averager_buffer_readback = nullptr;
-  ReadbackBuffer* averager_normals_readback = nullptr;
-  ReadbackBuffer* averager_albedo_readback = nullptr;
   UploadBuffer* averager_constants_buffer = nullptr;
 
-  AveragerConstantBuffer averager_constants[Device::NUM_BACK_BUFFERS] = {};
+  // Two slots per back buffer, the guide resolve is recorded into the same frame as the display resolve
+  AveragerConstantBuffer averager_constants[Device::NUM_BACK_BUFFERS * 2] = {};
 
   ID3D12RaytracingFallbackStateObject* picking_pso = nullptr;
   ShaderTable* picking_shader_table_ray_generation = nullptr;
@@ -144,20 +241,47 @@ int main(int argc, char** argv)
   ReadbackBuffer* picking_buffer_readback = nullptr;
   DescriptorHandle picking_buffer_descriptor;
 
+  ID3D12RootSignature* convergence_root_signature = nullptr;
+  ID3D12PipelineState* convergence_pso = nullptr;
+  Buffer* convergence_stats = nullptr;
+  Buffer* convergence_stats_zero = nullptr;
+  ReadbackBuffer* convergence_stats_readback = nullptr;
+  DescriptorHandle convergence_stats_descriptor;
+  UploadBuffer* convergence_constants_buffer = nullptr;
+
+  ConvergenceConstantBuffer convergence_constants[Device::NUM_BACK_BUFFERS] = {};
+
+  ID3D12RaytracingFallbackStateObject* restir_pso = nullptr;
+  ShaderTable* restir_shader_table_initial = nullptr;
+  ShaderTable* restir_shader_table_spatial = nullptr;
+  ShaderTable* restir_shader_table_hit = nullptr;
+  ShaderTable* restir_shader_table_miss = nullptr;
+
+  std::vector<EmissiveTriangle> emissive_triangles;
+  Buffer* emissive_triangles_buffer = nullptr;
+
+  std::vector<OpacityMask> opacity_masks;
+  std::vector<UINT> opacity_mask_bits;
+  Buffer* opacity_masks_buffer = nullptr;
+  Buffer* opacity_mask_bits_buffer = nullptr;
+
+  ID3D12RootSignature* guiding_root_signature = nullptr;
+  ID3D12PipelineState* guiding_pso = nullptr;
+  Buffer* guiding_training = nullptr;
+  Buffer* guiding_distribution = nullptr;
+  DescriptorHandle guiding_training_descriptor;
+  DescriptorHandle guiding_distribution_descriptor;
+  UploadBuffer* guiding_constants_buffer = nullptr;
+  DirectX::XMFLOAT3 guiding_bounds_min;
+  DirectX::XMFLOAT3 guiding_bounds_max;
+
+  GuidingConstantBuffer guiding_constants[Device::NUM_BACK_BUFFERS] = {};
+
   Application app;
   GLFWwindow* window = nullptr;
   Device device;
   ImGuiLayer imgui_layer;
 
-  optix::Context optix;
-  optix::Buffer optix_input;
-  optix::Buffer optix_normals;
-  optix::Buffer optix_albedo;
-  optix::Buffer optix_output;
-  optix::CommandList optix_list;
-  optix::PostprocessingStage optix_denoiser_stage;
-  unsigned char* denoised_pixels = new unsigned char[1280 * 720 * 4];
-
   // App
   {
     app.Initialize();
@@ -181,12 +305,21 @@ int main(int argc, char** argv)
 
   // Pathtracing global root signature
   {
-    CD3DX12_DESCRIPTOR_RANGE ranges[5];
+    CD3DX12_DESCRIPTOR_RANGE ranges[14];
     ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, CPP_REGISTER_OUTPUT);
     ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1024, CPP_REGISTER_TEXTURES);
     ranges[2].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, CPP_REGISTER_PICKING_BUFFER);
     ranges[3].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, CPP_REGISTER_NORMALS);
     ranges[4].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, CPP_REGISTER_ALBEDO);
+    ranges[5].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, CPP_REGISTER_VARIANCE);
+    ranges[6].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, CPP_REGISTER_CONVERGENCE);
+    ranges[7].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, BLUE_NOISE_SLICES, CPP_REGISTER_BLUE_NOISE, CPP_SPACE_BLUE_NOISE);
+    ranges[8].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, CPP_REGISTER_RESERVOIRS);
+    ranges[9].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, CPP_REGISTER_RESERVOIR_HISTORY);
+    ranges[10].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, CPP_REGISTER_RESERVOIR_SURFACES);
+    ranges[11].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, CPP_REGISTER_GUIDING_TRAINING);
+    ranges[12].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, CPP_REGISTER_GUIDING_DISTRIBUTION);
+    ranges[13].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, CPP_REGISTER_TEXTURE_FEEDBACK);
 
     CD3DX12_ROOT_PARAMETER root_parameters[GlobalRootSignatureParams::Count];
     root_parameters[GlobalRootSignatureParams::SceneConstants].InitAsConstantBufferView(0);
@@ -194,6 +327,8 @@ int main(int argc, char** argv)
     root_parameters[GlobalRootSignatureParams::OutputTexture].InitAsDescriptorTable(1, &ranges[0]);
     root_parameters[GlobalRootSignatureParams::OutputNormals].InitAsDescriptorTable(1, &ranges[3]);
     root_parameters[GlobalRootSignatureParams::OutputAlbedo].InitAsDescriptorTable(1, &ranges[4]);
+    root_parameters[GlobalRootSignatureParams::OutputVariance].InitAsDescriptorTable(1, &ranges[5]);
+    root_parameters[GlobalRootSignatureParams::ConvergenceTiles].InitAsDescriptorTable(1, &ranges[6]);
 
     root_parameters[GlobalRootSignatureParams::AccelerationStructure].InitAsShaderResourceView(CPP_REGISTER_ACCELERATION_STRUCT);
     root_parameters[GlobalRootSignatureParams::Meshes].InitAsShaderResourceView(CPP_REGISTER_MESHES);
@@ -203,6 +338,16 @@ int main(int argc, char** argv)
     root_parameters[GlobalRootSignatureParams::Textures].InitAsDescriptorTable(1, &ranges[1]);
     root_parameters[GlobalRootSignatureParams::Lights].InitAsShaderResourceView(CPP_REGISTER_LIGHTS);
     root_parameters[GlobalRootSignatureParams::PickingBuffer].InitAsDescriptorTable(1, &ranges[2]);
+    root_parameters[GlobalRootSignatureParams::BlueNoise].InitAsDescriptorTable(1, &ranges[7]);
+    root_parameters[GlobalRootSignatureParams::Reservoirs].InitAsDescriptorTable(1, &ranges[8]);
+    root_parameters[GlobalRootSignatureParams::ReservoirHistory].InitAsDescriptorTable(1, &ranges[9]);
+    root_parameters[GlobalRootSignatureParams::ReservoirSurfaces].InitAsDescriptorTable(1, &ranges[10]);
+    root_parameters[GlobalRootSignatureParams::EmissiveTriangles].InitAsShaderResourceView(CPP_REGISTER_EMISSIVE_TRIANGLES, CPP_SPACE_EMISSIVE_TRIANGLES);
+    root_parameters[GlobalRootSignatureParams::GuidingTraining].InitAsDescriptorTable(1, &ranges[11]);
+    root_parameters[GlobalRootSignatureParams::GuidingDistribution].InitAsDescriptorTable(1, &ranges[12]);
+    root_parameters[GlobalRootSignatureParams::OpacityMasks].InitAsShaderResourceView(CPP_REGISTER_OPACITY_MASKS, CPP_SPACE_OPACITY_MASKS);
+    root_parameters[GlobalRootSignatureParams::OpacityMaskBits].InitAsShaderResourceView(CPP_REGISTER_OPACITY_MASK_BITS, CPP_SPACE_OPACITY_MASKS);
+    root_parameters[GlobalRootSignatureParams::TextureFeedback].InitAsDescriptorTable(1, &ranges[13]);
 
     D3D12_STATIC_SAMPLER_DESC sampler;
     sampler.AddressU = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
@@ -235,18 +380,25 @@ int main(int argc, char** argv)
     auto color_hit_group_subobject = pso_desc.CreateSubobject<CD3D12_HIT_GROUP_SUBOBJECT>();
     color_hit_group_subobject->SetHitGroupType(D3D12_HIT_GROUP_TYPE_TRIANGLES);
     color_hit_group_subobject->SetClosestHitShaderImport(L"ColorHit");
+    color_hit_group_subobject->SetAnyHitShaderImport(L"ColorAnyHit");
     color_hit_group_subobject->SetHitGroupExport(L"ColorHitGroup");
 
     auto geometry_hit_group_subobject = pso_desc.CreateSubobject<CD3D12_HIT_GROUP_SUBOBJECT>();
     geometry_hit_group_subobject->SetHitGroupType(D3D12_HIT_GROUP_TYPE_TRIANGLES);
     geometry_hit_group_subobject->SetClosestHitShaderImport(L"GeometryHit");
+    geometry_hit_group_subobject->SetAnyHitShaderImport(L"GeometryAnyHit");
     geometry_hit_group_subobject->SetHitGroupExport(L"GeometryHitGroup");
 
+    auto occlusion_hit_group_subobject = pso_desc.CreateSubobject<CD3D12_HIT_GROUP_SUBOBJECT>();
+    occlusion_hit_group_subobject->SetHitGroupType(D3D12_HIT_GROUP_TYPE_TRIANGLES);
+    occlusion_hit_group_subobject->SetAnyHitShaderImport(L"OcclusionAnyHit");
+    occlusion_hit_group_subobject->SetHitGroupExport(L"OcclusionHitGroup");
+
     auto global_root_signature_subobject = pso_desc.CreateSubobject<CD3D12_GLOBAL_ROOT_SIGNATURE_SUBOBJECT>();
     global_root_signature_subobject->SetRootSignature(global_root_signature);
 
     auto shader_config_subobject = pso_desc.CreateSubobject<CD3D12_RAYTRACING_SHADER_CONFIG_SUBOBJECT>();
-    shader_config_subobject->Config(6 * sizeof(float), 2 * sizeof(float));
+    shader_config_subobject->Config(10 * sizeof(float), 2 * sizeof(float));
 
     auto pipeline_config_subobject = pso_desc.CreateSubobject<CD3D12_RAYTRACING_PIPELINE_CONFIG_SUBOBJECT>();
     pipeline_config_subobject->Config(31);
@@ -261,82 +413,82 @@ int main(int argc, char** argv)
     shader_table_ray_generation = new ShaderTable(device.device, 1, shader_identifier_size);
     shader_table_ray_generation->Add(ShaderRecord(pso->GetShaderIdentifier(L"PrimaryRaygeneration"), shader_identifier_size, nullptr, 0));
 
-    shader_table_hit = new ShaderTable(device.device, 2, shader_identifier_size);
+    shader_table_occlusion_benchmark = new ShaderTable(device.device, 1, shader_identifier_size);
+    shader_table_occlusion_benchmark->Add(ShaderRecord(pso->GetShaderIdentifier(L"OcclusionBenchmarkRaygeneration"), shader_identifier_size, nullptr, 0));
+
+    shader_table_closest_hit_benchmark = new ShaderTable(device.device, 1, shader_identifier_size);
+    shader_table_closest_hit_benchmark->Add(ShaderRecord(pso->GetShaderIdentifier(L"ClosestHitBenchmarkRaygeneration"), shader_identifier_size, nullptr, 0));
+
+    shader_table_hit = new ShaderTable(device.device, 3, shader_identifier_size);
     shader_table_hit->Add(ShaderRecord(pso->GetShaderIdentifier(L"ColorHitGroup"), shader_identifier_size, nullptr, 0));
     shader_table_hit->Add(ShaderRecord(pso->GetShaderIdentifier(L"GeometryHitGroup"), shader_identifier_size, nullptr, 0));
+    shader_table_hit->Add(ShaderRecord(pso->GetShaderIdentifier(L"OcclusionHitGroup"), shader_identifier_size, nullptr, 0));
 
-    shader_table_miss = new ShaderTable(device.device, 2, shader_identifier_size);
+    shader_table_miss = new ShaderTable(device.device, 3, shader_identifier_size);
     shader_table_miss->Add(ShaderRecord(pso->GetShaderIdentifier(L"ColorMiss"), shader_identifier_size, nullptr, 0));
     shader_table_miss->Add(ShaderRecord(pso->GetShaderIdentifier(L"GeometryMiss"), shader_identifier_size, nullptr, 0));
+    shader_table_miss->Add(ShaderRecord(pso->GetShaderIdentifier(L"OcclusionMiss"), shader_identifier_size, nullptr, 0));
   }
 
-  // Pathtracing render targets & readbacks
+  // ReSTIR PSO
   {
-    // Render target
-    {
-      device.device->CreateCommittedResource(
-        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-        D3D12_HEAP_FLAG_NONE,
-        &CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R32G32B32A32_FLOAT, 1280, 720, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS),
-        D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-        nullptr,
-        IID_PPV_ARGS(&target_render)
-      );
+    CD3D12_STATE_OBJECT_DESC pso_desc;
+    pso_desc.SetStateObjectType(D3D12_STATE_OBJECT_TYPE_RAYTRACING_PIPELINE);
 
-      D3D12_UNORDERED_ACCESS_VIEW_DESC uav_desc;
-      uav_desc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
-      uav_desc.Texture2D.MipSlice = 0;
-      uav_desc.Texture2D.PlaneSlice = 0;
-      uav_desc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+    auto dxil_lib_subobject = pso_desc.CreateSubobject<CD3D12_DXIL_LIBRARY_SUBOBJECT>();
+    D3D12_SHADER_BYTECODE dxil_lib = CD3DX12_SHADER_BYTECODE(cso_restir, ARRAYSIZE(cso_restir));
+    dxil_lib_subobject->SetDXILLibrary(&dxil_lib);
 
-      device.uav_heap->CreateDescriptor(device.device, target_render, nullptr, &uav_desc, &target_render_descriptor);
-    }
+    auto surface_hit_group_subobject = pso_desc.CreateSubobject<CD3D12_HIT_GROUP_SUBOBJECT>();
+    surface_hit_group_subobject->SetHitGroupType(D3D12_HIT_GROUP_TYPE_TRIANGLES);
+    surface_hit_group_subobject->SetClosestHitShaderImport(L"ReservoirSurfaceHit");
+    surface_hit_group_subobject->SetAnyHitShaderImport(L"ReservoirSurfaceAnyHit");
+    surface_hit_group_subobject->SetHitGroupExport(L"ReservoirSurfaceHitGroup");
 
-    // Normals target
-    {
-      device.device->CreateCommittedResource(
-        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-        D3D12_HEAP_FLAG_NONE,
-        &CD3DX12_RESOURCE_DESC::Buffer(1280 * 720 * 16, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS),
-        D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-        nullptr,
-        IID_PPV_ARGS(&target_normals)
-      );
+    auto occlusion_hit_group_subobject = pso_desc.CreateSubobject<CD3D12_HIT_GROUP_SUBOBJECT>();
+    occlusion_hit_group_subobject->SetHitGroupType(D3D12_HIT_GROUP_TYPE_TRIANGLES);
+    occlusion_hit_group_subobject->SetAnyHitShaderImport(L"OcclusionAnyHit");
+    occlusion_hit_group_subobject->SetHitGroupExport(L"OcclusionHitGroup");
 
-      D3D12_UNORDERED_ACCESS_VIEW_DESC uav_desc;
-      uav_desc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
-      uav_desc.Buffer.CounterOffsetInBytes = 0;
-      uav_desc.Buffer.FirstElement = 0;
-      uav_desc.Buffer.Flags = D3D12_BUFFER_UAV_FLAG_NONE;
-      uav_desc.Buffer.NumElements = 1280 * 720;
-      uav_desc.Buffer.StructureByteStride = 16;
-      uav_desc.Format = DXGI_FORMAT_UNKNOWN;
+    auto global_root_signature_subobject = pso_desc.CreateSubobject<CD3D12_GLOBAL_ROOT_SIGNATURE_SUBOBJECT>();
+    global_root_signature_subobject->SetRootSignature(global_root_signature);
 
-      device.uav_heap->CreateDescriptor(device.device, target_normals, nullptr, &uav_desc, &target_normals_descriptor);
-    }
+    auto shader_config_subobject = pso_desc.CreateSubobject<CD3D12_RAYTRACING_SHADER_CONFIG_SUBOBJECT>();
+    shader_config_subobject->Config(sizeof(ReservoirSurface), 2 * sizeof(float));
 
-    // Albedo target
-    {
-      device.device->CreateCommittedResource(
-        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-        D3D12_HEAP_FLAG_NONE, 
-        &CD3DX12_RESOURCE_DESC::Buffer(1280 * 720 * 16, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS),
-        D3D12_RESOURCE_STATE_UNORDERED_ACCESS, 
-        nullptr, 
-        IID_PPV_ARGS(&target_albedo_target)
-      );
+    auto pipeline_config_subobject = pso_desc.CreateSubobject<CD3D12_RAYTRACING_PIPELINE_CONFIG_SUBOBJECT>();
+    pipeline_config_subobject->Config(1);
 
-      D3D12_UNORDERED_ACCESS_VIEW_DESC uav_desc;
-      uav_desc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
-      uav_desc.Buffer.CounterOffsetInBytes = 0;
-      uav_desc.Buffer.FirstElement = 0;
-      uav_desc.Buffer.Flags = D3D12_BUFFER_UAV_FLAG_NONE;
-      uav_desc.Buffer.NumElements = 1280 * 720;
-      uav_desc.Buffer.StructureByteStride = 16;
-      uav_desc.Format = DXGI_FORMAT_UNKNOWN;
+    ThrowIfFailed(device.fallback_device->CreateStateObject(pso_desc, IID_PPV_ARGS(&restir_pso)));
+  }
 
-      device.uav_heap->CreateDescriptor(device.device, target_albedo_target, nullptr, &uav_desc, &target_albedo_descriptor);
-    }
+  // ReSTIR shader tables
+  {
+    UINT shader_identifier_size = device.fallback_device->GetShaderIdentifierSize();
+
+    restir_shader_table_initial = new ShaderTable(device.device, 1, shader_identifier_size);
+    restir_shader_table_initial->Add(ShaderRecord(restir_pso->GetShaderIdentifier(L"ReservoirInitialRaygeneration"), shader_identifier_size, nullptr, 0));
+
+    restir_shader_table_spatial = new ShaderTable(device.device, 1, shader_identifier_size);
+    restir_shader_table_spatial->Add(ShaderRecord(restir_pso->GetShaderIdentifier(L"ReservoirSpatialRaygeneration"), shader_identifier_size, nullptr, 0));
+
+    restir_shader_table_hit = new ShaderTable(device.device, 2, shader_identifier_size);
+    restir_shader_table_hit->Add(ShaderRecord(restir_pso->GetShaderIdentifier(L"ReservoirSurfaceHitGroup"), shader_identifier_size, nullptr, 0));
+    restir_shader_table_hit->Add(ShaderRecord(restir_pso->GetShaderIdentifier(L"OcclusionHitGroup"), shader_identifier_size, nullptr, 0));
+
+    restir_shader_table_miss = new ShaderTable(device.device, 2, shader_identifier_size);
+    restir_shader_table_miss->Add(ShaderRecord(restir_pso->GetShaderIdentifier(L"ReservoirSurfaceMiss"), shader_identifier_size, nullptr, 0));
+    restir_shader_table_miss->Add(ShaderRecord(restir_pso->GetShaderIdentifier(L"OcclusionMiss"), shader_identifier_size, nullptr, 0));
+  }
+
+  // GPU timers
+  {
+    gpu_timer.Create(device.device, device.command_queue);
+  }
+
+  // Render targets, everything whose size depends on the render resolution
+  {
+    render_targets.Create(&device, app.resolution.width, app.resolution.height);
   }
 
   // Model loading
@@ -352,24 +504,82 @@ int main(int argc, char** argv)
       index_buffers[i]->Create(&device, D3D12_RESOURCE_STATE_INDEX_BUFFER, static_cast<UINT>(mesh.indices.size() * sizeof(Index)), mesh.indices.data());
     }
 
-    textures.resize(app.model.textures.size());
-    texture_descriptors.resize(app.model.textures.size());
+    // Identical images exported under different names share one texture, materials are remapped before anything indexes them
+    TextureRegistryUtility::DeduplicateTextures(&app.model);
+
+    // Textures stream in while rendering: every texture starts out as a placeholder and gets its mips in the order the
+    // texture feedback asks for them. Decoding, mip generation and block compression happen on the streaming threads.
+    std::vector<std::string> texture_paths(app.model.textures.size());
+    std::vector<TextureUsage> texture_usages(app.model.textures.size());
     for (size_t i = 0; i < app.model.textures.size(); i++)
     {
-      TextureLoader::LoadTexture(device.device, device.command_queue, app.model.textures[i].path, &textures[i]);
+      texture_paths[i] = app.model.textures[i].path;
+      texture_usages[i] = app.model.textures[i].usage;
+    }
+
+    texture_streamer.Create(device.device, device.command_queue, device.srv_heap, texture_paths, texture_usages, true, static_cast<UINT64>(app.texture_streaming.budget_mb) * 1024 * 1024);
+    texture_descriptors = texture_streamer.GetDescriptors();
+
+    // Feedback is cleared by copying over it, which starts every texture at "not sampled"
+    std::vector<TextureFeedback> clear_feedback(std::max(texture_paths.size(), static_cast<size_t>(1)), { 0xFFFFFFFF, 0 });
 
-      D3D12_SHADER_RESOURCE_VIEW_DESC srv_desc;
-      srv_desc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-      srv_desc.Format = DXGI_FORMAT_UNKNOWN;
-      srv_desc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-      srv_desc.Texture2D.MipLevels = 1;
-      srv_desc.Texture2D.MostDetailedMip = 0;
-      srv_desc.Texture2D.PlaneSlice = 0;
-      srv_desc.Texture2D.ResourceMinLODClamp = 0.0f;
+    texture_feedback = new Buffer();
+    texture_feedback->Create(&device, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, static_cast<UINT>(clear_feedback.size() * sizeof(TextureFeedback)), clear_feedback.data());
 
-      device.srv_heap->CreateDescriptor(device.device, textures[i], &srv_desc, &texture_descriptors[i]);
+    texture_feedback_clear = new Buffer();
+    texture_feedback_clear->Create(&device, D3D12_RESOURCE_STATE_COPY_SOURCE, static_cast<UINT>(clear_feedback.size() * sizeof(TextureFeedback)), clear_feedback.data());
+
+    texture_feedback_readback = new ReadbackBuffer();
+    texture_feedback_readback->Create(device.device, static_cast<UINT>(clear_feedback.size() * sizeof(TextureFeedback)));
+
+    D3D12_UNORDERED_ACCESS_VIEW_DESC uav_desc;
+    uav_desc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
+    uav_desc.Buffer.CounterOffsetInBytes = 0;
+    uav_desc.Buffer.FirstElement = 0;
+    uav_desc.Buffer.Flags = D3D12_BUFFER_UAV_FLAG_NONE;
+    uav_desc.Buffer.NumElements = static_cast<UINT>(clear_feedback.size());
+    uav_desc.Buffer.StructureByteStride = sizeof(TextureFeedback);
+    uav_desc.Format = DXGI_FORMAT_UNKNOWN;
+
+    device.uav_heap->CreateDescriptor(device.device, texture_feedback->GetBuffer(), nullptr, &uav_desc, &texture_feedback_descriptor);
+
+    // Blue-noise tiles are optional, they are generated offline by the blue-noise-generator
+    bool blue_noise_found = true;
+    for (UINT i = 0; i < BLUE_NOISE_SLICES; i++)
+    {
+      blue_noise_found = blue_noise_found && std::experimental::filesystem::exists("./textures/blue-noise/blue_noise_" + std::to_string(i) + ".png");
     }
 
+    if (blue_noise_found == true)
+    {
+      blue_noise_textures.resize(BLUE_NOISE_SLICES);
+      blue_noise_descriptors.resize(BLUE_NOISE_SLICES);
+      for (UINT i = 0; i < BLUE_NOISE_SLICES; i++)
+      {
+        TextureLoader::LoadDataTexture(device.device, device.command_queue, "./textures/blue-noise/blue_noise_" + std::to_string(i) + ".png", &blue_noise_textures[i]);
+
+        D3D12_SHADER_RESOURCE_VIEW_DESC srv_desc;
+        srv_desc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+        srv_desc.Format = DXGI_FORMAT_UNKNOWN;
+        srv_desc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+        srv_desc.Texture2D.MipLevels = 1;
+        srv_desc.Texture2D.MostDetailedMip = 0;
+        srv_desc.Texture2D.PlaneSlice = 0;
+        srv_desc.Texture2D.ResourceMinLODClamp = 0.0f;
+
+        device.srv_heap->CreateDescriptor(device.device, blue_noise_textures[i], &srv_desc, &blue_noise_descriptors[i]);
+      }
+    }
+    else
+    {
+      LOG("Blue-noise tiles not found in ./textures/blue-noise/, the blue-noise sampler is unavailable.\n");
+    }
+
+    app.sampling.blue_noise_available = blue_noise_found;
+
+    // Has to happen before the materials are copied and the BLASes are built, both depend on Material::opacity_mask
+    OpacityMaskUtility::BuildOpacityMasks(&app.model, &opacity_masks, &opacity_mask_bits);
+
     materials.resize(app.model.materials.size());
     for (size_t i = 0; i < app.model.materials.size(); i++)
     {
@@ -390,6 +600,9 @@ int main(int argc, char** argv)
       materials[i].normal_map = app.model.materials[i].normal_map;
       materials[i].index_of_refraction = app.model.materials[i].index_of_refraction;
       materials[i].shading_model = app.model.materials[i].shading_model;
+      materials[i].glossiness = app.model.materials[i].glossiness;
+      materials[i].opacity_map = app.model.materials[i].opacity_map;
+      materials[i].opacity_mask = app.model.materials[i].opacity_mask;
     }
 
     materials_buffer = new Buffer();
@@ -447,9 +660,35 @@ int main(int argc, char** argv)
     lights_buffer->Create(device.device, static_cast<UINT>(sizeof(Light) * lights.size()), lights.data());
   }
 
+  // Emissive triangles, the buffer always holds at least one element so that it can be bound
+  {
+    LightListUtility::BuildEmissiveTriangles(app.model, &emissive_triangles);
+
+    std::vector<EmissiveTriangle> buffer_data = emissive_triangles;
+    buffer_data.resize(std::max(buffer_data.size(), size_t(1)), EmissiveTriangle{});
+
+    emissive_triangles_buffer = new Buffer();
+    emissive_triangles_buffer->Create(&device, D3D12_RESOURCE_STATE_GENERIC_READ, static_cast<UINT>(sizeof(EmissiveTriangle) * buffer_data.size()), buffer_data.data());
+  }
+
+  // Opacity masks, both buffers always hold at least one element so that they can be bound
+  {
+    std::vector<OpacityMask> mask_data = opacity_masks;
+    mask_data.resize(std::max(mask_data.size(), size_t(1)), OpacityMask{});
+
+    std::vector<UINT> bit_data = opacity_mask_bits;
+    bit_data.resize(std::max(bit_data.size(), size_t(1)), 0);
+
+    opacity_masks_buffer = new Buffer();
+    opacity_masks_buffer->Create(&device, D3D12_RESOURCE_STATE_GENERIC_READ, static_cast<UINT>(sizeof(OpacityMask) * mask_data.size()), mask_data.data());
+
+    opacity_mask_bits_buffer = new Buffer();
+    opacity_mask_bits_buffer->Create(&device, D3D12_RESOURCE_STATE_GENERIC_READ, static_cast<UINT>(sizeof(UINT) * bit_data.size()), bit_data.data());
+  }
+
   // Averager root signature
   {
-    CD3DX12_DESCRIPTOR_RANGE ranges[7];
+    CD3DX12_DESCRIPTOR_RANGE ranges[9];
     ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 0);
     ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 1);
     ranges[2].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 2);
@@ -457,6 +696,8 @@ int main(int argc, char** argv)
     ranges[4].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 4);
     ranges[5].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 5);
     ranges[6].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 6);
+    ranges[7].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 7);
+    ranges[8].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 8);
 
     CD3DX12_ROOT_PARAMETER root_parameters[AveragerRootSignatureParams::Count];
     root_parameters[AveragerRootSignatureParams::InputTexture].InitAsDescriptorTable(1, &ranges[0]);
@@ -467,6 +708,8 @@ int main(int argc, char** argv)
     root_parameters[AveragerRootSignatureParams::OutputNormals].InitAsDescriptorTable(1, &ranges[5]);
     root_parameters[AveragerRootSignatureParams::OutputAlbedo].InitAsDescriptorTable(1, &ranges[6]);
     root_parameters[AveragerRootSignatureParams::Constants].InitAsConstantBufferView(0);
+    root_parameters[AveragerRootSignatureParams::InputVariance].InitAsDescriptorTable(1, &ranges[7]);
+    root_parameters[AveragerRootSignatureParams::ConvergenceTiles].InitAsDescriptorTable(1, &ranges[8]);
 
     CD3DX12_ROOT_SIGNATURE_DESC root_signature_desc(ARRAYSIZE(root_parameters), root_parameters);
     averager_root_signature = RootSignatureFactory::BuildRootSignature(device.device, &root_signature_desc);
@@ -484,100 +727,129 @@ int main(int argc, char** argv)
     device.device->CreateComputePipelineState(&accum_pso_desc, IID_PPV_ARGS(&averager_pso));
   }
 
-  // Averager output
+  // Averager constants
   {
-    {
-      D3D12_RESOURCE_DESC averager_output_desc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, 1280, 720, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
-      CD3DX12_HEAP_PROPERTIES heap_props(D3D12_HEAP_TYPE_DEFAULT);
-      device.device->CreateCommittedResource(
-        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-        D3D12_HEAP_FLAG_NONE, 
-        &CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, 1280, 720, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS),
-        D3D12_RESOURCE_STATE_UNORDERED_ACCESS, 
-        nullptr, 
-        IID_PPV_ARGS(&averager_texture)
-      );
+    averager_constants_buffer = new UploadBuffer();
+    averager_constants_buffer->Create(device.device, sizeof(AlignedAveragerConstantBuffer) * Device::NUM_BACK_BUFFERS * 2, nullptr);
+  }
 
-      D3D12_UNORDERED_ACCESS_VIEW_DESC uav_desc;
-      uav_desc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
-      uav_desc.Texture2D.MipSlice = 0;
-      uav_desc.Texture2D.PlaneSlice = 0;
-      uav_desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+  // Convergence root signature
+  {
+    CD3DX12_DESCRIPTOR_RANGE ranges[4];
+    ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 0);
+    ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 1);
+    ranges[2].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 2);
+    ranges[3].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 3);
 
-      device.uav_heap->CreateDescriptor(device.device, averager_texture, nullptr, &uav_desc, &averager_texture_descriptor);
-    }
+    CD3DX12_ROOT_PARAMETER root_parameters[ConvergenceRootSignatureParams::Count];
+    root_parameters[ConvergenceRootSignatureParams::InputTexture].InitAsDescriptorTable(1, &ranges[0]);
+    root_parameters[ConvergenceRootSignatureParams::InputVariance].InitAsDescriptorTable(1, &ranges[1]);
+    root_parameters[ConvergenceRootSignatureParams::OutputTiles].InitAsDescriptorTable(1, &ranges[2]);
+    root_parameters[ConvergenceRootSignatureParams::OutputStats].InitAsDescriptorTable(1, &ranges[3]);
+    root_parameters[ConvergenceRootSignatureParams::Constants].InitAsConstantBufferView(0);
 
-    {
-      device.device->CreateCommittedResource(
-        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-        D3D12_HEAP_FLAG_NONE,
-        &CD3DX12_RESOURCE_DESC::Buffer(1280 * 720 * 16, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS),
-        D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-        nullptr,
-        IID_PPV_ARGS(&averager_buffer)
-      );
+    CD3DX12_ROOT_SIGNATURE_DESC root_signature_desc(ARRAYSIZE(root_parameters), root_parameters);
+    convergence_root_signature = RootSignatureFactory::BuildRootSignature(device.device, &root_signature_desc);
+  }
 
-      D3D12_UNORDERED_ACCESS_VIEW_DESC uav_desc;
-      uav_desc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
-      uav_desc.Buffer.CounterOffsetInBytes = 0;
-      uav_desc.Buffer.FirstElement = 0;
-      uav_desc.Buffer.Flags = D3D12_BUFFER_UAV_FLAG_NONE;
-      uav_desc.Buffer.NumElements = 1280 * 720;
-      uav_desc.Buffer.StructureByteStride = 16;
-      uav_desc.Format = DXGI_FORMAT_UNKNOWN;
+  // Convergence pso
+  {
+    D3D12_COMPUTE_PIPELINE_STATE_DESC convergence_pso_desc = {};
 
-      device.uav_heap->CreateDescriptor(device.device, averager_buffer, nullptr, &uav_desc, &averager_buffer_descriptor);
-    }
+    convergence_pso_desc.CS = CD3DX12_SHADER_BYTECODE(cso_convergence, ARRAYSIZE(cso_convergence));
+    convergence_pso_desc.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
+    convergence_pso_desc.NodeMask = 0;
+    convergence_pso_desc.pRootSignature = convergence_root_signature;
 
-    {
-      device.device->CreateCommittedResource(
-        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-        D3D12_HEAP_FLAG_NONE,
-        &CD3DX12_RESOURCE_DESC::Buffer(1280 * 720 * 16, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS),
-        D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-        nullptr,
-        IID_PPV_ARGS(&averager_normals)
-      );
+    device.device->CreateComputePipelineState(&convergence_pso_desc, IID_PPV_ARGS(&convergence_pso));
+  }
 
-      D3D12_UNORDERED_ACCESS_VIEW_DESC uav_desc;
-      uav_desc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
-      uav_desc.Buffer.CounterOffsetInBytes = 0;
-      uav_desc.Buffer.FirstElement = 0;
-      uav_desc.Buffer.Flags = D3D12_BUFFER_UAV_FLAG_NONE;
-      uav_desc.Buffer.NumElements = 1280 * 720;
-      uav_desc.Buffer.StructureByteStride = 16;
-      uav_desc.Format = DXGI_FORMAT_UNKNOWN;
+  // Convergence statistics
+  {
+    UINT zero_stats[CONVERGENCE_STATS_COUNT] = {};
 
-      device.uav_heap->CreateDescriptor(device.device, averager_normals, nullptr, &uav_desc, &averager_normals_descriptor);
-    }
+    convergence_stats = new Buffer();
+    convergence_stats->Create(&device, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, sizeof(zero_stats), zero_stats);
 
-    {
-      device.device->CreateCommittedResource(
-        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-        D3D12_HEAP_FLAG_NONE,
-        &CD3DX12_RESOURCE_DESC::Buffer(1280 * 720 * 16, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS),
-        D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-        nullptr,
-        IID_PPV_ARGS(&averager_albedo)
-      );
+    convergence_stats_zero = new Buffer();
+    convergence_stats_zero->Create(&device, D3D12_RESOURCE_STATE_COPY_SOURCE, sizeof(zero_stats), zero_stats);
+
+    D3D12_UNORDERED_ACCESS_VIEW_DESC uav_desc;
+    uav_desc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
+    uav_desc.Buffer.CounterOffsetInBytes = 0;
+    uav_desc.Buffer.FirstElement = 0;
+    uav_desc.Buffer.Flags = D3D12_BUFFER_UAV_FLAG_NONE;
+    uav_desc.Buffer.NumElements = CONVERGENCE_STATS_COUNT;
+    uav_desc.Buffer.StructureByteStride = sizeof(UINT);
+    uav_desc.Format = DXGI_FORMAT_UNKNOWN;
 
-      D3D12_UNORDERED_ACCESS_VIEW_DESC uav_desc;
-      uav_desc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
-      uav_desc.Buffer.CounterOffsetInBytes = 0;
-      uav_desc.Buffer.FirstElement = 0;
-      uav_desc.Buffer.Flags = D3D12_BUFFER_UAV_FLAG_NONE;
-      uav_desc.Buffer.NumElements = 1280 * 720;
-      uav_desc.Buffer.StructureByteStride = 16;
-      uav_desc.Format = DXGI_FORMAT_UNKNOWN;
+    device.uav_heap->CreateDescriptor(device.device, convergence_stats->GetBuffer(), nullptr, &uav_desc, &convergence_stats_descriptor);
 
-      device.uav_heap->CreateDescriptor(device.device, averager_albedo, nullptr, &uav_desc, &averager_albedo_descriptor);
-    }
+    convergence_stats_readback = new ReadbackBuffer();
+    convergence_stats_readback->Create(device.device, sizeof(zero_stats));
+
+    convergence_constants_buffer = new UploadBuffer();
+    convergence_constants_buffer->Create(device.device, sizeof(AlignedConvergenceConstantBuffer) * Device::NUM_BACK_BUFFERS, nullptr);
   }
 
-  // Averager constants
+  // Guiding root signature
   {
-    averager_constants_buffer = new UploadBuffer();
-    averager_constants_buffer->Create(device.device, sizeof(AlignedAveragerConstantBuffer) * Device::NUM_BACK_BUFFERS, nullptr);
+    CD3DX12_DESCRIPTOR_RANGE ranges[2];
+    ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 0);
+    ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 1);
+
+    CD3DX12_ROOT_PARAMETER root_parameters[GuidingRootSignatureParams::Count];
+    root_parameters[GuidingRootSignatureParams::InputTraining].InitAsDescriptorTable(1, &ranges[0]);
+    root_parameters[GuidingRootSignatureParams::OutputDistribution].InitAsDescriptorTable(1, &ranges[1]);
+    root_parameters[GuidingRootSignatureParams::Constants].InitAsConstantBufferView(0);
+
+    CD3DX12_ROOT_SIGNATURE_DESC root_signature_desc(ARRAYSIZE(root_parameters), root_parameters);
+    guiding_root_signature = RootSignatureFactory::BuildRootSignature(device.device, &root_signature_desc);
+  }
+
+  // Guiding pso
+  {
+    D3D12_COMPUTE_PIPELINE_STATE_DESC guiding_pso_desc = {};
+
+    guiding_pso_desc.CS = CD3DX12_SHADER_BYTECODE(cso_guiding, ARRAYSIZE(cso_guiding));
+    guiding_pso_desc.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
+    guiding_pso_desc.NodeMask = 0;
+    guiding_pso_desc.pRootSignature = guiding_root_signature;
+
+    device.device->CreateComputePipelineState(&guiding_pso_desc, IID_PPV_ARGS(&guiding_pso));
+  }
+
+  // Guiding grid: training histograms & sampling distributions
+  {
+    PathGuidingUtility::CalculateSceneBounds(app.model, &guiding_bounds_min, &guiding_bounds_max);
+
+    // Everything starts out untrained, which makes the path tracer fall back to BSDF sampling
+    std::vector<UINT> zero_training(GUIDING_NUM_CELLS * GUIDING_DIRECTIONAL_BINS, 0);
+    std::vector<float> zero_distribution(GUIDING_NUM_CELLS * GUIDING_DIRECTIONAL_BINS, 0.0f);
+
+    guiding_training = new Buffer();
+    guiding_training->Create(&device, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, static_cast<UINT>(zero_training.size() * sizeof(UINT)), zero_training.data());
+
+    guiding_distribution = new Buffer();
+    guiding_distribution->Create(&device, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, static_cast<UINT>(zero_distribution.size() * sizeof(float)), zero_distribution.data());
+
+    D3D12_UNORDERED_ACCESS_VIEW_DESC uav_desc;
+    uav_desc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
+    uav_desc.Buffer.CounterOffsetInBytes = 0;
+    uav_desc.Buffer.FirstElement = 0;
+    uav_desc.Buffer.Flags = D3D12_BUFFER_UAV_FLAG_NONE;
+    uav_desc.Buffer.NumElements = GUIDING_NUM_CELLS * GUIDING_DIRECTIONAL_BINS;
+    uav_desc.Buffer.StructureByteStride = sizeof(UINT);
+    uav_desc.Format = DXGI_FORMAT_UNKNOWN;
+
+    device.uav_heap->CreateDescriptor(device.device, guiding_training->GetBuffer(), nullptr, &uav_desc, &guiding_training_descriptor);
+
+    uav_desc.Buffer.StructureByteStride = sizeof(float);
+
+    device.uav_heap->CreateDescriptor(device.device, guiding_distribution->GetBuffer(), nullptr, &uav_desc, &guiding_distribution_descriptor);
+
+    guiding_constants_buffer = new UploadBuffer();
+    guiding_constants_buffer->Create(device.device, sizeof(AlignedGuidingConstantBuffer) * Device::NUM_BACK_BUFFERS, nullptr);
   }
 
   // Picking pso
@@ -592,6 +864,7 @@ int main(int argc, char** argv)
     auto primary_hit_group_subobject = pso_desc.CreateSubobject<CD3D12_HIT_GROUP_SUBOBJECT>();
     primary_hit_group_subobject->SetHitGroupType(D3D12_HIT_GROUP_TYPE_TRIANGLES);
     primary_hit_group_subobject->SetClosestHitShaderImport(L"PickingHit");
+    primary_hit_group_subobject->SetAnyHitShaderImport(L"PickingAnyHit");
     primary_hit_group_subobject->SetHitGroupExport(L"PickingHitGroup");
 
     auto global_root_signature_subobject = pso_desc.CreateSubobject<CD3D12_GLOBAL_ROOT_SIGNATURE_SUBOBJECT>();
@@ -640,50 +913,189 @@ int main(int argc, char** argv)
     picking_buffer_readback->Create(device.device, 4);
   }
 
-  // OptiX
+  image_writer.Create();
+
+  // Denoisers
+  {
+    for (int i = 0; i < Denoising::NumMethods; i++)
+    {
+      app.denoising.names[i] = denoisers[i]->GetName();
+      app.denoising.available[i] = denoisers[i]->Create(render_targets.width, render_targets.height);
+    }
+
+    // The first available backend is picked, the a-trous filter runs everywhere
+    for (int i = Denoising::NumMethods - 1; i >= 0; i--)
+    {
+      app.denoising.method = app.denoising.available[i] ? static_cast<Denoising::Method>(i) : app.denoising.method;
+    }
+  }
+
+  // Binds the scene, the render targets and the acceleration structure to the global root signature of the ray tracing pipelines
+  auto bind_global_root_signature = [&]()
   {
-    try
+    device.command_list->SetComputeRootSignature(global_root_signature);
+    device.command_list->SetComputeRootConstantBufferView(GlobalRootSignatureParams::SceneConstants, scene_constants_buffer->GetBuffer()->GetGPUVirtualAddress() + device.back_buffer_index * sizeof(AlignedSceneConstantBuffer));
+    device.command_list->SetComputeRootDescriptorTable(GlobalRootSignatureParams::OutputTexture, render_targets.render_descriptor);
+    device.command_list->SetComputeRootDescriptorTable(GlobalRootSignatureParams::OutputNormals, render_targets.normals_descriptor);
+    device.command_list->SetComputeRootDescriptorTable(GlobalRootSignatureParams::OutputAlbedo, render_targets.albedo_descriptor);
+    device.command_list->SetComputeRootDescriptorTable(GlobalRootSignatureParams::OutputVariance, render_targets.variance_descriptor);
+    device.command_list->SetComputeRootDescriptorTable(GlobalRootSignatureParams::ConvergenceTiles, render_targets.convergence_tiles_descriptor);
+    device.command_list->SetComputeRootDescriptorTable(GlobalRootSignatureParams::PickingBuffer, picking_buffer_descriptor);
+    device.command_list->SetComputeRootShaderResourceView(GlobalRootSignatureParams::Materials, materials_buffer->GetBuffer()->GetGPUVirtualAddress());
+    device.command_list->SetComputeRootShaderResourceView(GlobalRootSignatureParams::Meshes, meshes_buffer->GetBuffer()->GetGPUVirtualAddress());
+    device.command_list->SetComputeRootShaderResourceView(GlobalRootSignatureParams::Vertices, all_vertices_buffer->GetBuffer()->GetGPUVirtualAddress());
+    device.command_list->SetComputeRootShaderResourceView(GlobalRootSignatureParams::Indices, all_indices_buffer->GetBuffer()->GetGPUVirtualAddress());
+    device.command_list->SetComputeRootShaderResourceView(GlobalRootSignatureParams::Lights, lights_buffer->GetBuffer()->GetGPUVirtualAddress());
+    device.command_list->SetComputeRootShaderResourceView(GlobalRootSignatureParams::EmissiveTriangles, emissive_triangles_buffer->GetBuffer()->GetGPUVirtualAddress());
+    device.command_list->SetComputeRootShaderResourceView(GlobalRootSignatureParams::OpacityMasks, opacity_masks_buffer->GetBuffer()->GetGPUVirtualAddress());
+    device.command_list->SetComputeRootShaderResourceView(GlobalRootSignatureParams::OpacityMaskBits, opacity_mask_bits_buffer->GetBuffer()->GetGPUVirtualAddress());
+    device.command_list->SetComputeRootDescriptorTable(GlobalRootSignatureParams::Reservoirs, render_targets.reservoirs_descriptor);
+    device.command_list->SetComputeRootDescriptorTable(GlobalRootSignatureParams::ReservoirHistory, render_targets.reservoir_history_descriptor);
+    device.command_list->SetComputeRootDescriptorTable(GlobalRootSignatureParams::ReservoirSurfaces, render_targets.reservoir_surfaces_descriptor);
+    device.command_list->SetComputeRootDescriptorTable(GlobalRootSignatureParams::GuidingTraining, guiding_training_descriptor);
+    device.command_list->SetComputeRootDescriptorTable(GlobalRootSignatureParams::GuidingDistribution, guiding_distribution_descriptor);
+    device.command_list->SetComputeRootDescriptorTable(GlobalRootSignatureParams::TextureFeedback, texture_feedback_descriptor);
+    if (texture_descriptors.size() > 0)
     {
-      optix = optix::Context::create();
-      optix_input = optix->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_FLOAT4, 1280, 720);
-      optix_normals = optix->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_FLOAT4, 1280, 720);
-      optix_albedo = optix->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_FLOAT4, 1280, 720);
-      optix_output = optix->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_FLOAT4, 1280, 720);
+      device.command_list->SetComputeRootDescriptorTable(GlobalRootSignatureParams::Textures, texture_descriptors[0]);
+    }
+    if (blue_noise_descriptors.size() > 0)
+    {
+      device.command_list->SetComputeRootDescriptorTable(GlobalRootSignatureParams::BlueNoise, blue_noise_descriptors[0]);
+    }
+    device.fallback_command_list->SetTopLevelAccelerationStructure(GlobalRootSignatureParams::AccelerationStructure, top_level_acceleration_structure.structure_pointers[0]);
+  };
 
-      optix_denoiser_stage = optix->createBuiltinPostProcessingStage("DLDenoiser");
-      optix_denoiser_stage->declareVariable("input_buffer")->set(optix_input);
-      optix_denoiser_stage->declareVariable("input_normal_buffer")->set(optix_normals);
-      optix_denoiser_stage->declareVariable("input_albedo_buffer")->set(optix_albedo);
-      optix_denoiser_stage->declareVariable("output_buffer")->set(optix_output);
+  // Records the averager for the current back buffer, either resolving the accumulated samples or only the denoiser guides
+  auto record_averager = [&](bool resolve_guides)
+  {
+    // The writes land in the upload heap right away, so both passes of a frame need constants of their own
+    UINT slot = device.back_buffer_index * 2 + (resolve_guides ? 1 : 0);
+
+    averager_constants[slot].clear_samples = app.clear_samples ? 0 : 1;
+    averager_constants[slot].gamma = app.pp.gamma;
+    averager_constants[slot].debug_view = app.adaptive.show_heat_map ? DEBUG_VIEW_CONVERGENCE : DEBUG_VIEW_NONE;
+    averager_constants[slot].convergence_tiles_x = render_targets.convergence_tiles_x;
+    averager_constants[slot].error_threshold = app.adaptive.error_threshold;
+    averager_constants[slot].width = render_targets.width;
+    averager_constants[slot].height = render_targets.height;
+    averager_constants[slot].resolve_guides = resolve_guides ? 1 : 0;
+    averager_constants[slot].exposure = app.pp.exposure;
+    averager_constants[slot].tonemapper = static_cast<UINT>(app.pp.tonemapper);
+    averager_constants_buffer->Write(sizeof(AveragerConstantBuffer), &(averager_constants[slot]), sizeof(AlignedAveragerConstantBuffer) * slot);
+
+    device.command_list->SetPipelineState(averager_pso);
+    device.command_list->SetComputeRootSignature(averager_root_signature);
+    device.command_list->SetComputeRootDescriptorTable(AveragerRootSignatureParams::InputTexture, render_targets.render_descriptor);
+    device.command_list->SetComputeRootDescriptorTable(AveragerRootSignatureParams::InputNormals, render_targets.normals_descriptor);
+    device.command_list->SetComputeRootDescriptorTable(AveragerRootSignatureParams::InputAlbedo, render_targets.albedo_descriptor);
+    device.command_list->SetComputeRootDescriptorTable(AveragerRootSignatureParams::OutputTexture, render_targets.averager_texture_descriptor);
+    device.command_list->SetComputeRootDescriptorTable(AveragerRootSignatureParams::OutputBuffer, render_targets.averager_buffer_descriptor);
+    device.command_list->SetComputeRootDescriptorTable(AveragerRootSignatureParams::OutputNormals, render_targets.averager_normals_descriptor);
+    device.command_list->SetComputeRootDescriptorTable(AveragerRootSignatureParams::OutputAlbedo, render_targets.averager_albedo_descriptor);
+    device.command_list->SetComputeRootDescriptorTable(AveragerRootSignatureParams::InputVariance, render_targets.variance_descriptor);
+    device.command_list->SetComputeRootDescriptorTable(AveragerRootSignatureParams::ConvergenceTiles, render_targets.convergence_tiles_descriptor);
+    device.command_list->SetComputeRootConstantBufferView(AveragerRootSignatureParams::Constants, averager_constants_buffer->GetBuffer()->GetGPUVirtualAddress() + slot * sizeof(AlignedAveragerConstantBuffer));
+    device.command_list->Dispatch((render_targets.width + AVERAGER_GROUP_SIZE - 1) / AVERAGER_GROUP_SIZE, (render_targets.height + AVERAGER_GROUP_SIZE - 1) / AVERAGER_GROUP_SIZE, 1);
+  };
 
-      optix_list = optix->createCommandList();
-      optix_list->appendPostprocessingStage(optix_denoiser_stage, 1280, 720);
-      optix_list->finalize();
+  // Queues the outputs that are enabled in the UI, the encoding and the disk writes happen on the writer's threads
+  auto save_outputs = [&](const DenoiserInputs& inputs, const XMFLOAT4* denoised, const ToneMapping& tone_mapping, UINT64 sample)
+  {
+    ImageWriter::Format format = static_cast<ImageWriter::Format>(app.output.format);
 
-      optix->validate();
-      optix->compile();
+    auto write = [&](const char* name, ImageWriter::Content content, const XMFLOAT4* pixels)
+    {
+      std::stringstream path;
+      path << app.output.prefix << "_" << name << "_" << sample << ImageWriter::GetExtension(format);
+      image_writer.Write(path.str(), format, content, tone_mapping, pixels, inputs.width, inputs.height);
+    };
 
-      // Immediately execute denoising with empty inputs...
-      // the first execute of optix takes ages (not sure why)
-      // so it's better to execute during init time
-      optix_list->execute();
+    if (app.output.beauty)
+    {
+      write("beauty", ImageWriter::Radiance, inputs.color);
     }
-    catch (optix::Exception e)
+
+    if (app.output.normals)
     {
-      std::cout << e.getErrorString() << std::endl;
+      write("normals", ImageWriter::Normals, inputs.normals);
     }
 
-    averager_buffer_readback = new ReadbackBuffer();
-    averager_buffer_readback->Create(device.device, 1280 * 720 * 16);
-    averager_normals_readback = new ReadbackBuffer();
-    averager_normals_readback->Create(device.device, 1280 * 720 * 16);
-    averager_albedo_readback = new ReadbackBuffer();
-    averager_albedo_readback->Create(device.device, 1280 * 720 * 16);
-  }
+    if (app.output.albedo)
+    {
+      write("albedo", ImageWriter::Albedo, inputs.albedo);
+    }
+
+    if (app.output.variance)
+    {
+      write("variance", ImageWriter::Moments, inputs.moments);
+    }
+
+    if (app.output.denoised && denoised != nullptr)
+    {
+      write("denoised", ImageWriter::Radiance, denoised);
+    }
+  };
+
+  // Denoising runs a few frames behind the request, these track what is in flight
+  UINT denoise_requested_frame = 0;
+  UINT64 denoised_upload_fence = 0;
+  UINT samples_traced = 0; // Samples per pixel the last path tracing dispatch traced, for the frame budget
+  UINT64 previous_tile_samples = 0; // Sum of the sample counts of all tiles after the previous convergence pass
 
   while (!glfwWindowShouldClose(window))
   {
     glfwPollEvents();
+
+    // A checkpoint brings its own resolution and camera, both are in place before anything of this frame is recorded
+    Checkpoint checkpoint;
+    if (app.checkpointing.load)
+    {
+      if (checkpoint.Open(app.checkpointing.path))
+      {
+        if (app.RestoreCheckpointState(checkpoint.GetState()) == false)
+        {
+          std::stringstream message;
+          message << "Checkpoint " << app.checkpointing.path << " was saved from another model or with other materials\n";
+          LOG(message.str().c_str());
+
+          checkpoint.Close();
+        }
+      }
+      else
+      {
+        std::stringstream message;
+        message << "Could not open checkpoint " << app.checkpointing.path << "\n";
+        LOG(message.str().c_str());
+      }
+
+      app.checkpointing.load = false;
+    }
+
+    // The application picked a new resolution last frame, everything sized by it is recreated before anything is recorded
+    if (app.resolution.width != render_targets.width || app.resolution.height != render_targets.height)
+    {
+      device.Resize(app.resolution.width, app.resolution.height);
+      render_targets.Resize(app.resolution.width, app.resolution.height);
+
+      for (int i = 0; i < Denoising::NumMethods; i++)
+      {
+        if (app.denoising.available[i])
+        {
+          denoisers[i]->Resize(render_targets.width, render_targets.height);
+        }
+      }
+    }
+
+    if (checkpoint.IsOpen())
+    {
+      std::stringstream message;
+      message << (checkpoint.Upload(&device, &render_targets) ? "Resumed " : "Could not resume ") << app.checkpointing.path << " at sample " << checkpoint.GetState().sample_count << "\n";
+      LOG(message.str().c_str());
+
+      checkpoint.Close();
+    }
+
     device.PrepareCommandLists();
     imgui_layer.NewFrame();
 
@@ -700,29 +1112,45 @@ int main(int argc, char** argv)
       constant_buffer_data[device.back_buffer_index].aa_algorithm = static_cast<UINT>(app.aa.algorithm);
       constant_buffer_data[device.back_buffer_index].aa_sampling_point = app.aa.sample_point;
       constant_buffer_data[device.back_buffer_index].sky_color = app.sky_color;
-      constant_buffer_data[device.back_buffer_index].picking_point = DirectX::XMINT2(static_cast<int>(std::min(std::max(app.current_cursor_position.x, 0.0f), 1280.0f)), static_cast<int>(std::min(std::max(app.current_cursor_position.y, 0.0f), 720.0f)));
+      // The cursor is in window coordinates, the back buffers are stretched to the window
+      int window_width, window_height;
+      glfwGetWindowSize(window, &window_width, &window_height);
+
+      float picking_x = app.current_cursor_position.x * render_targets.width / std::max(window_width, 1);
+      float picking_y = app.current_cursor_position.y * render_targets.height / std::max(window_height, 1);
+
+      constant_buffer_data[device.back_buffer_index].picking_point = DirectX::XMINT2(
+        static_cast<int>(std::min(std::max(picking_x, 0.0f), static_cast<float>(render_targets.width - 1))),
+        static_cast<int>(std::min(std::max(picking_y, 0.0f), static_cast<float>(render_targets.height - 1)))
+      );
+      constant_buffer_data[device.back_buffer_index].adaptive_enabled = app.adaptive.enabled ? 1 : 0;
+      constant_buffer_data[device.back_buffer_index].convergence_tiles_x = render_targets.convergence_tiles_x;
+      constant_buffer_data[device.back_buffer_index].sampler_type = app.sampling.sampler_type;
+      constant_buffer_data[device.back_buffer_index].restir_enabled = app.restir.enabled ? 1 : 0;
+      constant_buffer_data[device.back_buffer_index].num_emissive_triangles = static_cast<UINT>(emissive_triangles.size());
+      constant_buffer_data[device.back_buffer_index].restir_candidates = static_cast<UINT>(app.restir.candidates);
+      constant_buffer_data[device.back_buffer_index].restir_spatial_samples = app.restir.spatial_reuse ? static_cast<UINT>(app.restir.spatial_samples) : 0;
+      constant_buffer_data[device.back_buffer_index].restir_spatial_radius = app.restir.spatial_radius;
+      constant_buffer_data[device.back_buffer_index].restir_temporal_enabled = app.restir.temporal_reuse ? 1 : 0;
+      constant_buffer_data[device.back_buffer_index].restir_history_limit = static_cast<UINT>(app.restir.history_limit);
+      constant_buffer_data[device.back_buffer_index].guiding_bounds_min = guiding_bounds_min;
+      constant_buffer_data[device.back_buffer_index].guiding_bounds_max = guiding_bounds_max;
+      constant_buffer_data[device.back_buffer_index].guiding_enabled = app.guiding.enabled ? 1 : 0;
+      constant_buffer_data[device.back_buffer_index].guiding_training = app.guiding.enabled && static_cast<int>(app.sample_count) < app.guiding.training_samples ? 1 : 0;
+      constant_buffer_data[device.back_buffer_index].guiding_probability = app.guiding.probability;
+      constant_buffer_data[device.back_buffer_index].cone_spread_angle = std::atan(2.0f * std::tan(app.camera->GetFovRadians() * 0.5f) / static_cast<float>(render_targets.height));
+      constant_buffer_data[device.back_buffer_index].texture_lod_enabled = app.texture_lod.enabled ? 1 : 0;
+      constant_buffer_data[device.back_buffer_index].texture_lod_bias = app.texture_lod.bias;
+      constant_buffer_data[device.back_buffer_index].render_width = render_targets.width;
+      constant_buffer_data[device.back_buffer_index].render_height = render_targets.height;
+      constant_buffer_data[device.back_buffer_index].firefly_clamp = app.pp.firefly_clamp;
 
       scene_constants_buffer->Write(sizeof(SceneConstantBuffer), &(constant_buffer_data[device.back_buffer_index]), sizeof(AlignedSceneConstantBuffer) * device.back_buffer_index);
     }
 
     // Picking rays
     {
-      device.command_list->SetComputeRootSignature(global_root_signature);
-      device.command_list->SetComputeRootConstantBufferView(GlobalRootSignatureParams::SceneConstants, scene_constants_buffer->GetBuffer()->GetGPUVirtualAddress() + device.back_buffer_index * sizeof(AlignedSceneConstantBuffer));
-      device.command_list->SetComputeRootDescriptorTable(GlobalRootSignatureParams::OutputTexture, target_render_descriptor);
-      device.command_list->SetComputeRootDescriptorTable(GlobalRootSignatureParams::OutputNormals, target_normals_descriptor);
-      device.command_list->SetComputeRootDescriptorTable(GlobalRootSignatureParams::OutputAlbedo, target_albedo_descriptor);
-      device.command_list->SetComputeRootDescriptorTable(GlobalRootSignatureParams::PickingBuffer, picking_buffer_descriptor);
-      device.command_list->SetComputeRootShaderResourceView(GlobalRootSignatureParams::Materials, materials_buffer->GetBuffer()->GetGPUVirtualAddress());
-      device.command_list->SetComputeRootShaderResourceView(GlobalRootSignatureParams::Meshes, meshes_buffer->GetBuffer()->GetGPUVirtualAddress());
-      device.command_list->SetComputeRootShaderResourceView(GlobalRootSignatureParams::Vertices, all_vertices_buffer->GetBuffer()->GetGPUVirtualAddress());
-      device.command_list->SetComputeRootShaderResourceView(GlobalRootSignatureParams::Indices, all_indices_buffer->GetBuffer()->GetGPUVirtualAddress());
-      device.command_list->SetComputeRootShaderResourceView(GlobalRootSignatureParams::Lights, lights_buffer->GetBuffer()->GetGPUVirtualAddress());
-      if (texture_descriptors.size() > 0)
-      {
-        device.command_list->SetComputeRootDescriptorTable(GlobalRootSignatureParams::Textures, texture_descriptors[0]);
-      }
-      device.fallback_command_list->SetTopLevelAccelerationStructure(GlobalRootSignatureParams::AccelerationStructure, top_level_acceleration_structure.structure_pointers[0]);
+      bind_global_root_signature();
       device.fallback_command_list->SetPipelineState1(picking_pso);
 
       D3D12_DISPATCH_RAYS_DESC raytracing_dispatch = {};
@@ -768,6 +1196,58 @@ int main(int argc, char** argv)
     app.Update(window, *static_cast<int*>(picking_buffer_readback->GetData()));
     picking_buffer_readback->Unmap();
 
+    // Texture streaming, driven by the feedback of the previous frame. The GPU is idle here, so textures can be swapped.
+    {
+      TextureFeedback* feedback = texture_feedback_recorded ? static_cast<TextureFeedback*>(texture_feedback_readback->Map()) : nullptr;
+
+      texture_streamer.SetMemoryBudget(static_cast<UINT64>(app.texture_streaming.budget_mb) * 1024 * 1024);
+      if (texture_streamer.Update(feedback, app.frame_count))
+      {
+        app.clear_samples = true;
+      }
+
+      if (feedback != nullptr)
+      {
+        texture_feedback_readback->Unmap();
+      }
+
+      texture_feedback_recorded = false;
+      app.UpdateTextureStreamingStatistics(texture_streamer.GetResidentSize(), texture_streamer.GetNumLoading());
+    }
+
+    // Convergence statistics of the previous frame
+    float adaptive_samples_traced = 0.0f;
+    {
+      UINT* stats = static_cast<UINT*>(convergence_stats_readback->Map());
+      UINT num_tiles = render_targets.convergence_tiles_x * render_targets.convergence_tiles_y;
+      UINT64 tile_samples = (static_cast<UINT64>(stats[CONVERGENCE_STATS_TILE_SAMPLES_HIGH]) << 32) | stats[CONVERGENCE_STATS_TILE_SAMPLES_LOW];
+
+      app.UpdateConvergenceStatistics(stats[CONVERGENCE_STATS_CONVERGED_TILES], tile_samples, stats[CONVERGENCE_STATS_MAX_PIXEL_SAMPLES], num_tiles);
+      convergence_stats_readback->Unmap();
+
+      // Adaptive tiles trace anywhere between none and the maximum, what they traced on average is what the frame cost.
+      // The sums drop when the samples were cleared, everything since then was traced by the last frame.
+      UINT64 traced = tile_samples >= previous_tile_samples ? tile_samples - previous_tile_samples : tile_samples;
+      adaptive_samples_traced = static_cast<float>(traced) / static_cast<float>(std::max(num_tiles, 1u));
+      previous_tile_samples = tile_samples;
+    }
+
+    // GPU timings of the previous frame
+    {
+      app.UpdateGpuTimings(
+        gpu_timer.GetMilliseconds(GpuTimers::Pathtrace),
+        gpu_timer.GetMilliseconds(GpuTimers::OcclusionBenchmark),
+        gpu_timer.GetMilliseconds(GpuTimers::ClosestHitBenchmark),
+        gpu_timer.GetMilliseconds(GpuTimers::Averager),
+        render_targets.GetNumPixels()
+      );
+
+      float samples_per_pixel = app.adaptive.enabled && samples_traced > 0 ? adaptive_samples_traced : static_cast<float>(samples_traced);
+
+      app.UpdateFrameBudget(gpu_timer.GetMilliseconds(GpuTimers::Pathtrace), samples_per_pixel);
+      samples_traced = 0;
+    }
+
     if (app.materials_dirty)
     {
       materials.resize(app.model.materials.size());
@@ -791,46 +1271,186 @@ int main(int argc, char** argv)
         materials[i].index_of_refraction = app.model.materials[i].index_of_refraction;
         materials[i].shading_model = app.model.materials[i].shading_model;
         materials[i].glossiness = app.model.materials[i].glossiness;
+        materials[i].opacity_map = app.model.materials[i].opacity_map;
+        materials[i].opacity_mask = app.model.materials[i].opacity_mask;
       }
 
-
       DELETE(materials_buffer);
       materials_buffer = new Buffer();
       materials_buffer->Create(&device, D3D12_RESOURCE_STATE_GENERIC_READ, static_cast<UINT>(app.model.materials.size() * sizeof(Material)), materials.data());
+
+      // Edited emissive colors change the light list
+      LightListUtility::BuildEmissiveTriangles(app.model, &emissive_triangles);
+
+      std::vector<EmissiveTriangle> buffer_data = emissive_triangles;
+      buffer_data.resize(std::max(buffer_data.size(), size_t(1)), EmissiveTriangle{});
+
+      DELETE(emissive_triangles_buffer);
+      emissive_triangles_buffer = new Buffer();
+      emissive_triangles_buffer->Create(&device, D3D12_RESOURCE_STATE_GENERIC_READ, static_cast<UINT>(sizeof(EmissiveTriangle) * buffer_data.size()), buffer_data.data());
+
+      // The learned radiance distribution no longer matches the scene
+      app.guiding.reset = true;
+    }
+
+    // The GPU is idle and the accumulation holds sample_count samples, unless this frame throws them away
+    if (app.checkpointing.save && !app.clear_samples && app.sample_count > 0)
+    {
+      Checkpoint::State state;
+      app.GetCheckpointState(&state);
+
+      std::stringstream message;
+      message << (Checkpoint::Save(&device, &render_targets, state, app.checkpointing.path) ? "Saved " : "Could not save ") << app.checkpointing.path << " at sample " << app.sample_count << "\n";
+      LOG(message.str().c_str());
+
+      app.checkpointing.save = false;
     }
 
     device.PrepareCommandLists();
 
-    if (app.denoise_at_sample > 0 && static_cast<int>(app.sample_count) < app.denoise_at_sample)
+    bool accumulating = app.denoise_at_sample > 0 && static_cast<int>(app.sample_count) < app.denoise_at_sample;
+
+    ToneMapping tone_mapping;
+    tone_mapping.tonemapper = static_cast<UINT>(app.pp.tonemapper);
+    tone_mapping.exposure = app.pp.exposure;
+    tone_mapping.gamma = app.pp.gamma;
+
+    // Denoise the newest inputs the GPU finished copying back, inputs of samples that were cleared since are stale
     {
-      if (!app.freeze_rendering)
+      const ReadbackRing::Slot* readback = render_targets.readbacks->Poll(device.fence);
+
+      if (readback != nullptr && !app.denoised && readback->tag == app.sample_count && !accumulating)
       {
-        // Resource binding for pathtracing
+        const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& footprint = render_targets.denoised_footprint;
+        UINT row_size = render_targets.width * 4;
+
+        // The upload buffer is only rewritten once the copy out of it that the previous denoise recorded is done
+        if (device.fence->GetCompletedValue() < denoised_upload_fence)
+        {
+          device.WaitForGPU();
+        }
+
+        // When the rows are tightly packed in the upload buffer the denoiser writes into it directly
+        unsigned char* upload = static_cast<unsigned char*>(render_targets.denoised_upload->GetData()) + footprint.Offset;
+        bool packed = footprint.Footprint.RowPitch == row_size;
+
+        DenoiserOutput output;
+        output.linear = render_targets.denoised_linear.data();
+        output.pixels = packed ? upload : render_targets.denoised_pixels.data();
+        output.tone_mapping = tone_mapping;
+
+        atrous_denoiser.num_iterations = app.denoising.atrous_iterations;
+        atrous_denoiser.sigma_luminance = app.denoising.atrous_sigma_luminance;
+        atrous_denoiser.normal_sharpness = app.denoising.atrous_normal_sharpness;
+
+        Denoiser* denoiser = denoisers[app.denoising.method];
+        denoiser->Denoise(readback->inputs, output);
+        app.denoising.timings = denoiser->GetTimings();
+        app.denoising.readback_frames = app.frame_count - denoise_requested_frame;
+
+        if (app.denoising.method == Denoising::ATrous)
         {
-          device.command_list->SetComputeRootSignature(global_root_signature);
-          device.command_list->SetComputeRootConstantBufferView(GlobalRootSignatureParams::SceneConstants, scene_constants_buffer->GetBuffer()->GetGPUVirtualAddress() + device.back_buffer_index * sizeof(AlignedSceneConstantBuffer));
-          device.command_list->SetComputeRootDescriptorTable(GlobalRootSignatureParams::OutputTexture, target_render_descriptor);
-          device.command_list->SetComputeRootDescriptorTable(GlobalRootSignatureParams::OutputNormals, target_normals_descriptor);
-          device.command_list->SetComputeRootDescriptorTable(GlobalRootSignatureParams::OutputAlbedo, target_albedo_descriptor);
-          device.command_list->SetComputeRootDescriptorTable(GlobalRootSignatureParams::PickingBuffer, picking_buffer_descriptor);
-          device.command_list->SetComputeRootShaderResourceView(GlobalRootSignatureParams::Materials, materials_buffer->GetBuffer()->GetGPUVirtualAddress());
-          device.command_list->SetComputeRootShaderResourceView(GlobalRootSignatureParams::Meshes, meshes_buffer->GetBuffer()->GetGPUVirtualAddress());
-          device.command_list->SetComputeRootShaderResourceView(GlobalRootSignatureParams::Vertices, all_vertices_buffer->GetBuffer()->GetGPUVirtualAddress());
-          device.command_list->SetComputeRootShaderResourceView(GlobalRootSignatureParams::Indices, all_indices_buffer->GetBuffer()->GetGPUVirtualAddress());
-          device.command_list->SetComputeRootShaderResourceView(GlobalRootSignatureParams::Lights, lights_buffer->GetBuffer()->GetGPUVirtualAddress());
-          if (texture_descriptors.size() > 0)
+          std::vector<TileScheduler::ThreadStats> stats;
+          double elapsed_ms = atrous_denoiser.GetScheduler().GetStats(&stats);
+
+          app.denoising.num_threads = static_cast<UINT>(stats.size());
+          app.denoising.average_utilization = 0.0f;
+          app.denoising.min_utilization = 1.0f;
+          app.denoising.tiles_stolen = 0;
+
+          for (size_t i = 0; i < stats.size(); i++)
           {
-            device.command_list->SetComputeRootDescriptorTable(GlobalRootSignatureParams::Textures, texture_descriptors[0]);
+            float utilization = elapsed_ms > 0.0 ? static_cast<float>(std::min(stats[i].busy_ms / elapsed_ms, 1.0)) : 0.0f;
+            app.denoising.average_utilization += utilization / static_cast<float>(stats.size());
+            app.denoising.min_utilization = std::min(app.denoising.min_utilization, utilization);
+            app.denoising.tiles_stolen += stats[i].num_stolen;
           }
-          device.fallback_command_list->SetTopLevelAccelerationStructure(GlobalRootSignatureParams::AccelerationStructure, top_level_acceleration_structure.structure_pointers[0]);
+        }
+
+        for (UINT y = 0; packed == false && y < render_targets.height; y++)
+        {
+          memcpy(upload + y * footprint.Footprint.RowPitch, render_targets.denoised_pixels.data() + y * row_size, row_size);
+        }
+
+        // The denoised image replaces the averaged one, which is copied into the backbuffer below
+        device.command_list->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(render_targets.averager_texture, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_DEST));
+
+        CD3DX12_TEXTURE_COPY_LOCATION destination(render_targets.averager_texture, 0);
+        CD3DX12_TEXTURE_COPY_LOCATION source(render_targets.denoised_upload->GetBuffer(), footprint);
+        device.command_list->CopyTextureRegion(&destination, 0, 0, 0, &source, nullptr);
+
+        device.command_list->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(render_targets.averager_texture, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
+
+        denoised_upload_fence = device.fence_values[device.back_buffer_index];
+        app.denoised = true;
+      }
+
+      // Any readback is a good enough snapshot while accumulating, otherwise saving waits for the denoised image
+      if (readback != nullptr && app.output.save && (accumulating || app.denoised))
+      {
+        save_outputs(readback->inputs, accumulating ? nullptr : render_targets.denoised_linear.data(), tone_mapping, readback->tag);
+        app.output.save = false;
+      }
+
+      app.output.num_pending = image_writer.GetNumPending();
+    }
+
+    if (accumulating)
+    {
+      if (!app.freeze_rendering)
+      {
+        // The samples of this frame are picked by app.Update, which runs after the scene constants were written for picking
+        {
+          constant_buffer_data[device.back_buffer_index].samples_per_frame = app.frame_budget.samples_per_frame;
+          scene_constants_buffer->Write(sizeof(SceneConstantBuffer), &(constant_buffer_data[device.back_buffer_index]), sizeof(AlignedSceneConstantBuffer) * device.back_buffer_index);
+
+          samples_traced = app.frame_budget.samples_per_frame;
+        }
+
+        // Resource binding for pathtracing
+        {
+          bind_global_root_signature();
+          device.fallback_command_list->SetPipelineState1(pso);
+        }
+
+        // Reservoir resampling of direct lighting: initial candidates & temporal reuse, then spatial reuse
+        if (app.restir.enabled && emissive_triangles.size() > 0)
+        {
+          device.fallback_command_list->SetPipelineState1(restir_pso);
+
+          D3D12_DISPATCH_RAYS_DESC raytracing_dispatch = {};
+          raytracing_dispatch.Width = render_targets.width;
+          raytracing_dispatch.Height = render_targets.height;
+          raytracing_dispatch.Depth = 1;
+
+          raytracing_dispatch.HitGroupTable.StartAddress = restir_shader_table_hit->GetBuffer()->GetGPUVirtualAddress();
+          raytracing_dispatch.HitGroupTable.SizeInBytes = restir_shader_table_hit->GetSizeInBytes();
+          raytracing_dispatch.HitGroupTable.StrideInBytes = restir_shader_table_hit->GetStrideInBytes();
+
+          raytracing_dispatch.MissShaderTable.StartAddress = restir_shader_table_miss->GetBuffer()->GetGPUVirtualAddress();
+          raytracing_dispatch.MissShaderTable.SizeInBytes = restir_shader_table_miss->GetSizeInBytes();
+          raytracing_dispatch.MissShaderTable.StrideInBytes = restir_shader_table_miss->GetStrideInBytes();
+
+          raytracing_dispatch.RayGenerationShaderRecord.StartAddress = restir_shader_table_initial->GetBuffer()->GetGPUVirtualAddress();
+          raytracing_dispatch.RayGenerationShaderRecord.SizeInBytes = restir_shader_table_initial->GetSizeInBytes();
+
+          device.fallback_command_list->DispatchRays(&raytracing_dispatch);
+          device.command_list->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(nullptr));
+
+          raytracing_dispatch.RayGenerationShaderRecord.StartAddress = restir_shader_table_spatial->GetBuffer()->GetGPUVirtualAddress();
+          raytracing_dispatch.RayGenerationShaderRecord.SizeInBytes = restir_shader_table_spatial->GetSizeInBytes();
+
+          device.fallback_command_list->DispatchRays(&raytracing_dispatch);
+          device.command_list->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(nullptr));
+
           device.fallback_command_list->SetPipelineState1(pso);
         }
 
         // Dispatch rays for pathtracing
         {
           D3D12_DISPATCH_RAYS_DESC raytracing_dispatch = {};
-          raytracing_dispatch.Width = 1280;
-          raytracing_dispatch.Height = 720;
+          raytracing_dispatch.Width = render_targets.width;
+          raytracing_dispatch.Height = render_targets.height;
           raytracing_dispatch.Depth = 1;
 
           raytracing_dispatch.HitGroupTable.StartAddress = shader_table_hit->GetBuffer()->GetGPUVirtualAddress();
@@ -844,137 +1464,196 @@ int main(int argc, char** argv)
           raytracing_dispatch.RayGenerationShaderRecord.StartAddress = shader_table_ray_generation->GetBuffer()->GetGPUVirtualAddress();
           raytracing_dispatch.RayGenerationShaderRecord.SizeInBytes = shader_table_ray_generation->GetSizeInBytes();
 
+          gpu_timer.Start(device.command_list, GpuTimers::Pathtrace);
           device.fallback_command_list->DispatchRays(&raytracing_dispatch);
-        }
+          gpu_timer.Stop(device.command_list, GpuTimers::Pathtrace);
 
-        // Perform an averaging pass in compute (averages out all samples)
-        {
-          averager_constants[device.back_buffer_index].clear_samples = app.clear_samples ? 0 : 1;
-          averager_constants[device.back_buffer_index].gamma = app.pp.gamma;
-          averager_constants_buffer->Write(sizeof(AveragerConstantBuffer), &(averager_constants[device.back_buffer_index]), sizeof(AlignedAveragerConstantBuffer) * device.back_buffer_index);
-
-          device.command_list->SetPipelineState(averager_pso);
-          device.command_list->SetComputeRootSignature(averager_root_signature);
-          device.command_list->SetComputeRootDescriptorTable(AveragerRootSignatureParams::InputTexture, target_render_descriptor);
-          device.command_list->SetComputeRootDescriptorTable(AveragerRootSignatureParams::InputNormals, target_normals_descriptor);
-          device.command_list->SetComputeRootDescriptorTable(AveragerRootSignatureParams::InputAlbedo, target_albedo_descriptor);
-          device.command_list->SetComputeRootDescriptorTable(AveragerRootSignatureParams::OutputTexture, averager_texture_descriptor);
-          device.command_list->SetComputeRootDescriptorTable(AveragerRootSignatureParams::OutputBuffer, averager_buffer_descriptor);
-          device.command_list->SetComputeRootDescriptorTable(AveragerRootSignatureParams::OutputNormals, averager_normals_descriptor);
-          device.command_list->SetComputeRootDescriptorTable(AveragerRootSignatureParams::OutputAlbedo, averager_albedo_descriptor);
-          device.command_list->SetComputeRootConstantBufferView(AveragerRootSignatureParams::Constants, averager_constants_buffer->GetBuffer()->GetGPUVirtualAddress() + device.back_buffer_index * sizeof(AlignedAveragerConstantBuffer));
-          device.command_list->Dispatch(1280, 720, 1);
-        }
-      }
+          // Hand the texture feedback to the streamer and clear it for the next frame
+          {
+            D3D12_RESOURCE_BARRIER pre_copy_barriers[2];
+            pre_copy_barriers[0] = CD3DX12_RESOURCE_BARRIER::UAV(texture_feedback->GetBuffer());
+            pre_copy_barriers[1] = CD3DX12_RESOURCE_BARRIER::Transition(texture_feedback->GetBuffer(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE);
+            device.command_list->ResourceBarrier(ARRAYSIZE(pre_copy_barriers), pre_copy_barriers);
 
-      // Copy averaged result from previous pass into the backbuffer
-      {
-        D3D12_RESOURCE_BARRIER pre_copy_barriers[2];
-        pre_copy_barriers[0] = CD3DX12_RESOURCE_BARRIER::Transition(device.back_buffers[device.back_buffer_index], D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_COPY_DEST);
-        pre_copy_barriers[1] = CD3DX12_RESOURCE_BARRIER::Transition(averager_texture, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE);
-        device.command_list->ResourceBarrier(ARRAYSIZE(pre_copy_barriers), pre_copy_barriers);
+            device.command_list->CopyResource(texture_feedback_readback->GetBuffer(), texture_feedback->GetBuffer());
 
-        device.command_list->CopyResource(device.back_buffers[device.back_buffer_index], averager_texture);
+            device.command_list->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(texture_feedback->GetBuffer(), D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_COPY_DEST));
+            device.command_list->CopyResource(texture_feedback->GetBuffer(), texture_feedback_clear->GetBuffer());
+            device.command_list->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(texture_feedback->GetBuffer(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
 
-        D3D12_RESOURCE_BARRIER post_copy_barriers[2];
-        post_copy_barriers[0] = CD3DX12_RESOURCE_BARRIER::Transition(device.back_buffers[device.back_buffer_index], D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_RENDER_TARGET);
-        post_copy_barriers[1] = CD3DX12_RESOURCE_BARRIER::Transition(averager_texture, D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-        device.command_list->ResourceBarrier(ARRAYSIZE(post_copy_barriers), post_copy_barriers);
-      }
-    }
-    else
-    {
-      if (!app.denoised)
-      {
-        device.command_list->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(device.back_buffers[device.back_buffer_index], D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_COPY_DEST));
-
-        device.command_list->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(averager_buffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE));
-        device.command_list->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(averager_normals, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE));
-        device.command_list->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(averager_albedo, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE));
-        device.command_list->CopyResource(averager_buffer_readback->GetBuffer(), averager_buffer);
-        device.command_list->CopyResource(averager_normals_readback->GetBuffer(), averager_normals);
-        device.command_list->CopyResource(averager_albedo_readback->GetBuffer(), averager_albedo);
-        device.command_list->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(averager_buffer, D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
-        device.command_list->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(averager_normals, D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
-        device.command_list->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(averager_albedo, D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
-
-        device.ExecuteCommandLists();
-        device.WaitForGPU();
-        device.PrepareCommandLists();
-
-        float* noisy_pixels = reinterpret_cast<float*>(averager_buffer_readback->Map());
-        float* noisy_normals = reinterpret_cast<float*>(averager_normals_readback->Map());
-        float* noisy_albedo = reinterpret_cast<float*>(averager_albedo_readback->Map());
-
-        try
-        {
-          float* input = static_cast<float*>(optix_input->map());
-          memcpy(input, noisy_pixels, sizeof(float) * 1280 * 720 * 4);
-          optix_input->unmap();
+            texture_feedback_recorded = true;
+          }
 
-          float* normals = static_cast<float*>(optix_normals->map());
-          memcpy(normals, noisy_normals, sizeof(float) * 1280 * 720 * 4);
-          optix_normals->unmap();
+          // Occlusion queries versus closest hit traversal of the same rays, results show up as rays per second
+          if (app.ray_benchmark.enabled)
+          {
+            device.command_list->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(nullptr));
 
-          float* albedo = static_cast<float*>(optix_albedo->map());
-          memcpy(albedo, noisy_albedo, sizeof(float) * 1280 * 720 * 4);
-          optix_albedo->unmap();
+            raytracing_dispatch.RayGenerationShaderRecord.StartAddress = shader_table_occlusion_benchmark->GetBuffer()->GetGPUVirtualAddress();
+            raytracing_dispatch.RayGenerationShaderRecord.SizeInBytes = shader_table_occlusion_benchmark->GetSizeInBytes();
 
-          optix_list->execute();
+            gpu_timer.Start(device.command_list, GpuTimers::OcclusionBenchmark);
+            device.fallback_command_list->DispatchRays(&raytracing_dispatch);
+            gpu_timer.Stop(device.command_list, GpuTimers::OcclusionBenchmark);
 
-          float* denoised_output = static_cast<float*>(optix_output->map());
+            raytracing_dispatch.RayGenerationShaderRecord.StartAddress = shader_table_closest_hit_benchmark->GetBuffer()->GetGPUVirtualAddress();
+            raytracing_dispatch.RayGenerationShaderRecord.SizeInBytes = shader_table_closest_hit_benchmark->GetSizeInBytes();
 
-          for (int i = 0; i < 1280 * 720 * 4; i++)
-          {
-            denoised_pixels[i] = static_cast<unsigned char>(denoised_output[i] * 255);
+            gpu_timer.Start(device.command_list, GpuTimers::ClosestHitBenchmark);
+            device.fallback_command_list->DispatchRays(&raytracing_dispatch);
+            gpu_timer.Stop(device.command_list, GpuTimers::ClosestHitBenchmark);
           }
+        }
 
-          optix_output->unmap();
+        // Perform an averaging pass in compute (averages out all samples)
+        {
+          gpu_timer.Start(device.command_list, GpuTimers::Averager);
+          record_averager(false);
+          gpu_timer.Stop(device.command_list, GpuTimers::Averager);
         }
-        catch (optix::Exception e)
+
+        // Evaluate per-tile convergence, which drives the sample distribution of the next frame
         {
-          std::cout << e.getErrorString() << std::endl;
+          // With a frame budget the noisiest tiles take as many samples as fit in the frame, instead of a fixed maximum
+          UINT max_samples_per_frame = app.frame_budget.enabled ? app.frame_budget.samples_per_frame : static_cast<UINT>(app.adaptive.max_samples_per_frame);
+
+          convergence_constants[device.back_buffer_index].min_samples = static_cast<UINT>(app.adaptive.min_samples);
+          convergence_constants[device.back_buffer_index].max_samples_per_frame = max_samples_per_frame;
+          convergence_constants[device.back_buffer_index].error_threshold = app.adaptive.error_threshold;
+          convergence_constants[device.back_buffer_index].convergence_tiles_x = render_targets.convergence_tiles_x;
+          convergence_constants[device.back_buffer_index].sample_limit = app.GetSampleLimit();
+          convergence_constants_buffer->Write(sizeof(ConvergenceConstantBuffer), &(convergence_constants[device.back_buffer_index]), sizeof(AlignedConvergenceConstantBuffer) * device.back_buffer_index);
+
+          D3D12_RESOURCE_BARRIER pre_clear_barriers[2];
+          pre_clear_barriers[0] = CD3DX12_RESOURCE_BARRIER::UAV(nullptr);
+          pre_clear_barriers[1] = CD3DX12_RESOURCE_BARRIER::Transition(convergence_stats->GetBuffer(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_DEST);
+          device.command_list->ResourceBarrier(ARRAYSIZE(pre_clear_barriers), pre_clear_barriers);
+
+          device.command_list->CopyResource(convergence_stats->GetBuffer(), convergence_stats_zero->GetBuffer());
+          device.command_list->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(convergence_stats->GetBuffer(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
+
+          device.command_list->SetPipelineState(convergence_pso);
+          device.command_list->SetComputeRootSignature(convergence_root_signature);
+          device.command_list->SetComputeRootDescriptorTable(ConvergenceRootSignatureParams::InputTexture, render_targets.render_descriptor);
+          device.command_list->SetComputeRootDescriptorTable(ConvergenceRootSignatureParams::InputVariance, render_targets.variance_descriptor);
+          device.command_list->SetComputeRootDescriptorTable(ConvergenceRootSignatureParams::OutputTiles, render_targets.convergence_tiles_descriptor);
+          device.command_list->SetComputeRootDescriptorTable(ConvergenceRootSignatureParams::OutputStats, convergence_stats_descriptor);
+          device.command_list->SetComputeRootConstantBufferView(ConvergenceRootSignatureParams::Constants, convergence_constants_buffer->GetBuffer()->GetGPUVirtualAddress() + device.back_buffer_index * sizeof(AlignedConvergenceConstantBuffer));
+          device.command_list->Dispatch(render_targets.convergence_tiles_x, render_targets.convergence_tiles_y, 1);
+
+          D3D12_RESOURCE_BARRIER pre_copy_barriers[1];
+          pre_copy_barriers[0] = CD3DX12_RESOURCE_BARRIER::Transition(convergence_stats->GetBuffer(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE);
+          device.command_list->ResourceBarrier(ARRAYSIZE(pre_copy_barriers), pre_copy_barriers);
+
+          device.command_list->CopyResource(convergence_stats_readback->GetBuffer(), convergence_stats->GetBuffer());
+
+          D3D12_RESOURCE_BARRIER post_copy_barriers[1];
+          post_copy_barriers[0] = CD3DX12_RESOURCE_BARRIER::Transition(convergence_stats->GetBuffer(), D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+          device.command_list->ResourceBarrier(ARRAYSIZE(post_copy_barriers), post_copy_barriers);
         }
 
-        averager_buffer_readback->Unmap();
-        averager_normals_readback->Unmap();
-        averager_albedo_readback->Unmap();
+        // Rebuild the guiding distributions from everything recorded so far, used by the next frame
+        if (app.guiding.enabled)
+        {
+          guiding_constants[device.back_buffer_index].clear_training = app.guiding.reset ? 1 : 0;
+          guiding_constants_buffer->Write(sizeof(GuidingConstantBuffer), &(guiding_constants[device.back_buffer_index]), sizeof(AlignedGuidingConstantBuffer) * device.back_buffer_index);
 
-        TextureLoader::UploadTexture(device.device, device.command_queue, denoised_pixels, 1280, 720, &device.back_buffers[device.back_buffer_index]);
-        device.command_list->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(device.back_buffers[device.back_buffer_index], D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_RENDER_TARGET));
-        app.denoised = true;
+          device.command_list->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(guiding_training->GetBuffer()));
+
+          device.command_list->SetPipelineState(guiding_pso);
+          device.command_list->SetComputeRootSignature(guiding_root_signature);
+          device.command_list->SetComputeRootDescriptorTable(GuidingRootSignatureParams::InputTraining, guiding_training_descriptor);
+          device.command_list->SetComputeRootDescriptorTable(GuidingRootSignatureParams::OutputDistribution, guiding_distribution_descriptor);
+          device.command_list->SetComputeRootConstantBufferView(GuidingRootSignatureParams::Constants, guiding_constants_buffer->GetBuffer()->GetGPUVirtualAddress() + device.back_buffer_index * sizeof(AlignedGuidingConstantBuffer));
+          device.command_list->Dispatch((GUIDING_NUM_CELLS + 63) / 64, 1, 1);
+
+          app.guiding.reset = false;
+        }
       }
-      else
+    }
+    else if (!app.denoised && !render_targets.readbacks->IsPending())
+    {
+      // Resolve the denoiser inputs and queue their readback, a later frame denoises them once the copies are done
+      record_averager(true);
+
+      if (render_targets.readbacks->Record(device.command_list, &render_targets, app.sample_count))
       {
-        device.command_list->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(device.back_buffers[device.back_buffer_index], D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_COPY_DEST));
-        device.ExecuteCommandLists();
-        device.WaitForGPU();
-        device.PrepareCommandLists();
-        TextureLoader::UploadTexture(device.device, device.command_queue, denoised_pixels, 1280, 720, &device.back_buffers[device.back_buffer_index]);
-        device.command_list->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(device.back_buffers[device.back_buffer_index], D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_RENDER_TARGET));
+        denoise_requested_frame = app.frame_count;
       }
     }
 
+    // Saving needs the AOVs on the CPU, they come back through the same ring as the denoiser inputs. A frame that
+    // clears the samples has emptied the accumulation in its display resolve already, the save waits for the next one.
+    if (app.output.save && !app.clear_samples && (accumulating || app.denoised) && !render_targets.readbacks->IsPending())
+    {
+      device.command_list->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(nullptr));
+      record_averager(true);
+      render_targets.readbacks->Record(device.command_list, &render_targets, app.sample_count);
+    }
+
+    // Copy averaged result from previous pass into the backbuffer, this is the denoised image once it was uploaded
+    {
+      D3D12_RESOURCE_BARRIER pre_copy_barriers[2];
+      pre_copy_barriers[0] = CD3DX12_RESOURCE_BARRIER::Transition(device.back_buffers[device.back_buffer_index], D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_COPY_DEST);
+      pre_copy_barriers[1] = CD3DX12_RESOURCE_BARRIER::Transition(render_targets.averager_texture, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE);
+      device.command_list->ResourceBarrier(ARRAYSIZE(pre_copy_barriers), pre_copy_barriers);
+
+      device.command_list->CopyResource(device.back_buffers[device.back_buffer_index], render_targets.averager_texture);
+
+      D3D12_RESOURCE_BARRIER post_copy_barriers[2];
+      post_copy_barriers[0] = CD3DX12_RESOURCE_BARRIER::Transition(device.back_buffers[device.back_buffer_index], D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_RENDER_TARGET);
+      post_copy_barriers[1] = CD3DX12_RESOURCE_BARRIER::Transition(render_targets.averager_texture, D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+      device.command_list->ResourceBarrier(ARRAYSIZE(post_copy_barriers), post_copy_barriers);
+    }
+
     // Render imgui
     imgui_layer.Render(device.back_buffer_rtvs[device.back_buffer_index]);
 
     // Transition backbuffer to PRESENT
     device.command_list->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(device.back_buffers[device.back_buffer_index], D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
 
+    gpu_timer.Resolve(device.command_list);
+
     device.ExecuteCommandLists();
+    render_targets.readbacks->Submit(device.fence_values[device.back_buffer_index]);
     device.Present();
     device.WaitForGPU();
   }
 
   device.WaitForGPU();
 
+  // Closing the window preempts the render, the samples the last frame traced are in the accumulation already
+  if (app.checkpointing.save_on_exit && !app.clear_samples && app.sample_count + samples_traced > 0)
+  {
+    Checkpoint::State state;
+    app.GetCheckpointState(&state);
+    state.sample_count += samples_traced;
+
+    std::stringstream message;
+    message << (Checkpoint::Save(&device, &render_targets, state, app.checkpointing.path) ? "Saved " : "Could not save ") << app.checkpointing.path << " at sample " << state.sample_count << "\n";
+    LOG(message.str().c_str());
+  }
+
   RELEASE(global_root_signature);
   RELEASE(pso);
 
-  RELEASE(target_render);
+  for (int i = 0; i < Denoising::NumMethods; i++)
+  {
+    denoisers[i]->Destroy();
+  }
+
+  // Images that are still queued are written before the application exits
+  image_writer.Destroy();
+
+  render_targets.Destroy();
+  RELEASE(convergence_pso);
+  RELEASE(convergence_root_signature);
+  DELETE(convergence_stats);
+  DELETE(convergence_stats_zero);
+  DELETE(convergence_stats_readback);
+  DELETE(convergence_constants_buffer);
   RELEASE(averager_pso);
   RELEASE(averager_root_signature);
-  RELEASE(averager_texture);
   DELETE(averager_constants_buffer);
 
   DELETE(meshes_buffer);
@@ -983,6 +1662,9 @@ int main(int argc, char** argv)
   DELETE(shader_table_ray_generation);
   DELETE(shader_table_hit);
   DELETE(shader_table_miss);
+  DELETE(shader_table_occlusion_benchmark);
+  DELETE(shader_table_closest_hit_benchmark);
+  gpu_timer.Destroy();
   DELETE(scene_constants_buffer);
   DELETE(lights_buffer);
   DELETE(picking_buffer);
@@ -994,12 +1676,32 @@ int main(int argc, char** argv)
     DELETE(index_buffers[i]);
   }
 
-  for (size_t i = 0; i < textures.size(); i++)
+  texture_streamer.Destroy();
+  DELETE(texture_feedback);
+  DELETE(texture_feedback_clear);
+  DELETE(texture_feedback_readback);
+
+  for (size_t i = 0; i < blue_noise_textures.size(); i++)
   {
-    RELEASE(textures[i]);
+    RELEASE(blue_noise_textures[i]);
   }
 
   DELETE(materials_buffer);
+  DELETE(emissive_triangles_buffer);
+  DELETE(opacity_masks_buffer);
+  DELETE(opacity_mask_bits_buffer);
+
+  DELETE(restir_shader_table_initial);
+  DELETE(restir_shader_table_spatial);
+  DELETE(restir_shader_table_hit);
+  DELETE(restir_shader_table_miss);
+  RELEASE(restir_pso);
+
+  RELEASE(guiding_pso);
+  RELEASE(guiding_root_signature);
+  DELETE(guiding_training);
+  DELETE(guiding_distribution);
+  DELETE(guiding_constants_buffer);
 
   imgui_layer.Shutdown();
 
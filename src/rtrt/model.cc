@@ -250,6 +250,8 @@ namespace rtrt
       material.specular_map = MATERIAL_NO_TEXTURE_INDEX;
       material.specular_power_map = MATERIAL_NO_TEXTURE_INDEX;
       material.diffuse_map = MATERIAL_NO_TEXTURE_INDEX;
+      material.opacity_map = MATERIAL_NO_TEXTURE_INDEX;
+      material.opacity_mask = MATERIAL_NO_TEXTURE_INDEX;
       material.glossiness = 0.0f;
 
       for (int i = 0; i < aiTextureType_UNKNOWN; i++)
@@ -271,6 +273,7 @@ namespace rtrt
             {
               Texture texture;
               texture.path = full_path.c_str();
+              texture.usage = GetTextureUsage(static_cast<aiTextureType>(i));
 
               texture_indices.insert(std::make_pair(full_path, (UINT)textures.size()));
               texture_id = (UINT)textures.size();
@@ -304,6 +307,9 @@ namespace rtrt
             case aiTextureType_SPECULAR:
               material.specular_map = texture_id;
               break;
+            case aiTextureType_OPACITY:
+              material.opacity_map = texture_id;
+              break;
             }
           }
         }
@@ -313,6 +319,19 @@ namespace rtrt
     }
   }
   
+  //------------------------------------------------------------------------------------------------------
+  TextureUsage Model::GetTextureUsage(aiTextureType type)
+  {
+    switch (type)
+    {
+    case aiTextureType_NORMALS: return TextureUsage::Normal;
+    case aiTextureType_HEIGHT: return TextureUsage::Linear;
+    case aiTextureType_SHININESS: return TextureUsage::Linear;
+    case aiTextureType_OPACITY: return TextureUsage::Linear;
+    default: return TextureUsage::Color;
+    }
+  }
+
   //------------------------------------------------------------------------------------------------------
   bool Model::IsTextureTypeSupported(aiTextureType type)
   {
@@ -325,6 +344,7 @@ namespace rtrt
     case aiTextureType_NORMALS: return true;
     case aiTextureType_SHININESS: return true;
     case aiTextureType_SPECULAR: return true;
+    case aiTextureType_OPACITY: return true;
     }
 
     return false;
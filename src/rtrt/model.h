@@ -4,6 +4,7 @@
 #include <vector>
 
 #include "shared/raytracing_data.h"
+#include "texture_processor.h"
 
 namespace rtrt
 {
@@ -35,6 +36,7 @@ namespace rtrt
     struct Texture
     {
       std::string path;
+      TextureUsage usage; // Of the first material slot the texture was found in
     };
 
     struct Material
@@ -58,6 +60,8 @@ namespace rtrt
       float index_of_refraction;
       UINT shading_model;
       float glossiness;
+      UINT opacity_map;
+      UINT opacity_mask;
     };
 
     Model();
@@ -76,6 +80,7 @@ namespace rtrt
     void ProcessMaterials(aiMaterial** materials, UINT num_materials);
 
     bool IsTextureTypeSupported(aiTextureType type);
+    TextureUsage GetTextureUsage(aiTextureType type);
   private:
     std::string model_file_path_;
     std::string model_directory_path_;
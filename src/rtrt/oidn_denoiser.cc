@@ -0,0 +1,142 @@
+#include "oidn_denoiser.h"
+
+#include <chrono>
+
+namespace rtrt
+{
+  //------------------------------------------------------------------------------------------------------
+  OidnDenoiser::OidnDenoiser() :
+    available_(false)
+  {
+
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  OidnDenoiser::~OidnDenoiser()
+  {
+    Destroy();
+  }
+
+#ifdef RTRT_USE_OIDN
+  //------------------------------------------------------------------------------------------------------
+  bool OidnDenoiser::Create(UINT width, UINT height)
+  {
+    device_ = oidn::newDevice();
+    device_.commit();
+
+    // The RT filter is trained for path traced images with albedo and normal guides, the color is unclamped radiance
+    filter_ = device_.newFilter("RT");
+    filter_.set("hdr", true);
+
+    available_ = !CheckError();
+
+    Resize(width, height);
+
+    return available_;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void OidnDenoiser::Destroy()
+  {
+    filter_ = nullptr;
+    device_ = nullptr;
+    result_.clear();
+    available_ = false;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void OidnDenoiser::Resize(UINT width, UINT height)
+  {
+    // The w of the result stays 1, only the color channels are written by the filter
+    result_.assign(static_cast<size_t>(width) * height, XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f));
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void OidnDenoiser::Denoise(const DenoiserInputs& inputs, const DenoiserOutput& output)
+  {
+    auto input_start = std::chrono::high_resolution_clock::now();
+
+    size_t num_pixels = static_cast<size_t>(inputs.width) * inputs.height;
+    size_t row_stride = inputs.width * sizeof(XMFLOAT4);
+
+    // The linear output gets the filtered color directly, its w is set here since the filter leaves it alone
+    XMFLOAT4* color = result_.data();
+    if (output.linear != nullptr)
+    {
+      color = output.linear;
+
+      for (size_t i = 0; i < num_pixels; i++)
+      {
+        color[i].w = 1.0f;
+      }
+    }
+
+    filter_.setImage("color", const_cast<XMFLOAT4*>(inputs.color), oidn::Format::Float3, inputs.width, inputs.height, 0, sizeof(XMFLOAT4), row_stride);
+    filter_.setImage("albedo", const_cast<XMFLOAT4*>(inputs.albedo), oidn::Format::Float3, inputs.width, inputs.height, 0, sizeof(XMFLOAT4), row_stride);
+    filter_.setImage("normal", const_cast<XMFLOAT4*>(inputs.normals), oidn::Format::Float3, inputs.width, inputs.height, 0, sizeof(XMFLOAT4), row_stride);
+    filter_.setImage("output", color, oidn::Format::Float3, inputs.width, inputs.height, 0, sizeof(XMFLOAT4), row_stride);
+    filter_.commit();
+
+    auto denoise_start = std::chrono::high_resolution_clock::now();
+
+    filter_.execute();
+
+    auto output_start = std::chrono::high_resolution_clock::now();
+
+    if (!CheckError())
+    {
+      WriteOutput(color, num_pixels, output);
+    }
+
+    auto output_end = std::chrono::high_resolution_clock::now();
+
+    timings_.input_ms = std::chrono::duration<double, std::milli>(denoise_start - input_start).count();
+    timings_.denoise_ms = std::chrono::duration<double, std::milli>(output_start - denoise_start).count();
+    timings_.output_ms = std::chrono::duration<double, std::milli>(output_end - output_start).count();
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  bool OidnDenoiser::CheckError()
+  {
+    const char* message = nullptr;
+
+    if (device_.getError(message) == oidn::Error::None)
+    {
+      return false;
+    }
+
+    std::cout << "Open Image Denoise: " << (message != nullptr ? message : "unknown error") << std::endl;
+    return true;
+  }
+#else
+  //------------------------------------------------------------------------------------------------------
+  bool OidnDenoiser::Create(UINT, UINT)
+  {
+    return false;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void OidnDenoiser::Destroy()
+  {
+    available_ = false;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void OidnDenoiser::Resize(UINT, UINT)
+  {
+
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void OidnDenoiser::Denoise(const DenoiserInputs&, const DenoiserOutput&)
+  {
+
+  }
+#endif
+
+  //------------------------------------------------------------------------------------------------------
+  const char* OidnDenoiser::GetName() const
+  {
+    return "Open Image Denoise";
+  }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "denoiser.h"
+
+#ifdef RTRT_USE_OIDN
+#include <OpenImageDenoise/oidn.hpp>
+#endif
+
+namespace rtrt
+{
+  /**
+  * The neural denoiser of Intel Open Image Denoise, running on the CPU. The readback buffers are handed to it as
+  * float3 images with a 16 byte pixel stride, so it reads the averager output in place. Only built when CMake is
+  * configured with RTRT_USE_OIDN, otherwise Create reports the backend as unavailable.
+  */
+  class OidnDenoiser : public Denoiser
+  {
+  public:
+    OidnDenoiser();
+    ~OidnDenoiser();
+
+    bool Create(UINT width, UINT height) override;
+    void Destroy() override;
+
+    void Resize(UINT width, UINT height) override;
+
+    void Denoise(const DenoiserInputs& inputs, const DenoiserOutput& output) override;
+
+    const char* GetName() const override;
+
+  private:
+#ifdef RTRT_USE_OIDN
+    // Logs and clears the error of the device, returns whether there was one
+    bool CheckError();
+
+    oidn::DeviceRef device_;
+    oidn::FilterRef filter_;
+#endif
+    std::vector<XMFLOAT4> result_; // The denoised color when no linear output is requested
+    bool available_;
+  };
+}
@@ -0,0 +1,127 @@
+#include "opacity_mask.h"
+
+#include "model.h"
+
+#include <stb_image.h>
+
+namespace filesystem = std::experimental::filesystem;
+
+namespace rtrt
+{
+  //------------------------------------------------------------------------------------------------------
+  void OpacityMaskUtility::BuildOpacityMasks(Model* model, std::vector<OpacityMask>* out_masks, std::vector<UINT>* out_mask_bits)
+  {
+    ThrowIfFalse(model != nullptr && out_masks != nullptr && out_mask_bits != nullptr);
+
+    out_masks->clear();
+    out_mask_bits->clear();
+
+    // Cache of decoded textures, maps a texture index and the channel the mask is read from to the mask, or to
+    // MATERIAL_NO_TEXTURE_INDEX if it is fully opaque. A texture can be the opacity map of one material and the
+    // diffuse map of another, the two masks come from different channels.
+    std::unordered_map<UINT64, UINT> cache;
+
+    for (size_t i = 0; i < model->materials.size(); i++)
+    {
+      Model::Material& material = model->materials[i];
+      material.opacity_mask = MATERIAL_NO_TEXTURE_INDEX;
+
+      bool use_alpha_channel = material.opacity_map == MATERIAL_NO_TEXTURE_INDEX;
+      UINT texture = use_alpha_channel ? material.diffuse_map : material.opacity_map;
+
+      if (texture == MATERIAL_NO_TEXTURE_INDEX)
+      {
+        continue;
+      }
+
+      UINT64 key = static_cast<UINT64>(texture) << 1 | (use_alpha_channel ? 1 : 0);
+
+      auto cached = cache.find(key);
+      if (cached != cache.end())
+      {
+        material.opacity_mask = cached->second;
+        continue;
+      }
+
+      OpacityMask mask;
+      if (BuildMaskFromTexture(model->textures[texture].path, use_alpha_channel, &mask, out_mask_bits))
+      {
+        material.opacity_mask = static_cast<UINT>(out_masks->size());
+        out_masks->push_back(mask);
+      }
+
+      cache.insert(std::make_pair(key, material.opacity_mask));
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  bool OpacityMaskUtility::HasOpacityMask(const Model& model, UINT material)
+  {
+    return material < model.materials.size() && model.materials[material].opacity_mask != MATERIAL_NO_TEXTURE_INDEX;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  bool OpacityMaskUtility::BuildMaskFromTexture(const std::string& texture_path, bool use_alpha_channel, OpacityMask* out_mask, std::vector<UINT>* out_mask_bits)
+  {
+    // DDS textures are uploaded as-is by the DirectX Toolkit and cannot be decoded here, they are treated as opaque
+    std::string extension = filesystem::path(texture_path).extension().string();
+    if (extension == ".dds" || extension == ".DDS")
+    {
+      return false;
+    }
+
+    int width, height, comp;
+    if (stbi_info(texture_path.c_str(), &width, &height, &comp) == 0)
+    {
+      return false;
+    }
+
+    // Diffuse maps without an alpha channel can never cut anything out, no need to decode them
+    if (use_alpha_channel && comp != 2 && comp != 4)
+    {
+      return false;
+    }
+
+    unsigned char* pixel_data = stbi_load(texture_path.c_str(), &width, &height, &comp, 4);
+    if (pixel_data == nullptr)
+    {
+      return false;
+    }
+
+    const int channel = use_alpha_channel ? 3 : 0;
+    const unsigned char cutoff = static_cast<unsigned char>(OPACITY_ALPHA_CUTOFF * 255.0f);
+
+    UINT num_texels = static_cast<UINT>(width * height);
+    std::vector<UINT> bits((num_texels + 31) / 32, 0);
+    bool any_cut_out = false;
+
+    for (UINT i = 0; i < num_texels; i++)
+    {
+      if (pixel_data[i * 4 + channel] >= cutoff)
+      {
+        bits[i / 32] |= 1u << (i % 32);
+      }
+      else
+      {
+        any_cut_out = true;
+      }
+    }
+
+    STBI_FREE(pixel_data);
+
+    // Fully opaque textures keep their geometry on the opaque fast path
+    if (any_cut_out == false)
+    {
+      return false;
+    }
+
+    out_mask->first_word = static_cast<UINT>(out_mask_bits->size());
+    out_mask->width = static_cast<UINT>(width);
+    out_mask->height = static_cast<UINT>(height);
+    out_mask->padding = 0;
+
+    out_mask_bits->insert(out_mask_bits->end(), bits.begin(), bits.end());
+
+    return true;
+  }
+}
\ No newline at end of file
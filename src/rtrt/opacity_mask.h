@@ -0,0 +1,28 @@
+#pragma once
+
+#include "shared/raytracing_data.h"
+
+namespace rtrt
+{
+  class Model;
+
+  class OpacityMaskUtility
+  {
+  public:
+    /**
+    * Builds a 1-bit alpha test mask for every material with an opacity map, or with a diffuse map whose alpha
+    * channel actually cuts anything out, and stores its index in Model::Material::opacity_mask. Textures are
+    * decoded once and their masks are shared between all materials that reference them.
+    * @param[in] model The model to build the opacity masks for
+    * @param[out] out_masks The masks, indexed by Model::Material::opacity_mask
+    * @param[out] out_mask_bits The packed bits of all masks, 32 texels per word
+    */
+    static void BuildOpacityMasks(Model* model, std::vector<OpacityMask>* out_masks, std::vector<UINT>* out_mask_bits);
+
+    // Materials without an opacity mask are built as opaque geometry and never invoke any-hit shaders
+    static bool HasOpacityMask(const Model& model, UINT material);
+
+  private:
+    static bool BuildMaskFromTexture(const std::string& texture_path, bool use_alpha_channel, OpacityMask* out_mask, std::vector<UINT>* out_mask_bits);
+  };
+}
\ No newline at end of file
@@ -0,0 +1,157 @@
+#include "optix_denoiser.h"
+
+#include <chrono>
+
+namespace rtrt
+{
+  //------------------------------------------------------------------------------------------------------
+  OptixDenoiser::OptixDenoiser() :
+    available_(false)
+  {
+
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  OptixDenoiser::~OptixDenoiser()
+  {
+    Destroy();
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  bool OptixDenoiser::Create(UINT width, UINT height)
+  {
+    Destroy();
+
+    try
+    {
+      context_ = optix::Context::create();
+      input_ = context_->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_FLOAT4, width, height);
+      normals_ = context_->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_FLOAT4, width, height);
+      albedo_ = context_->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_FLOAT4, width, height);
+      output_ = context_->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_FLOAT4, width, height);
+
+      denoiser_stage_ = context_->createBuiltinPostProcessingStage("DLDenoiser");
+      denoiser_stage_->declareVariable("input_buffer")->set(input_);
+      denoiser_stage_->declareVariable("input_normal_buffer")->set(normals_);
+      denoiser_stage_->declareVariable("input_albedo_buffer")->set(albedo_);
+      denoiser_stage_->declareVariable("output_buffer")->set(output_);
+
+      // The inputs are linear radiance, which is what the HDR network is trained on
+      denoiser_stage_->declareVariable("hdr")->setUint(1);
+
+      command_list_ = context_->createCommandList();
+      command_list_->appendPostprocessingStage(denoiser_stage_, width, height);
+      command_list_->finalize();
+
+      context_->validate();
+      context_->compile();
+
+      // Immediately execute denoising with empty inputs...
+      // the first execute of optix takes ages (not sure why)
+      // so it's better to execute during init time
+      command_list_->execute();
+
+      available_ = true;
+    }
+    catch (optix::Exception e)
+    {
+      std::cout << e.getErrorString() << std::endl;
+      Destroy();
+    }
+
+    return available_;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void OptixDenoiser::Destroy()
+  {
+    // A Create that failed halfway leaves a context behind too, it owns everything that was created from it
+    input_ = optix::Buffer();
+    normals_ = optix::Buffer();
+    albedo_ = optix::Buffer();
+    output_ = optix::Buffer();
+    command_list_ = optix::CommandList();
+    denoiser_stage_ = optix::PostprocessingStage();
+
+    if (context_.get() != nullptr)
+    {
+      context_->destroy();
+      context_ = optix::Context();
+    }
+
+    available_ = false;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void OptixDenoiser::Resize(UINT width, UINT height)
+  {
+    if (!available_)
+    {
+      return;
+    }
+
+    try
+    {
+      input_->setSize(width, height);
+      normals_->setSize(width, height);
+      albedo_->setSize(width, height);
+      output_->setSize(width, height);
+
+      command_list_->destroy();
+      command_list_ = context_->createCommandList();
+      command_list_->appendPostprocessingStage(denoiser_stage_, width, height);
+      command_list_->finalize();
+    }
+    catch (optix::Exception e)
+    {
+      std::cout << e.getErrorString() << std::endl;
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void OptixDenoiser::Denoise(const DenoiserInputs& inputs, const DenoiserOutput& output)
+  {
+    size_t num_pixels = static_cast<size_t>(inputs.width) * inputs.height;
+
+    try
+    {
+      auto input_start = std::chrono::high_resolution_clock::now();
+
+      // The HDR network takes linear color and albedo, exactly what the averager resolved. OptiX only reads its own
+      // buffers, so the planes are copied out of the readback buffers
+      memcpy(input_->map(), inputs.color, num_pixels * sizeof(XMFLOAT4));
+      input_->unmap();
+
+      memcpy(albedo_->map(), inputs.albedo, num_pixels * sizeof(XMFLOAT4));
+      albedo_->unmap();
+
+      memcpy(normals_->map(), inputs.normals, num_pixels * sizeof(XMFLOAT4));
+      normals_->unmap();
+
+      auto denoise_start = std::chrono::high_resolution_clock::now();
+
+      command_list_->execute();
+
+      auto output_start = std::chrono::high_resolution_clock::now();
+
+      WriteOutput(static_cast<XMFLOAT4*>(output_->map()), num_pixels, output);
+      output_->unmap();
+
+      auto output_end = std::chrono::high_resolution_clock::now();
+
+      timings_.input_ms = std::chrono::duration<double, std::milli>(denoise_start - input_start).count();
+      timings_.denoise_ms = std::chrono::duration<double, std::milli>(output_start - denoise_start).count();
+      timings_.output_ms = std::chrono::duration<double, std::milli>(output_end - output_start).count();
+    }
+    catch (optix::Exception e)
+    {
+      std::cout << e.getErrorString() << std::endl;
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  const char* OptixDenoiser::GetName() const
+  {
+    return "OptiX";
+  }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "denoiser.h"
+
+#include <optix_world.h>
+
+namespace rtrt
+{
+  /**
+  * The deep-learning denoiser of OptiX, running the network that was trained on HDR images. The linear radiance goes
+  * in as is and comes out linear, so denoised EXR and PFM saves hold radiance like the other backends produce.
+  */
+  class OptixDenoiser : public Denoiser
+  {
+  public:
+    OptixDenoiser();
+    ~OptixDenoiser();
+
+    bool Create(UINT width, UINT height) override;
+    void Destroy() override;
+
+    // Rebuilds the command list, the size of the denoiser stage is fixed when it is appended
+    void Resize(UINT width, UINT height) override;
+
+    void Denoise(const DenoiserInputs& inputs, const DenoiserOutput& output) override;
+
+    const char* GetName() const override;
+
+  private:
+    optix::Context context_;
+    optix::Buffer input_;
+    optix::Buffer normals_;
+    optix::Buffer albedo_;
+    optix::Buffer output_;
+    optix::CommandList command_list_;
+    optix::PostprocessingStage denoiser_stage_;
+    bool available_;
+  };
+}
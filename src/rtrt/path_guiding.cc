@@ -0,0 +1,65 @@
+#include "path_guiding.h"
+
+#include "model.h"
+
+namespace rtrt
+{
+  //------------------------------------------------------------------------------------------------------
+  void PathGuidingUtility::CalculateSceneBounds(const Model& model, DirectX::XMFLOAT3* out_min, DirectX::XMFLOAT3* out_max)
+  {
+    ThrowIfFalse(out_min != nullptr && out_max != nullptr);
+
+    DirectX::XMVECTOR bounds_min = DirectX::XMVectorReplicate(FLT_MAX);
+    DirectX::XMVECTOR bounds_max = DirectX::XMVectorReplicate(-FLT_MAX);
+
+    std::function<DirectX::XMMATRIX(const Model::Node*)> CalculateTransformForNode = [&](const Model::Node* node)->DirectX::XMMATRIX
+    {
+      if (node->parent != nullptr)
+      {
+        return DirectX::XMMatrixMultiply(node->transform, CalculateTransformForNode(node->parent));
+      }
+      else
+      {
+        return DirectX::XMMatrixIdentity();
+      }
+    };
+
+    std::function<void(const Model::Node*)> ProcessModelNode = [&](const Model::Node* node)
+    {
+      if (node->meshes.size() > 0)
+      {
+        DirectX::XMMATRIX transform = CalculateTransformForNode(node);
+
+        for (size_t i = 0; i < node->meshes.size(); i++)
+        {
+          const Model::Mesh& mesh = model.meshes[node->meshes[i]];
+
+          for (size_t j = 0; j < mesh.vertices.size(); j++)
+          {
+            DirectX::XMVECTOR position = DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&mesh.vertices[j].position), transform);
+            bounds_min = DirectX::XMVectorMin(bounds_min, position);
+            bounds_max = DirectX::XMVectorMax(bounds_max, position);
+          }
+        }
+      }
+
+      for (size_t i = 0; i < node->children.size(); i++)
+      {
+        ProcessModelNode(node->children[i]);
+      }
+    };
+
+    ProcessModelNode(model.root_node);
+
+    // Empty models still get a valid, if meaningless, grid
+    if (DirectX::XMVector3Greater(bounds_min, bounds_max))
+    {
+      bounds_min = DirectX::XMVectorZero();
+      bounds_max = DirectX::XMVectorSplatOne();
+    }
+
+    DirectX::XMVECTOR padding = DirectX::XMVectorScale(DirectX::XMVectorSubtract(bounds_max, bounds_min), 0.01f);
+    DirectX::XMStoreFloat3(out_min, DirectX::XMVectorSubtract(bounds_min, padding));
+    DirectX::XMStoreFloat3(out_max, DirectX::XMVectorAdd(bounds_max, padding));
+  }
+}
\ No newline at end of file
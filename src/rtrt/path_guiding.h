@@ -0,0 +1,21 @@
+#pragma once
+
+#include "shared/raytracing_data.h"
+
+namespace rtrt
+{
+  class Model;
+
+  class PathGuidingUtility
+  {
+  public:
+    /**
+    * Calculates the world space bounding box of every vertex in the model, the guiding grid is laid over it.
+    * The box is padded slightly so that hits on the outermost surfaces do not all land on the border cells.
+    * @param[in] model The model to calculate the bounds of
+    * @param[out] out_min The minimum corner of the bounds
+    * @param[out] out_max The maximum corner of the bounds
+    */
+    static void CalculateSceneBounds(const Model& model, DirectX::XMFLOAT3* out_min, DirectX::XMFLOAT3* out_max);
+  };
+}
\ No newline at end of file
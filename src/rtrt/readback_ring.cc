@@ -0,0 +1,167 @@
+#include "readback_ring.h"
+#include "readback_buffer.h"
+#include "render_target_set.h"
+
+namespace rtrt
+{
+  //------------------------------------------------------------------------------------------------------
+  ReadbackRing::ReadbackRing() :
+    next_slot_(0)
+  {
+    for (UINT i = 0; i < NUM_SLOTS; i++)
+    {
+      slots_[i].color = nullptr;
+      slots_[i].normals = nullptr;
+      slots_[i].albedo = nullptr;
+      slots_[i].moments = nullptr;
+      slots_[i].tag = 0;
+      slots_[i].fence_value = 0;
+      slots_[i].pending = false;
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  ReadbackRing::~ReadbackRing()
+  {
+    Destroy();
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void ReadbackRing::Create(ID3D12Device* device, UINT width, UINT height)
+  {
+    UINT buffer_size = width * height * static_cast<UINT>(sizeof(XMFLOAT4));
+
+    for (UINT i = 0; i < NUM_SLOTS; i++)
+    {
+      Slot& slot = slots_[i];
+
+      slot.color = new ReadbackBuffer();
+      slot.color->Create(device, buffer_size);
+      slot.normals = new ReadbackBuffer();
+      slot.normals->Create(device, buffer_size);
+      slot.albedo = new ReadbackBuffer();
+      slot.albedo->Create(device, buffer_size);
+      slot.moments = new ReadbackBuffer();
+      slot.moments->Create(device, buffer_size);
+
+      // Mapped for as long as the buffers live, the GPU only writes them while the slot is pending
+      slot.inputs.color = static_cast<XMFLOAT4*>(slot.color->Map());
+      slot.inputs.normals = static_cast<XMFLOAT4*>(slot.normals->Map());
+      slot.inputs.albedo = static_cast<XMFLOAT4*>(slot.albedo->Map());
+      slot.inputs.moments = static_cast<XMFLOAT4*>(slot.moments->Map());
+      slot.inputs.width = width;
+      slot.inputs.height = height;
+
+      slot.tag = 0;
+      slot.fence_value = 0;
+      slot.pending = false;
+    }
+
+    next_slot_ = 0;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void ReadbackRing::Destroy()
+  {
+    for (UINT i = 0; i < NUM_SLOTS; i++)
+    {
+      DELETE(slots_[i].color);
+      DELETE(slots_[i].normals);
+      DELETE(slots_[i].albedo);
+      DELETE(slots_[i].moments);
+      slots_[i].pending = false;
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  bool ReadbackRing::Record(ID3D12GraphicsCommandList* command_list, RenderTargetSet* targets, UINT64 tag)
+  {
+    Slot* slot = nullptr;
+
+    for (UINT i = 0; i < NUM_SLOTS && slot == nullptr; i++)
+    {
+      UINT index = (next_slot_ + i) % NUM_SLOTS;
+      slot = slots_[index].pending ? nullptr : &slots_[index];
+      next_slot_ = slot != nullptr ? (index + 1) % NUM_SLOTS : next_slot_;
+    }
+
+    if (slot == nullptr)
+    {
+      return false;
+    }
+
+    ID3D12Resource* sources[4] = { targets->averager_buffer, targets->averager_normals, targets->averager_albedo, targets->variance };
+    ReadbackBuffer* destinations[4] = { slot->color, slot->normals, slot->albedo, slot->moments };
+
+    D3D12_RESOURCE_BARRIER barriers[4];
+
+    for (int i = 0; i < 4; i++)
+    {
+      barriers[i] = CD3DX12_RESOURCE_BARRIER::Transition(sources[i], D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    }
+    command_list->ResourceBarrier(ARRAYSIZE(barriers), barriers);
+
+    for (int i = 0; i < 4; i++)
+    {
+      command_list->CopyResource(destinations[i]->GetBuffer(), sources[i]);
+    }
+
+    for (int i = 0; i < 4; i++)
+    {
+      barriers[i] = CD3DX12_RESOURCE_BARRIER::Transition(sources[i], D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    }
+    command_list->ResourceBarrier(ARRAYSIZE(barriers), barriers);
+
+    slot->tag = tag;
+    slot->fence_value = 0;
+    slot->pending = true;
+
+    return true;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void ReadbackRing::Submit(UINT64 fence_value)
+  {
+    for (UINT i = 0; i < NUM_SLOTS; i++)
+    {
+      if (slots_[i].pending && slots_[i].fence_value == 0)
+      {
+        slots_[i].fence_value = fence_value;
+      }
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  const ReadbackRing::Slot* ReadbackRing::Poll(ID3D12Fence* fence)
+  {
+    UINT64 completed_value = fence->GetCompletedValue();
+    const Slot* newest = nullptr;
+
+    for (UINT i = 0; i < NUM_SLOTS; i++)
+    {
+      Slot& slot = slots_[i];
+
+      if (slot.pending && slot.fence_value != 0 && slot.fence_value <= completed_value)
+      {
+        slot.pending = false;
+        newest = newest == nullptr || slot.fence_value > newest->fence_value ? &slot : newest;
+      }
+    }
+
+    return newest;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  bool ReadbackRing::IsPending() const
+  {
+    for (UINT i = 0; i < NUM_SLOTS; i++)
+    {
+      if (slots_[i].pending)
+      {
+        return true;
+      }
+    }
+
+    return false;
+  }
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "denoiser.h"
+
+namespace rtrt
+{
+  class ReadbackBuffer;
+  class RenderTargetSet;
+
+  /**
+  * A ring of persistently mapped readback buffers for the denoiser inputs. Copies are recorded into a free slot and
+  * tagged with the fence value of the frame that records them, the CPU picks the slot up once the GPU passed that
+  * fence. This saves the copy out of the resources into CPU memory, not the wait: the render loop still waits for the
+  * GPU after every Present, so a slot is always finished by the next frame.
+  *
+  * The renderer only records a readback while none is pending, so the ring holds a single slot. Every slot is four
+  * full resolution float4 planes, more are only worth their memory once frames stop waiting for the GPU.
+  */
+  class ReadbackRing
+  {
+  public:
+    struct Slot
+    {
+      ReadbackBuffer* color;
+      ReadbackBuffer* normals;
+      ReadbackBuffer* albedo;
+      ReadbackBuffer* moments;
+
+      DenoiserInputs inputs; // Points into the mapped buffers above
+      UINT64 tag; // Identifies what was read back, handed to Record
+      UINT64 fence_value; // 0 until the frame that recorded the copies is submitted
+      bool pending;
+    };
+
+  public:
+    ReadbackRing();
+    ~ReadbackRing();
+
+    void Create(ID3D12Device* device, UINT width, UINT height);
+    void Destroy();
+
+    /**
+    * Records copies of the averager outputs and the luminance moments into a free slot.
+    * @param[in] command_list The command list of the current frame
+    * @param[in] targets The render targets the averager resolved the denoiser inputs into
+    * @param[in] tag Handed back with the slot, so stale readbacks can be told apart
+    * @return Whether a slot was free, all of them may still be waiting for the GPU
+    */
+    bool Record(ID3D12GraphicsCommandList* command_list, RenderTargetSet* targets, UINT64 tag);
+
+    /**
+    * Marks the copies recorded this frame as submitted.
+    * @param[in] fence_value The value the fence is signaled with once the frame is done on the GPU
+    */
+    void Submit(UINT64 fence_value);
+
+    /**
+    * Finds the newest slot the GPU finished copying into. Every finished slot is free again right away, so the
+    * returned slot has to be consumed before the next call to Record.
+    * @param[in] fence The fence the frames are signaled with
+    * @return The finished slot or nullptr if there is none
+    */
+    const Slot* Poll(ID3D12Fence* fence);
+
+    // Whether any copies are still on their way
+    bool IsPending() const;
+
+    static const UINT NUM_SLOTS = 1; // One readback pending at a time, see above
+
+  private:
+    Slot slots_[NUM_SLOTS];
+    UINT next_slot_;
+  };
+}
\ No newline at end of file
@@ -0,0 +1,233 @@
+#include "render_target_set.h"
+#include "device.h"
+#include "buffer.h"
+#include "upload_buffer.h"
+#include "readback_ring.h"
+#include "shared/raytracing_data.h"
+
+namespace rtrt
+{
+  //------------------------------------------------------------------------------------------------------
+  RenderTargetSet::RenderTargetSet() :
+    width(0),
+    height(0),
+    convergence_tiles_x(0),
+    convergence_tiles_y(0),
+    render(nullptr),
+    normals(nullptr),
+    albedo(nullptr),
+    variance(nullptr),
+    reservoirs(nullptr),
+    reservoir_history(nullptr),
+    reservoir_surfaces(nullptr),
+    convergence_tiles(nullptr),
+    averager_texture(nullptr),
+    averager_buffer(nullptr),
+    averager_normals(nullptr),
+    averager_albedo(nullptr),
+    readbacks(nullptr),
+    denoised_upload(nullptr),
+    device_(nullptr)
+  {
+
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  RenderTargetSet::~RenderTargetSet()
+  {
+    Destroy();
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void RenderTargetSet::Create(Device* device, UINT a_width, UINT a_height)
+  {
+    device_ = device;
+    width = a_width;
+    height = a_height;
+
+    std::vector<DescriptorHandle> descriptors;
+    device_->uav_heap->AllocateRange(NUM_DESCRIPTORS, &descriptors);
+
+    render_descriptor = descriptors[0];
+    normals_descriptor = descriptors[1];
+    albedo_descriptor = descriptors[2];
+    variance_descriptor = descriptors[3];
+    reservoirs_descriptor = descriptors[4];
+    reservoir_history_descriptor = descriptors[5];
+    reservoir_surfaces_descriptor = descriptors[6];
+    convergence_tiles_descriptor = descriptors[7];
+    averager_texture_descriptor = descriptors[8];
+    averager_buffer_descriptor = descriptors[9];
+    averager_normals_descriptor = descriptors[10];
+    averager_albedo_descriptor = descriptors[11];
+
+    CreateResources();
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void RenderTargetSet::Destroy()
+  {
+    ReleaseResources();
+    device_ = nullptr;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void RenderTargetSet::Resize(UINT a_width, UINT a_height)
+  {
+    ReleaseResources();
+
+    width = a_width;
+    height = a_height;
+
+    CreateResources();
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  UINT RenderTargetSet::GetNumPixels() const
+  {
+    return width * height;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void RenderTargetSet::CreateResources()
+  {
+    UINT num_pixels = GetNumPixels();
+
+    convergence_tiles_x = (width + CONVERGENCE_TILE_SIZE - 1) / CONVERGENCE_TILE_SIZE;
+    convergence_tiles_y = (height + CONVERGENCE_TILE_SIZE - 1) / CONVERGENCE_TILE_SIZE;
+
+    // Accumulation targets
+    render = CreateTarget(CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R32G32B32A32_FLOAT, width, height, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS));
+    normals = CreateTarget(CD3DX12_RESOURCE_DESC::Buffer(num_pixels * 16, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS));
+    albedo = CreateTarget(CD3DX12_RESOURCE_DESC::Buffer(num_pixels * 16, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS));
+    variance = CreateTarget(CD3DX12_RESOURCE_DESC::Buffer(num_pixels * 16, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS));
+
+    WriteTextureView(render, DXGI_FORMAT_R32G32B32A32_FLOAT, render_descriptor);
+    WriteBufferView(normals, num_pixels, 16, normals_descriptor);
+    WriteBufferView(albedo, num_pixels, 16, albedo_descriptor);
+    WriteBufferView(variance, num_pixels, 16, variance_descriptor);
+
+    // Reservoir buffers, zero-initialized so no history gets reused on the first frame
+    {
+      std::vector<Reservoir> empty_reservoirs(num_pixels, Reservoir{});
+      std::vector<ReservoirSurface> empty_surfaces(num_pixels, ReservoirSurface{});
+
+      reservoirs = new Buffer();
+      reservoirs->Create(device_, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, static_cast<UINT>(empty_reservoirs.size() * sizeof(Reservoir)), empty_reservoirs.data());
+
+      reservoir_history = new Buffer();
+      reservoir_history->Create(device_, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, static_cast<UINT>(empty_reservoirs.size() * sizeof(Reservoir)), empty_reservoirs.data());
+
+      reservoir_surfaces = new Buffer();
+      reservoir_surfaces->Create(device_, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, static_cast<UINT>(empty_surfaces.size() * sizeof(ReservoirSurface)), empty_surfaces.data());
+
+      WriteBufferView(reservoirs->GetBuffer(), num_pixels, sizeof(Reservoir), reservoirs_descriptor);
+      WriteBufferView(reservoir_history->GetBuffer(), num_pixels, sizeof(Reservoir), reservoir_history_descriptor);
+      WriteBufferView(reservoir_surfaces->GetBuffer(), num_pixels, sizeof(ReservoirSurface), reservoir_surfaces_descriptor);
+    }
+
+    // Every tile starts out unconverged with a single sample per frame
+    {
+      std::vector<TileConvergence> initial_tiles(convergence_tiles_x * convergence_tiles_y, { 0.0f, 1 });
+
+      convergence_tiles = new Buffer();
+      convergence_tiles->Create(device_, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, static_cast<UINT>(initial_tiles.size() * sizeof(TileConvergence)), initial_tiles.data());
+
+      WriteBufferView(convergence_tiles->GetBuffer(), static_cast<UINT>(initial_tiles.size()), sizeof(TileConvergence), convergence_tiles_descriptor);
+    }
+
+    // Averager outputs
+    averager_texture = CreateTarget(CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, width, height, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS));
+    averager_buffer = CreateTarget(CD3DX12_RESOURCE_DESC::Buffer(num_pixels * 16, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS));
+    averager_normals = CreateTarget(CD3DX12_RESOURCE_DESC::Buffer(num_pixels * 16, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS));
+    averager_albedo = CreateTarget(CD3DX12_RESOURCE_DESC::Buffer(num_pixels * 16, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS));
+
+    WriteTextureView(averager_texture, DXGI_FORMAT_R8G8B8A8_UNORM, averager_texture_descriptor);
+    WriteBufferView(averager_buffer, num_pixels, 16, averager_buffer_descriptor);
+    WriteBufferView(averager_normals, num_pixels, 16, averager_normals_descriptor);
+    WriteBufferView(averager_albedo, num_pixels, 16, averager_albedo_descriptor);
+
+    // Denoising
+    readbacks = new ReadbackRing();
+    readbacks->Create(device_->device, width, height);
+
+    denoised_linear.assign(num_pixels, XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f));
+    denoised_pixels.assign(static_cast<size_t>(num_pixels) * 4, 0);
+
+    D3D12_RESOURCE_DESC texture_desc = averager_texture->GetDesc();
+    UINT64 upload_size;
+    device_->device->GetCopyableFootprints(&texture_desc, 0, 1, 0, &denoised_footprint, nullptr, nullptr, &upload_size);
+
+    denoised_upload = new UploadBuffer();
+    denoised_upload->Create(device_->device, static_cast<UINT>(upload_size), nullptr);
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void RenderTargetSet::ReleaseResources()
+  {
+    RELEASE(render);
+    RELEASE(normals);
+    RELEASE(albedo);
+    RELEASE(variance);
+    DELETE(reservoirs);
+    DELETE(reservoir_history);
+    DELETE(reservoir_surfaces);
+    DELETE(convergence_tiles);
+
+    RELEASE(averager_texture);
+    RELEASE(averager_buffer);
+    RELEASE(averager_normals);
+    RELEASE(averager_albedo);
+    DELETE(readbacks);
+    DELETE(denoised_upload);
+
+    denoised_linear.clear();
+    denoised_pixels.clear();
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  ID3D12Resource* RenderTargetSet::CreateTarget(const D3D12_RESOURCE_DESC& desc)
+  {
+    ID3D12Resource* resource = nullptr;
+
+    ThrowIfFailed(
+      device_->device->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+        D3D12_HEAP_FLAG_NONE,
+        &desc,
+        D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+        nullptr,
+        IID_PPV_ARGS(&resource)
+      )
+    );
+
+    return resource;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void RenderTargetSet::WriteTextureView(ID3D12Resource* texture, DXGI_FORMAT format, DescriptorHandle handle)
+  {
+    D3D12_UNORDERED_ACCESS_VIEW_DESC uav_desc;
+    uav_desc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
+    uav_desc.Texture2D.MipSlice = 0;
+    uav_desc.Texture2D.PlaneSlice = 0;
+    uav_desc.Format = format;
+
+    device_->device->CreateUnorderedAccessView(texture, nullptr, &uav_desc, handle.cpu_handle());
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void RenderTargetSet::WriteBufferView(ID3D12Resource* buffer, UINT num_elements, UINT stride, DescriptorHandle handle)
+  {
+    D3D12_UNORDERED_ACCESS_VIEW_DESC uav_desc;
+    uav_desc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
+    uav_desc.Buffer.CounterOffsetInBytes = 0;
+    uav_desc.Buffer.FirstElement = 0;
+    uav_desc.Buffer.Flags = D3D12_BUFFER_UAV_FLAG_NONE;
+    uav_desc.Buffer.NumElements = num_elements;
+    uav_desc.Buffer.StructureByteStride = stride;
+    uav_desc.Format = DXGI_FORMAT_UNKNOWN;
+
+    device_->device->CreateUnorderedAccessView(buffer, nullptr, &uav_desc, handle.cpu_handle());
+  }
+}
\ No newline at end of file
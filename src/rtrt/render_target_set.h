@@ -0,0 +1,89 @@
+#pragma once
+
+#include "descriptor_heap.h"
+
+namespace rtrt
+{
+  class Device;
+  class Buffer;
+  class UploadBuffer;
+  class ReadbackRing;
+
+  /**
+  * Every resource whose size depends on the render resolution: the accumulation targets the path tracer writes,
+  * the ReSTIR reservoirs, the adaptive sampling tiles and the outputs of the averager. The descriptors are allocated
+  * once as a single range, a resize recreates the resources and rewrites the descriptors in place, so descriptor
+  * tables that were bound before the resize stay valid.
+  */
+  class RenderTargetSet
+  {
+  public:
+    RenderTargetSet();
+    ~RenderTargetSet();
+
+    void Create(Device* device, UINT width, UINT height);
+    void Destroy();
+
+    /**
+    * Recreates every target at a new resolution. Accumulated samples, reservoirs and tile statistics are lost.
+    * Resources are released right away, so this may only be called while the GPU is idle.
+    */
+    void Resize(UINT width, UINT height);
+
+    UINT GetNumPixels() const;
+
+  public:
+    UINT width;
+    UINT height;
+    UINT convergence_tiles_x;
+    UINT convergence_tiles_y;
+
+    // Accumulated by the path tracer
+    ID3D12Resource* render;
+    ID3D12Resource* normals;
+    ID3D12Resource* albedo;
+    ID3D12Resource* variance;
+    Buffer* reservoirs;
+    Buffer* reservoir_history;
+    Buffer* reservoir_surfaces;
+    Buffer* convergence_tiles;
+
+    // Resolved by the averager
+    ID3D12Resource* averager_texture;
+    ID3D12Resource* averager_buffer;
+    ID3D12Resource* averager_normals;
+    ID3D12Resource* averager_albedo;
+
+    // Denoising
+    ReadbackRing* readbacks;
+    std::vector<XMFLOAT4> denoised_linear; // Kept for saving the denoised image
+    std::vector<unsigned char> denoised_pixels;
+    UploadBuffer* denoised_upload; // Copied into averager_texture, so the denoised image is shown like any other frame
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT denoised_footprint;
+
+    DescriptorHandle render_descriptor;
+    DescriptorHandle normals_descriptor;
+    DescriptorHandle albedo_descriptor;
+    DescriptorHandle variance_descriptor;
+    DescriptorHandle reservoirs_descriptor;
+    DescriptorHandle reservoir_history_descriptor;
+    DescriptorHandle reservoir_surfaces_descriptor;
+    DescriptorHandle convergence_tiles_descriptor;
+    DescriptorHandle averager_texture_descriptor;
+    DescriptorHandle averager_buffer_descriptor;
+    DescriptorHandle averager_normals_descriptor;
+    DescriptorHandle averager_albedo_descriptor;
+
+    static const UINT NUM_DESCRIPTORS = 12;
+
+  private:
+    void CreateResources();
+    void ReleaseResources();
+
+    ID3D12Resource* CreateTarget(const D3D12_RESOURCE_DESC& desc);
+    void WriteTextureView(ID3D12Resource* texture, DXGI_FORMAT format, DescriptorHandle handle);
+    void WriteBufferView(ID3D12Resource* buffer, UINT num_elements, UINT stride, DescriptorHandle handle);
+
+    Device* device_;
+  };
+}
\ No newline at end of file
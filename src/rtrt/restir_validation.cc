@@ -0,0 +1,253 @@
+#include "restir_validation.h"
+#include "light_list.h"
+#include "shared/reservoir.h"
+
+#include <random>
+
+namespace rtrt
+{
+  namespace
+  {
+    struct Surface
+    {
+      XMFLOAT3 position;
+      XMFLOAT3 normal;
+      XMFLOAT3 diffuse;
+    };
+
+    // GetLightSample in restir.hlsli
+    struct LightSample
+    {
+      XMFLOAT3 position;
+      XMFLOAT3 normal;
+      XMFLOAT3 emission;
+      float area_pdf;
+    };
+
+    //------------------------------------------------------------------------------------------------------
+    float Luminance(const XMFLOAT3& color)
+    {
+      return 0.2126f * color.x + 0.7152f * color.y + 0.0722f * color.z;
+    }
+
+    //------------------------------------------------------------------------------------------------------
+    UINT SelectEmissiveTriangle(const std::vector<EmissiveTriangle>& triangles, float random)
+    {
+      UINT first = 0;
+      UINT last = static_cast<UINT>(triangles.size()) - 1;
+
+      while (first < last)
+      {
+        UINT middle = (first + last) / 2;
+
+        if (triangles[middle].cdf < random)
+        {
+          first = middle + 1;
+        }
+        else
+        {
+          last = middle;
+        }
+      }
+
+      return first;
+    }
+
+    //------------------------------------------------------------------------------------------------------
+    LightSample GetLightSample(const std::vector<EmissiveTriangle>& triangles, UINT light, const XMFLOAT2& barycentrics)
+    {
+      const EmissiveTriangle& tri = triangles[light];
+
+      XMVECTOR p0 = XMLoadFloat3(&tri.p0);
+      XMVECTOR p1 = XMLoadFloat3(&tri.p1);
+      XMVECTOR p2 = XMLoadFloat3(&tri.p2);
+
+      LightSample light_sample;
+      XMStoreFloat3(&light_sample.position, XMVectorAdd(XMVectorScale(p0, 1.0f - barycentrics.x - barycentrics.y), XMVectorAdd(XMVectorScale(p1, barycentrics.x), XMVectorScale(p2, barycentrics.y))));
+      XMStoreFloat3(&light_sample.normal, XMVector3Normalize(XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0))));
+      light_sample.emission = tri.emission;
+      light_sample.area_pdf = tri.pdf / tri.area;
+
+      return light_sample;
+    }
+
+    //------------------------------------------------------------------------------------------------------
+    // EvaluateDirectLighting in restir.hlsli, unshadowed and with two-sided emitters
+    XMFLOAT3 EvaluateDirectLighting(const Surface& surface, const LightSample& light_sample)
+    {
+      XMVECTOR to_light = XMVectorSubtract(XMLoadFloat3(&light_sample.position), XMLoadFloat3(&surface.position));
+      float distance_sq = XMVectorGetX(XMVector3Dot(to_light, to_light));
+
+      if (distance_sq <= 0.0f)
+      {
+        return XMFLOAT3(0.0f, 0.0f, 0.0f);
+      }
+
+      XMVECTOR direction = XMVectorScale(to_light, 1.0f / std::sqrt(distance_sq));
+      float cos_surface = XMVectorGetX(XMVector3Dot(XMLoadFloat3(&surface.normal), direction));
+      float cos_light = std::abs(XMVectorGetX(XMVector3Dot(XMLoadFloat3(&light_sample.normal), direction)));
+
+      if (cos_surface <= 0.0f)
+      {
+        return XMFLOAT3(0.0f, 0.0f, 0.0f);
+      }
+
+      float scale = cos_surface * cos_light / (distance_sq * 3.14159265f);
+
+      return XMFLOAT3(
+        surface.diffuse.x * light_sample.emission.x * scale,
+        surface.diffuse.y * light_sample.emission.y * scale,
+        surface.diffuse.z * light_sample.emission.z * scale
+      );
+    }
+
+    //------------------------------------------------------------------------------------------------------
+    // SampleInitialReservoir in restir.hlsli
+    Reservoir SampleInitialReservoir(const Surface& surface, const std::vector<EmissiveTriangle>& triangles, UINT num_candidates, std::mt19937& random)
+    {
+      std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+      Reservoir reservoir = EmptyReservoir();
+
+      for (UINT i = 0; i < num_candidates; i++)
+      {
+        UINT light = SelectEmissiveTriangle(triangles, uniform(random));
+        float random_x = uniform(random);
+        float random_y = uniform(random);
+        XMFLOAT2 barycentrics = SampleTriangleBarycentrics(random_x, random_y);
+        LightSample light_sample = GetLightSample(triangles, light, barycentrics);
+
+        float target_pdf = Luminance(EvaluateDirectLighting(surface, light_sample));
+        UpdateReservoir(reservoir, light, barycentrics, target_pdf / light_sample.area_pdf, target_pdf, uniform(random));
+      }
+
+      FinalizeReservoir(reservoir);
+
+      return reservoir;
+    }
+
+    //------------------------------------------------------------------------------------------------------
+    // ShadeReservoir in restir.hlsli, without the visibility ray
+    float ShadeReservoir(const Reservoir& reservoir, const Surface& surface, const std::vector<EmissiveTriangle>& triangles)
+    {
+      if (reservoir.contribution_weight <= 0.0f)
+      {
+        return 0.0f;
+      }
+
+      return Luminance(EvaluateDirectLighting(surface, GetLightSample(triangles, reservoir.light, reservoir.barycentrics))) * reservoir.contribution_weight;
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  bool RestirValidationUtility::RunValidation(UINT num_trials)
+  {
+    const UINT num_lights = 16;
+    const UINT num_candidates = 32;
+    const UINT num_combined = 4;
+    const UINT reference_resolution = 256;
+
+    std::mt19937 random(1337);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+    Surface surface;
+    surface.position = XMFLOAT3(0.0f, 0.0f, 0.0f);
+    surface.normal = XMFLOAT3(0.0f, 1.0f, 0.0f);
+    surface.diffuse = XMFLOAT3(0.8f, 0.6f, 0.4f);
+
+    // Emitters of every orientation, partly below the horizon where they contribute nothing
+    std::vector<EmissiveTriangle> triangles(num_lights);
+    for (UINT i = 0; i < num_lights; i++)
+    {
+      EmissiveTriangle& triangle = triangles[i];
+      triangle = {};
+
+      XMFLOAT3* vertices[] = { &triangle.p0, &triangle.p1, &triangle.p2 };
+      XMFLOAT3 center(uniform(random) * 4.0f - 2.0f, uniform(random) * 3.0f - 0.5f, uniform(random) * 4.0f - 2.0f);
+
+      for (XMFLOAT3* vertex : vertices)
+      {
+        *vertex = XMFLOAT3(center.x + uniform(random) - 0.5f, center.y + uniform(random) - 0.5f, center.z + uniform(random) - 0.5f);
+      }
+
+      XMVECTOR p0 = XMLoadFloat3(&triangle.p0);
+      triangle.area = 0.5f * XMVectorGetX(XMVector3Length(XMVector3Cross(XMVectorSubtract(XMLoadFloat3(&triangle.p1), p0), XMVectorSubtract(XMLoadFloat3(&triangle.p2), p0))));
+      triangle.emission = XMFLOAT3(uniform(random) * 5.0f, uniform(random) * 5.0f, uniform(random) * 5.0f);
+      triangle.material = i;
+    }
+
+    LightListUtility::BuildSelectionDistribution(&triangles);
+
+    // Reference: the lighting of every triangle integrated with stratified samples over its area
+    double reference = 0.0;
+    for (UINT light = 0; light < num_lights; light++)
+    {
+      double light_sum = 0.0;
+
+      for (UINT y = 0; y < reference_resolution; y++)
+      {
+        for (UINT x = 0; x < reference_resolution; x++)
+        {
+          float random_x = (static_cast<float>(x) + 0.5f) / static_cast<float>(reference_resolution);
+          float random_y = (static_cast<float>(y) + 0.5f) / static_cast<float>(reference_resolution);
+
+          light_sum += Luminance(EvaluateDirectLighting(surface, GetLightSample(triangles, light, SampleTriangleBarycentrics(random_x, random_y))));
+        }
+      }
+
+      reference += light_sum * triangles[light].area / (reference_resolution * reference_resolution);
+    }
+
+    auto estimate = [&](const char* name, std::function<float()> sample, std::stringstream& message)
+    {
+      double sum = 0.0;
+      double sum_sq = 0.0;
+
+      for (UINT i = 0; i < num_trials; i++)
+      {
+        double value = sample();
+        sum += value;
+        sum_sq += value * value;
+      }
+
+      double mean = sum / num_trials;
+      double standard_error = std::sqrt(std::max(sum_sq / num_trials - mean * mean, 0.0) / num_trials);
+
+      // The reference has an integration error of its own, far below the noise of the estimators
+      bool passed = std::abs(mean - reference) <= 4.0 * standard_error + 1e-3 * reference;
+
+      message << "  " << name << ": " << mean << " +- " << standard_error << (passed ? "" : " (BIASED)") << "\n";
+      return passed;
+    };
+
+    std::stringstream message;
+    message << "ReSTIR validation, " << num_lights << " emissive triangles, " << num_trials << " trials per estimator\n";
+    message << std::fixed << std::setprecision(5);
+    message << "  Reference: " << reference << "\n";
+
+    bool passed = estimate("Initial candidates", [&]()
+    {
+      return ShadeReservoir(SampleInitialReservoir(surface, triangles, num_candidates, random), surface, triangles);
+    }, message);
+
+    passed = estimate("Combined reservoirs", [&]()
+    {
+      Reservoir combined = EmptyReservoir();
+
+      for (UINT i = 0; i < num_combined; i++)
+      {
+        Reservoir other = SampleInitialReservoir(surface, triangles, num_candidates, random);
+        float target_pdf = Luminance(EvaluateDirectLighting(surface, GetLightSample(triangles, other.light, other.barycentrics)));
+
+        CombineReservoir(combined, other, target_pdf, uniform(random));
+      }
+
+      FinalizeReservoir(combined);
+
+      return ShadeReservoir(combined, surface, triangles);
+    }, message) && passed;
+
+    LOG(message.str().c_str());
+
+    return passed;
+  }
+}
\ No newline at end of file
@@ -0,0 +1,21 @@
+#pragma once
+
+namespace rtrt
+{
+  /**
+  * CPU validation of the reservoir resampling in restir.hlsli. Builds a synthetic set of emissive triangles above a
+  * diffuse surface, integrates their unshadowed direct lighting as the reference, and checks that reservoirs of
+  * initial candidates, and reservoirs combined from several of those on the same surface, estimate it without bias.
+  * The reservoir bookkeeping is shared with the shaders through shared/reservoir.h.
+  */
+  class RestirValidationUtility
+  {
+  public:
+    /**
+    * Runs the validation and logs the estimates next to the reference. Started with --validate-restir on the command line.
+    * @param[in] num_trials How many reservoirs every estimator averages
+    * @return Whether every estimator is within four standard errors of the reference
+    */
+    static bool RunValidation(UINT num_trials);
+  };
+}
\ No newline at end of file
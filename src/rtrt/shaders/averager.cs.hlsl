@@ -1,4 +1,5 @@
 #include "raytracing_data.h"
+#include "tonemapping.hlsli"
 
 ConstantBuffer<AveragerConstantBuffer> constants : register(b0);
 
@@ -9,19 +10,67 @@ RWTexture2D<float4> output_texture  : register(u3);
 RWBuffer<float4>    output_buffer   : register(u4);
 RWBuffer<float4>    output_normals  : register(u5);
 RWBuffer<float4>    output_albedo   : register(u6);
+RWStructuredBuffer<float4>          input_variance    : register(u7);
+RWStructuredBuffer<TileConvergence> convergence_tiles : register(u8);
 
-[numthreads(1, 1, 1)]
+float3 ConvergenceHeatMap(uint2 pixel)
+{
+  uint2 tile = pixel / CONVERGENCE_TILE_SIZE;
+  TileConvergence convergence = convergence_tiles[tile.y * constants.convergence_tiles_x + tile.x];
+
+  if (convergence.samples_per_frame == 0)
+  {
+    return float3(0.0f, 0.15f, 0.6f);
+  }
+
+  // Green at the error threshold, red at 4x the threshold or worse
+  float t = saturate((convergence.relative_error / constants.error_threshold - 1.0f) / 3.0f);
+  return lerp(float3(0.0f, 1.0f, 0.0f), float3(1.0f, 0.0f, 0.0f), t);
+}
+
+[numthreads(AVERAGER_GROUP_SIZE, AVERAGER_GROUP_SIZE, 1)]
 void main(uint3 thread_id : SV_DispatchThreadID)
 {
-  int idx = thread_id.y * 1280 + thread_id.x;
-  float exp = 1.0f / constants.gamma;
+  // The last row and column of groups hang over the edge of the image
+  if (thread_id.x >= constants.width || thread_id.y >= constants.height)
+  {
+    return;
+  }
+
+  uint idx = thread_id.y * constants.width + thread_id.x;
+  float3 exponent = 1.0f / constants.gamma;
+
+  // The denoisers get linear color, albedo and signed normals in a pass of their own right before they run
+  if (constants.resolve_guides != 0)
+  {
+    float4 radiance = input_texture[thread_id.xy];
+    float4 normals = input_normals[idx];
+    float4 albedo = input_albedo[idx];
+
+    output_buffer[idx]  = float4(radiance.xyz / radiance.w, 1.0f);
+    output_normals[idx] = float4(normals.xyz / normals.w, 0.0f);
+    output_albedo[idx]  = float4(albedo.xyz / albedo.w, 1.0f);
+    return;
+  }
+
+  // Accumulated radiance is HDR, it only gets to display range through the tonemapper
+  float4 accumulated = input_texture[thread_id.xy];
+  float4 color = float4(pow(Tonemap(accumulated.xyz / accumulated.w, constants.exposure, constants.tonemapper), exponent), 1.0f);
+
+  output_buffer[idx] = color;
+
+  if (constants.debug_view == DEBUG_VIEW_CONVERGENCE)
+  {
+    color = float4(ConvergenceHeatMap(thread_id.xy), 1.0f);
+  }
+
+  output_texture[thread_id.xy] = color;
 
-  output_texture[thread_id.xy]  = float4(pow(abs(input_texture[thread_id.xy].xyz / input_texture[thread_id.xy].w), float3(exp, exp, exp)), 1.0f);
-  output_buffer[idx]            = output_texture[thread_id.xy];
-  output_normals[idx]           = float4(pow(abs(input_normals[idx].xyz / input_normals[idx].w), float3(exp, exp, exp)), 0.0f);
-  output_albedo[idx]            = float4(pow(abs(input_albedo[idx].xyz / input_albedo[idx].w), float3(exp, exp, exp)), 0.0f);
+  // Cleared by assignment, multiplying by zero would keep any NaN that made it into the accumulation
+  bool keep_samples = constants.clear_samples != 0;
 
-  input_texture[thread_id.xy] *= constants.clear_samples;
-  input_normals[idx]          *= constants.clear_samples;
-  input_albedo[idx]           *= constants.clear_samples;
+  input_texture[thread_id.xy] = keep_samples ? accumulated : 0.0f;
+  input_normals[idx]          = keep_samples ? input_normals[idx] : 0.0f;
+  input_albedo[idx]           = keep_samples ? input_albedo[idx] : 0.0f;
+  input_variance[idx]         = keep_samples ? input_variance[idx] : 0.0f;
 }
\ No newline at end of file
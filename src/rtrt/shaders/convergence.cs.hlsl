@@ -0,0 +1,110 @@
+#include "raytracing_data.h"
+
+ConstantBuffer<ConvergenceConstantBuffer> constants : register(b0);
+
+RWTexture2D<float4>                   input_texture   : register(u0);
+RWStructuredBuffer<float4>            input_variance  : register(u1);
+RWStructuredBuffer<TileConvergence>   output_tiles    : register(u2);
+RWStructuredBuffer<uint>              output_stats    : register(u3);
+
+groupshared float tile_error[CONVERGENCE_TILE_SIZE * CONVERGENCE_TILE_SIZE];
+groupshared float tile_samples[CONVERGENCE_TILE_SIZE * CONVERGENCE_TILE_SIZE];
+
+//------------------------------------------------------------------------------------------------------
+// Relative standard error of the mean luminance of a single pixel
+float PixelRelativeError(float4 moments)
+{
+  float n = moments.w;
+
+  if (n < 2.0f)
+  {
+    return 1e10f;
+  }
+
+  float mean = moments.x / n;
+  float variance = max(moments.y / n - mean * mean, 0.0f) * (n / (n - 1.0f));
+
+  return sqrt(variance / n) / (mean + 1e-3f);
+}
+
+//------------------------------------------------------------------------------------------------------
+[numthreads(CONVERGENCE_TILE_SIZE, CONVERGENCE_TILE_SIZE, 1)]
+void main(uint3 thread_id : SV_DispatchThreadID, uint3 group_id : SV_GroupID, uint group_index : SV_GroupIndex)
+{
+  uint width, height;
+  input_texture.GetDimensions(width, height);
+
+  float error = 0.0f;
+  float samples = 0.0f;
+
+  if (thread_id.x < width && thread_id.y < height)
+  {
+    float4 moments = input_variance[thread_id.y * width + thread_id.x];
+    error = PixelRelativeError(moments);
+    samples = moments.w;
+  }
+
+  tile_error[group_index] = error;
+  tile_samples[group_index] = samples;
+
+  GroupMemoryBarrierWithGroupSync();
+
+  [unroll]
+  for (uint stride = (CONVERGENCE_TILE_SIZE * CONVERGENCE_TILE_SIZE) / 2; stride > 0; stride >>= 1)
+  {
+    if (group_index < stride)
+    {
+      tile_error[group_index] += tile_error[group_index + stride];
+      tile_samples[group_index] = max(tile_samples[group_index], tile_samples[group_index + stride]);
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+  }
+
+  if (group_index == 0)
+  {
+    // Tiles on the right and bottom edges hang over the image, the pixels outside of it are not part of the mean
+    uint2 tile_origin = group_id.xy * CONVERGENCE_TILE_SIZE;
+    uint2 tile_size = min(uint2(CONVERGENCE_TILE_SIZE, CONVERGENCE_TILE_SIZE), uint2(width, height) - tile_origin);
+    uint valid_pixels = tile_size.x * tile_size.y;
+
+    float mean_error = tile_error[0] / float(valid_pixels);
+    uint max_samples = uint(tile_samples[0]);
+
+    TileConvergence tile;
+    tile.relative_error = mean_error;
+
+    if (max_samples < constants.min_samples)
+    {
+      // Not enough samples to trust the variance estimate yet, sample uniformly
+      tile.samples_per_frame = 1;
+    }
+    else if (mean_error <= constants.error_threshold)
+    {
+      tile.samples_per_frame = 0;
+      InterlockedAdd(output_stats[CONVERGENCE_STATS_CONVERGED_TILES], 1);
+    }
+    else
+    {
+      // Noisier tiles get a larger share of the per-frame sample budget
+      tile.samples_per_frame = clamp(uint(ceil(mean_error / constants.error_threshold)), 1, constants.max_samples_per_frame);
+    }
+
+    // Tiles stop at the sample that rendering freezes or denoises at, however many samples the others took
+    if (constants.sample_limit > 0)
+    {
+      tile.samples_per_frame = min(tile.samples_per_frame, constants.sample_limit > max_samples ? constants.sample_limit - max_samples : 0);
+    }
+
+    output_tiles[group_id.y * constants.convergence_tiles_x + group_id.x] = tile;
+
+    uint previous_low;
+    InterlockedAdd(output_stats[CONVERGENCE_STATS_TILE_SAMPLES_LOW], max_samples, previous_low);
+
+    if (previous_low + max_samples < previous_low)
+    {
+      InterlockedAdd(output_stats[CONVERGENCE_STATS_TILE_SAMPLES_HIGH], 1);
+    }
+    InterlockedMax(output_stats[CONVERGENCE_STATS_MAX_PIXEL_SAMPLES], max_samples);
+  }
+}
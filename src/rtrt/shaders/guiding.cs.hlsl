@@ -0,0 +1,84 @@
+#include "raytracing_data.h"
+
+ConstantBuffer<GuidingConstantBuffer> constants : register(b0);
+
+RWStructuredBuffer<uint>  input_training      : register(u0);
+RWStructuredBuffer<float> output_distribution : register(u1);
+
+// Fraction of every trained histogram that is spread uniformly, so directions that have not been sampled
+// enough yet keep a non-zero probability
+#define GUIDING_UNIFORM_FRACTION 0.1f
+
+// Cells whose fullest bin passes this are halved, which keeps the shape of the histogram and leaves room for
+// the records of long renders
+#define GUIDING_RESCALE_THRESHOLD 0x40000000
+
+//------------------------------------------------------------------------------------------------------
+// Rebuilds the sampling distribution of a single grid cell from its training histogram
+[numthreads(64, 1, 1)]
+void main(uint3 thread_id : SV_DispatchThreadID)
+{
+  uint cell = thread_id.x;
+
+  if (cell >= GUIDING_NUM_CELLS)
+  {
+    return;
+  }
+
+  uint first = cell * GUIDING_DIRECTIONAL_BINS;
+  uint i;
+
+  if (constants.clear_training != 0)
+  {
+    for (i = 0; i < GUIDING_DIRECTIONAL_BINS; i++)
+    {
+      input_training[first + i] = 0;
+      output_distribution[first + i] = 0.0f;
+    }
+
+    return;
+  }
+
+  uint fullest = 0;
+
+  for (i = 0; i < GUIDING_DIRECTIONAL_BINS; i++)
+  {
+    fullest = max(fullest, input_training[first + i]);
+  }
+
+  if (fullest >= GUIDING_RESCALE_THRESHOLD)
+  {
+    for (i = 0; i < GUIDING_DIRECTIONAL_BINS; i++)
+    {
+      input_training[first + i] = input_training[first + i] >> 1;
+    }
+  }
+
+  float total = 0.0f;
+
+  for (i = 0; i < GUIDING_DIRECTIONAL_BINS; i++)
+  {
+    total += float(input_training[first + i]);
+  }
+
+  // Untrained cells fall back to BSDF sampling, an all zero CDF marks them
+  if (total <= 0.0f)
+  {
+    for (i = 0; i < GUIDING_DIRECTIONAL_BINS; i++)
+    {
+      output_distribution[first + i] = 0.0f;
+    }
+
+    return;
+  }
+
+  float cdf = 0.0f;
+
+  for (i = 0; i < GUIDING_DIRECTIONAL_BINS; i++)
+  {
+    cdf += (1.0f - GUIDING_UNIFORM_FRACTION) * float(input_training[first + i]) / total + GUIDING_UNIFORM_FRACTION / GUIDING_DIRECTIONAL_BINS;
+    output_distribution[first + i] = cdf;
+  }
+
+  output_distribution[first + GUIDING_DIRECTIONAL_BINS - 1] = 1.0f;
+}
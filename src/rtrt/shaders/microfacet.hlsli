@@ -0,0 +1,119 @@
+#ifndef MICROFACET_HLSL
+#define MICROFACET_HLSL
+
+#include "util.hlsli"
+
+// GGX (Trowbridge-Reitz) microfacet reflection with separable Smith masking.
+// All functions with a "local" direction work in a tangent frame where the shading normal is +Z.
+
+// Below this alpha the lobe is treated as a perfect mirror, the distribution would be numerically unstable
+#define GGX_MIN_ALPHA 0.001f
+
+//------------------------------------------------------------------------------------------------------
+inline float GGXRoughnessToAlpha(in float roughness)
+{
+  float clamped = saturate(roughness);
+  return clamped * clamped;
+}
+
+//------------------------------------------------------------------------------------------------------
+inline float3 FresnelSchlick(in float3 f0, in float cosine)
+{
+  return f0 + (1.0f - f0) * pow(1.0f - saturate(cosine), 5.0f);
+}
+
+//------------------------------------------------------------------------------------------------------
+inline float GGXDistribution(in float3 local_half, in float alpha)
+{
+  float a2 = alpha * alpha;
+  float d = local_half.z * local_half.z * (a2 - 1.0f) + 1.0f;
+
+  return a2 / (3.14159265f * d * d);
+}
+
+//------------------------------------------------------------------------------------------------------
+// Smith masking for a single direction
+inline float GGXSmithG1(in float3 local_direction, in float alpha)
+{
+  float cos2 = local_direction.z * local_direction.z;
+  float tan2 = max(1.0f - cos2, 0.0f) / max(cos2, 1e-8f);
+
+  return 2.0f / (1.0f + sqrt(1.0f + alpha * alpha * tan2));
+}
+
+//------------------------------------------------------------------------------------------------------
+// Samples a microfacet normal from the distribution of normals visible from local_view (Heitz 2018)
+inline float3 SampleGGXVNDF(in float3 local_view, in float alpha, in float2 random)
+{
+  // Stretch the view direction to the hemisphere configuration
+  float3 vh = normalize(float3(alpha * local_view.x, alpha * local_view.y, local_view.z));
+
+  // Orthonormal basis around the stretched view direction
+  float length_sq = vh.x * vh.x + vh.y * vh.y;
+  float3 t1 = length_sq > 0.0f ? float3(-vh.y, vh.x, 0.0f) * rsqrt(length_sq) : float3(1.0f, 0.0f, 0.0f);
+  float3 t2 = cross(vh, t1);
+
+  // Uniformly sample the projected area of the visible hemisphere
+  float r = sqrt(random.x);
+  float phi = 2.0f * 3.14159265f * random.y;
+  float p1 = r * cos(phi);
+  float p2 = r * sin(phi);
+  float s = 0.5f * (1.0f + vh.z);
+  p2 = (1.0f - s) * sqrt(1.0f - p1 * p1) + s * p2;
+
+  // Reproject onto the hemisphere and unstretch
+  float3 nh = p1 * t1 + p2 * t2 + sqrt(max(0.0f, 1.0f - p1 * p1 - p2 * p2)) * vh;
+  return normalize(float3(alpha * nh.x, alpha * nh.y, max(0.0f, nh.z)));
+}
+
+//------------------------------------------------------------------------------------------------------
+// Solid angle density of reflecting local_view into local_light with a VNDF-sampled half vector
+inline float GGXReflectionPdf(in float3 local_view, in float3 local_light, in float alpha)
+{
+  float3 local_half = normalize(local_view + local_light);
+  return GGXSmithG1(local_view, alpha) * GGXDistribution(local_half, alpha) / (4.0f * max(local_view.z, 1e-8f));
+}
+
+//------------------------------------------------------------------------------------------------------
+// Samples a reflected direction for a ray travelling along incoming_direction and returns the sample
+// weight (BRDF * cosine / pdf). With VNDF sampling all terms but fresnel and the masking of the
+// outgoing direction cancel, so the weight never exceeds the fresnel reflectance.
+inline bool SampleGGXReflection(in float3 incoming_direction, in float3 normal, in float alpha, in float3 f0, in float2 random, out float3 direction, out float3 weight)
+{
+  float3 bitangent = normalize(GetPerpendicularVector(normal));
+  float3 tangent = cross(bitangent, normal);
+
+  float3 view = -incoming_direction;
+  float3 local_view = float3(dot(view, tangent), dot(view, bitangent), dot(view, normal));
+
+  direction = float3(0.0f, 0.0f, 0.0f);
+  weight = float3(0.0f, 0.0f, 0.0f);
+
+  if (local_view.z <= 0.0f)
+  {
+    return false;
+  }
+
+  if (alpha < GGX_MIN_ALPHA)
+  {
+    direction = reflect(incoming_direction, normal);
+    weight = FresnelSchlick(f0, local_view.z);
+    return true;
+  }
+
+  float3 local_half = SampleGGXVNDF(local_view, alpha, random);
+  float3 local_light = reflect(-local_view, local_half);
+
+  // Reflections below the geometric surface carry no energy
+  if (local_light.z <= 0.0f)
+  {
+    return false;
+  }
+
+  direction = normalize(local_light.x * tangent + local_light.y * bitangent + local_light.z * normal);
+  weight = FresnelSchlick(f0, dot(local_view, local_half)) * GGXSmithG1(local_light, alpha);
+
+  return true;
+}
+
+#endif // MICROFACET_HLSL
\ No newline at end of file
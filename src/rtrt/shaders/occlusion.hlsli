@@ -0,0 +1,67 @@
+#ifndef OCCLUSION_HLSL
+#define OCCLUSION_HLSL
+
+// Occlusion queries: any intersection terminates traversal and no closest hit shader is invoked, only the
+// miss shader marks the ray as unoccluded. Requires shading_data.hlsli for the acceleration structure.
+// Every pipeline that traces occlusion rays exports OcclusionMiss at the miss index it passes in and an
+// OcclusionHitGroup (any-hit only, for alpha tested geometry) at the hit group index it passes in.
+
+struct OcclusionPayload
+{
+  uint visible;
+};
+
+//------------------------------------------------------------------------------------------------------
+inline bool TraceOcclusionRay(in float3 origin, in float3 direction, in float tmin, in float tmax, in uint occlusion_hit_group_index, in uint occlusion_miss_index)
+{
+  RayDesc ray;
+  ray.Origin = origin;
+  ray.Direction = direction;
+  ray.TMin = tmin;
+  ray.TMax = tmax;
+
+  OcclusionPayload payload;
+  payload.visible = 0;
+
+  TraceRay(
+    scene_as,
+    RAY_FLAG_ACCEPT_FIRST_HIT_AND_END_SEARCH | RAY_FLAG_SKIP_CLOSEST_HIT_SHADER,
+    ~0,
+    occlusion_hit_group_index,
+    0,
+    occlusion_miss_index,
+    ray,
+    payload
+  );
+
+  return payload.visible != 0;
+}
+
+//------------------------------------------------------------------------------------------------------
+// Mutual visibility of two points, the far end is shortened slightly so the target surface does not occlude itself
+inline bool TraceVisibility(in float3 origin, in float3 target, in uint occlusion_hit_group_index, in uint occlusion_miss_index)
+{
+  float3 to_target = target - origin;
+  float distance = length(to_target);
+
+  return TraceOcclusionRay(origin, to_target / distance, 0.001f, distance * 0.999f, occlusion_hit_group_index, occlusion_miss_index);
+}
+
+//------------------------------------------------------------------------------------------------------
+[shader("anyhit")]
+void OcclusionAnyHit(inout OcclusionPayload payload, in TriangleAttributes attr)
+{
+  if (PassesAlphaTest(attr) == false)
+  {
+    IgnoreHit();
+  }
+}
+
+//------------------------------------------------------------------------------------------------------
+[shader("miss")]
+void OcclusionMiss(inout OcclusionPayload payload)
+{
+  payload.visible = 1;
+}
+
+#endif // OCCLUSION_HLSL
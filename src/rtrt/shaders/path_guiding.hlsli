@@ -0,0 +1,141 @@
+#ifndef PATH_GUIDING_HLSL
+#define PATH_GUIDING_HLSL
+
+#include "util.hlsli"
+
+// Online path guiding with spatio-directional histograms (after Mueller et al. 2017, "Practical Path Guiding").
+// Requires shading_data.hlsli for the guiding buffers. guiding_distribution holds the inclusive CDF of the
+// directional bins of every cell, cells without any training data have a CDF of all zeroes.
+
+//------------------------------------------------------------------------------------------------------
+inline uint GuidingCellIndex(in float3 position)
+{
+  float3 extent = max(scene_constants.guiding_bounds_max - scene_constants.guiding_bounds_min, 1e-4f);
+  float3 uvw = saturate((position - scene_constants.guiding_bounds_min) / extent);
+  uint3 cell = min(uint3(uvw * GUIDING_GRID_RESOLUTION), GUIDING_GRID_RESOLUTION - 1);
+
+  return (cell.z * GUIDING_GRID_RESOLUTION + cell.y) * GUIDING_GRID_RESOLUTION + cell.x;
+}
+
+//------------------------------------------------------------------------------------------------------
+// Equal-area cylindrical mapping, every bin covers the same solid angle
+inline float2 GuidingDirectionToSquare(in float3 direction)
+{
+  float phi = atan2(direction.y, direction.x) / (2.0f * 3.14159265f);
+  return float2(saturate(direction.z * 0.5f + 0.5f), phi < 0.0f ? phi + 1.0f : phi);
+}
+
+//------------------------------------------------------------------------------------------------------
+inline float3 GuidingSquareToDirection(in float2 square)
+{
+  float cos_theta = square.x * 2.0f - 1.0f;
+  float sin_theta = sqrt(max(0.0f, 1.0f - cos_theta * cos_theta));
+  float phi = square.y * 2.0f * 3.14159265f;
+
+  return float3(sin_theta * cos(phi), sin_theta * sin(phi), cos_theta);
+}
+
+//------------------------------------------------------------------------------------------------------
+inline uint GuidingDirectionToBin(in float3 direction)
+{
+  uint2 bin = min(uint2(GuidingDirectionToSquare(direction) * GUIDING_DIRECTIONAL_RESOLUTION), GUIDING_DIRECTIONAL_RESOLUTION - 1);
+  return bin.x * GUIDING_DIRECTIONAL_RESOLUTION + bin.y;
+}
+
+//------------------------------------------------------------------------------------------------------
+inline bool IsGuidingCellTrained(in uint cell)
+{
+  return guiding_distribution[cell * GUIDING_DIRECTIONAL_BINS + GUIDING_DIRECTIONAL_BINS - 1] > 0.0f;
+}
+
+//------------------------------------------------------------------------------------------------------
+// Solid angle density of sampling a direction from the histogram of a cell
+inline float GuidingPdf(in uint cell, in float3 direction)
+{
+  uint first = cell * GUIDING_DIRECTIONAL_BINS;
+  uint bin = GuidingDirectionToBin(direction);
+
+  float bin_probability = guiding_distribution[first + bin] - (bin > 0 ? guiding_distribution[first + bin - 1] : 0.0f);
+  return bin_probability * GUIDING_DIRECTIONAL_BINS / (4.0f * 3.14159265f);
+}
+
+//------------------------------------------------------------------------------------------------------
+inline float3 SampleGuiding(in uint cell, in float bin_random, in float2 random)
+{
+  uint first = cell * GUIDING_DIRECTIONAL_BINS;
+  uint bin = GUIDING_DIRECTIONAL_BINS - 1;
+
+  for (uint i = 0; i < GUIDING_DIRECTIONAL_BINS; i++)
+  {
+    if (bin_random < guiding_distribution[first + i])
+    {
+      bin = i;
+      break;
+    }
+  }
+
+  float2 square = (float2(bin / GUIDING_DIRECTIONAL_RESOLUTION, bin % GUIDING_DIRECTIONAL_RESOLUTION) + random) / GUIDING_DIRECTIONAL_RESOLUTION;
+  return GuidingSquareToDirection(square);
+}
+
+//------------------------------------------------------------------------------------------------------
+// One-sample MIS between cosine weighted BSDF sampling and the guiding histogram. Returns the sampled
+// direction, pdf is the density of the mixture so that the estimator stays unbiased for either lobe.
+inline float3 SampleGuidedDiffuse(in float3 position, in float3 normal, in float lobe_random, in float bin_random, in float2 random, out float pdf)
+{
+  float3 direction;
+  uint cell = GuidingCellIndex(position);
+
+  if (scene_constants.guiding_enabled == 0 || IsGuidingCellTrained(cell) == false)
+  {
+    direction = CosineWeightedHemisphereSample(random, normal);
+    pdf = max(dot(direction, normal), 0.0f) / 3.14159265f;
+
+    return direction;
+  }
+
+  float guiding_probability = scene_constants.guiding_probability;
+
+  if (lobe_random < guiding_probability)
+  {
+    direction = SampleGuiding(cell, bin_random, random);
+  }
+  else
+  {
+    direction = CosineWeightedHemisphereSample(random, normal);
+  }
+
+  float bsdf_pdf = max(dot(direction, normal), 0.0f) / 3.14159265f;
+  pdf = guiding_probability * GuidingPdf(cell, direction) + (1.0f - guiding_probability) * bsdf_pdf;
+
+  return direction;
+}
+
+//------------------------------------------------------------------------------------------------------
+// Splats the incident radiance of a completed bounce into the training histogram of its cell. Records are
+// divided by the sampling density, so the histogram estimates incident radiance regardless of the lobe used.
+inline void RecordGuidingSample(in float3 position, in float3 direction, in float3 radiance, in float pdf)
+{
+  if (scene_constants.guiding_training == 0 || pdf <= 0.0f)
+  {
+    return;
+  }
+
+  float record = min(Luminance(radiance) / pdf, GUIDING_MAX_RECORD);
+
+  if (record > 0.0f)
+  {
+    uint index = GuidingCellIndex(position) * GUIDING_DIRECTIONAL_BINS + GuidingDirectionToBin(direction);
+    uint value = uint(record * GUIDING_FIXED_POINT_SCALE);
+    uint previous;
+    InterlockedAdd(guiding_training[index], value, previous);
+
+    // Saturate instead of wrapping around, every add that wraps sets the bin to the maximum again afterwards
+    if (previous + value < previous)
+    {
+      InterlockedMax(guiding_training[index], 0xFFFFFFFF);
+    }
+  }
+}
+
+#endif // PATH_GUIDING_HLSL
@@ -4,12 +4,29 @@
 #include <raytracing_data.h>
 #include "util.hlsli"
 #include "shading_data.hlsli"
+#include "sample_generator.hlsli"
+#include "microfacet.hlsli"
+#include "restir.hlsli"
+#include "path_guiding.hlsli"
+
+// Hit group & miss shader table layout of the pathtracing pipeline
+#define PATHTRACE_OCCLUSION_MISS_INDEX 2
+#define PATHTRACE_OCCLUSION_HIT_GROUP_INDEX 2
+
+// Emission of triangles in the emissive triangle list was already sampled at the previous vertex
+#define PAYLOAD_FLAG_SKIP_LIGHT_EMISSION 1
+
+// The primary hit may be lit by the pixel's spatiotemporal reservoir, only the first sample of a frame is, the
+// others would all repeat its light sample and their direct lighting would not average out
+#define PAYLOAD_FLAG_USE_RESERVOIR 2
 
 struct ColorPayload
 {
   float3 color;
   uint depth;
-  uint seed;
+  SampleGenerator rng;
+  uint flags;
+  RayCone cone;
 };
 
 struct GeometryPayload
@@ -19,11 +36,11 @@ struct GeometryPayload
 };
 
 //------------------------------------------------------------------------------------------------------
-inline void GenerateCameraRay(uint2 index, inout uint seed, out float3 origin, out float3 direction)
+inline void GenerateCameraRay(uint2 index, inout SampleGenerator rng, out float3 origin, out float3 direction)
 {
   float lens_radius = scene_constants.lens_diameter / 2.0f;
 
-  float2 xy = float2(index) + (float2(nextRand(seed) * 2.0f - 1.0f, nextRand(seed) * 2.0f - 1.0f) * scene_constants.aa_enabled);
+  float2 xy = float2(index) + ((NextSample2D(rng) * 2.0f - 1.0f) * scene_constants.aa_enabled);
   float2 screen_pos = xy / float2(DispatchRaysDimensions().xy) * 2.0f - 1.0f;
 
   // Invert Y for DirectX-style coordinates.
@@ -33,12 +50,12 @@ inline void GenerateCameraRay(uint2 index, inout uint seed, out float3 origin, o
   float4 world = mul(float4(screen_pos, 0, 1), scene_constants.projection_to_world);
 
   world.xyz /= world.w;
-  origin = scene_constants.camera_position.xyz + (RandomPointInUnitDisk(seed) * lens_radius);
+  origin = scene_constants.camera_position.xyz + (float3(ConcentricSampleDisk(NextSample2D(rng)), 0.0f) * lens_radius);
   direction = normalize(world.xyz - origin);
 }
 
 //------------------------------------------------------------------------------------------------------
-inline float3 ShootColorRay(float3 origin, float3 direction, float tmin, float tmax, uint seed, uint depth = 0)
+inline float3 ShootColorRay(float3 origin, float3 direction, float tmin, float tmax, RayCone cone, SampleGenerator rng, uint depth = 0, uint flags = 0)
 {
   if (depth <= scene_constants.gi_num_bounces)
   {
@@ -51,7 +68,9 @@ inline float3 ShootColorRay(float3 origin, float3 direction, float tmin, float t
     ColorPayload pay;
     pay.color = float3(0.0f, 0.0f, 0.0f);
     pay.depth = depth;
-    pay.seed = seed;
+    pay.rng = rng;
+    pay.flags = flags;
+    pay.cone = cone;
 
     TraceRay(
       scene_as,
@@ -102,26 +121,101 @@ GeometryPayload ShootGeometryRay(float3 origin, float3 direction, float tmin, fl
 [shader("raygeneration")]
 void PrimaryRaygeneration()
 {
+  uint samples_per_frame = scene_constants.samples_per_frame;
+
+  if (scene_constants.adaptive_enabled)
+  {
+    uint2 tile = DispatchRaysIndex().xy / CONVERGENCE_TILE_SIZE;
+    samples_per_frame = convergence_tiles[tile.y * scene_constants.convergence_tiles_x + tile.x].samples_per_frame;
+
+    // Converged tiles and tiles at the sample limit are skipped entirely
+    if (samples_per_frame == 0)
+    {
+      return;
+    }
+  }
+
+  SampleGenerator rng = CreateSampleGenerator(DispatchRaysIndex().xy);
+  uint idx = DispatchRaysIndex().y * DispatchRaysDimensions().x + DispatchRaysIndex().x;
+
+  // The accumulated sample count doubles as the index into the pixel's sample sequence
+  uint first_sample_index = uint(render_target[DispatchRaysIndex().xy].w);
+
+  for (uint i = 0; i < samples_per_frame; i++)
+  {
+    float3 ray_direction;
+    float3 ray_origin;
+
+    StartSample(rng, first_sample_index + i);
+    GenerateCameraRay(DispatchRaysIndex().xy, rng, ray_origin, ray_direction);
+
+    uint flags = i == 0 ? PAYLOAD_FLAG_USE_RESERVOIR : 0;
+    float3 color = ShootColorRay(ray_origin, ray_direction, 0.001f, 10000.0f, CreateRayCone(0.0f, scene_constants.cone_spread_angle), rng, 0, flags);
+
+    // A single NaN or Inf would poison the pixel until the next clear, such samples are dropped from every plane
+    if (any(isnan(color) || isinf(color)))
+    {
+      continue;
+    }
+
+    GeometryPayload geometry = ShootGeometryRay(ray_origin, ray_direction, 0.001f, 10000.0f);
+
+    float lum = Luminance(color);
+
+    // Radiance is accumulated in HDR, clamping fireflies is an explicit trade of energy for less noise
+    if (scene_constants.firefly_clamp > 0.0f && lum > scene_constants.firefly_clamp)
+    {
+      color *= scene_constants.firefly_clamp / lum;
+      lum = scene_constants.firefly_clamp;
+    }
+
+    render_target[DispatchRaysIndex().xy] += float4(color, 1.0f);
+    normals_target[idx] += float4(geometry.normal, 1.0f);
+    albedo_target[idx] += float4(geometry.albedo, 1.0f);
+    variance_target[idx] += float4(lum, lum * lum, 0.0f, 1.0f);
+  }
+}
+
+//------------------------------------------------------------------------------------------------------
+// Ray throughput benchmark: the same camera rays as the path tracer, traced as occlusion queries
+[shader("raygeneration")]
+void OcclusionBenchmarkRaygeneration()
+{
+  SampleGenerator rng = CreateSampleGenerator(DispatchRaysIndex().xy);
+  StartSample(rng, scene_constants.frame_count);
+
   float3 ray_direction;
   float3 ray_origin;
+  GenerateCameraRay(DispatchRaysIndex().xy, rng, ray_origin, ray_direction);
 
-  uint seed = initRand(DispatchRaysIndex().x * scene_constants.frame_count, DispatchRaysIndex().y * scene_constants.frame_count, 16);
+  TraceOcclusionRay(ray_origin, ray_direction, 0.001f, 10000.0f, PATHTRACE_OCCLUSION_HIT_GROUP_INDEX, PATHTRACE_OCCLUSION_MISS_INDEX);
+}
 
-  GenerateCameraRay(DispatchRaysIndex().xy, seed, ray_origin, ray_direction);
+//------------------------------------------------------------------------------------------------------
+// Ray throughput benchmark: the same camera rays, traced to the closest hit with the cheapest hit group
+[shader("raygeneration")]
+void ClosestHitBenchmarkRaygeneration()
+{
+  SampleGenerator rng = CreateSampleGenerator(DispatchRaysIndex().xy);
+  StartSample(rng, scene_constants.frame_count);
 
-  float3 color = ShootColorRay(ray_origin, ray_direction, 0.001f, 10000.0f, seed, 0);
-  GeometryPayload geometry = ShootGeometryRay(ray_origin, ray_direction, 0.001f, 10000.0f);
+  float3 ray_direction;
+  float3 ray_origin;
+  GenerateCameraRay(DispatchRaysIndex().xy, rng, ray_origin, ray_direction);
 
-  render_target[DispatchRaysIndex().xy] += float4(saturate(color), 1.0f);
-  normals_target[DispatchRaysIndex().y * 1280 + DispatchRaysIndex().x] += float4(geometry.normal, 1.0f);
-  albedo_target[DispatchRaysIndex().y * 1280 + DispatchRaysIndex().x] += float4(geometry.albedo, 1.0f);
+  ShootGeometryRay(ray_origin, ray_direction, 0.001f, 10000.0f);
 }
 
 //------------------------------------------------------------------------------------------------------
 [shader("closesthit")]
 void ColorHit(inout ColorPayload payload, in TriangleAttributes attr)
 {
-  ShadingData hit = GetShadingData(attr);
+  RayCone cone = PropagateRayCone(payload.cone, RayTCurrent());
+  ShadingData hit = GetShadingData(attr, cone.width);
+
+  StartBounce(payload.rng, payload.depth);
+
+  bool emission_sampled = (payload.flags & PAYLOAD_FLAG_SKIP_LIGHT_EMISSION) != 0 && hit.is_light;
 
   payload.color = hit.diffuse;
 
@@ -157,35 +251,107 @@ void ColorHit(inout ColorPayload payload, in TriangleAttributes attr)
       reflect_prob = 1;
     }
     
-    if (nextRand(payload.seed) < reflect_prob)
+    if (NextSample(payload.rng) < reflect_prob)
     {
-      payload.color = ShootColorRay(hit.position, normalize(reflected), 0.001f, scene_constants.gi_bounce_distance, payload.seed, payload.depth + 1);
+      payload.color = ShootColorRay(hit.position, normalize(reflected), 0.001f, scene_constants.gi_bounce_distance, ScatterRayCone(cone, 0.0f), payload.rng, payload.depth + 1);
     }
     else
     {
-      payload.color = ShootColorRay(hit.position, normalize(refracted), 0.001f, scene_constants.gi_bounce_distance, payload.seed, payload.depth + 1);
+      payload.color = ShootColorRay(hit.position, normalize(refracted), 0.001f, scene_constants.gi_bounce_distance, ScatterRayCone(cone, 0.0f), payload.rng, payload.depth + 1);
     }
   }
   else if (hit.shading_model == 8)
   {
-    float3 reflection_direction = reflect(WorldRayDirection(), hit.normal);
+    float3 reflection_direction;
+    float3 weight;
 
-    reflection_direction += RandomPointInUnitSphere(payload.seed) * hit.glossiness;
+    // Back-facing hits use the flipped normal, so the lobe always faces the incoming ray
+    float3 normal = dot(WorldRayDirection(), hit.normal) > 0.0f ? -hit.normal : hit.normal;
 
-    payload.color = ShootColorRay(hit.position, normalize(reflection_direction), 0.001f, scene_constants.gi_bounce_distance, payload.seed, payload.depth + 1);
+    float alpha = GGXRoughnessToAlpha(hit.roughness);
+
+    if (SampleGGXReflection(WorldRayDirection(), normal, alpha, hit.specular, NextSample2D(payload.rng), reflection_direction, weight))
+    {
+      payload.color = weight * ShootColorRay(hit.position, reflection_direction, 0.001f, scene_constants.gi_bounce_distance, ScatterRayCone(cone, alpha), payload.rng, payload.depth + 1);
+    }
+    else
+    {
+      payload.color = float3(0.0f, 0.0f, 0.0f);
+    }
   }
   else if (hit.shading_model == 9) 
   {
-    payload.color = hit.emissive;
+    payload.color = emission_sampled ? float3(0.0f, 0.0f, 0.0f) : hit.emissive;
   }
   else 
   {
-    float3 reflection_direction = CosineWeightedHemisphereSample(payload.seed, hit.normal);
+    float3 direct = float3(0.0f, 0.0f, 0.0f);
+    uint bounce_flags = 0;
+
+    // Direct lighting of primary hits is resampled from the emissive triangles, either by the pixel's reservoir or,
+    // when that was built for another surface or is already used by this frame, from candidates of this hit alone.
+    // Either way all emitters are covered, so the next bounce can skip their emission.
+    if (payload.depth == 0 && scene_constants.restir_enabled != 0 && scene_constants.num_emissive_triangles > 0)
+    {
+      uint idx = DispatchRaysIndex().y * DispatchRaysDimensions().x + DispatchRaysIndex().x;
+      Reservoir reservoir;
+
+      if ((payload.flags & PAYLOAD_FLAG_USE_RESERVOIR) != 0 && IsSameSurface(restir_surfaces[idx], hit.position, hit.normal))
+      {
+        reservoir = restir_history[idx];
+      }
+      else
+      {
+        ReservoirSurface surface;
+        surface.position = hit.position;
+        surface.depth = RayTCurrent();
+        surface.normal = hit.normal;
+        surface.valid = 1;
+        surface.diffuse = hit.diffuse;
+        surface.padding = 0.0f;
+
+        uint seed = initRand(idx, payload.rng.sample_index, 16);
+        reservoir = SampleInitialReservoir(surface, seed);
+      }
+
+      direct = ShadeReservoir(reservoir, hit.position, hit.normal, hit.diffuse, PATHTRACE_OCCLUSION_HIT_GROUP_INDEX, PATHTRACE_OCCLUSION_MISS_INDEX);
+      bounce_flags = PAYLOAD_FLAG_SKIP_LIGHT_EMISSION;
+    }
+
+    // The first two dimensions stay the direction sample, so unguided paths sample exactly as before
+    float2 direction_random = NextSample2D(payload.rng);
+    float lobe_random = NextSample(payload.rng);
+    float bin_random = NextSample(payload.rng);
+
+    float pdf;
+    float3 reflection_direction = SampleGuidedDiffuse(hit.position, hit.normal, lobe_random, bin_random, direction_random, pdf);
+    float cos_theta = dot(reflection_direction, hit.normal);
+
+    payload.color = direct;
 
-    payload.color = hit.diffuse * ShootColorRay(hit.position, reflection_direction, 0.001f, scene_constants.gi_bounce_distance, payload.seed, payload.depth + 1);
+    if (cos_theta > 0.0f && pdf > 0.0f)
+    {
+      float3 incident = ShootColorRay(hit.position, reflection_direction, 0.001f, scene_constants.gi_bounce_distance, ScatterRayCone(cone, 1.0f), payload.rng, payload.depth + 1, bounce_flags);
+      RecordGuidingSample(hit.position, reflection_direction, incident, pdf);
+
+      payload.color += hit.diffuse * incident * (cos_theta / (3.14159265f * pdf));
+    }
   }
 
-  payload.color += hit.emissive;
+  if (emission_sampled == false)
+  {
+    payload.color += hit.emissive;
+  }
+}
+
+//------------------------------------------------------------------------------------------------------
+[shader("anyhit")]
+void ColorAnyHit(inout ColorPayload payload, in TriangleAttributes attr)
+{
+  if (PassesAlphaTest(attr) == false)
+  {
+    IgnoreHit();
+  }
 }
 
 //------------------------------------------------------------------------------------------------------
@@ -217,6 +383,16 @@ void GeometryHit(inout GeometryPayload payload, in TriangleAttributes attr)
   }
 }
 
+//------------------------------------------------------------------------------------------------------
+[shader("anyhit")]
+void GeometryAnyHit(inout GeometryPayload payload, in TriangleAttributes attr)
+{
+  if (PassesAlphaTest(attr) == false)
+  {
+    IgnoreHit();
+  }
+}
+
 //------------------------------------------------------------------------------------------------------
 [shader("miss")]
 void GeometryMiss(inout GeometryPayload payload)
@@ -16,7 +16,7 @@ inline void GenerateCameraRay(uint2 index, out float3 origin, out float3 directi
   float lens_radius = scene_constants.lens_diameter / 2.0f;
 
   float2 xy = float2(index);
-  float2 screen_pos = xy / float2(1280.0f, 720.0f) * 2.0f - 1.0f;
+  float2 screen_pos = xy / float2(scene_constants.render_width, scene_constants.render_height) * 2.0f - 1.0f;
 
   // Invert Y for DirectX-style coordinates.
   screen_pos.y = -screen_pos.y;
@@ -73,6 +73,16 @@ void PickingHit(inout PickingPayload payload, in TriangleAttributes attr)
   payload.material_index = scene_meshes[InstanceID()].material;
 }
 
+//------------------------------------------------------------------------------------------------------
+[shader("anyhit")]
+void PickingAnyHit(inout PickingPayload payload, in TriangleAttributes attr)
+{
+  if (PassesAlphaTest(attr) == false)
+  {
+    IgnoreHit();
+  }
+}
+
 //------------------------------------------------------------------------------------------------------
 [shader("miss")]
 void PickingMiss(inout PickingPayload payload)
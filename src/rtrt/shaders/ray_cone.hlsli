@@ -0,0 +1,70 @@
+#ifndef RAY_CONE_HLSL
+#define RAY_CONE_HLSL
+
+// Ray cone texture level of detail (Akenine-Moller et al. 2019, "Texture Level of Detail Strategies for Real-Time
+// Ray Tracing"). Every ray carries the width of its footprint at its origin and the angle at which that footprint
+// grows, the mip level at a hit follows from the footprint there and the texel density of the hit triangle.
+
+// Widening of the spread angle per unit of GGX alpha at a bounce. The paper only handles mirror reflections,
+// rough lobes blur the incoming radiance far more than the coarser mip does.
+#define RAY_CONE_ROUGH_SPREAD 0.25f
+
+struct RayCone
+{
+  float width;
+  float spread_angle;
+};
+
+//------------------------------------------------------------------------------------------------------
+inline RayCone CreateRayCone(in float width, in float spread_angle)
+{
+  RayCone cone;
+  cone.width = width;
+  cone.spread_angle = spread_angle;
+
+  return cone;
+}
+
+//------------------------------------------------------------------------------------------------------
+// The footprint of the cone after travelling distance along the ray
+inline RayCone PropagateRayCone(in RayCone cone, in float distance)
+{
+  return CreateRayCone(cone.width + cone.spread_angle * distance, cone.spread_angle);
+}
+
+//------------------------------------------------------------------------------------------------------
+// The cone leaving a surface, alpha is the GGX alpha of the sampled lobe: 0 for mirrors and glass, 1 for diffuse.
+// Surface curvature is not accounted for.
+inline RayCone ScatterRayCone(in RayCone cone, in float alpha)
+{
+  return CreateRayCone(cone.width, cone.spread_angle + alpha * RAY_CONE_ROUGH_SPREAD);
+}
+
+//------------------------------------------------------------------------------------------------------
+// The texture independent part of the mip level: half the log of the texel to world area ratio of the triangle,
+// plus the log of the footprint width projected onto the triangle
+inline float RayConeLodBase(in float3 p0, in float3 p1, in float3 p2, in float2 uv0, in float2 uv1, in float2 uv2, in float3 direction, in float cone_width)
+{
+  float3 world_cross = cross(p1 - p0, p2 - p0);
+  float world_area = length(world_cross);
+
+  float2 uv10 = uv1 - uv0;
+  float2 uv20 = uv2 - uv0;
+  float uv_area = abs(uv10.x * uv20.y - uv20.x * uv10.y);
+
+  float cos_theta = world_area > 0.0f ? abs(dot(direction, world_cross / world_area)) : 1.0f;
+
+  return 0.5f * log2(max(uv_area, 1e-20f) / max(world_area, 1e-20f)) + log2(max(abs(cone_width), 1e-20f) / max(cos_theta, 1e-4f));
+}
+
+//------------------------------------------------------------------------------------------------------
+// The mip level of a specific texture, lod_base comes from RayConeLodBase
+inline float RayConeTextureLod(in Texture2D tex, in float lod_base)
+{
+  uint width, height, levels;
+  tex.GetDimensions(0, width, height, levels);
+
+  return max(lod_base + 0.5f * log2(float(width * height)), 0.0f);
+}
+
+#endif // RAY_CONE_HLSL
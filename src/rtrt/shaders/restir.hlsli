@@ -0,0 +1,149 @@
+#ifndef RESTIR_HLSL
+#define RESTIR_HLSL
+
+#include <reservoir.h>
+#include "util.hlsli"
+#include "occlusion.hlsli"
+
+// Spatiotemporal reservoir resampling of direct lighting from emissive triangles (ReSTIR DI, Bitterli et al. 2020)
+// Requires shading_data.hlsli for the scene and reservoir buffers.
+//
+// This is the biased variant: reused reservoirs are combined with 1 / M weights and without MIS, so with temporal or
+// spatial reuse the converged image is slightly off at geometric edges and shadow boundaries. Reservoirs of the
+// initial candidates alone are unbiased, restir_validation.cc checks both against a reference on the CPU.
+
+struct LightSample
+{
+  float3 position;
+  float3 normal;
+  float3 emission;
+  float area_pdf; // Density of picking this point, per unit area
+};
+
+//------------------------------------------------------------------------------------------------------
+// Picks a triangle proportional to its emitted power by searching the cumulative distribution
+inline uint SelectEmissiveTriangle(in float random)
+{
+  uint first = 0;
+  uint last = scene_constants.num_emissive_triangles - 1;
+
+  while (first < last)
+  {
+    uint middle = (first + last) / 2;
+
+    if (scene_emissive_triangles[middle].cdf < random)
+    {
+      first = middle + 1;
+    }
+    else
+    {
+      last = middle;
+    }
+  }
+
+  return first;
+}
+
+//------------------------------------------------------------------------------------------------------
+inline LightSample GetLightSample(in uint light, in float2 barycentrics)
+{
+  EmissiveTriangle tri = scene_emissive_triangles[light];
+
+  LightSample light_sample;
+  light_sample.position = tri.p0 * (1.0f - barycentrics.x - barycentrics.y) + tri.p1 * barycentrics.x + tri.p2 * barycentrics.y;
+  light_sample.normal = normalize(cross(tri.p1 - tri.p0, tri.p2 - tri.p0));
+  light_sample.emission = tri.emission;
+  light_sample.area_pdf = tri.pdf / tri.area;
+
+  return light_sample;
+}
+
+//------------------------------------------------------------------------------------------------------
+// Unshadowed diffuse reflection of a point on an emitter, per unit area of the emitter.
+// Emitters are two-sided, like emissive hits in the path tracer.
+inline float3 EvaluateDirectLighting(in float3 position, in float3 normal, in float3 diffuse, in LightSample light_sample)
+{
+  float3 to_light = light_sample.position - position;
+  float distance_sq = dot(to_light, to_light);
+
+  if (distance_sq <= 0.0f)
+  {
+    return float3(0.0f, 0.0f, 0.0f);
+  }
+
+  float3 direction = to_light * rsqrt(distance_sq);
+  float cos_surface = dot(normal, direction);
+  float cos_light = abs(dot(light_sample.normal, direction));
+
+  if (cos_surface <= 0.0f)
+  {
+    return float3(0.0f, 0.0f, 0.0f);
+  }
+
+  return (diffuse / 3.14159265f) * light_sample.emission * (cos_surface * cos_light / distance_sq);
+}
+
+//------------------------------------------------------------------------------------------------------
+inline float DirectLightingTargetPdf(in ReservoirSurface surface, in LightSample light_sample)
+{
+  return Luminance(EvaluateDirectLighting(surface.position, surface.normal, surface.diffuse, light_sample));
+}
+
+//------------------------------------------------------------------------------------------------------
+// Neighbouring reservoirs are only reused on surfaces with a similar orientation and distance
+inline bool IsSimilarSurface(in ReservoirSurface a, in ReservoirSurface b)
+{
+  return a.valid != 0 && b.valid != 0 && dot(a.normal, b.normal) > 0.9f && abs(a.depth - b.depth) < 0.1f * a.depth;
+}
+
+//------------------------------------------------------------------------------------------------------
+// Whether a reservoir was built for the surface the path tracer hit, the reservoir's primary ray is not jittered
+// and has no depth of field, so at silhouettes and out of focus it can land on another surface
+inline bool IsSameSurface(in ReservoirSurface surface, in float3 position, in float3 normal)
+{
+  float3 offset = surface.position - position;
+  return surface.valid != 0 && dot(surface.normal, normal) > 0.9f && dot(offset, offset) < 0.0025f * surface.depth * surface.depth;
+}
+
+//------------------------------------------------------------------------------------------------------
+// Generates the initial candidates of a pixel with resampled importance sampling
+inline Reservoir SampleInitialReservoir(in ReservoirSurface surface, inout uint seed)
+{
+  Reservoir reservoir = EmptyReservoir();
+
+  for (uint i = 0; i < scene_constants.restir_candidates; i++)
+  {
+    uint light = SelectEmissiveTriangle(nextRand(seed));
+    float2 barycentrics = SampleTriangleBarycentrics(nextRand(seed), nextRand(seed));
+    LightSample light_sample = GetLightSample(light, barycentrics);
+
+    float target_pdf = DirectLightingTargetPdf(surface, light_sample);
+    UpdateReservoir(reservoir, light, barycentrics, target_pdf / light_sample.area_pdf, target_pdf, nextRand(seed));
+  }
+
+  FinalizeReservoir(reservoir);
+
+  return reservoir;
+}
+
+//------------------------------------------------------------------------------------------------------
+// Shades a diffuse point with the sample of a reservoir, this traces the single visibility ray of the pixel
+inline float3 ShadeReservoir(in Reservoir reservoir, in float3 position, in float3 normal, in float3 diffuse, in uint occlusion_hit_group_index, in uint occlusion_miss_index)
+{
+  if (reservoir.contribution_weight <= 0.0f || reservoir.light >= scene_constants.num_emissive_triangles)
+  {
+    return float3(0.0f, 0.0f, 0.0f);
+  }
+
+  LightSample light_sample = GetLightSample(reservoir.light, reservoir.barycentrics);
+  float3 direct = EvaluateDirectLighting(position, normal, diffuse, light_sample);
+
+  if (any(direct > 0.0f) && TraceVisibility(position, light_sample.position, occlusion_hit_group_index, occlusion_miss_index))
+  {
+    return direct * reservoir.contribution_weight;
+  }
+
+  return float3(0.0f, 0.0f, 0.0f);
+}
+
+#endif // RESTIR_HLSL
\ No newline at end of file
@@ -0,0 +1,175 @@
+#ifndef RESTIR_RT_HLSL
+#define RESTIR_RT_HLSL
+
+#include <raytracing_data.h>
+#include "util.hlsli"
+#include "shading_data.hlsli"
+#include "restir.hlsli"
+
+// Hit group & miss shader table layout of the ReSTIR pipeline
+#define RESTIR_SURFACE_MISS_INDEX 0
+#define RESTIR_OCCLUSION_MISS_INDEX 1
+#define RESTIR_OCCLUSION_HIT_GROUP_INDEX 1
+
+struct SurfacePayload
+{
+  ReservoirSurface surface;
+};
+
+//------------------------------------------------------------------------------------------------------
+// Traces the primary ray through the center of the path tracer's jitter footprint, which spans a pixel to either side
+// of the pixel's corner, without depth of field. The path tracer only uses the reservoir where its own hit agrees.
+inline ReservoirSurface TracePrimarySurface(uint2 index)
+{
+  float2 screen_pos = float2(index) / float2(DispatchRaysDimensions().xy) * 2.0f - 1.0f;
+  screen_pos.y = -screen_pos.y;
+
+  float4 world = mul(float4(screen_pos, 0, 1), scene_constants.projection_to_world);
+  world.xyz /= world.w;
+
+  RayDesc ray;
+  ray.Origin = scene_constants.camera_position.xyz;
+  ray.Direction = normalize(world.xyz - ray.Origin);
+  ray.TMin = 0.001f;
+  ray.TMax = 10000.0f;
+
+  SurfacePayload payload;
+  payload.surface.valid = 0;
+
+  TraceRay(
+    scene_as,
+    RAY_FLAG_NONE,
+    ~0,
+    0,
+    0,
+    RESTIR_SURFACE_MISS_INDEX,
+    ray,
+    payload
+  );
+
+  return payload.surface;
+}
+
+//------------------------------------------------------------------------------------------------------
+// Initial candidates and temporal reuse, writes restir_reservoirs
+[shader("raygeneration")]
+void ReservoirInitialRaygeneration()
+{
+  uint2 pixel = DispatchRaysIndex().xy;
+  uint idx = pixel.y * DispatchRaysDimensions().x + pixel.x;
+  uint seed = initRand(idx, scene_constants.frame_count, 16);
+
+  ReservoirSurface surface = TracePrimarySurface(pixel);
+  ReservoirSurface previous_surface = restir_surfaces[idx];
+  restir_surfaces[idx] = surface;
+
+  Reservoir reservoir = EmptyReservoir();
+
+  if (surface.valid != 0 && scene_constants.num_emissive_triangles > 0)
+  {
+    reservoir = SampleInitialReservoir(surface, seed);
+
+    if (scene_constants.restir_temporal_enabled != 0 && IsSimilarSurface(surface, previous_surface))
+    {
+      Reservoir previous = restir_history[idx];
+
+      // The light list may have been rebuilt since the previous frame
+      if (previous.light < scene_constants.num_emissive_triangles)
+      {
+        // Bound the history so stale samples cannot dominate the new candidates
+        previous.num_samples = min(previous.num_samples, scene_constants.restir_history_limit * max(reservoir.num_samples, 1.0f));
+
+        Reservoir merged = EmptyReservoir();
+        CombineReservoir(merged, reservoir, reservoir.target_pdf, nextRand(seed));
+        CombineReservoir(merged, previous, DirectLightingTargetPdf(surface, GetLightSample(previous.light, previous.barycentrics)), nextRand(seed));
+        FinalizeReservoir(merged);
+
+        reservoir = merged;
+      }
+    }
+  }
+
+  restir_reservoirs[idx] = reservoir;
+}
+
+//------------------------------------------------------------------------------------------------------
+// Spatial reuse from neighbouring pixels, writes restir_history which is shaded by the path tracer and
+// is the temporal history of the next frame
+[shader("raygeneration")]
+void ReservoirSpatialRaygeneration()
+{
+  uint2 pixel = DispatchRaysIndex().xy;
+  uint2 dimensions = DispatchRaysDimensions().xy;
+  uint idx = pixel.y * dimensions.x + pixel.x;
+  uint seed = initRand(idx, scene_constants.frame_count ^ 0x5bd1e995, 16);
+
+  ReservoirSurface surface = restir_surfaces[idx];
+  Reservoir reservoir = restir_reservoirs[idx];
+
+  if (surface.valid != 0 && scene_constants.restir_spatial_samples > 0)
+  {
+    Reservoir merged = EmptyReservoir();
+    CombineReservoir(merged, reservoir, reservoir.target_pdf, nextRand(seed));
+
+    for (uint i = 0; i < scene_constants.restir_spatial_samples; i++)
+    {
+      float2 offset = ConcentricSampleDisk(float2(nextRand(seed), nextRand(seed))) * scene_constants.restir_spatial_radius;
+      int2 neighbor = int2(pixel) + int2(round(offset));
+
+      if (any(neighbor < 0) || any(neighbor >= int2(dimensions)) || all(neighbor == int2(pixel)))
+      {
+        continue;
+      }
+
+      uint neighbor_idx = neighbor.y * dimensions.x + neighbor.x;
+
+      if (IsSimilarSurface(surface, restir_surfaces[neighbor_idx]) == false)
+      {
+        continue;
+      }
+
+      Reservoir neighbor_reservoir = restir_reservoirs[neighbor_idx];
+      CombineReservoir(merged, neighbor_reservoir, DirectLightingTargetPdf(surface, GetLightSample(neighbor_reservoir.light, neighbor_reservoir.barycentrics)), nextRand(seed));
+    }
+
+    FinalizeReservoir(merged);
+    reservoir = merged;
+  }
+
+  restir_history[idx] = reservoir;
+}
+
+//------------------------------------------------------------------------------------------------------
+[shader("closesthit")]
+void ReservoirSurfaceHit(inout SurfacePayload payload, in TriangleAttributes attr)
+{
+  ShadingData hit = GetShadingData(attr);
+
+  payload.surface.position = hit.position;
+  payload.surface.depth = RayTCurrent();
+  payload.surface.normal = hit.normal;
+  payload.surface.diffuse = hit.diffuse;
+  payload.surface.padding = 0.0f;
+
+  // Only diffuse surfaces are lit through reservoirs, specular and emissive ones are left to the path tracer
+  payload.surface.valid = (hit.shading_model != 7 && hit.shading_model != 8 && hit.shading_model != 9) ? 1 : 0;
+}
+
+//------------------------------------------------------------------------------------------------------
+[shader("anyhit")]
+void ReservoirSurfaceAnyHit(inout SurfacePayload payload, in TriangleAttributes attr)
+{
+  if (PassesAlphaTest(attr) == false)
+  {
+    IgnoreHit();
+  }
+}
+
+//------------------------------------------------------------------------------------------------------
+[shader("miss")]
+void ReservoirSurfaceMiss(inout SurfacePayload payload)
+{
+  payload.surface.valid = 0;
+}
+
+#endif // RESTIR_RT_HLSL
\ No newline at end of file
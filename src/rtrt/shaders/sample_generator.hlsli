@@ -0,0 +1,90 @@
+#ifndef SAMPLE_GENERATOR_HLSL
+#define SAMPLE_GENERATOR_HLSL
+
+#include <sampling.h>
+
+// Sample dimensions consumed by the camera (pixel jitter & lens) and by every bounce of a path
+#define SAMPLE_DIMENSION_CAMERA 0
+#define SAMPLE_DIMENSION_FIRST_BOUNCE 4
+#define SAMPLE_DIMENSIONS_PER_BOUNCE 8
+
+struct SampleGenerator
+{
+  uint seed;
+  uint sample_index;
+  uint dimension;
+};
+
+//------------------------------------------------------------------------------------------------------
+inline SampleGenerator CreateSampleGenerator(uint2 pixel)
+{
+  SampleGenerator rng;
+  rng.seed = initRand(pixel.x * scene_constants.frame_count, pixel.y * scene_constants.frame_count, 16);
+  rng.sample_index = 0;
+  rng.dimension = 0;
+
+  return rng;
+}
+
+//------------------------------------------------------------------------------------------------------
+inline void StartSample(inout SampleGenerator rng, uint sample_index)
+{
+  rng.sample_index = sample_index;
+  rng.dimension = SAMPLE_DIMENSION_CAMERA;
+}
+
+//------------------------------------------------------------------------------------------------------
+inline void StartBounce(inout SampleGenerator rng, uint depth)
+{
+  rng.dimension = SAMPLE_DIMENSION_FIRST_BOUNCE + depth * SAMPLE_DIMENSIONS_PER_BOUNCE;
+}
+
+//------------------------------------------------------------------------------------------------------
+// Every channel of every slice is an independent blue-noise mask, dimensions beyond those shift the tile
+inline float BlueNoiseOffset(uint2 pixel, uint dimension)
+{
+  uint slice = (dimension / 4) % BLUE_NOISE_SLICES;
+  uint tile_shift = dimension / (4 * BLUE_NOISE_SLICES);
+  uint2 texel = (pixel + uint2(tile_shift * 17, tile_shift * 29)) % BLUE_NOISE_SIZE;
+
+  float4 offsets = blue_noise_textures[NonUniformResourceIndex(slice)].Load(int3(texel, 0));
+  return offsets[dimension % 4];
+}
+
+//------------------------------------------------------------------------------------------------------
+inline float NextSample(inout SampleGenerator rng)
+{
+  if (scene_constants.sampler_type == SAMPLER_TYPE_LCG)
+  {
+    return nextRand(rng.seed);
+  }
+
+  if (scene_constants.sampler_type == SAMPLER_TYPE_BLUE_NOISE)
+  {
+    // All pixels share one sequence and only differ by their blue-noise rotation, so neighbouring pixels
+    // get well distributed samples and the error is pushed to high frequencies
+    float shared_value = LowDiscrepancySample(SAMPLER_TYPE_BLUE_NOISE, 0, rng.sample_index, rng.dimension);
+    float offset = BlueNoiseOffset(DispatchRaysIndex().xy, rng.dimension);
+    rng.dimension++;
+
+    return CranleyPattersonRotation(shared_value, offset);
+  }
+
+  uint pixel_seed = SamplingPixelSeed(DispatchRaysIndex().x, DispatchRaysIndex().y);
+  float value = LowDiscrepancySample(scene_constants.sampler_type, pixel_seed, rng.sample_index, rng.dimension);
+  rng.dimension++;
+
+  return value;
+}
+
+//------------------------------------------------------------------------------------------------------
+inline float2 NextSample2D(inout SampleGenerator rng)
+{
+  float2 value;
+  value.x = NextSample(rng);
+  value.y = NextSample(rng);
+
+  return value;
+}
+
+#endif // SAMPLE_GENERATOR_HLSL
\ No newline at end of file
@@ -1,12 +1,22 @@
 #ifndef SHADINGDATA_HLSL
 #define SHADINGDATA_HLSL
 
+#include "ray_cone.hlsli"
+
 ConstantBuffer<SceneConstantBuffer> scene_constants : register(HLSL_REGISTER_CONSTANTS);
 
 RWTexture2D<float4> render_target : register(HLSL_REGISTER_OUTPUT);
 RWStructuredBuffer<float4> normals_target : register(HLSL_REGISTER_NORMALS);
 RWStructuredBuffer<float4> albedo_target : register(HLSL_REGISTER_ALBEDO);
 RWStructuredBuffer<int> picking_buffer : register(HLSL_REGISTER_PICKING_BUFFER);
+RWStructuredBuffer<float4> variance_target : register(HLSL_REGISTER_VARIANCE);
+RWStructuredBuffer<TileConvergence> convergence_tiles : register(HLSL_REGISTER_CONVERGENCE);
+RWStructuredBuffer<Reservoir> restir_reservoirs : register(HLSL_REGISTER_RESERVOIRS);
+RWStructuredBuffer<Reservoir> restir_history : register(HLSL_REGISTER_RESERVOIR_HISTORY);
+RWStructuredBuffer<ReservoirSurface> restir_surfaces : register(HLSL_REGISTER_RESERVOIR_SURFACES);
+RWStructuredBuffer<uint> guiding_training : register(HLSL_REGISTER_GUIDING_TRAINING);
+RWStructuredBuffer<float> guiding_distribution : register(HLSL_REGISTER_GUIDING_DISTRIBUTION);
+RWStructuredBuffer<TextureFeedback> texture_feedback : register(HLSL_REGISTER_TEXTURE_FEEDBACK);
 
 RaytracingAccelerationStructure scene_as : register(HLSL_REGISTER_ACCELERATION_STRUCT);
 StructuredBuffer<Mesh> scene_meshes : register(HLSL_REGISTER_MESHES);
@@ -15,6 +25,10 @@ StructuredBuffer<uint> scene_indices : register(HLSL_REGISTER_INDICES);
 StructuredBuffer<Material> scene_materials : register(HLSL_REGISTER_MATERIALS);
 Texture2D<float4> scene_textures[] : register(HLSL_REGISTER_TEXTURES);
 StructuredBuffer<Light> scene_lights : register(HLSL_REGISTER_LIGHTS);
+Texture2D<float4> blue_noise_textures[BLUE_NOISE_SLICES] : register(HLSL_REGISTER_BLUE_NOISE);
+StructuredBuffer<EmissiveTriangle> scene_emissive_triangles : register(HLSL_REGISTER_EMISSIVE_TRIANGLES);
+StructuredBuffer<OpacityMask> scene_opacity_masks : register(HLSL_REGISTER_OPACITY_MASKS);
+StructuredBuffer<uint> scene_opacity_mask_bits : register(HLSL_REGISTER_OPACITY_MASK_BITS);
 
 SamplerState scene_sampler : register(HLSL_REGISTER_SAMPLER);
 
@@ -74,6 +88,31 @@ InterpolatedVertex CalculateInterpolatedVertex(in Vertex v[3], in float2 barycen
   return vertex;
 }
 
+// Alpha test of the current hit against the 1-bit opacity mask of its material. Any-hit shaders only run for
+// geometry that was built without the opaque flag, which is exactly the geometry with an opacity mask.
+inline bool PassesAlphaTest(in TriangleAttributes attr)
+{
+  Material material = scene_materials[scene_meshes[InstanceID()].material];
+
+  if (material.opacity_mask == MATERIAL_NO_TEXTURE_INDEX)
+  {
+    return true;
+  }
+
+  OpacityMask mask = scene_opacity_masks[material.opacity_mask];
+
+  uint3 indices = GetIndices();
+  float3 bary_factors = CalculateBarycentricalInterpolationFactors(attr.barycentrics);
+  float2 uv = BarycentricInterpolation(scene_vertices[indices.x].uv, scene_vertices[indices.y].uv, scene_vertices[indices.z].uv, bary_factors);
+
+  // Wrap addressing, like scene_sampler
+  uint2 size = uint2(mask.width, mask.height);
+  uint2 texel = min(uint2(frac(uv) * float2(size)), size - 1);
+  uint index = texel.y * mask.width + texel.x;
+
+  return ((scene_opacity_mask_bits[mask.first_word + index / 32] >> (index % 32)) & 1) != 0;
+}
+
 struct ShadingData
 {
   uint shading_model;
@@ -81,16 +120,49 @@ struct ShadingData
   float3 normal;
   float3 diffuse;
   float3 emissive;
+  float3 specular;
   float index_of_refraction;
-  float glossiness;
+  float roughness;
+  bool is_light;
 };
 
-inline float4 SampleTexture(in SamplerState samplr, in Texture2D tex, in float2 uv)
+// Materials whose triangles are in the emissive triangle list, keep in sync with LightListUtility
+inline bool IsEmissiveTriangleMaterial(in Material material)
 {
-  return tex.SampleLevel(samplr, uv, 0, 0);
+  return material.emissive_map == MATERIAL_NO_TEXTURE_INDEX && any(material.color_emissive.xyz > 0.0f);
 }
 
-inline ShadingData GetShadingData(TriangleAttributes attr)
+// Tells the texture streamer which mip of a texture was wanted, see TextureFeedback
+inline void RecordTextureFeedback(in uint texture_index, in Texture2D tex, in float lod_base)
+{
+  if (any(DispatchRaysIndex().xy % TEXTURE_FEEDBACK_PIXEL_STRIDE != 0))
+  {
+    return;
+  }
+
+  uint width, height, levels;
+  tex.GetDimensions(0, width, height, levels);
+
+  // Unclamped, a negative level asks for more detail than is resident. Without ray cones the top mip is always wanted.
+  float lod = scene_constants.texture_lod_enabled != 0 ? lod_base + 0.5f * log2(float(width * height)) + scene_constants.texture_lod_bias : -TEXTURE_FEEDBACK_LOD_OFFSET;
+  uint encoded_lod = uint(clamp(lod + TEXTURE_FEEDBACK_LOD_OFFSET, 0.0f, 2.0f * TEXTURE_FEEDBACK_LOD_OFFSET) * TEXTURE_FEEDBACK_LOD_SCALE);
+
+  InterlockedMin(texture_feedback[texture_index].min_lod, encoded_lod);
+  InterlockedAdd(texture_feedback[texture_index].samples, 1);
+}
+
+// lod_base is the texture independent part of the ray cone mip level, see RayConeLodBase
+inline float4 SampleTexture(in SamplerState samplr, in uint texture_index, in float2 uv, in float lod_base)
+{
+  Texture2D tex = scene_textures[texture_index];
+  RecordTextureFeedback(texture_index, tex, lod_base);
+
+  float lod = scene_constants.texture_lod_enabled != 0 ? RayConeTextureLod(tex, lod_base) + scene_constants.texture_lod_bias : 0.0f;
+  return tex.SampleLevel(samplr, uv, max(lod, 0.0f), 0);
+}
+
+// cone_width is the width of the ray cone's footprint at the hit
+inline ShadingData GetShadingData(TriangleAttributes attr, float cone_width)
 {
   ShadingData data;
 
@@ -98,15 +170,30 @@ inline ShadingData GetShadingData(TriangleAttributes attr)
   InterpolatedVertex vertex = CalculateInterpolatedVertex(tri.vertices, attr.barycentrics);
   Material material = scene_materials[scene_meshes[InstanceID()].material];
 
+  float lod_base = RayConeLodBase(
+    tri.vertices[0].position, tri.vertices[1].position, tri.vertices[2].position,
+    tri.vertices[0].uv, tri.vertices[1].uv, tri.vertices[2].uv,
+    WorldRayDirection(), cone_width);
+
   data.shading_model = material.shading_model;
   data.position = WorldRayOrigin() + (WorldRayDirection() * RayTCurrent());
   data.normal = normalize(vertex.normal);
-  data.diffuse = material.diffuse_map != MATERIAL_NO_TEXTURE_INDEX ? SampleTexture(scene_sampler, scene_textures[material.diffuse_map], vertex.uv).xyz : material.color_diffuse.xyz;
-  data.emissive = material.emissive_map != MATERIAL_NO_TEXTURE_INDEX ? SampleTexture(scene_sampler, scene_textures[material.emissive_map], vertex.uv).xyz : material.color_emissive.xyz;
+  data.diffuse = material.diffuse_map != MATERIAL_NO_TEXTURE_INDEX ? SampleTexture(scene_sampler, material.diffuse_map, vertex.uv, lod_base).xyz : material.color_diffuse.xyz;
+  data.emissive = material.emissive_map != MATERIAL_NO_TEXTURE_INDEX ? SampleTexture(scene_sampler, material.emissive_map, vertex.uv, lod_base).xyz : material.color_emissive.xyz;
   data.index_of_refraction = material.index_of_refraction;
-  data.glossiness = material.glossiness;
+  data.roughness = material.glossiness;
+  data.is_light = IsEmissiveTriangleMaterial(material);
+
+  // Materials without a specular color reflect like the old untinted mirror did
+  data.specular = any(material.color_specular.xyz > 0.0f) ? material.color_specular.xyz : float3(1.0f, 1.0f, 1.0f);
 
   return data;
 }
 
+// Primary hits: the camera cone starts as a point at the eye
+inline ShadingData GetShadingData(TriangleAttributes attr)
+{
+  return GetShadingData(attr, scene_constants.cone_spread_angle * RayTCurrent());
+}
+
 #endif // SHADINGDATA_HLSL
\ No newline at end of file
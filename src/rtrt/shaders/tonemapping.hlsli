@@ -0,0 +1,60 @@
+#ifndef TONEMAPPING_HLSL
+#define TONEMAPPING_HLSL
+
+#include <raytracing_data.h>
+
+// Every curve maps exposed linear radiance to linear display values in [0, 1], gamma is applied afterwards.
+// tonemapping.cc evaluates the exact same curves on the CPU, for denoised images and the resolve benchmark.
+
+//------------------------------------------------------------------------------------------------------
+inline float3 TonemapReinhard(in float3 x)
+{
+  return x / (1.0f + x);
+}
+
+//------------------------------------------------------------------------------------------------------
+// John Hable's filmic curve from Uncharted 2, normalized so that a linear white of 11.2 maps to 1
+inline float3 HableCurve(in float3 x)
+{
+  const float a = 0.15f;
+  const float b = 0.50f;
+  const float c = 0.10f;
+  const float d = 0.20f;
+  const float e = 0.02f;
+  const float f = 0.30f;
+
+  return ((x * (a * x + c * b) + d * e) / (x * (a * x + b) + d * f)) - e / f;
+}
+
+//------------------------------------------------------------------------------------------------------
+inline float3 TonemapFilmic(in float3 x)
+{
+  return saturate(HableCurve(x * 2.0f) / HableCurve(11.2f));
+}
+
+//------------------------------------------------------------------------------------------------------
+// Krzysztof Narkowicz's fit of the ACES reference rendering and output transforms
+inline float3 TonemapACES(in float3 x)
+{
+  return saturate((x * (2.51f * x + 0.03f)) / (x * (2.43f * x + 0.59f) + 0.14f));
+}
+
+//------------------------------------------------------------------------------------------------------
+inline float3 Tonemap(in float3 radiance, in float exposure, in uint tonemapper)
+{
+  float3 x = max(radiance, 0.0f) * exp2(exposure);
+
+  switch (tonemapper)
+  {
+  case TONEMAPPER_REINHARD:
+    return TonemapReinhard(x);
+  case TONEMAPPER_FILMIC:
+    return TonemapFilmic(x);
+  case TONEMAPPER_ACES:
+    return TonemapACES(x);
+  default:
+    return saturate(x);
+  }
+}
+
+#endif // TONEMAPPING_HLSL
\ No newline at end of file
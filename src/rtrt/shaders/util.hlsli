@@ -41,18 +41,78 @@ float3 GetPerpendicularVector(float3 u)
   return cross(u, float3(xm, ym, zm));
 }
 
+//
+// Closed-form sample warps, every warp consumes a fixed number of sample dimensions
 //------------------------------------------------------------------------------------------------------
-// From: http://intro-to-dxr.cwyman.org/
-float3 CosineWeightedHemisphereSample(inout uint seed, float3 normal)
+// Shirley & Chiu concentric mapping from the unit square to the unit disk, preserves stratification
+float2 ConcentricSampleDisk(float2 random)
 {
-  float2 random = float2(nextRand(seed), nextRand(seed));
+  float2 offset = random * 2.0f - 1.0f;
 
-  float3 bitangent = GetPerpendicularVector(normal);
-  float3 tangent = cross(bitangent, normal);
-  float r = sqrt(random.x);
+  if (offset.x == 0.0f && offset.y == 0.0f)
+  {
+    return float2(0.0f, 0.0f);
+  }
+
+  float r, theta;
+
+  if (abs(offset.x) > abs(offset.y))
+  {
+    r = offset.x;
+    theta = (3.14159265f / 4.0f) * (offset.y / offset.x);
+  }
+  else
+  {
+    r = offset.y;
+    theta = (3.14159265f / 2.0f) - (3.14159265f / 4.0f) * (offset.x / offset.y);
+  }
+
+  return r * float2(cos(theta), sin(theta));
+}
+
+//------------------------------------------------------------------------------------------------------
+float3 UniformSampleSphere(float2 random)
+{
+  float z = 1.0f - 2.0f * random.x;
+  float r = sqrt(max(0.0f, 1.0f - z * z));
   float phi = 2.0f * 3.14159265f * random.y;
 
-  return tangent * (r * cos(phi).x) + bitangent * (r * sin(phi)) + normal.xyz * sqrt(1 - random.x);
+  return float3(r * cos(phi), r * sin(phi), z);
+}
+
+//------------------------------------------------------------------------------------------------------
+float3 UniformSampleHemisphere(float2 random, float3 normal)
+{
+  float3 bitangent = normalize(GetPerpendicularVector(normal));
+  float3 tangent = cross(bitangent, normal);
+  float3 local = UniformSampleSphere(float2(random.x * 0.5f, random.y));
+
+  return tangent * local.x + bitangent * local.y + normal * local.z;
+}
+
+//------------------------------------------------------------------------------------------------------
+// Uniform point inside the unit ball: a direction on the sphere scaled by a cube-root distributed radius
+float3 UniformSampleBall(float3 random)
+{
+  return UniformSampleSphere(random.xy) * pow(random.z, 1.0f / 3.0f);
+}
+
+//------------------------------------------------------------------------------------------------------
+// Malley's method: project a concentric disk sample up onto the hemisphere
+float3 CosineWeightedHemisphereSample(float2 random, float3 normal)
+{
+  float3 bitangent = normalize(GetPerpendicularVector(normal));
+  float3 tangent = cross(bitangent, normal);
+  float2 disk = ConcentricSampleDisk(random);
+
+  return tangent * disk.x + bitangent * disk.y + normal * sqrt(max(0.0f, 1.0f - dot(disk, disk)));
+}
+
+//------------------------------------------------------------------------------------------------------
+float3 CosineWeightedHemisphereSample(inout uint seed, float3 normal)
+{
+  float2 random = float2(nextRand(seed), nextRand(seed));
+  return CosineWeightedHemisphereSample(random, normal);
 }
 
 // Calculates barycentrical interpolation factors based on actual barycentrics
@@ -84,27 +144,21 @@ float4 BarycentricInterpolation(in float4 a0, in float4 a1, in float4 a2, in flo
 //------------------------------------------------------------------------------------------------------
 inline float3 RandomPointInUnitDisk(inout uint seed)
 {
-  float3 p = float3(2.0f, 2.0f, 2.0f);
-
-  while (dot(p, p) > 1.0f)
-  {
-    p = float3(nextRand(seed) * 2.0f - 1.0f, nextRand(seed) * 2.0f - 1.0f, 0.0f);
-  }
-
-  return p;
+  float2 random = float2(nextRand(seed), nextRand(seed));
+  return float3(ConcentricSampleDisk(random), 0.0f);
 }
 
 //------------------------------------------------------------------------------------------------------
 inline float3 RandomPointInUnitSphere(inout uint seed)
 {
-  float3 p = float3(2.0f, 2.0f, 2.0f);
-
-  while (length(p) > 1.0f)
-  {
-    p = float3(nextRand(seed) * 2.0f - 1.0f, nextRand(seed) * 2.0f - 1.0f, nextRand(seed) * 2.0f - 1.0f);
-  }
+  float3 random = float3(nextRand(seed), nextRand(seed), nextRand(seed));
+  return UniformSampleBall(random);
+}
 
-  return p;
+//------------------------------------------------------------------------------------------------------
+inline float Luminance(in float3 color)
+{
+  return dot(color, float3(0.2126f, 0.7152f, 0.0722f));
 }
 
 //------------------------------------------------------------------------------------------------------
@@ -18,6 +18,30 @@
 #define CPP_REGISTER_ALBEDO 3
 #define HLSL_REGISTER_ALBEDO u3
 
+#define CPP_REGISTER_VARIANCE 4
+#define HLSL_REGISTER_VARIANCE u4
+
+#define CPP_REGISTER_CONVERGENCE 5
+#define HLSL_REGISTER_CONVERGENCE u5
+
+#define CPP_REGISTER_RESERVOIRS 6
+#define HLSL_REGISTER_RESERVOIRS u6
+
+#define CPP_REGISTER_RESERVOIR_HISTORY 7
+#define HLSL_REGISTER_RESERVOIR_HISTORY u7
+
+#define CPP_REGISTER_RESERVOIR_SURFACES 8
+#define HLSL_REGISTER_RESERVOIR_SURFACES u8
+
+#define CPP_REGISTER_GUIDING_TRAINING 9
+#define HLSL_REGISTER_GUIDING_TRAINING u9
+
+#define CPP_REGISTER_GUIDING_DISTRIBUTION 10
+#define HLSL_REGISTER_GUIDING_DISTRIBUTION u10
+
+#define CPP_REGISTER_TEXTURE_FEEDBACK 11
+#define HLSL_REGISTER_TEXTURE_FEEDBACK u11
+
 // SRV slots
 #define CPP_REGISTER_ACCELERATION_STRUCT 0
 #define HLSL_REGISTER_ACCELERATION_STRUCT t0
@@ -40,6 +64,23 @@
 #define CPP_REGISTER_TEXTURES 6
 #define HLSL_REGISTER_TEXTURES t6
 
+// The texture table above is unbounded, so the blue-noise tiles get a register space of their own
+#define CPP_REGISTER_BLUE_NOISE 0
+#define CPP_SPACE_BLUE_NOISE 1
+#define HLSL_REGISTER_BLUE_NOISE t0, space1
+
+#define CPP_REGISTER_EMISSIVE_TRIANGLES 0
+#define CPP_SPACE_EMISSIVE_TRIANGLES 2
+#define HLSL_REGISTER_EMISSIVE_TRIANGLES t0, space2
+
+#define CPP_SPACE_OPACITY_MASKS 3
+
+#define CPP_REGISTER_OPACITY_MASKS 0
+#define HLSL_REGISTER_OPACITY_MASKS t0, space3
+
+#define CPP_REGISTER_OPACITY_MASK_BITS 1
+#define HLSL_REGISTER_OPACITY_MASK_BITS t1, space3
+
 // Sampler slots
 #define CPP_REGISTER_SAMPLER 0
 #define HLSL_REGISTER_SAMPLER s0
@@ -59,6 +100,43 @@ using namespace DirectX;
 
 #define MATERIAL_NO_TEXTURE_INDEX (0xFFFFFFFF)
 
+// Texels with an opacity below the cutoff are cut out by the alpha test
+#define OPACITY_ALPHA_CUTOFF 0.5f
+
+// Adaptive sampling evaluates convergence per square tile of pixels
+#define CONVERGENCE_TILE_SIZE 8
+
+// The averager resolves square thread groups of pixels, dispatches are rounded up to whole groups
+#define AVERAGER_GROUP_SIZE 8
+
+// Precomputed blue-noise tiles (see src/blue-noise-generator), every channel holds an independent mask
+#define BLUE_NOISE_SIZE 64
+#define BLUE_NOISE_SLICES 8
+
+// Path guiding learns a directional histogram of incident radiance for every cell of a uniform grid
+// over the scene bounds. Directions are binned with an equal-area cylindrical mapping of the sphere.
+#define GUIDING_GRID_RESOLUTION 16
+#define GUIDING_NUM_CELLS (GUIDING_GRID_RESOLUTION * GUIDING_GRID_RESOLUTION * GUIDING_GRID_RESOLUTION)
+#define GUIDING_DIRECTIONAL_RESOLUTION 8
+#define GUIDING_DIRECTIONAL_BINS (GUIDING_DIRECTIONAL_RESOLUTION * GUIDING_DIRECTIONAL_RESOLUTION)
+#define GUIDING_FIXED_POINT_SCALE 64.0f  // Training records are accumulated with integer atomics
+#define GUIDING_MAX_RECORD 1024.0f       // Clamps single records so that fireflies cannot overflow a bin
+
+// Texture streaming feedback: the tracer records the most detailed mip it wanted from every texture it sampled,
+// relative to the resident mip chain and in fixed point so that InterlockedMin can find it
+#define TEXTURE_FEEDBACK_PIXEL_STRIDE 4      // Only one in every 4x4 pixels records feedback
+#define TEXTURE_FEEDBACK_LOD_OFFSET 16.0f
+#define TEXTURE_FEEDBACK_LOD_SCALE 16.0f
+
+#define DEBUG_VIEW_NONE 0
+#define DEBUG_VIEW_CONVERGENCE 1
+
+// Curves the averager maps exposed HDR radiance to display range with, mirrored on the CPU by ToneMappingUtility
+#define TONEMAPPER_NONE 0
+#define TONEMAPPER_REINHARD 1
+#define TONEMAPPER_FILMIC 2
+#define TONEMAPPER_ACES 3
+
 struct Vertex
 {
   XMFLOAT3 position;
@@ -88,6 +166,23 @@ struct Material
   float index_of_refraction;
   UINT shading_model;
   float glossiness;
+  UINT opacity_map;
+  UINT opacity_mask;  // Index into the opacity masks, MATERIAL_NO_TEXTURE_INDEX for opaque materials
+};
+
+// 1-bit alpha test mask, precomputed at load time from an opacity map or the alpha channel of a diffuse map
+struct OpacityMask
+{
+  UINT first_word;  // Offset of the first texel into the packed mask bits, 32 texels per word
+  UINT width;
+  UINT height;
+  UINT padding;
+};
+
+struct TextureFeedback
+{
+  UINT min_lod; // Encoded with TEXTURE_FEEDBACK_LOD_OFFSET and TEXTURE_FEEDBACK_LOD_SCALE
+  UINT samples;
 };
 
 struct SceneConstantBuffer
@@ -110,15 +205,85 @@ struct SceneConstantBuffer
   XMINT2 picking_point;
   // boundary
   XMFLOAT4 sky_color;
+  // boundary
+  UINT adaptive_enabled;
+  UINT convergence_tiles_x;
+  UINT sampler_type;
+  UINT samples_per_frame; // Samples every pixel traces this frame when adaptive sampling is off
+  // boundary
+  UINT restir_enabled;
+  UINT num_emissive_triangles;
+  UINT restir_candidates;
+  UINT restir_spatial_samples;
+  // boundary
+  float restir_spatial_radius;
+  UINT restir_temporal_enabled;
+  UINT restir_history_limit;
+  float restir_padding;
+  // boundary
+  XMFLOAT3 guiding_bounds_min;
+  UINT guiding_enabled;
+  // boundary
+  XMFLOAT3 guiding_bounds_max;
+  UINT guiding_training;
+  // boundary
+  float guiding_probability;
+  float cone_spread_angle;
+  UINT texture_lod_enabled;
+  float texture_lod_bias;
+  // boundary
+  UINT render_width;
+  UINT render_height;
+  float firefly_clamp; // Samples brighter than this luminance are scaled down to it, 0 accumulates them unclamped
+  float resolution_padding;
 };
 
 struct AveragerConstantBuffer
 {
   UINT clear_samples;
   float gamma;
+  UINT debug_view;
+  UINT convergence_tiles_x;
+  // boundary
+  float error_threshold;
+  UINT width;
+  UINT height;
+  UINT resolve_guides; // Resolves only the normals and albedo for the denoiser, leaves the accumulation untouched
+  // boundary
+  float exposure; // In stops, applied before the tonemapper
+  UINT tonemapper;
   XMFLOAT2 padding;
 };
 
+struct ConvergenceConstantBuffer
+{
+  UINT min_samples;
+  UINT max_samples_per_frame;
+  float error_threshold;
+  UINT convergence_tiles_x;
+  UINT sample_limit; // No pixel is given samples beyond this, 0 if there is no limit
+  XMFLOAT3 padding;
+};
+
+struct GuidingConstantBuffer
+{
+  UINT clear_training;
+  XMFLOAT3 padding;
+};
+
+struct TileConvergence
+{
+  float relative_error;
+  UINT samples_per_frame; // 0 means the tile has converged and is not traced anymore
+};
+
+// Layout of the convergence statistics buffer that is read back every frame
+#define CONVERGENCE_STATS_CONVERGED_TILES 0
+#define CONVERGENCE_STATS_TILE_SAMPLES_LOW 1 // The sum of the tile sample counts is 64-bit, it outgrows 32 bits at high resolutions
+#define CONVERGENCE_STATS_TILE_SAMPLES_HIGH 2
+#define CONVERGENCE_STATS_MAX_PIXEL_SAMPLES 3
+#define CONVERGENCE_STATS_COUNT 4
+
 struct Mesh
 {
   UINT first_idx_vertices;
@@ -132,4 +297,46 @@ struct Light
   XMFLOAT3 position;
 };
 
+// World space triangle of an emissive material, lights are picked proportional to their emitted power
+struct EmissiveTriangle
+{
+  XMFLOAT3 p0;
+  float area;
+  // boundary
+  XMFLOAT3 p1;
+  float cdf;          // Inclusive cumulative selection probability
+  // boundary
+  XMFLOAT3 p2;
+  float pdf;          // Selection probability of this triangle
+  // boundary
+  XMFLOAT3 emission;
+  UINT material;
+};
+
+// Weighted reservoir of a single light sample (ReSTIR DI)
+struct Reservoir
+{
+  UINT light;                 // Index into the emissive triangle list
+  XMFLOAT2 barycentrics;      // Sampled point on that triangle
+  float target_pdf;           // Target function of the selected sample at the owning pixel
+  // boundary
+  float weight_sum;
+  float num_samples;          // M, the number of candidates this reservoir has seen
+  float contribution_weight;  // W, the unbiased contribution weight of the selected sample
+  float padding;
+};
+
+// Primary surface a reservoir was built for, used to validate temporal and spatial reuse
+struct ReservoirSurface
+{
+  XMFLOAT3 position;
+  float depth;
+  // boundary
+  XMFLOAT3 normal;
+  UINT valid;
+  // boundary
+  XMFLOAT3 diffuse;
+  float padding;
+};
+
 #endif
\ No newline at end of file
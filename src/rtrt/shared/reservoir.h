@@ -0,0 +1,80 @@
+#ifndef RESERVOIR
+#define RESERVOIR
+
+// Weighted reservoir streaming shared between the ReSTIR shaders and their CPU validation (see restir_validation.h).
+// Only the reservoir bookkeeping lives here, the target function is evaluated by the caller.
+
+#include "raytracing_data.h"
+
+#ifdef __cplusplus
+#define RESERVOIR_FUNC inline
+#define RESERVOIR_INOUT(type) type&
+#else
+#define RESERVOIR_FUNC
+#define RESERVOIR_INOUT(type) inout type
+#endif
+
+//------------------------------------------------------------------------------------------------------
+RESERVOIR_FUNC Reservoir EmptyReservoir()
+{
+  Reservoir reservoir;
+  reservoir.light = 0;
+  reservoir.barycentrics = XMFLOAT2(0.0f, 0.0f);
+  reservoir.target_pdf = 0.0f;
+  reservoir.weight_sum = 0.0f;
+  reservoir.num_samples = 0.0f;
+  reservoir.contribution_weight = 0.0f;
+  reservoir.padding = 0.0f;
+
+  return reservoir;
+}
+
+//------------------------------------------------------------------------------------------------------
+// Weighted reservoir sampling: streams in one candidate and keeps it with probability weight / weight_sum
+RESERVOIR_FUNC bool UpdateReservoir(RESERVOIR_INOUT(Reservoir) reservoir, UINT light, XMFLOAT2 barycentrics, float weight, float target_pdf, float random)
+{
+  reservoir.weight_sum += weight;
+  reservoir.num_samples += 1.0f;
+
+  if (weight > 0.0f && random * reservoir.weight_sum < weight)
+  {
+    reservoir.light = light;
+    reservoir.barycentrics = barycentrics;
+    reservoir.target_pdf = target_pdf;
+    return true;
+  }
+
+  return false;
+}
+
+//------------------------------------------------------------------------------------------------------
+// Merges another reservoir, target_pdf is the target function of its sample evaluated at the merging pixel.
+// Combined reservoirs are weighted by 1 / M, which is only unbiased when every merged reservoir could have
+// produced the selected sample, i.e. on identical surfaces. Reuse across surfaces trades that for less noise.
+RESERVOIR_FUNC bool CombineReservoir(RESERVOIR_INOUT(Reservoir) reservoir, Reservoir other, float target_pdf, float random)
+{
+  float num_samples = reservoir.num_samples;
+  float weight = target_pdf * other.contribution_weight * other.num_samples;
+
+  bool selected = UpdateReservoir(reservoir, other.light, other.barycentrics, weight, target_pdf, random);
+  reservoir.num_samples = num_samples + other.num_samples;
+
+  return selected;
+}
+
+//------------------------------------------------------------------------------------------------------
+RESERVOIR_FUNC void FinalizeReservoir(RESERVOIR_INOUT(Reservoir) reservoir)
+{
+  float denominator = reservoir.num_samples * reservoir.target_pdf;
+  reservoir.contribution_weight = denominator > 0.0f ? reservoir.weight_sum / denominator : 0.0f;
+}
+
+//------------------------------------------------------------------------------------------------------
+// Uniformly distributed barycentrics, in the same convention as the hit attributes
+RESERVOIR_FUNC XMFLOAT2 SampleTriangleBarycentrics(float random_x, float random_y)
+{
+  float su = sqrt(random_x);
+  return XMFLOAT2(random_y * su, 1.0f - su);
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,148 @@
+#ifndef SAMPLING
+#define SAMPLING
+
+// Sample generation shared between C++ and HLSL.
+// Low-discrepancy samples are indexed by a per-pixel seed, the sample index of the pixel and the sample dimension.
+
+#include "raytracing_data.h"
+
+#ifdef __cplusplus
+#define SAMPLING_FUNC inline
+#else
+#define SAMPLING_FUNC
+#endif
+
+#define SAMPLER_TYPE_LCG 0    // TEA-seeded LCG, kept as a fallback
+#define SAMPLER_TYPE_SOBOL 1  // Owen-scrambled Sobol, stratified in groups of 4 dimensions
+#define SAMPLER_TYPE_PMJ02 2  // Shuffled Owen-scrambled Sobol pairs, every 2D pair is a (0,2)-sequence like PMJ02
+#define SAMPLER_TYPE_BLUE_NOISE 3  // PMJ02 pairs shared by all pixels, rotated per pixel by precomputed blue-noise tiles
+#define SAMPLER_TYPE_COUNT 4
+
+// Direction numbers for the first 4 Sobol dimensions (Joe & Kuo)
+static const UINT SOBOL_DIRECTIONS[4 * 32] = {
+  0x80000000u, 0x40000000u, 0x20000000u, 0x10000000u, 0x08000000u, 0x04000000u, 0x02000000u, 0x01000000u,
+  0x00800000u, 0x00400000u, 0x00200000u, 0x00100000u, 0x00080000u, 0x00040000u, 0x00020000u, 0x00010000u,
+  0x00008000u, 0x00004000u, 0x00002000u, 0x00001000u, 0x00000800u, 0x00000400u, 0x00000200u, 0x00000100u,
+  0x00000080u, 0x00000040u, 0x00000020u, 0x00000010u, 0x00000008u, 0x00000004u, 0x00000002u, 0x00000001u,
+
+  0x80000000u, 0xc0000000u, 0xa0000000u, 0xf0000000u, 0x88000000u, 0xcc000000u, 0xaa000000u, 0xff000000u,
+  0x80800000u, 0xc0c00000u, 0xa0a00000u, 0xf0f00000u, 0x88880000u, 0xcccc0000u, 0xaaaa0000u, 0xffff0000u,
+  0x80008000u, 0xc000c000u, 0xa000a000u, 0xf000f000u, 0x88008800u, 0xcc00cc00u, 0xaa00aa00u, 0xff00ff00u,
+  0x80808080u, 0xc0c0c0c0u, 0xa0a0a0a0u, 0xf0f0f0f0u, 0x88888888u, 0xccccccccu, 0xaaaaaaaau, 0xffffffffu,
+
+  0x80000000u, 0xc0000000u, 0x60000000u, 0x90000000u, 0xe8000000u, 0x5c000000u, 0x8e000000u, 0xc5000000u,
+  0x68800000u, 0x9cc00000u, 0xee600000u, 0x55900000u, 0x80680000u, 0xc09c0000u, 0x60ee0000u, 0x90550000u,
+  0xe8808000u, 0x5cc0c000u, 0x8e606000u, 0xc5909000u, 0x6868e800u, 0x9c9c5c00u, 0xeeee8e00u, 0x5555c500u,
+  0x8000e880u, 0xc0005cc0u, 0x60008e60u, 0x9000c590u, 0xe8006868u, 0x5c009c9cu, 0x8e00eeeeu, 0xc5005555u,
+
+  0x80000000u, 0xc0000000u, 0x20000000u, 0x50000000u, 0xf8000000u, 0x74000000u, 0xa2000000u, 0x93000000u,
+  0xd8800000u, 0x25400000u, 0x59e00000u, 0xe6d00000u, 0x78080000u, 0xb40c0000u, 0x82020000u, 0xc3050000u,
+  0x208f8000u, 0x51474000u, 0xfbea2000u, 0x75d93000u, 0xa0858800u, 0x914e5400u, 0xdbe79e00u, 0x25db6d00u,
+  0x58800080u, 0xe54000c0u, 0x79e00020u, 0xb6d00050u, 0x800800f8u, 0xc00c0074u, 0x200200a2u, 0x50050093u
+};
+
+//------------------------------------------------------------------------------------------------------
+SAMPLING_FUNC UINT SamplingReverseBits(UINT x)
+{
+#ifdef __cplusplus
+  x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+  x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+  x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+  x = ((x >> 8) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8);
+  return (x >> 16) | (x << 16);
+#else
+  return reversebits(x);
+#endif
+}
+
+//------------------------------------------------------------------------------------------------------
+// From: https://nullprogram.com/blog/2018/07/31/ (lowbias32)
+SAMPLING_FUNC UINT SamplingHash(UINT x)
+{
+  x ^= x >> 16;
+  x *= 0x7feb352du;
+  x ^= x >> 15;
+  x *= 0x846ca68bu;
+  x ^= x >> 16;
+  return x;
+}
+
+//------------------------------------------------------------------------------------------------------
+SAMPLING_FUNC UINT SamplingHashCombine(UINT seed, UINT value)
+{
+  return seed ^ (value + (seed << 6) + (seed >> 2));
+}
+
+//------------------------------------------------------------------------------------------------------
+SAMPLING_FUNC UINT SamplingPixelSeed(UINT x, UINT y)
+{
+  return SamplingHash(SamplingHashCombine(SamplingHash(x), y));
+}
+
+//------------------------------------------------------------------------------------------------------
+// From: Burley, "Practical Hash-based Owen Scrambling", JCGT 2020
+SAMPLING_FUNC UINT LaineKarrasPermutation(UINT x, UINT seed)
+{
+  x += seed;
+  x ^= x * 0x6c50b47cu;
+  x ^= x * 0xb82f1e52u;
+  x ^= x * 0xc7afe638u;
+  x ^= x * 0x8d22f6e6u;
+  return x;
+}
+
+//------------------------------------------------------------------------------------------------------
+SAMPLING_FUNC UINT NestedUniformScramble(UINT x, UINT seed)
+{
+  x = SamplingReverseBits(x);
+  x = LaineKarrasPermutation(x, seed);
+  return SamplingReverseBits(x);
+}
+
+//------------------------------------------------------------------------------------------------------
+SAMPLING_FUNC UINT SobolSample(UINT index, UINT dimension)
+{
+  UINT x = 0;
+
+  for (UINT bit = 0; index != 0; bit++)
+  {
+    if ((index & 1u) != 0)
+    {
+      x ^= SOBOL_DIRECTIONS[dimension * 32 + bit];
+    }
+
+    index >>= 1;
+  }
+
+  return x;
+}
+
+//------------------------------------------------------------------------------------------------------
+// Shuffles the sample order with the group seed, so all dimensions of a group stay jointly stratified
+SAMPLING_FUNC float OwenScrambledSobol(UINT index, UINT dimension, UINT group_seed)
+{
+  UINT shuffled_index = NestedUniformScramble(index, group_seed);
+  UINT x = NestedUniformScramble(SobolSample(shuffled_index, dimension), SamplingHashCombine(group_seed, dimension));
+  return float(x >> 8) / 16777216.0f;
+}
+
+//------------------------------------------------------------------------------------------------------
+SAMPLING_FUNC float LowDiscrepancySample(UINT sampler_type, UINT pixel_seed, UINT sample_index, UINT dimension)
+{
+  if (sampler_type == SAMPLER_TYPE_PMJ02 || sampler_type == SAMPLER_TYPE_BLUE_NOISE)
+  {
+    return OwenScrambledSobol(sample_index, dimension % 2, SamplingHashCombine(pixel_seed, SamplingHash(dimension / 2)));
+  }
+
+  return OwenScrambledSobol(sample_index, dimension % 4, SamplingHashCombine(pixel_seed, SamplingHash(dimension / 4)));
+}
+
+//------------------------------------------------------------------------------------------------------
+// Toroidal shift of a sample in [0, 1), keeps the stratification of the sequence it is applied to
+SAMPLING_FUNC float CranleyPattersonRotation(float value, float offset)
+{
+  float rotated = value + offset;
+  return rotated - floor(rotated);
+}
+
+#endif
\ No newline at end of file
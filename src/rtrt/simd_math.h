@@ -0,0 +1,57 @@
+#pragma once
+
+#include <immintrin.h>
+
+namespace rtrt
+{
+  //------------------------------------------------------------------------------------------------------
+  // log2 for positive normal floats: the exponent bits plus a minimax polynomial of the mantissa in [1, 2)
+  inline __m256 SimdLog2(__m256 x)
+  {
+    const __m256i exponent_mask = _mm256_set1_epi32(0x7F800000);
+    const __m256i mantissa_mask = _mm256_set1_epi32(0x007FFFFF);
+    const __m256 one = _mm256_set1_ps(1.0f);
+
+    __m256i bits = _mm256_castps_si256(x);
+    __m256 exponent = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(_mm256_and_si256(bits, exponent_mask), 23), _mm256_set1_epi32(127)));
+    __m256 mantissa = _mm256_or_ps(_mm256_castsi256_ps(_mm256_and_si256(bits, mantissa_mask)), one);
+
+    __m256 p = _mm256_set1_ps(-3.4436006e-2f);
+    p = _mm256_add_ps(_mm256_mul_ps(p, mantissa), _mm256_set1_ps(3.1821337e-1f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, mantissa), _mm256_set1_ps(-1.2315303f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, mantissa), _mm256_set1_ps(2.5988452f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, mantissa), _mm256_set1_ps(-3.3241990f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, mantissa), _mm256_set1_ps(3.1157899f));
+
+    // Multiplying by (m - 1) makes log2(1) exactly 0
+    return _mm256_add_ps(_mm256_mul_ps(p, _mm256_sub_ps(mantissa, one)), exponent);
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  // exp2 as the integer part built into the exponent bits times a minimax polynomial of the fraction in [0, 1)
+  inline __m256 SimdExp2(__m256 x)
+  {
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-126.0f)), _mm256_set1_ps(127.0f));
+
+    __m256 integer = _mm256_floor_ps(x);
+    __m256 fraction = _mm256_sub_ps(x, integer);
+
+    __m256i exponent = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(integer), _mm256_set1_epi32(127)), 23);
+
+    __m256 p = _mm256_set1_ps(1.8775767e-3f);
+    p = _mm256_add_ps(_mm256_mul_ps(p, fraction), _mm256_set1_ps(8.9893397e-3f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, fraction), _mm256_set1_ps(5.5826318e-2f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, fraction), _mm256_set1_ps(2.4015361e-1f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, fraction), _mm256_set1_ps(6.9315308e-1f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, fraction), _mm256_set1_ps(9.9999994e-1f));
+
+    return _mm256_mul_ps(p, _mm256_castsi256_ps(exponent));
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  // e^x through exp2, accurate to the same relative error
+  inline __m256 SimdExp(__m256 x)
+  {
+    return SimdExp2(_mm256_mul_ps(x, _mm256_set1_ps(1.44269504f)));
+  }
+}
\ No newline at end of file
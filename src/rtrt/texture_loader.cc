@@ -3,6 +3,8 @@
 #include <DDSTextureLoader.h>
 #include <ResourceUploadBatch.h>
 
+#include "texture_processor.h"
+
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
@@ -26,17 +28,27 @@ namespace rtrt
     }
   }
   //------------------------------------------------------------------------------------------------------
-  void TextureLoader::UploadTexture(ID3D12Device* device, ID3D12CommandQueue* queue, unsigned char* pixels, UINT width, UINT height, ID3D12Resource** out_texture)
+  void TextureLoader::UploadTexture(ID3D12Device* device, ID3D12CommandQueue* queue, unsigned char* pixels, UINT width, UINT height, ID3D12Resource** out_texture, UINT mip_levels)
   {
-    D3D12_SUBRESOURCE_DATA subresource_data;
-    subresource_data.pData = pixels;
-    subresource_data.RowPitch = width * 4;
-    subresource_data.SlicePitch = subresource_data.RowPitch * height;
+    std::vector<D3D12_SUBRESOURCE_DATA> subresource_data(mip_levels);
+    unsigned char* level_pixels = pixels;
+
+    for (UINT i = 0; i < mip_levels; i++)
+    {
+      UINT level_width = std::max(width >> i, 1u);
+      UINT level_height = std::max(height >> i, 1u);
 
-    D3D12_RESOURCE_DESC texture_desc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, static_cast<UINT64>(width), static_cast<UINT>(height));
+      subresource_data[i].pData = level_pixels;
+      subresource_data[i].RowPitch = level_width * 4;
+      subresource_data[i].SlicePitch = subresource_data[i].RowPitch * level_height;
+
+      level_pixels += subresource_data[i].SlicePitch;
+    }
+
+    D3D12_RESOURCE_DESC texture_desc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, static_cast<UINT64>(width), static_cast<UINT>(height), 1, static_cast<UINT16>(mip_levels));
 
     UINT64 texture_upload_buffer_size;
-    device->GetCopyableFootprints(&texture_desc, 0, 1, 0, nullptr, nullptr, nullptr, &texture_upload_buffer_size);
+    device->GetCopyableFootprints(&texture_desc, 0, mip_levels, 0, nullptr, nullptr, nullptr, &texture_upload_buffer_size);
 
     ID3D12Resource* upload_buffer = nullptr;
 
@@ -57,7 +69,7 @@ namespace rtrt
     ID3D12GraphicsCommandList* list = nullptr;
     ThrowIfFailed(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, allocator, nullptr, IID_PPV_ARGS(&list)));
 
-    UpdateSubresources(list, *out_texture, upload_buffer, 0, 0, 1, &subresource_data);
+    UpdateSubresources(list, *out_texture, upload_buffer, 0, 0, mip_levels, subresource_data.data());
 
     list->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(*out_texture, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ));
 
@@ -101,12 +113,45 @@ namespace rtrt
   
   //------------------------------------------------------------------------------------------------------
   void TextureLoader::LoadUsingSTB(ID3D12Device* device, ID3D12CommandQueue* queue, const std::string& texture_path, ID3D12Resource** out_texture)
+  {
+    ProcessedTexture texture;
+    TextureProcessor::ProcessTexture(texture_path, TextureUsage::Color, &texture);
+
+    LoadProcessedTexture(device, queue, texture, out_texture);
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void TextureLoader::LoadProcessedTexture(ID3D12Device* device, ID3D12CommandQueue* queue, const ProcessedTexture& texture, ID3D12Resource** out_texture)
+  {
+    CreateTexture(device, texture, out_texture);
+
+    UploadTexture(device, queue, const_cast<unsigned char*>(texture.mip_chain.data()), texture.width, texture.height, out_texture, texture.mip_levels);
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void TextureLoader::LoadDataTexture(ID3D12Device* device, ID3D12CommandQueue* queue, const std::string& texture_path, ID3D12Resource** out_texture)
   {
     int width, height, comp;
     unsigned char* pixel_data = stbi_load(texture_path.c_str(), &width, &height, &comp, 4);
     ThrowIfFalse(pixel_data != nullptr);
 
-    D3D12_RESOURCE_DESC texture_desc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, static_cast<UINT64>(width), static_cast<UINT>(height));
+    ProcessedTexture texture;
+    texture.width = static_cast<UINT>(width);
+    texture.height = static_cast<UINT>(height);
+    texture.mip_levels = 1;
+    texture.mip_chain.assign(pixel_data, pixel_data + texture.width * texture.height * 4);
+
+    STBI_FREE(pixel_data);
+
+    LoadProcessedTexture(device, queue, texture, out_texture);
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void TextureLoader::CreateTexture(ID3D12Device* device, const ProcessedTexture& texture, ID3D12Resource** out_texture)
+  {
+    ThrowIfFalse(texture.mip_levels > 0);
+
+    D3D12_RESOURCE_DESC texture_desc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, static_cast<UINT64>(texture.width), texture.height, 1, static_cast<UINT16>(texture.mip_levels));
 
     ThrowIfFailed(
       device->CreateCommittedResource(
@@ -118,8 +163,5 @@ namespace rtrt
         IID_PPV_ARGS(out_texture)
       )
     );
-
-    UploadTexture(device, queue, pixel_data, width, height, out_texture);
-    STBI_FREE(pixel_data);
   }
 }
\ No newline at end of file
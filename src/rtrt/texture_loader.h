@@ -1,13 +1,21 @@
 #pragma once
 
+#include "texture_processor.h"
+
 namespace rtrt
 {
   class TextureLoader
   {
   public:
     static void LoadTexture(ID3D12Device* device, ID3D12CommandQueue* queue, const std::string& texture_path, ID3D12Resource** out_texture);
-    static void UploadTexture(ID3D12Device* device, ID3D12CommandQueue* queue, unsigned char* pixels, UINT width, UINT height, ID3D12Resource** out_texture);
+    static void UploadTexture(ID3D12Device* device, ID3D12CommandQueue* queue, unsigned char* pixels, UINT width, UINT height, ID3D12Resource** out_texture, UINT mip_levels = 1);
+    static void LoadProcessedTexture(ID3D12Device* device, ID3D12CommandQueue* queue, const ProcessedTexture& texture, ID3D12Resource** out_texture);
+
+    // Loads the texels as they are stored, without sRGB conversion, mips or the texture cache, e.g. for noise tiles
+    static void LoadDataTexture(ID3D12Device* device, ID3D12CommandQueue* queue, const std::string& texture_path, ID3D12Resource** out_texture);
+
   private:
+    static void CreateTexture(ID3D12Device* device, const ProcessedTexture& texture, ID3D12Resource** out_texture);
     static void LoadUsingDDS(ID3D12Device* device, ID3D12CommandQueue* queue, const std::string& texture_path, ID3D12Resource** out_texture);
     static void LoadUsingSTB(ID3D12Device* device, ID3D12CommandQueue* queue, const std::string& texture_path, ID3D12Resource** out_texture);
   };
@@ -0,0 +1,461 @@
+#include "texture_processor.h"
+#include "block_compression.h"
+
+#include <stb_image.h>
+#include <emmintrin.h>
+#include <chrono>
+#include <fstream>
+
+namespace filesystem = std::experimental::filesystem;
+
+namespace rtrt
+{
+  namespace
+  {
+    //------------------------------------------------------------------------------------------------------
+    // Size of the full RGBA8 mip chain GenerateMipChain produces for a texture of this size
+    UINT64 GetMipChainSize(UINT width, UINT height, UINT* out_mip_levels)
+    {
+      UINT mip_levels = 1;
+      UINT64 chain_size = static_cast<UINT64>(width) * height * 4;
+
+      for (UINT w = width, h = height; w > 1 || h > 1; mip_levels++)
+      {
+        w = std::max(w / 2, 1u);
+        h = std::max(h / 2, 1u);
+        chain_size += static_cast<UINT64>(w) * h * 4;
+      }
+
+      *out_mip_levels = mip_levels;
+      return chain_size;
+    }
+  }
+
+  const char* TextureProcessor::CACHE_DIRECTORY = "./cache/textures";
+
+  //------------------------------------------------------------------------------------------------------
+  void TextureProcessor::ProcessTexture(const std::string& texture_path, TextureUsage usage, ProcessedTexture* out_texture, bool compress)
+  {
+    *out_texture = ProcessedTexture();
+
+    std::string extension = filesystem::path(texture_path).extension().string();
+    if (extension == ".dds" || extension == ".DDS")
+    {
+      return;
+    }
+
+    if (compress && ReadCompressedCache(texture_path, usage, out_texture))
+    {
+      return;
+    }
+
+    if (ReadCache(texture_path, usage, out_texture))
+    {
+      if (compress)
+      {
+        Compress(texture_path, usage, out_texture);
+      }
+
+      return;
+    }
+
+    int width, height, comp;
+    unsigned char* pixel_data = stbi_load(texture_path.c_str(), &width, &height, &comp, 4);
+    ThrowIfFalse(pixel_data != nullptr);
+
+    out_texture->width = static_cast<UINT>(width);
+    out_texture->height = static_cast<UINT>(height);
+    out_texture->mip_levels = GenerateMipChain(pixel_data, out_texture->width, out_texture->height, usage, &out_texture->mip_chain);
+
+    STBI_FREE(pixel_data);
+
+    // Compressed textures are cached as DDS only, the uncompressed mip chain would never be read again
+    if (compress == false || Compress(texture_path, usage, out_texture) == false)
+    {
+      WriteCache(texture_path, usage, *out_texture);
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void TextureProcessor::LogStatistics(const std::vector<ProcessedTexture>& textures, bool compress)
+  {
+    size_t num_cached = std::count_if(textures.begin(), textures.end(), [](const ProcessedTexture& texture) { return texture.from_cache; });
+
+    std::stringstream message;
+    message << "Processed " << textures.size() << " textures (" << num_cached << " from cache).\n";
+    LOG(message.str().c_str());
+
+    if (compress == false)
+    {
+      return;
+    }
+
+    size_t num_compressed = 0, uncompressed_size = 0, compressed_size = 0, encoded_size = 0;
+    double encode_ms = 0.0;
+
+    for (size_t i = 0; i < textures.size(); i++)
+    {
+      const ProcessedTexture& texture = textures[i];
+
+      if (texture.compressed_path.empty() == false)
+      {
+        num_compressed++;
+        uncompressed_size += texture.uncompressed_size;
+        compressed_size += texture.compressed_size;
+      }
+
+      if (texture.encode_ms > 0.0)
+      {
+        encoded_size += texture.uncompressed_size;
+        encode_ms += texture.encode_ms;
+      }
+    }
+
+    std::stringstream report;
+    report << std::fixed << std::setprecision(1);
+    report << "Block compressed " << num_compressed << " of " << textures.size() << " textures: " << uncompressed_size / (1024.0 * 1024.0) << " MB -> " << compressed_size / (1024.0 * 1024.0) << " MB, " << (uncompressed_size - compressed_size) / (1024.0 * 1024.0) << " MB saved.\n";
+
+    if (encode_ms > 0.0)
+    {
+      report << "Encoded " << encoded_size / (1024.0 * 1024.0) << " MB of RGBA8 at " << (encoded_size / (1024.0 * 1024.0)) / (encode_ms / 1000.0) << " MB/s per thread.\n";
+    }
+
+    LOG(report.str().c_str());
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  UINT TextureProcessor::GenerateMipChain(const unsigned char* pixels, UINT width, UINT height, TextureUsage usage, std::vector<unsigned char>* out_mip_chain)
+  {
+    UINT mip_levels;
+    out_mip_chain->resize(static_cast<size_t>(GetMipChainSize(width, height, &mip_levels)));
+    memcpy(out_mip_chain->data(), pixels, static_cast<size_t>(width) * height * 4);
+
+    size_t src_offset = 0;
+    size_t dst_offset = static_cast<size_t>(width) * height * 4;
+    UINT src_width = width;
+    UINT src_height = height;
+
+    // Every level is filtered from the previous one, so the levels of a single texture are processed in order
+    for (UINT level = 1; level < mip_levels; level++)
+    {
+      UINT dst_width = std::max(src_width / 2, 1u);
+      UINT dst_height = std::max(src_height / 2, 1u);
+
+      Downsample(out_mip_chain->data() + src_offset, src_width, src_height, out_mip_chain->data() + dst_offset, dst_width, dst_height, usage);
+
+      src_offset = dst_offset;
+      dst_offset += static_cast<size_t>(dst_width) * dst_height * 4;
+      src_width = dst_width;
+      src_height = dst_height;
+    }
+
+    return mip_levels;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void TextureProcessor::Downsample(const unsigned char* src, UINT src_width, UINT src_height, unsigned char* dst, UINT dst_width, UINT dst_height, TextureUsage usage)
+  {
+    // Decoding through a table is exact for 8 bit input, encoding through a finer table is within one step
+    static const std::vector<float> srgb_to_linear = []()
+    {
+      std::vector<float> table(256);
+      for (int i = 0; i < 256; i++)
+      {
+        float c = i / 255.0f;
+        table[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+      }
+      return table;
+    }();
+
+    static const std::vector<unsigned char> linear_to_srgb = []()
+    {
+      std::vector<unsigned char> table(4096);
+      for (int i = 0; i < 4096; i++)
+      {
+        float c = i / 4095.0f;
+        float s = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+        table[i] = static_cast<unsigned char>(std::min(std::max(s * 255.0f + 0.5f, 0.0f), 255.0f));
+      }
+      return table;
+    }();
+
+    const __m128 quarter = _mm_set1_ps(0.25f);
+    const __m128 to_unit = _mm_set1_ps(1.0f / 255.0f);
+    const __m128 to_byte = _mm_set1_ps(255.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    // Loads a texel as four floats, color channels of color textures are decoded to linear
+    auto load = [&](UINT x, UINT y)
+    {
+      const unsigned char* texel = src + (static_cast<size_t>(y) * src_width + x) * 4;
+
+      if (usage == TextureUsage::Color)
+      {
+        return _mm_setr_ps(srgb_to_linear[texel[0]], srgb_to_linear[texel[1]], srgb_to_linear[texel[2]], texel[3] / 255.0f);
+      }
+
+      return _mm_mul_ps(_mm_setr_ps(texel[0], texel[1], texel[2], texel[3]), to_unit);
+    };
+
+    for (UINT y = 0; y < dst_height; y++)
+    {
+      UINT y0 = std::min(y * 2, src_height - 1);
+      UINT y1 = std::min(y * 2 + 1, src_height - 1);
+
+      for (UINT x = 0; x < dst_width; x++)
+      {
+        UINT x0 = std::min(x * 2, src_width - 1);
+        UINT x1 = std::min(x * 2 + 1, src_width - 1);
+
+        __m128 sum = _mm_add_ps(_mm_add_ps(load(x0, y0), load(x1, y0)), _mm_add_ps(load(x0, y1), load(x1, y1)));
+        __m128 average = _mm_mul_ps(sum, quarter);
+
+        float result[4];
+        _mm_storeu_ps(result, _mm_min_ps(_mm_max_ps(average, zero), one));
+
+        unsigned char* texel = dst + (static_cast<size_t>(y) * dst_width + x) * 4;
+
+        if (usage == TextureUsage::Color)
+        {
+          texel[0] = linear_to_srgb[static_cast<size_t>(result[0] * 4095.0f + 0.5f)];
+          texel[1] = linear_to_srgb[static_cast<size_t>(result[1] * 4095.0f + 0.5f)];
+          texel[2] = linear_to_srgb[static_cast<size_t>(result[2] * 4095.0f + 0.5f)];
+          texel[3] = static_cast<unsigned char>(result[3] * 255.0f + 0.5f);
+          continue;
+        }
+
+        if (usage == TextureUsage::Normal)
+        {
+          // Averaged normals are shorter than unit length, renormalize them in [-1, 1] space
+          float nx = result[0] * 2.0f - 1.0f;
+          float ny = result[1] * 2.0f - 1.0f;
+          float nz = result[2] * 2.0f - 1.0f;
+          float length = std::sqrt(nx * nx + ny * ny + nz * nz);
+
+          if (length > 0.0f)
+          {
+            result[0] = (nx / length) * 0.5f + 0.5f;
+            result[1] = (ny / length) * 0.5f + 0.5f;
+            result[2] = (nz / length) * 0.5f + 0.5f;
+          }
+        }
+
+        __m128i bytes = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(result), to_byte), half));
+        bytes = _mm_packs_epi32(bytes, bytes);
+        bytes = _mm_packus_epi16(bytes, bytes);
+        *reinterpret_cast<int*>(texel) = _mm_cvtsi128_si32(bytes);
+      }
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  std::string TextureProcessor::GetCachePath(const std::string& texture_path, TextureUsage usage)
+  {
+    std::string absolute_path = filesystem::absolute(texture_path).string();
+    size_t hash = std::hash<std::string>()(absolute_path + "|" + std::to_string(static_cast<UINT>(usage)));
+
+    std::stringstream path;
+    path << CACHE_DIRECTORY << "/" << filesystem::path(texture_path).stem().string() << "_" << std::hex << hash << ".rtex";
+
+    return path.str();
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  std::string TextureProcessor::GetCompressedCachePath(const std::string& texture_path, TextureUsage usage)
+  {
+    // The DDS header cannot hold the source's size and time stamp, so they are part of the name instead
+    std::stringstream key;
+    key << filesystem::absolute(texture_path).string() << "|" << static_cast<UINT>(usage) << "|" << ENCODER_VERSION << "|";
+    key << filesystem::file_size(texture_path) << "|" << filesystem::last_write_time(texture_path).time_since_epoch().count();
+
+    std::stringstream path;
+    path << CACHE_DIRECTORY << "/" << filesystem::path(texture_path).stem().string() << "_" << std::hex << std::hash<std::string>()(key.str()) << ".dds";
+
+    return path.str();
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  bool TextureProcessor::ReadCompressedCache(const std::string& texture_path, TextureUsage usage, ProcessedTexture* out_texture)
+  {
+    std::string compressed_path = GetCompressedCachePath(texture_path, usage);
+
+    UINT width, height, mip_levels;
+    DXGI_FORMAT format;
+
+    if (BlockCompressionUtility::ReadDDSDescription(compressed_path, &width, &height, &mip_levels, &format) == false)
+    {
+      return false;
+    }
+
+    out_texture->width = width;
+    out_texture->height = height;
+    out_texture->mip_levels = mip_levels;
+    out_texture->from_cache = true;
+    out_texture->compressed_path = compressed_path;
+    out_texture->compressed_format = format;
+    out_texture->uncompressed_size = MipChainSize(width, height, mip_levels);
+    out_texture->compressed_size = 0;
+
+    for (UINT level = 0; level < mip_levels; level++)
+    {
+      out_texture->compressed_size += static_cast<size_t>((std::max(width >> level, 1u) + 3) / 4) * ((std::max(height >> level, 1u) + 3) / 4) * BlockCompressionUtility::BlockSize(format);
+    }
+
+    return true;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  bool TextureProcessor::Compress(const std::string& texture_path, TextureUsage usage, ProcessedTexture* texture)
+  {
+    DXGI_FORMAT format = BlockCompressionUtility::SelectFormat(*texture, usage);
+    if (format == DXGI_FORMAT_UNKNOWN)
+    {
+      return false;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::vector<unsigned char> blocks;
+    BlockCompressionUtility::CompressMipChain(*texture, format, &blocks);
+
+    double encode_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    std::error_code error;
+    filesystem::create_directories(CACHE_DIRECTORY, error);
+
+    std::string compressed_path = GetCompressedCachePath(texture_path, usage);
+    std::string temporary_path = compressed_path + ".tmp";
+
+    // filesystem::rename does not replace existing files, a stale entry is only overwritten by MoveFileEx
+    if (BlockCompressionUtility::WriteDDS(temporary_path, format, texture->width, texture->height, texture->mip_levels, blocks) == false ||
+      MoveFileExA(temporary_path.c_str(), compressed_path.c_str(), MOVEFILE_REPLACE_EXISTING) == FALSE)
+    {
+      filesystem::remove(temporary_path, error);
+      return false;
+    }
+
+    texture->compressed_path = compressed_path;
+    texture->compressed_format = format;
+    texture->uncompressed_size = texture->mip_chain.size();
+    texture->compressed_size = blocks.size();
+    texture->encode_ms = encode_ms;
+
+    texture->mip_chain.clear();
+    texture->mip_chain.shrink_to_fit();
+
+    return true;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  size_t TextureProcessor::MipChainSize(UINT width, UINT height, UINT mip_levels)
+  {
+    size_t size = 0;
+
+    for (UINT level = 0; level < mip_levels; level++)
+    {
+      size += static_cast<size_t>(std::max(width >> level, 1u)) * std::max(height >> level, 1u) * 4;
+    }
+
+    return size;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  bool TextureProcessor::ReadCache(const std::string& texture_path, TextureUsage usage, ProcessedTexture* out_texture)
+  {
+    std::string cache_path = GetCachePath(texture_path, usage);
+
+    std::ifstream file(cache_path, std::ios::binary);
+    if (file.is_open() == false)
+    {
+      return false;
+    }
+
+    CacheHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(CacheHeader));
+
+    // Stale entries are simply overwritten when the texture is processed again
+    if (file.good() == false ||
+      header.magic != CACHE_MAGIC ||
+      header.version != CACHE_VERSION ||
+      header.usage != static_cast<UINT>(usage) ||
+      header.source_size != static_cast<UINT64>(filesystem::file_size(texture_path)) ||
+      header.source_write_time != static_cast<INT64>(filesystem::last_write_time(texture_path).time_since_epoch().count()))
+    {
+      return false;
+    }
+
+    // The sizes in the header are only trusted as far as the file backs them, anything else is a miss
+    if (header.width == 0 || header.width > D3D12_REQ_TEXTURE2D_U_OR_V_DIMENSION ||
+      header.height == 0 || header.height > D3D12_REQ_TEXTURE2D_U_OR_V_DIMENSION)
+    {
+      return false;
+    }
+
+    std::error_code error;
+    UINT64 file_size = static_cast<UINT64>(filesystem::file_size(cache_path, error));
+
+    UINT mip_levels;
+    UINT64 chain_size = GetMipChainSize(header.width, header.height, &mip_levels);
+
+    if (error || header.mip_levels != mip_levels || header.data_size != chain_size || file_size != sizeof(CacheHeader) + chain_size)
+    {
+      return false;
+    }
+
+    out_texture->width = header.width;
+    out_texture->height = header.height;
+    out_texture->mip_levels = header.mip_levels;
+    out_texture->mip_chain.resize(static_cast<size_t>(header.data_size));
+    file.read(reinterpret_cast<char*>(out_texture->mip_chain.data()), header.data_size);
+
+    if (file.good() == false)
+    {
+      *out_texture = ProcessedTexture();
+      return false;
+    }
+
+    out_texture->from_cache = true;
+    return true;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void TextureProcessor::WriteCache(const std::string& texture_path, TextureUsage usage, const ProcessedTexture& texture)
+  {
+    std::error_code error;
+    filesystem::create_directories(CACHE_DIRECTORY, error);
+
+    // Written under a temporary name first, so a crash halfway never leaves a truncated entry behind
+    std::string cache_path = GetCachePath(texture_path, usage);
+    std::string temporary_path = cache_path + ".tmp";
+
+    std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+    if (file.is_open() == false)
+    {
+      return;
+    }
+
+    CacheHeader header;
+    header.magic = CACHE_MAGIC;
+    header.version = CACHE_VERSION;
+    header.usage = static_cast<UINT>(usage);
+    header.width = texture.width;
+    header.height = texture.height;
+    header.mip_levels = texture.mip_levels;
+    header.source_size = static_cast<UINT64>(filesystem::file_size(texture_path));
+    header.source_write_time = static_cast<INT64>(filesystem::last_write_time(texture_path).time_since_epoch().count());
+    header.data_size = static_cast<UINT64>(texture.mip_chain.size());
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(CacheHeader));
+    file.write(reinterpret_cast<const char*>(texture.mip_chain.data()), texture.mip_chain.size());
+
+    bool written = file.good();
+    file.close();
+
+    if (written == false || MoveFileExA(temporary_path.c_str(), cache_path.c_str(), MOVEFILE_REPLACE_EXISTING) == FALSE)
+    {
+      filesystem::remove(temporary_path, error);
+    }
+  }
+}
\ No newline at end of file
@@ -0,0 +1,93 @@
+#pragma once
+
+namespace rtrt
+{
+  // How the texels of a texture are interpreted while filtering its mip chain
+  enum class TextureUsage
+  {
+    Color,  // sRGB encoded color, filtered in linear space
+    Linear, // Data that is filtered as-is, e.g. masks and height maps
+    Normal  // Tangent space normals, renormalized after filtering
+  };
+
+  struct ProcessedTexture
+  {
+    UINT width = 0;
+    UINT height = 0;
+    UINT mip_levels = 0; // 0 if the texture was not processed, e.g. DDS textures that already carry their mips
+    std::vector<unsigned char> mip_chain; // RGBA8, all levels tightly packed one after the other
+    bool from_cache = false;
+
+    // Block compression, compressed textures are uploaded from compressed_path and leave mip_chain empty
+    std::string compressed_path;
+    DXGI_FORMAT compressed_format = DXGI_FORMAT_UNKNOWN;
+    size_t uncompressed_size = 0;
+    size_t compressed_size = 0;
+    double encode_ms = 0.0; // 0 if the compressed texture came from the cache
+  };
+
+  class TextureProcessor
+  {
+  public:
+    /**
+    * Decodes a texture and generates its full mip chain, or reads both from the texture cache if the source
+    * file did not change since it was last processed. Freshly processed textures are written to the cache.
+    * @param[in] texture_path The path to the source texture
+    * @param[in] usage How the texture is filtered
+    * @param[out] out_texture The processed texture, left empty for DDS textures
+    * @param[in] compress Whether the texture is block compressed into a DDS file in the cache
+    */
+    static void ProcessTexture(const std::string& texture_path, TextureUsage usage, ProcessedTexture* out_texture, bool compress = false);
+
+    /**
+    * Logs how many textures came from the cache and, if they were compressed, how much memory the block
+    * compression saved and how fast the encoder ran.
+    * @param[in] textures The processed textures
+    * @param[in] compress Whether the textures were processed with compression enabled
+    */
+    static void LogStatistics(const std::vector<ProcessedTexture>& textures, bool compress);
+
+    /**
+    * Generates a 2x2 box filtered RGBA8 mip chain. Odd dimensions fold their last row/column into the last texel
+    * of the next level.
+    * @param[in] pixels The RGBA8 texels of the top level
+    * @param[in] width The width of the top level
+    * @param[in] height The height of the top level
+    * @param[in] usage How the texels are filtered
+    * @param[out] out_mip_chain All levels tightly packed one after the other, starting with the top level
+    * @return The number of mip levels
+    */
+    static UINT GenerateMipChain(const unsigned char* pixels, UINT width, UINT height, TextureUsage usage, std::vector<unsigned char>* out_mip_chain);
+
+    static const char* CACHE_DIRECTORY;
+
+  private:
+    // Cache files are this header followed by the mip chain
+    struct CacheHeader
+    {
+      UINT magic;
+      UINT version;
+      UINT usage;
+      UINT width;
+      UINT height;
+      UINT mip_levels;
+      UINT64 source_size;
+      INT64 source_write_time;
+      UINT64 data_size;
+    };
+
+    static const UINT CACHE_MAGIC = 0x58455452; // "RTEX"
+    static const UINT CACHE_VERSION = 1;
+
+    static const UINT ENCODER_VERSION = 1;
+
+    static std::string GetCachePath(const std::string& texture_path, TextureUsage usage);
+    static std::string GetCompressedCachePath(const std::string& texture_path, TextureUsage usage);
+    static bool ReadCompressedCache(const std::string& texture_path, TextureUsage usage, ProcessedTexture* out_texture);
+    static bool Compress(const std::string& texture_path, TextureUsage usage, ProcessedTexture* texture);
+    static size_t MipChainSize(UINT width, UINT height, UINT mip_levels);
+    static bool ReadCache(const std::string& texture_path, TextureUsage usage, ProcessedTexture* out_texture);
+    static void WriteCache(const std::string& texture_path, TextureUsage usage, const ProcessedTexture& texture);
+    static void Downsample(const unsigned char* src, UINT src_width, UINT src_height, unsigned char* dst, UINT dst_width, UINT dst_height, TextureUsage usage);
+  };
+}
\ No newline at end of file
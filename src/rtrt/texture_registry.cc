@@ -0,0 +1,138 @@
+#include "texture_registry.h"
+#include "model.h"
+
+#include <fstream>
+#include <tuple>
+
+namespace filesystem = std::experimental::filesystem;
+
+namespace rtrt
+{
+  //------------------------------------------------------------------------------------------------------
+  bool TextureRegistryUtility::TextureKey::operator<(const TextureKey& other) const
+  {
+    return std::tie(file_size, content_hash, usage) < std::tie(other.file_size, other.content_hash, other.usage);
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  UINT TextureRegistryUtility::DeduplicateTextures(Model* model)
+  {
+    std::vector<TextureKey> keys(model->textures.size());
+    std::unordered_map<UINT64, UINT> files_per_size;
+
+    for (size_t i = 0; i < model->textures.size(); i++)
+    {
+      std::error_code error;
+      UINT64 file_size = filesystem::file_size(model->textures[i].path, error);
+
+      // Missing files are never merged, the loader reports them
+      keys[i].file_size = error ? ~0ull : file_size;
+      keys[i].content_hash = i;
+      keys[i].usage = static_cast<UINT>(model->textures[i].usage);
+
+      if (!error)
+      {
+        files_per_size[file_size]++;
+      }
+    }
+
+    // Files with a unique size cannot have a duplicate, which spares reading most of the scene
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+      UINT64 content_hash;
+
+      if (keys[i].file_size != ~0ull && files_per_size[keys[i].file_size] > 1 && HashFile(model->textures[i].path, &content_hash))
+      {
+        keys[i].content_hash = content_hash;
+      }
+    }
+
+    std::vector<UINT> remap, kept;
+    BuildRemap(keys, &remap, &kept);
+
+    UINT num_merged = static_cast<UINT>(model->textures.size() - kept.size());
+    if (num_merged == 0)
+    {
+      return 0;
+    }
+
+    std::vector<Model::Texture> textures(kept.size());
+    for (size_t i = 0; i < kept.size(); i++)
+    {
+      textures[i] = model->textures[kept[i]];
+    }
+
+    model->textures = textures;
+
+    auto remap_texture = [&](UINT* texture)
+    {
+      *texture = *texture != MATERIAL_NO_TEXTURE_INDEX ? remap[*texture] : MATERIAL_NO_TEXTURE_INDEX;
+    };
+
+    for (size_t i = 0; i < model->materials.size(); i++)
+    {
+      Model::Material& material = model->materials[i];
+      remap_texture(&material.emissive_map);
+      remap_texture(&material.ambient_map);
+      remap_texture(&material.diffuse_map);
+      remap_texture(&material.specular_map);
+      remap_texture(&material.specular_power_map);
+      remap_texture(&material.bump_map);
+      remap_texture(&material.normal_map);
+      remap_texture(&material.opacity_map);
+    }
+
+    std::stringstream message;
+    message << "Merged " << num_merged << " duplicate textures, " << model->textures.size() << " textures left.\n";
+    LOG(message.str().c_str());
+
+    return num_merged;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void TextureRegistryUtility::BuildRemap(const std::vector<TextureKey>& keys, std::vector<UINT>* out_remap, std::vector<UINT>* out_kept)
+  {
+    std::map<TextureKey, UINT> first_with_key;
+
+    out_remap->resize(keys.size());
+    out_kept->clear();
+
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+      auto inserted = first_with_key.insert(std::make_pair(keys[i], static_cast<UINT>(out_kept->size())));
+
+      if (inserted.second)
+      {
+        out_kept->push_back(static_cast<UINT>(i));
+      }
+
+      (*out_remap)[i] = inserted.first->second;
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  bool TextureRegistryUtility::HashFile(const std::string& path, UINT64* out_hash)
+  {
+    std::ifstream file(path, std::ios::binary);
+    if (file.is_open() == false)
+    {
+      return false;
+    }
+
+    UINT64 hash = 14695981039346656037ull;
+    char buffer[64 * 1024];
+
+    while (file)
+    {
+      file.read(buffer, sizeof(buffer));
+
+      for (std::streamsize i = 0; i < file.gcount(); i++)
+      {
+        hash = (hash ^ static_cast<unsigned char>(buffer[i])) * 1099511628211ull;
+      }
+    }
+
+    *out_hash = hash;
+    return true;
+  }
+}
\ No newline at end of file
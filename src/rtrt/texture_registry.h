@@ -0,0 +1,42 @@
+#pragma once
+
+#include "shared/raytracing_data.h"
+
+namespace rtrt
+{
+  class Model;
+
+  class TextureRegistryUtility
+  {
+  public:
+    // Textures are the same image when their files are byte for byte identical and they are filtered the same way
+    struct TextureKey
+    {
+      UINT64 file_size;
+      UINT64 content_hash;
+      UINT usage;
+
+      bool operator<(const TextureKey& other) const;
+    };
+
+    /**
+    * Merges the textures of a model whose files have identical contents and points every material at the copy
+    * that is kept. Model::ProcessMaterials only merges textures with the same path, while exported scenes often
+    * ship the same image under several names. Only files that share their size with another file are hashed.
+    * @param[in] model The model whose textures are deduplicated
+    * @return The number of textures that were merged away
+    */
+    static UINT DeduplicateTextures(Model* model);
+
+    /**
+    * Assigns every texture to the first texture with an equal key, the bookkeeping behind DeduplicateTextures.
+    * @param[in] keys One key per texture
+    * @param[out] out_remap For every texture its index in the compacted list
+    * @param[out] out_kept The original indices of the textures in the compacted list
+    */
+    static void BuildRemap(const std::vector<TextureKey>& keys, std::vector<UINT>* out_remap, std::vector<UINT>* out_kept);
+
+    // 64-bit FNV-1a of the contents of a file, false if the file could not be read
+    static bool HashFile(const std::string& path, UINT64* out_hash);
+  };
+}
\ No newline at end of file
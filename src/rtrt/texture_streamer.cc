@@ -0,0 +1,547 @@
+#include "texture_streamer.h"
+
+#include <DDSTextureLoader.h>
+
+namespace rtrt
+{
+  //------------------------------------------------------------------------------------------------------
+  TextureStreamer::TextureStreamer() :
+    device_(nullptr),
+    compress_(false),
+    memory_budget_(0),
+    resident_size_(0),
+    placeholders_{ nullptr, nullptr, nullptr },
+    loaded_size_(0),
+    stop_(false),
+    num_initial_loaded_(0),
+    initial_process_ms_(0.0)
+  {
+
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  TextureStreamer::~TextureStreamer()
+  {
+    Destroy();
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void TextureStreamer::Create(ID3D12Device* device, ID3D12CommandQueue* queue, DescriptorHeap* srv_heap, const std::vector<std::string>& texture_paths, const std::vector<TextureUsage>& usages, bool compress, UINT64 memory_budget)
+  {
+    ThrowIfFalse(texture_paths.size() == usages.size());
+
+    device_ = device;
+    compress_ = compress;
+    memory_budget_ = memory_budget;
+    resident_size_ = 0;
+    loaded_size_ = 0;
+    stop_ = false;
+
+    create_time_ = std::chrono::high_resolution_clock::now();
+    initial_textures_.assign(texture_paths.size(), ProcessedTexture());
+    num_initial_loaded_ = 0;
+    initial_process_ms_ = 0.0;
+
+    upload_batch_.Begin(device_, queue, UPLOAD_BUDGET);
+
+    // Neutral stand-ins in TextureUsage order: mid grey, white and a flat normal
+    static const unsigned char placeholder_texels[3][4] = {
+      { 128, 128, 128, 255 },
+      { 255, 255, 255, 255 },
+      { 128, 128, 255, 255 }
+    };
+
+    for (int i = 0; i < 3; i++)
+    {
+      ThrowIfFailed(
+        device_->CreateCommittedResource(
+          &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+          D3D12_HEAP_FLAG_NONE,
+          &CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, 1, 1, 1, 1),
+          D3D12_RESOURCE_STATE_COPY_DEST,
+          nullptr,
+          IID_PPV_ARGS(&placeholders_[i])
+        )
+      );
+
+      D3D12_SUBRESOURCE_DATA subresource_data;
+      subresource_data.pData = placeholder_texels[i];
+      subresource_data.RowPitch = 4;
+      subresource_data.SlicePitch = 4;
+
+      upload_batch_.Upload(placeholders_[i], &subresource_data, 1);
+    }
+
+    upload_batch_.Flush();
+
+    textures_.resize(texture_paths.size());
+
+    // The Textures descriptor table is indexed with the texture index, so the descriptors have to be consecutive
+    srv_heap->AllocateRange(static_cast<UINT>(texture_paths.size()), &descriptors_);
+
+    for (size_t i = 0; i < textures_.size(); i++)
+    {
+      StreamedTexture& texture = textures_[i];
+      texture.path = texture_paths[i];
+      texture.usage = usages[i];
+      texture.resource = nullptr;
+      texture.resident_dimension = 1;
+      texture.full_dimension = 0;
+      texture.desired_dimension = INITIAL_DIMENSION;
+      texture.resident_size = 0;
+      texture.samples = 0;
+      texture.last_used_frame = 0;
+      texture.state = LoadState::Queued;
+
+      WriteDescriptor(i);
+
+      requests_.push_back({ i, INITIAL_DIMENSION });
+    }
+
+    // One core is left for the render loop
+    UINT num_threads = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    for (UINT i = 0; i < num_threads; i++)
+    {
+      threads_.push_back(std::thread(&TextureStreamer::WorkerThread, this));
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void TextureStreamer::Destroy()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+      requests_.clear();
+    }
+
+    condition_.notify_all();
+
+    for (size_t i = 0; i < threads_.size(); i++)
+    {
+      threads_[i].join();
+    }
+
+    threads_.clear();
+
+    for (size_t i = 0; i < loaded_.size(); i++)
+    {
+      RELEASE(loaded_[i].resource);
+    }
+
+    loaded_.clear();
+    loaded_size_ = 0;
+
+    for (size_t i = 0; i < textures_.size(); i++)
+    {
+      RELEASE(textures_[i].resource);
+    }
+
+    textures_.clear();
+    descriptors_.clear();
+    resident_size_ = 0;
+
+    for (int i = 0; i < 3; i++)
+    {
+      RELEASE(placeholders_[i]);
+    }
+
+    upload_batch_.End();
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  bool TextureStreamer::Update(const TextureFeedback* feedback, UINT frame)
+  {
+    if (feedback != nullptr)
+    {
+      for (size_t i = 0; i < textures_.size(); i++)
+      {
+        StreamedTexture& texture = textures_[i];
+        texture.samples = feedback[i].samples;
+
+        if (feedback[i].samples == 0)
+        {
+          continue;
+        }
+
+        // The recorded mip is relative to the chain that was resident while the feedback was traced, so this runs
+        // before any texture is swapped. Every mip it is below that chain doubles the wanted size.
+        float lod = static_cast<float>(feedback[i].min_lod) / TEXTURE_FEEDBACK_LOD_SCALE - TEXTURE_FEEDBACK_LOD_OFFSET;
+        float desired_dimension = std::ceil(texture.resident_dimension * std::exp2(-lod));
+
+        texture.desired_dimension = static_cast<UINT>(std::min(desired_dimension, static_cast<float>(D3D12_REQ_TEXTURE2D_U_OR_V_DIMENSION)));
+        texture.last_used_frame = frame;
+      }
+    }
+
+    std::vector<LoadedTexture> swaps;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+
+      UINT64 upload_size = 0;
+      while (loaded_.empty() == false && upload_size < UPLOAD_BUDGET)
+      {
+        upload_size += loaded_.front().size;
+        swaps.push_back(std::move(loaded_.front()));
+        loaded_.pop_front();
+      }
+    }
+
+    for (size_t i = 0; i < swaps.size(); i++)
+    {
+      upload_batch_.Upload(swaps[i].resource, swaps[i].subresources.data(), static_cast<UINT>(swaps[i].subresources.size()));
+    }
+
+    upload_batch_.Flush();
+
+    for (size_t i = 0; i < swaps.size(); i++)
+    {
+      SwapIn(&swaps[i]);
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+
+      for (size_t i = 0; i < swaps.size(); i++)
+      {
+        loaded_size_ -= swaps[i].size;
+        textures_[swaps[i].texture].state = LoadState::Idle;
+      }
+    }
+
+    condition_.notify_all();
+
+    RequestMips(frame);
+
+    return swaps.empty() == false;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void TextureStreamer::SetMemoryBudget(UINT64 memory_budget)
+  {
+    memory_budget_ = memory_budget;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  const std::vector<DescriptorHandle>& TextureStreamer::GetDescriptors() const
+  {
+    return descriptors_;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  UINT64 TextureStreamer::GetResidentSize() const
+  {
+    return resident_size_;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  UINT TextureStreamer::GetNumLoading()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return static_cast<UINT>(std::count_if(textures_.begin(), textures_.end(), [](const StreamedTexture& texture) { return texture.state != LoadState::Idle; }));
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void TextureStreamer::WorkerThread()
+  {
+    while (true)
+    {
+      LoadRequest request;
+
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        // Loaded textures are only swapped in once per frame, the budget keeps workers from racing ahead of that
+        condition_.wait(lock, [&]() { return stop_ || (requests_.empty() == false && loaded_size_ < LOADED_BUDGET); });
+
+        if (stop_)
+        {
+          return;
+        }
+
+        request = requests_.front();
+        requests_.pop_front();
+        textures_[request.texture].state = LoadState::Loading;
+      }
+
+      LoadedTexture loaded;
+      Load(request, &loaded);
+
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        loaded_size_ += loaded.size;
+        loaded_.push_back(std::move(loaded));
+      }
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void TextureStreamer::Load(const LoadRequest& request, LoadedTexture* out_texture)
+  {
+    // Only the path and the usage are read, which never change after Create
+    const StreamedTexture& texture = textures_[request.texture];
+
+    out_texture->texture = request.texture;
+    out_texture->max_dimension = request.max_dimension;
+    out_texture->full_dimension = 0;
+    out_texture->resource = nullptr;
+    out_texture->size = 0;
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    ProcessedTexture& processed = out_texture->processed;
+    TextureProcessor::ProcessTexture(texture.path, texture.usage, &processed, compress_);
+
+    out_texture->process_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    if (processed.compressed_path.empty() == false || processed.mip_levels == 0)
+    {
+      const std::string& dds_path = processed.compressed_path.empty() == false ? processed.compressed_path : texture.path;
+      std::wstring wide_dds_path(dds_path.begin(), dds_path.end());
+
+      // The DDS loader skips the mips that are larger than the requested size by itself
+      ThrowIfFailed(DirectX::LoadDDSTextureFromFile(device_, wide_dds_path.c_str(), &out_texture->resource, out_texture->dds_data, out_texture->subresources, request.max_dimension));
+
+      out_texture->full_dimension = std::max(processed.width, processed.height);
+
+      for (size_t i = 0; i < out_texture->subresources.size(); i++)
+      {
+        out_texture->size += static_cast<size_t>(out_texture->subresources[i].SlicePitch);
+      }
+
+      return;
+    }
+
+    UINT first_mip = 0;
+    size_t first_mip_offset = 0;
+
+    while (first_mip + 1 < processed.mip_levels && std::max(processed.width >> first_mip, processed.height >> first_mip) > request.max_dimension)
+    {
+      first_mip_offset += static_cast<size_t>(std::max(processed.width >> first_mip, 1u)) * std::max(processed.height >> first_mip, 1u) * 4;
+      first_mip++;
+    }
+
+    UINT width = std::max(processed.width >> first_mip, 1u);
+    UINT height = std::max(processed.height >> first_mip, 1u);
+    UINT mip_levels = processed.mip_levels - first_mip;
+
+    ThrowIfFailed(
+      device_->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, static_cast<UINT64>(width), height, 1, static_cast<UINT16>(mip_levels)),
+        D3D12_RESOURCE_STATE_COPY_DEST,
+        nullptr,
+        IID_PPV_ARGS(&out_texture->resource)
+      )
+    );
+
+    // Only the mips that are made resident are held on to until the upload
+    out_texture->mip_chain.assign(processed.mip_chain.begin() + first_mip_offset, processed.mip_chain.end());
+    std::vector<unsigned char>().swap(processed.mip_chain);
+    out_texture->full_dimension = std::max(processed.width, processed.height);
+    out_texture->size = out_texture->mip_chain.size();
+    out_texture->subresources.resize(mip_levels);
+
+    const unsigned char* level_pixels = out_texture->mip_chain.data();
+
+    for (UINT level = 0; level < mip_levels; level++)
+    {
+      UINT level_width = std::max(width >> level, 1u);
+      UINT level_height = std::max(height >> level, 1u);
+
+      out_texture->subresources[level].pData = level_pixels;
+      out_texture->subresources[level].RowPitch = level_width * 4;
+      out_texture->subresources[level].SlicePitch = out_texture->subresources[level].RowPitch * level_height;
+
+      level_pixels += out_texture->subresources[level].SlicePitch;
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void TextureStreamer::SwapIn(LoadedTexture* loaded)
+  {
+    StreamedTexture& texture = textures_[loaded->texture];
+
+    D3D12_RESOURCE_DESC desc = loaded->resource->GetDesc();
+    UINT dimension = static_cast<UINT>(std::max(desc.Width, static_cast<UINT64>(desc.Height)));
+
+    // Without a size from the source, a chain that stays well below the requested size has to start at the top mip
+    if (loaded->full_dimension > 0)
+    {
+      texture.full_dimension = loaded->full_dimension;
+    }
+    else if (dimension <= loaded->max_dimension / 2)
+    {
+      texture.full_dimension = dimension;
+    }
+
+    UINT64 size = device_->GetResourceAllocationInfo(0, 1, &desc).SizeInBytes;
+
+    // Evicted textures keep a resource, only the very first load replaces the placeholder
+    if (texture.resource == nullptr)
+    {
+      initial_textures_[loaded->texture] = std::move(loaded->processed);
+      initial_process_ms_ += loaded->process_ms;
+
+      if (++num_initial_loaded_ == textures_.size())
+      {
+        LogInitialLoad();
+      }
+    }
+
+    RELEASE(texture.resource);
+
+    resident_size_ = resident_size_ - texture.resident_size + size;
+    texture.resource = loaded->resource;
+    texture.resident_dimension = dimension;
+    texture.resident_size = size;
+
+    loaded->resource = nullptr;
+
+    WriteDescriptor(loaded->texture);
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void TextureStreamer::RequestMips(UINT frame)
+  {
+    struct Candidate
+    {
+      size_t texture;
+      UINT max_dimension;
+      UINT64 growth;
+      float priority;
+    };
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Requests that did not start yet are prioritized again together with the new ones
+    for (size_t i = 0; i < requests_.size(); i++)
+    {
+      textures_[requests_[i].texture].state = LoadState::Idle;
+    }
+
+    requests_.clear();
+
+    std::vector<Candidate> candidates;
+    std::vector<size_t> cold_textures;
+    UINT64 total_growth = 0;
+
+    for (size_t i = 0; i < textures_.size(); i++)
+    {
+      const StreamedTexture& texture = textures_[i];
+
+      if (texture.state != LoadState::Idle)
+      {
+        continue;
+      }
+
+      if (texture.resident_dimension > INITIAL_DIMENSION && texture.last_used_frame + EVICTION_DELAY < frame)
+      {
+        cold_textures.push_back(i);
+        continue;
+      }
+
+      // The lowest mips of every texture come before anything else
+      if (texture.resource == nullptr)
+      {
+        candidates.push_back({ i, INITIAL_DIMENSION, 0, FLT_MAX });
+        continue;
+      }
+
+      UINT wanted_dimension = std::max(texture.desired_dimension, INITIAL_DIMENSION);
+      wanted_dimension = texture.full_dimension > 0 ? std::min(wanted_dimension, texture.full_dimension) : wanted_dimension;
+
+      if (wanted_dimension <= texture.resident_dimension)
+      {
+        continue;
+      }
+
+      // Odd sizes round down while halving, so the next mip up can be one texel larger than twice the resident one
+      UINT max_dimension = texture.resident_dimension * 2 + 1;
+      while (max_dimension < wanted_dimension)
+      {
+        max_dimension *= 2;
+      }
+
+      float scale = static_cast<float>(max_dimension) / texture.resident_dimension;
+      UINT64 growth = static_cast<UINT64>(texture.resident_size * (scale * scale - 1.0f));
+
+      candidates.push_back({ i, max_dimension, growth, texture.samples * std::log2(static_cast<float>(wanted_dimension) / texture.resident_dimension) });
+      total_growth += growth;
+    }
+
+    // Textures that were not sampled for the longest time are the first to drop back to their lowest mips
+    std::sort(cold_textures.begin(), cold_textures.end(), [&](size_t a, size_t b) { return textures_[a].last_used_frame < textures_[b].last_used_frame; });
+
+    UINT64 resident_size = resident_size_;
+
+    for (size_t i = 0; i < cold_textures.size() && resident_size + total_growth > memory_budget_; i++)
+    {
+      StreamedTexture& texture = textures_[cold_textures[i]];
+
+      requests_.push_back({ cold_textures[i], INITIAL_DIMENSION });
+      texture.state = LoadState::Queued;
+      texture.desired_dimension = INITIAL_DIMENSION; // Until it is sampled again
+
+      resident_size -= texture.resident_size;
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.priority > b.priority; });
+
+    for (size_t i = 0; i < candidates.size(); i++)
+    {
+      if (resident_size + candidates[i].growth > memory_budget_)
+      {
+        continue;
+      }
+
+      requests_.push_back({ candidates[i].texture, candidates[i].max_dimension });
+      textures_[candidates[i].texture].state = LoadState::Queued;
+
+      resident_size += candidates[i].growth;
+    }
+
+    condition_.notify_all();
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void TextureStreamer::WriteDescriptor(size_t texture)
+  {
+    ID3D12Resource* resource = textures_[texture].resource != nullptr ? textures_[texture].resource : placeholders_[static_cast<UINT>(textures_[texture].usage)];
+    D3D12_SHADER_RESOURCE_VIEW_DESC srv_desc = GetShaderResourceViewDesc(resource);
+
+    device_->CreateShaderResourceView(resource, &srv_desc, descriptors_[texture].cpu_handle());
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void TextureStreamer::LogInitialLoad()
+  {
+    double total_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - create_time_).count();
+
+    std::stringstream message;
+    message << std::fixed << std::setprecision(1);
+    message << "Loaded the lowest mips of " << textures_.size() << " textures in " << total_ms << " ms: processing " << initial_process_ms_ << " ms over " << threads_.size() << " threads, upload " << upload_batch_.GetRecordMilliseconds() << " ms, wait " << upload_batch_.GetWaitMilliseconds() << " ms in " << upload_batch_.GetNumSubmissions() << " submissions.\n";
+    LOG(message.str().c_str());
+
+    TextureProcessor::LogStatistics(initial_textures_, compress_);
+
+    std::vector<ProcessedTexture>().swap(initial_textures_);
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  D3D12_SHADER_RESOURCE_VIEW_DESC TextureStreamer::GetShaderResourceViewDesc(ID3D12Resource* resource)
+  {
+    D3D12_SHADER_RESOURCE_VIEW_DESC srv_desc;
+    srv_desc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+    srv_desc.Format = resource->GetDesc().Format;
+    srv_desc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    srv_desc.Texture2D.MipLevels = static_cast<UINT>(-1); // All resident mips, selected by the ray cones
+    srv_desc.Texture2D.MostDetailedMip = 0;
+    srv_desc.Texture2D.PlaneSlice = 0;
+    srv_desc.Texture2D.ResourceMinLODClamp = 0.0f;
+
+    return srv_desc;
+  }
+}
\ No newline at end of file
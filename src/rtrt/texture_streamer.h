@@ -0,0 +1,140 @@
+#pragma once
+
+#include "texture_processor.h"
+#include "texture_upload_batch.h"
+#include "descriptor_heap.h"
+#include "shared/raytracing_data.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <chrono>
+
+namespace rtrt
+{
+  /**
+  * Streams the mip chains of the scene textures in the background, so large texture sets do not hold up the first
+  * frame. Every texture starts out as a 1x1 placeholder while the lowest mips of all textures are loaded. From then
+  * on the texture feedback of the tracer decides which textures get more detail, the textures that are furthest
+  * from the mip they were sampled at and that were hit the most go first. Once the memory budget is reached, textures
+  * that have not been sampled for a while drop back to their lowest mips.
+  *
+  * A texture that gains or loses mips is replaced by a new resource holding the new chain, its descriptor is
+  * rewritten in place. Once the lowest mips of every texture are resident, the time that took and the texture
+  * processing statistics are logged.
+  */
+  class TextureStreamer
+  {
+  public:
+    TextureStreamer();
+    ~TextureStreamer();
+
+    /**
+    * Binds a placeholder to every texture and starts loading their lowest mips.
+    * @param[in] srv_heap The heap the texture descriptors are allocated from, as one consecutive range
+    * @param[in] texture_paths The paths to the source textures
+    * @param[in] usages How each texture is filtered
+    * @param[in] compress Whether the textures are block compressed into DDS files in the cache
+    * @param[in] memory_budget The number of bytes the streamed mips may use
+    */
+    void Create(ID3D12Device* device, ID3D12CommandQueue* queue, DescriptorHeap* srv_heap, const std::vector<std::string>& texture_paths, const std::vector<TextureUsage>& usages, bool compress, UINT64 memory_budget);
+    void Destroy();
+
+    /**
+    * Swaps in the textures that finished loading and requests new mips based on the texture feedback. Resources
+    * are released and descriptors are rewritten right away, so this may only be called while the GPU is idle.
+    * @param[in] feedback The texture feedback of the last frame, one entry per texture, or nullptr if there is none
+    * @param[in] frame The index of the current frame
+    * @return Whether any texture was swapped, which makes the accumulated samples stale
+    */
+    bool Update(const TextureFeedback* feedback, UINT frame);
+
+    void SetMemoryBudget(UINT64 memory_budget);
+
+    const std::vector<DescriptorHandle>& GetDescriptors() const;
+    UINT64 GetResidentSize() const;
+    UINT GetNumLoading();
+
+    static const UINT INITIAL_DIMENSION = 64; // The lowest mips are loaded up to this size
+    static const UINT EVICTION_DELAY = 120; // Frames a texture has to go unsampled before it can be evicted
+    static const UINT64 UPLOAD_BUDGET = 32ull * 1024 * 1024; // Bytes swapped in per Update
+    static const size_t LOADED_BUDGET = 256ull * 1024 * 1024; // Bytes workers may hold for textures waiting to be swapped in
+
+  private:
+    enum class LoadState
+    {
+      Idle,
+      Queued,
+      Loading
+    };
+
+    struct StreamedTexture
+    {
+      std::string path;
+      TextureUsage usage;
+      ID3D12Resource* resource; // nullptr while the placeholder is bound
+      UINT resident_dimension; // Largest side of the most detailed resident mip, 1 for the placeholder
+      UINT full_dimension; // Largest side of the source texture, 0 until it is known
+      UINT desired_dimension; // Largest side the tracer asked for in the last feedback
+      UINT64 resident_size;
+      UINT samples; // Feedback samples of the last frame
+      UINT last_used_frame;
+      LoadState state; // Guarded by mutex_
+    };
+
+    struct LoadRequest
+    {
+      size_t texture;
+      UINT max_dimension;
+    };
+
+    // A new mip chain, prepared by a worker and waiting to be uploaded
+    struct LoadedTexture
+    {
+      size_t texture;
+      UINT max_dimension;
+      UINT full_dimension; // 0 if the source does not tell, e.g. DDS source files
+      ID3D12Resource* resource;
+      std::vector<D3D12_SUBRESOURCE_DATA> subresources;
+      std::unique_ptr<uint8_t[]> dds_data;
+      std::vector<unsigned char> mip_chain;
+      size_t size;
+
+      ProcessedTexture processed; // Without its texels, for the load statistics
+      double process_ms;
+    };
+
+    void WorkerThread();
+    void Load(const LoadRequest& request, LoadedTexture* out_texture);
+    void SwapIn(LoadedTexture* texture);
+    void RequestMips(UINT frame);
+    void WriteDescriptor(size_t texture);
+    void LogInitialLoad();
+    static D3D12_SHADER_RESOURCE_VIEW_DESC GetShaderResourceViewDesc(ID3D12Resource* resource);
+
+    ID3D12Device* device_;
+    TextureUploadBatch upload_batch_;
+    bool compress_;
+    UINT64 memory_budget_;
+    UINT64 resident_size_;
+
+    std::vector<StreamedTexture> textures_;
+    std::vector<DescriptorHandle> descriptors_;
+    ID3D12Resource* placeholders_[3]; // One per TextureUsage
+
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    std::deque<LoadRequest> requests_;
+    std::deque<LoadedTexture> loaded_;
+    size_t loaded_size_;
+    bool stop_;
+
+    // Statistics of the first load of every texture, logged once all of them are resident
+    std::chrono::high_resolution_clock::time_point create_time_;
+    std::vector<ProcessedTexture> initial_textures_;
+    size_t num_initial_loaded_;
+    double initial_process_ms_;
+  };
+}
\ No newline at end of file
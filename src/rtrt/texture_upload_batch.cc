@@ -0,0 +1,184 @@
+#include "texture_upload_batch.h"
+
+#include <chrono>
+
+namespace rtrt
+{
+  //------------------------------------------------------------------------------------------------------
+  TextureUploadBatch::TextureUploadBatch() :
+    device_(nullptr),
+    queue_(nullptr),
+    allocator_(nullptr),
+    command_list_(nullptr),
+    fence_(nullptr),
+    fence_value_(0),
+    staging_(nullptr),
+    staging_size_(0),
+    staging_offset_(0),
+    num_recorded_(0),
+    record_ms_(0.0),
+    wait_ms_(0.0),
+    num_submissions_(0)
+  {
+
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  TextureUploadBatch::~TextureUploadBatch()
+  {
+    Release();
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void TextureUploadBatch::Begin(ID3D12Device* device, ID3D12CommandQueue* queue, UINT64 staging_size)
+  {
+    Release();
+
+    device_ = device;
+    queue_ = queue;
+    staging_size_ = staging_size;
+    staging_offset_ = 0;
+    num_recorded_ = 0;
+    record_ms_ = 0.0;
+    wait_ms_ = 0.0;
+    num_submissions_ = 0;
+
+    ThrowIfFailed(device_->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&allocator_)));
+    ThrowIfFailed(device_->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, allocator_, nullptr, IID_PPV_ARGS(&command_list_)));
+    ThrowIfFailed(device_->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&fence_)));
+    fence_value_ = 0;
+
+    ThrowIfFailed(
+      device_->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer(staging_size_),
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(&staging_)
+      )
+    );
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void TextureUploadBatch::Upload(ID3D12Resource* texture, const D3D12_SUBRESOURCE_DATA* subresources, UINT num_subresources)
+  {
+    auto start = std::chrono::high_resolution_clock::now();
+    double wait_before = wait_ms_;
+
+    UINT64 required_size = GetRequiredIntermediateSize(texture, 0, num_subresources);
+    ID3D12Resource* intermediate = staging_;
+    UINT64 offset = (staging_offset_ + D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1) & ~static_cast<UINT64>(D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1);
+
+    if (required_size > staging_size_)
+    {
+      // Too large for the ring, gets a staging buffer of its own for the rest of the batch
+      ThrowIfFailed(
+        device_->CreateCommittedResource(
+          &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+          D3D12_HEAP_FLAG_NONE,
+          &CD3DX12_RESOURCE_DESC::Buffer(required_size),
+          D3D12_RESOURCE_STATE_GENERIC_READ,
+          nullptr,
+          IID_PPV_ARGS(&intermediate)
+        )
+      );
+
+      oversized_staging_.push_back(intermediate);
+      offset = 0;
+    }
+    else
+    {
+      if (offset + required_size > staging_size_)
+      {
+        Flush();
+        offset = 0;
+      }
+
+      staging_offset_ = offset + required_size;
+    }
+
+    UpdateSubresources(command_list_, texture, intermediate, offset, 0, num_subresources, const_cast<D3D12_SUBRESOURCE_DATA*>(subresources));
+    command_list_->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(texture, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ));
+
+    num_recorded_++;
+
+    double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    record_ms_ += elapsed_ms - (wait_ms_ - wait_before);
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void TextureUploadBatch::End()
+  {
+    Flush();
+    Release();
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  double TextureUploadBatch::GetRecordMilliseconds() const
+  {
+    return record_ms_;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  double TextureUploadBatch::GetWaitMilliseconds() const
+  {
+    return wait_ms_;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  UINT TextureUploadBatch::GetNumSubmissions() const
+  {
+    return num_submissions_;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void TextureUploadBatch::Flush()
+  {
+    if (num_recorded_ == 0)
+    {
+      return;
+    }
+
+    ThrowIfFailed(command_list_->Close());
+    ID3D12CommandList* lists[] = { command_list_ };
+    queue_->ExecuteCommandLists(1, lists);
+
+    num_submissions_++;
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    fence_value_++;
+    ThrowIfFailed(queue_->Signal(fence_, fence_value_));
+
+    if (fence_->GetCompletedValue() < fence_value_)
+    {
+      ThrowIfFailed(fence_->SetEventOnCompletion(fence_value_, fence_event_.Get()));
+      WaitForSingleObjectEx(fence_event_.Get(), INFINITE, FALSE);
+    }
+
+    wait_ms_ += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    ThrowIfFailed(allocator_->Reset());
+    ThrowIfFailed(command_list_->Reset(allocator_, nullptr));
+
+    staging_offset_ = 0;
+    num_recorded_ = 0;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void TextureUploadBatch::Release()
+  {
+    for (size_t i = 0; i < oversized_staging_.size(); i++)
+    {
+      RELEASE(oversized_staging_[i]);
+    }
+
+    oversized_staging_.clear();
+
+    RELEASE(staging_);
+    RELEASE(fence_);
+    RELEASE(command_list_);
+    RELEASE(allocator_);
+  }
+}
\ No newline at end of file
@@ -0,0 +1,53 @@
+#pragma once
+
+namespace rtrt
+{
+  /**
+  * Records the uploads of many textures into one command list that copies out of a single staging ring. The list
+  * is only submitted when the ring is full and at the end of the batch, so a whole scene costs a handful of
+  * submissions and fence waits instead of one per texture.
+  */
+  class TextureUploadBatch
+  {
+  public:
+    TextureUploadBatch();
+    ~TextureUploadBatch();
+
+    void Begin(ID3D12Device* device, ID3D12CommandQueue* queue, UINT64 staging_size);
+
+    // The texels are copied into the staging ring right away, the source data can be freed as soon as this returns.
+    // The texture has to be in the copy destination state and is left in the generic read state.
+    void Upload(ID3D12Resource* texture, const D3D12_SUBRESOURCE_DATA* subresources, UINT num_subresources);
+
+    // Submits the recorded copies and waits for them, after which the whole staging ring can be reused
+    void Flush();
+
+    // Submits the remaining copies and waits for all of them
+    void End();
+
+    double GetRecordMilliseconds() const;
+    double GetWaitMilliseconds() const;
+    UINT GetNumSubmissions() const;
+
+  private:
+    void Release();
+
+    ID3D12Device* device_;
+    ID3D12CommandQueue* queue_;
+    ID3D12CommandAllocator* allocator_;
+    ID3D12GraphicsCommandList* command_list_;
+    ID3D12Fence* fence_;
+    UINT64 fence_value_;
+    Microsoft::WRL::Wrappers::Event fence_event_;
+
+    ID3D12Resource* staging_;
+    UINT64 staging_size_;
+    UINT64 staging_offset_;
+    std::vector<ID3D12Resource*> oversized_staging_; // Textures larger than the ring, released by End()
+    UINT num_recorded_;
+
+    double record_ms_;
+    double wait_ms_;
+    UINT num_submissions_;
+  };
+}
\ No newline at end of file
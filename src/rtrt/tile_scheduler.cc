@@ -0,0 +1,360 @@
+#include "tile_scheduler.h"
+
+#include <chrono>
+
+namespace rtrt
+{
+  namespace
+  {
+    //------------------------------------------------------------------------------------------------------
+    // Gathers the even bits of a Morton code into the low half
+    UINT CompactBits(UINT x)
+    {
+      x &= 0x55555555;
+      x = (x | (x >> 1)) & 0x33333333;
+      x = (x | (x >> 2)) & 0x0F0F0F0F;
+      x = (x | (x >> 4)) & 0x00FF00FF;
+      x = (x | (x >> 8)) & 0x0000FFFF;
+      return x;
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  TileScheduler::TileScheduler() :
+    num_threads_(0),
+    order_width_(0),
+    order_height_(0),
+    order_tile_size_(0),
+    task_(nullptr),
+    generation_(0),
+    num_running_(0),
+    stop_(false),
+    elapsed_ms_(0.0)
+  {
+
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  TileScheduler::~TileScheduler()
+  {
+    Destroy();
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void TileScheduler::Create(UINT num_threads)
+  {
+    num_threads_ = num_threads > 0 ? num_threads : GetNumProcessors();
+    queues_.reset(new Queue[num_threads_]);
+    generation_ = 0;
+    stop_ = false;
+
+    for (UINT i = 0; i < num_threads_; i++)
+    {
+      queues_[i].range = PackRange(0, 0);
+    }
+
+    ResetStats();
+
+    // The thread calling Run is the first, the pool provides the others
+    for (UINT i = 1; i < num_threads_; i++)
+    {
+      threads_.push_back(std::thread(&TileScheduler::WorkerThread, this, i));
+      PinToProcessorGroup(&threads_.back(), i);
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void TileScheduler::Destroy()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+
+    start_condition_.notify_all();
+
+    for (size_t i = 0; i < threads_.size(); i++)
+    {
+      threads_[i].join();
+    }
+
+    threads_.clear();
+    queues_.reset();
+    num_threads_ = 0;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void TileScheduler::Run(UINT width, UINT height, UINT tile_size, const std::function<void(const Tile&)>& task)
+  {
+    if (width == 0 || height == 0)
+    {
+      return;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    if (width != order_width_ || height != order_height_ || tile_size != order_tile_size_)
+    {
+      BuildOrder(width, height, tile_size);
+    }
+
+    // Contiguous stretches of the Morton order are compact blocks of the image
+    UINT num_tiles = static_cast<UINT>(order_.size());
+    for (UINT i = 0; i < num_threads_; i++)
+    {
+      queues_[i].range = PackRange(static_cast<UINT>(static_cast<UINT64>(num_tiles) * i / num_threads_), static_cast<UINT>(static_cast<UINT64>(num_tiles) * (i + 1) / num_threads_));
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      task_ = &task;
+      num_running_ = num_threads_ - 1;
+      generation_++;
+    }
+
+    start_condition_.notify_all();
+
+    Execute(0);
+
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      done_condition_.wait(lock, [&]() { return num_running_ == 0; });
+      task_ = nullptr;
+    }
+
+    elapsed_ms_ += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void TileScheduler::ResetStats()
+  {
+    for (UINT i = 0; i < num_threads_; i++)
+    {
+      queues_[i].stats.busy_ms = 0.0;
+      queues_[i].stats.num_tiles = 0;
+      queues_[i].stats.num_stolen = 0;
+    }
+
+    elapsed_ms_ = 0.0;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  double TileScheduler::GetStats(std::vector<ThreadStats>* out_stats) const
+  {
+    out_stats->resize(num_threads_);
+
+    for (UINT i = 0; i < num_threads_; i++)
+    {
+      (*out_stats)[i] = queues_[i].stats;
+    }
+
+    return elapsed_ms_;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  UINT TileScheduler::GetNumThreads() const
+  {
+    return num_threads_;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  UINT TileScheduler::GetNumProcessors()
+  {
+    // hardware_concurrency only counts the processor group the process started in
+    UINT num_processors = GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+    return std::max(num_processors, 1u);
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void TileScheduler::WorkerThread(UINT index)
+  {
+    UINT64 generation = 0;
+
+    while (true)
+    {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        start_condition_.wait(lock, [&]() { return stop_ || generation_ != generation; });
+
+        if (stop_)
+        {
+          return;
+        }
+
+        generation = generation_;
+      }
+
+      Execute(index);
+
+      bool last;
+
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        last = --num_running_ == 0;
+      }
+
+      if (last)
+      {
+        done_condition_.notify_one();
+      }
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void TileScheduler::Execute(UINT index)
+  {
+    ThreadStats& stats = queues_[index].stats;
+    const std::function<void(const Tile&)>& task = *task_;
+
+    while (true)
+    {
+      UINT tile;
+
+      if (Pop(index, &tile))
+      {
+        RunTask(task, tile, &stats);
+        continue;
+      }
+
+      // Neighbours first, their stretches of the Morton order are the closest to the one that just ran out.
+      // Tiles are never added during a run, so once every queue is empty the thread is done.
+      bool stolen = false;
+      for (UINT i = 1; i < num_threads_ && stolen == false; i++)
+      {
+        stolen = Steal((index + i) % num_threads_, &tile);
+      }
+
+      if (stolen == false)
+      {
+        break;
+      }
+
+      RunTask(task, tile, &stats);
+      stats.num_stolen++;
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void TileScheduler::RunTask(const std::function<void(const Tile&)>& task, UINT tile, ThreadStats* stats)
+  {
+    // Only the tile itself counts as busy, time spent looking for work is what utilization has to expose
+    auto start = std::chrono::high_resolution_clock::now();
+
+    task(order_[tile]);
+
+    stats->busy_ms += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    stats->num_tiles++;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  bool TileScheduler::Pop(UINT queue, UINT* out_tile)
+  {
+    std::atomic<UINT64>& range = queues_[queue].range;
+    UINT64 current = range.load();
+
+    while (static_cast<UINT>(current) < static_cast<UINT>(current >> 32))
+    {
+      UINT begin = static_cast<UINT>(current);
+
+      if (range.compare_exchange_weak(current, PackRange(begin + 1, static_cast<UINT>(current >> 32))))
+      {
+        *out_tile = begin;
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  bool TileScheduler::Steal(UINT queue, UINT* out_tile)
+  {
+    std::atomic<UINT64>& range = queues_[queue].range;
+    UINT64 current = range.load();
+
+    while (static_cast<UINT>(current) < static_cast<UINT>(current >> 32))
+    {
+      UINT end = static_cast<UINT>(current >> 32);
+
+      if (range.compare_exchange_weak(current, PackRange(static_cast<UINT>(current), end - 1)))
+      {
+        *out_tile = end - 1;
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void TileScheduler::BuildOrder(UINT width, UINT height, UINT tile_size)
+  {
+    UINT tiles_x = (width + tile_size - 1) / tile_size;
+    UINT tiles_y = (height + tile_size - 1) / tile_size;
+
+    // Morton codes of the smallest power of two square that covers the tiles, codes outside of the image are skipped
+    UINT side = 1;
+    while (side < tiles_x || side < tiles_y)
+    {
+      side <<= 1;
+    }
+
+    order_.clear();
+    order_.reserve(static_cast<size_t>(tiles_x) * tiles_y);
+
+    for (UINT code = 0; code < side * side; code++)
+    {
+      UINT tx = CompactBits(code);
+      UINT ty = CompactBits(code >> 1);
+
+      if (tx < tiles_x && ty < tiles_y)
+      {
+        Tile tile;
+        tile.x0 = tx * tile_size;
+        tile.y0 = ty * tile_size;
+        tile.x1 = std::min(tile.x0 + tile_size, width);
+        tile.y1 = std::min(tile.y0 + tile_size, height);
+        order_.push_back(tile);
+      }
+    }
+
+    order_width_ = width;
+    order_height_ = height;
+    order_tile_size_ = tile_size;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void TileScheduler::PinToProcessorGroup(std::thread* thread, UINT index)
+  {
+    WORD num_groups = GetActiveProcessorGroupCount();
+    if (num_groups <= 1)
+    {
+      return;
+    }
+
+    // Threads fill the groups in order, so every logical processor of every group gets one
+    UINT first = 0;
+    for (WORD group = 0; group < num_groups; group++)
+    {
+      UINT count = GetActiveProcessorCount(group);
+
+      if (index % GetNumProcessors() < first + count)
+      {
+        GROUP_AFFINITY affinity = {};
+        affinity.Group = group;
+        affinity.Mask = count >= sizeof(KAFFINITY) * 8 ? ~static_cast<KAFFINITY>(0) : (static_cast<KAFFINITY>(1) << count) - 1;
+
+        SetThreadGroupAffinity(thread->native_handle(), &affinity, nullptr);
+        return;
+      }
+
+      first += count;
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  UINT64 TileScheduler::PackRange(UINT begin, UINT end)
+  {
+    return static_cast<UINT64>(end) << 32 | begin;
+  }
+}
\ No newline at end of file
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+
+namespace rtrt
+{
+  /**
+  * Runs image kernels on square tiles spread over a persistent pool of threads. The tiles are visited in Morton
+  * order, and every thread starts out with one contiguous stretch of that order, so the pixels a thread touches stay
+  * close together in memory. A thread that runs out of tiles steals single tiles from the far end of the other
+  * threads' stretches, which keeps every core busy until the very end without a counter that all threads fight over.
+  *
+  * Threads are spread over every processor group, so machines with more than 64 logical processors are used fully.
+  */
+  class TileScheduler
+  {
+  public:
+    struct Tile
+    {
+      UINT x0; // First column
+      UINT y0; // First row
+      UINT x1; // One past the last column
+      UINT y1; // One past the last row
+    };
+
+    struct ThreadStats
+    {
+      double busy_ms; // Time spent running tiles
+      UINT num_tiles;
+      UINT num_stolen; // Tiles taken from other threads
+    };
+
+  public:
+    TileScheduler();
+    ~TileScheduler();
+
+    /**
+    * @param[in] num_threads The number of threads including the one calling Run, 0 uses every logical processor
+    */
+    void Create(UINT num_threads = 0);
+    void Destroy();
+
+    /**
+    * Runs task once for every tile of the image and returns when all tiles are done. The calling thread runs tiles too.
+    * @param[in] width The width of the image
+    * @param[in] height The height of the image
+    * @param[in] tile_size The width and height of a tile, tiles at the right and bottom edge may be smaller
+    * @param[in] task Called with the tile to process, tiles never overlap so they can write without synchronization
+    */
+    void Run(UINT width, UINT height, UINT tile_size, const std::function<void(const Tile&)>& task);
+
+    // Clears the statistics, they accumulate over every Run until then
+    void ResetStats();
+
+    /**
+    * @param[out] out_stats One entry per thread, the thread calling Run is the first
+    * @return The time spent in Run since the statistics were reset, the time every thread could have been busy
+    */
+    double GetStats(std::vector<ThreadStats>* out_stats) const;
+
+    UINT GetNumThreads() const;
+
+    // Logical processors over all processor groups
+    static UINT GetNumProcessors();
+
+  private:
+    // Every queue is a range of the Morton order, owners pop from the front and thieves from the back of the same word
+    struct Queue
+    {
+      std::atomic<UINT64> range;
+      ThreadStats stats;
+      char padding[128 - sizeof(std::atomic<UINT64>) - sizeof(ThreadStats)]; // Keeps queues off each other's cache lines
+    };
+
+    void WorkerThread(UINT index);
+    void Execute(UINT index);
+    void RunTask(const std::function<void(const Tile&)>& task, UINT tile, ThreadStats* stats);
+    bool Pop(UINT queue, UINT* out_tile);
+    bool Steal(UINT queue, UINT* out_tile);
+
+    void BuildOrder(UINT width, UINT height, UINT tile_size);
+    void PinToProcessorGroup(std::thread* thread, UINT index);
+
+    static UINT64 PackRange(UINT begin, UINT end);
+
+    UINT num_threads_;
+    std::unique_ptr<Queue[]> queues_;
+    std::vector<std::thread> threads_;
+
+    std::vector<Tile> order_;
+    UINT order_width_;
+    UINT order_height_;
+    UINT order_tile_size_;
+
+    const std::function<void(const Tile&)>* task_;
+    std::mutex mutex_;
+    std::condition_variable start_condition_;
+    std::condition_variable done_condition_;
+    UINT64 generation_; // Incremented by every Run, wakes the workers
+    UINT num_running_;
+    bool stop_;
+
+    double elapsed_ms_;
+  };
+}
\ No newline at end of file
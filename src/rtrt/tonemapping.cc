@@ -0,0 +1,329 @@
+#include "tonemapping.h"
+#include "simd_math.h"
+#include "shared/raytracing_data.h"
+
+#include <intrin.h>
+#include <chrono>
+#include <random>
+
+namespace rtrt
+{
+  namespace
+  {
+    // The linear white that the filmic curve maps to 1
+    const float FILMIC_WHITE = 11.2f;
+
+    //------------------------------------------------------------------------------------------------------
+    float HableCurve(float x)
+    {
+      const float a = 0.15f, b = 0.50f, c = 0.10f, d = 0.20f, e = 0.02f, f = 0.30f;
+      return ((x * (a * x + c * b) + d * e) / (x * (a * x + b) + d * f)) - e / f;
+    }
+
+    //------------------------------------------------------------------------------------------------------
+    float Tonemap(float x, UINT tonemapper)
+    {
+      switch (tonemapper)
+      {
+      case TONEMAPPER_REINHARD:
+        return x / (1.0f + x);
+      case TONEMAPPER_FILMIC:
+        return std::min(HableCurve(x * 2.0f) / HableCurve(FILMIC_WHITE), 1.0f);
+      case TONEMAPPER_ACES:
+        return std::min((x * (2.51f * x + 0.03f)) / (x * (2.43f * x + 0.59f) + 0.14f), 1.0f);
+      default:
+        return std::min(x, 1.0f);
+      }
+    }
+
+    //------------------------------------------------------------------------------------------------------
+    __m256 SimdHableCurve(__m256 x)
+    {
+      const __m256 a = _mm256_set1_ps(0.15f);
+      const __m256 b = _mm256_set1_ps(0.50f);
+      const __m256 cb = _mm256_set1_ps(0.10f * 0.50f);
+      const __m256 de = _mm256_set1_ps(0.20f * 0.02f);
+      const __m256 df = _mm256_set1_ps(0.20f * 0.30f);
+      const __m256 e_over_f = _mm256_set1_ps(0.02f / 0.30f);
+
+      __m256 numerator = _mm256_add_ps(_mm256_mul_ps(x, _mm256_add_ps(_mm256_mul_ps(a, x), cb)), de);
+      __m256 denominator = _mm256_add_ps(_mm256_mul_ps(x, _mm256_add_ps(_mm256_mul_ps(a, x), b)), df);
+
+      return _mm256_sub_ps(_mm256_div_ps(numerator, denominator), e_over_f);
+    }
+
+    //------------------------------------------------------------------------------------------------------
+    __m256 SimdTonemap(__m256 x, UINT tonemapper)
+    {
+      const __m256 one = _mm256_set1_ps(1.0f);
+
+      switch (tonemapper)
+      {
+      case TONEMAPPER_REINHARD:
+        return _mm256_div_ps(x, _mm256_add_ps(one, x));
+      case TONEMAPPER_FILMIC:
+        return _mm256_min_ps(_mm256_mul_ps(SimdHableCurve(_mm256_add_ps(x, x)), _mm256_set1_ps(1.0f / HableCurve(FILMIC_WHITE))), one);
+      case TONEMAPPER_ACES:
+      {
+        __m256 numerator = _mm256_mul_ps(x, _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(2.51f), x), _mm256_set1_ps(0.03f)));
+        __m256 denominator = _mm256_add_ps(_mm256_mul_ps(x, _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(2.43f), x), _mm256_set1_ps(0.59f))), _mm256_set1_ps(0.14f));
+        return _mm256_min_ps(_mm256_div_ps(numerator, denominator), one);
+      }
+      default:
+        return _mm256_min_ps(x, one);
+      }
+    }
+
+    //------------------------------------------------------------------------------------------------------
+    // Exposure, curve and gamma of a single linear pixel, alpha is set to 1
+    void DisplayPixel(const float* linear, float scale, float exponent, UINT tonemapper, float* out_display)
+    {
+      for (int c = 0; c < 3; c++)
+      {
+        out_display[c] = std::pow(Tonemap(std::max(linear[c], 0.0f) * scale, tonemapper), exponent);
+      }
+
+      out_display[3] = 1.0f;
+    }
+
+    //------------------------------------------------------------------------------------------------------
+    // DisplayPixel for two pixels at once, the curves work per channel so alpha is simply overwritten at the end
+    __m256 SimdDisplayPixels(__m256 linear, __m256 scale, __m256 exponent, UINT tonemapper)
+    {
+      const __m256 zero = _mm256_setzero_ps();
+      const __m256 one = _mm256_set1_ps(1.0f);
+
+      __m256 mapped = SimdTonemap(_mm256_mul_ps(_mm256_max_ps(linear, zero), scale), tonemapper);
+
+      // log2(0) has no meaning to the polynomial, black stays black like it does for pow
+      __m256 display = SimdExp2(_mm256_mul_ps(SimdLog2(mapped), exponent));
+      display = _mm256_and_ps(display, _mm256_cmp_ps(mapped, zero, _CMP_GT_OQ));
+
+      return _mm256_blend_ps(display, one, 0x88);
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void ToneMappingUtility::Apply(const XMFLOAT4* linear, size_t num_pixels, const ToneMapping& settings, XMFLOAT4* out_display)
+  {
+    if (IsAVX2Supported())
+    {
+      ApplyAVX2(linear, num_pixels, settings, out_display);
+      return;
+    }
+
+    ApplyReference(linear, num_pixels, settings, out_display);
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void ToneMappingUtility::Apply(const XMFLOAT4* linear, size_t num_pixels, const ToneMapping& settings, unsigned char* out_pixels)
+  {
+    XMFLOAT4 display[QUANTIZE_CHUNK];
+
+    for (size_t i = 0; i < num_pixels; i += QUANTIZE_CHUNK)
+    {
+      size_t count = std::min(QUANTIZE_CHUNK, num_pixels - i);
+
+      Apply(linear + i, count, settings, display);
+      Quantize(display, count, out_pixels + i * 4);
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void ToneMappingUtility::Quantize(const XMFLOAT4* display, size_t num_pixels, unsigned char* out_pixels)
+  {
+    for (size_t i = 0; i < num_pixels; i++)
+    {
+      const float* channels = &display[i].x;
+      unsigned char* pixel = out_pixels + i * 4;
+
+      for (int c = 0; c < 3; c++)
+      {
+        pixel[c] = static_cast<unsigned char>(std::min(std::max(channels[c], 0.0f), 1.0f) * 255.0f + 0.5f);
+      }
+
+      pixel[3] = 255;
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void ToneMappingUtility::ApplyReference(const XMFLOAT4* linear, size_t num_pixels, const ToneMapping& settings, XMFLOAT4* out_display)
+  {
+    float scale = std::exp2(settings.exposure);
+    float exponent = 1.0f / settings.gamma;
+
+    for (size_t i = 0; i < num_pixels; i++)
+    {
+      DisplayPixel(&linear[i].x, scale, exponent, settings.tonemapper, &out_display[i].x);
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void ToneMappingUtility::ApplyAVX2(const XMFLOAT4* linear, size_t num_pixels, const ToneMapping& settings, XMFLOAT4* out_display)
+  {
+    const __m256 scale = _mm256_set1_ps(std::exp2(settings.exposure));
+    const __m256 exponent = _mm256_set1_ps(1.0f / settings.gamma);
+
+    size_t i = 0;
+
+    // Two pixels per iteration
+    for (; i + 2 <= num_pixels; i += 2)
+    {
+      _mm256_storeu_ps(&out_display[i].x, SimdDisplayPixels(_mm256_loadu_ps(&linear[i].x), scale, exponent, settings.tonemapper));
+    }
+
+    if (i < num_pixels)
+    {
+      ApplyReference(linear + i, num_pixels - i, settings, out_display + i);
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void ToneMappingUtility::Resolve(const XMFLOAT4* accumulated, size_t num_pixels, const ToneMapping& settings, XMFLOAT4* out_display)
+  {
+    if (IsAVX2Supported())
+    {
+      ResolveAVX2(accumulated, num_pixels, settings, out_display);
+      return;
+    }
+
+    ResolveReference(accumulated, num_pixels, settings, out_display);
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void ToneMappingUtility::ResolveReference(const XMFLOAT4* accumulated, size_t num_pixels, const ToneMapping& settings, XMFLOAT4* out_display)
+  {
+    float scale = std::exp2(settings.exposure);
+    float exponent = 1.0f / settings.gamma;
+
+    for (size_t i = 0; i < num_pixels; i++)
+    {
+      const XMFLOAT4& pixel = accumulated[i];
+      float linear[3] = { pixel.x / pixel.w, pixel.y / pixel.w, pixel.z / pixel.w };
+
+      DisplayPixel(linear, scale, exponent, settings.tonemapper, &out_display[i].x);
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void ToneMappingUtility::ResolveAVX2(const XMFLOAT4* accumulated, size_t num_pixels, const ToneMapping& settings, XMFLOAT4* out_display)
+  {
+    const __m256 scale = _mm256_set1_ps(std::exp2(settings.exposure));
+    const __m256 exponent = _mm256_set1_ps(1.0f / settings.gamma);
+
+    size_t i = 0;
+
+    // Two pixels per iteration, every lane of a pixel is divided by its own sample count
+    for (; i + 2 <= num_pixels; i += 2)
+    {
+      __m256 pixels = _mm256_loadu_ps(&accumulated[i].x);
+      __m256 samples = _mm256_permute_ps(pixels, _MM_SHUFFLE(3, 3, 3, 3));
+
+      _mm256_storeu_ps(&out_display[i].x, SimdDisplayPixels(_mm256_div_ps(pixels, samples), scale, exponent, settings.tonemapper));
+    }
+
+    if (i < num_pixels)
+    {
+      ResolveReference(accumulated + i, num_pixels - i, settings, out_display + i);
+    }
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  bool ToneMappingUtility::IsAVX2Supported()
+  {
+    static const bool supported = []()
+    {
+      int info[4];
+
+      __cpuid(info, 0);
+      if (info[0] < 7)
+      {
+        return false;
+      }
+
+      // AVX needs the OS to save the upper halves of the YMM registers on context switches
+      __cpuid(info, 1);
+      bool osxsave = (info[2] & (1 << 27)) != 0;
+      bool avx = (info[2] & (1 << 28)) != 0;
+
+      if (osxsave == false || avx == false || (_xgetbv(0) & 0x6) != 0x6)
+      {
+        return false;
+      }
+
+      __cpuidex(info, 7, 0);
+      return (info[1] & (1 << 5)) != 0;
+    }();
+
+    return supported;
+  }
+
+  //------------------------------------------------------------------------------------------------------
+  void ToneMappingUtility::RunResolveBenchmark(UINT width, UINT height, UINT iterations)
+  {
+    size_t num_pixels = static_cast<size_t>(width) * height;
+
+    // Samples counts and radiance cover what a progressive render accumulates, including pixels that are still black
+    std::mt19937 random(1337);
+    std::uniform_real_distribution<float> radiance(0.0f, 4.0f);
+    std::uniform_int_distribution<int> samples(1, 4096);
+
+    std::vector<XMFLOAT4> accumulated(num_pixels);
+    for (size_t i = 0; i < num_pixels; i++)
+    {
+      float w = static_cast<float>(samples(random));
+      accumulated[i] = XMFLOAT4(radiance(random) * w, radiance(random) * w, i % 64 == 0 ? 0.0f : radiance(random) * w, w);
+    }
+
+    ToneMapping settings;
+    settings.tonemapper = TONEMAPPER_ACES;
+    settings.exposure = 0.0f;
+    settings.gamma = 2.2f;
+
+    std::vector<XMFLOAT4> reference(num_pixels);
+    std::vector<XMFLOAT4> vectorized(num_pixels);
+
+    auto time_kernel = [&](void(*kernel)(const XMFLOAT4*, size_t, const ToneMapping&, XMFLOAT4*), std::vector<XMFLOAT4>* out_display)
+    {
+      auto start = std::chrono::high_resolution_clock::now();
+
+      for (UINT i = 0; i < iterations; i++)
+      {
+        kernel(accumulated.data(), num_pixels, settings, out_display->data());
+      }
+
+      return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / iterations;
+    };
+
+    double reference_ms = time_kernel(&ResolveReference, &reference);
+
+    std::stringstream message;
+    message << "Resolve benchmark, " << width << "x" << height << " over " << iterations << " iterations\n";
+    message << "  Reference: " << std::fixed << std::setprecision(3) << reference_ms << " ms\n";
+
+    if (IsAVX2Supported() == false)
+    {
+      message << "  AVX2: not supported by this CPU\n";
+      LOG(message.str().c_str());
+      return;
+    }
+
+    double vectorized_ms = time_kernel(&ResolveAVX2, &vectorized);
+
+    float max_error = 0.0f;
+    for (size_t i = 0; i < num_pixels; i++)
+    {
+      const float* a = &reference[i].x;
+      const float* b = &vectorized[i].x;
+
+      for (int c = 0; c < 4; c++)
+      {
+        max_error = std::max(max_error, std::abs(a[c] - b[c]) / std::max(std::abs(a[c]), 1e-6f));
+      }
+    }
+
+    message << "  AVX2: " << vectorized_ms << " ms (" << std::setprecision(1) << reference_ms / vectorized_ms << "x)\n";
+    message << "  Largest relative difference: " << std::scientific << std::setprecision(2) << max_error << "\n";
+    LOG(message.str().c_str());
+  }
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+#pragma once
+
+namespace rtrt
+{
+  /**
+  * How linear HDR radiance becomes a displayable image: exposed, mapped to [0, 1] by one of the TONEMAPPER_* curves
+  * and gamma corrected.
+  */
+  struct ToneMapping
+  {
+    UINT tonemapper; // One of TONEMAPPER_* in raytracing_data.h
+    float exposure; // In stops
+    float gamma;
+  };
+
+  /**
+  * CPU twin of the display path of averager.cs.hlsl: Resolve turns accumulated radiance into display values exactly like
+  * the averager does, Apply does the same for linear images that are produced on the CPU like denoised ones.
+  * The reference kernels are the exact math of tonemapping.hlsli, the AVX2 kernels map two pixels per instruction and
+  * evaluate the gamma curve with polynomial exp2/log2 approximations.
+  */
+  class ToneMappingUtility
+  {
+  public:
+    /**
+    * Tonemaps every pixel with the fastest kernel the CPU supports.
+    * @param[in] linear The linear radiance, one XMFLOAT4 per pixel
+    * @param[in] num_pixels The number of pixels to tonemap
+    * @param[in] settings The exposure, curve and gamma to apply
+    * @param[out] out_display The display values in [0, 1], alpha is set to 1
+    */
+    static void Apply(const XMFLOAT4* linear, size_t num_pixels, const ToneMapping& settings, XMFLOAT4* out_display);
+
+    /**
+    * Tonemaps every pixel and quantizes the result to RGBA8.
+    * @param[in] linear The linear radiance, one XMFLOAT4 per pixel
+    * @param[in] num_pixels The number of pixels to tonemap
+    * @param[in] settings The exposure, curve and gamma to apply
+    * @param[out] out_pixels num_pixels RGBA8 pixels, alpha is set to 255
+    */
+    static void Apply(const XMFLOAT4* linear, size_t num_pixels, const ToneMapping& settings, unsigned char* out_pixels);
+
+    // Quantizes display values in [0, 1] to RGBA8, alpha is set to 255
+    static void Quantize(const XMFLOAT4* display, size_t num_pixels, unsigned char* out_pixels);
+
+    // The scalar kernel, per pixel identical to tonemapping.hlsli
+    static void ApplyReference(const XMFLOAT4* linear, size_t num_pixels, const ToneMapping& settings, XMFLOAT4* out_display);
+
+    // Differs from the reference by the error of the gamma approximation only, below 1e-5 relative
+    static void ApplyAVX2(const XMFLOAT4* linear, size_t num_pixels, const ToneMapping& settings, XMFLOAT4* out_display);
+
+    /**
+    * Resolves accumulated radiance, where the w component holds the number of samples, with the fastest kernel the CPU supports.
+    * @param[in] accumulated The accumulated radiance, one XMFLOAT4 per pixel
+    * @param[in] num_pixels The number of pixels to resolve
+    * @param[in] settings The exposure, curve and gamma to apply
+    * @param[out] out_display The display values in [0, 1], alpha is set to 1
+    */
+    static void Resolve(const XMFLOAT4* accumulated, size_t num_pixels, const ToneMapping& settings, XMFLOAT4* out_display);
+
+    // The scalar kernel, per pixel identical to the display output of the averager
+    static void ResolveReference(const XMFLOAT4* accumulated, size_t num_pixels, const ToneMapping& settings, XMFLOAT4* out_display);
+
+    // Differs from the reference by the error of the gamma approximation only
+    static void ResolveAVX2(const XMFLOAT4* accumulated, size_t num_pixels, const ToneMapping& settings, XMFLOAT4* out_display);
+
+    // Whether both the CPU and the OS support AVX2, i.e. whether the AVX2 kernels may be called
+    static bool IsAVX2Supported();
+
+    /**
+    * Times both resolve kernels on a synthetic accumulation buffer and logs their throughput and the largest difference
+    * between them. Started with --benchmark-resolve on the command line.
+    * @param[in] width The width of the synthetic image
+    * @param[in] height The height of the synthetic image
+    * @param[in] iterations How many times every kernel resolves the image
+    */
+    static void RunResolveBenchmark(UINT width, UINT height, UINT iterations);
+
+  private:
+    static const size_t QUANTIZE_CHUNK = 256; // Pixels tonemapped at a time on their way to RGBA8, fits on the stack
+  };
+}
\ No newline at end of file